@@ -1,19 +1,104 @@
 #include <Lemon/Graphics/Graphics.h>
+#include <Lemon/Graphics/Raster.h>
 #include <Lemon/Graphics/Surface.h>
 #include <Lemon/GUI/Window.h>
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <time.h>
+
+// Benchmark on rows of a 1080p framebuffer
+#define BENCHMARK_WIDTH 1920
+#define BENCHMARK_HEIGHT 1080
+// Time to run each kernel for (in ms)
+#define BENCHMARK_TIME 250
+
+using namespace Lemon::Graphics;
 
 Surface imageSurf;
 
+static long MsSince(const timespec& start) {
+    timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+
+    return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+}
+
+// Run the kernel over the whole surface until BENCHMARK_TIME has passed, returns Mpixels/s
+template <typename F> static double BenchmarkKernel(F kernel) {
+    long pixels = 0;
+
+    timespec start;
+    clock_gettime(CLOCK_BOOTTIME, &start);
+
+    long elapsed;
+    do {
+        for (int i = 0; i < BENCHMARK_HEIGHT; i++) {
+            kernel(i * BENCHMARK_WIDTH);
+        }
+        pixels += BENCHMARK_WIDTH * BENCHMARK_HEIGHT;
+    } while ((elapsed = MsSince(start)) < BENCHMARK_TIME);
+
+    return pixels / (elapsed * 1000.0);
+}
+
+// Report the throughput of every raster kernel for each ISA the CPU supports
+static int Benchmark() {
+    uint32_t* dest = new uint32_t[BENCHMARK_WIDTH * BENCHMARK_HEIGHT];
+    uint32_t* src = new uint32_t[BENCHMARK_WIDTH * BENCHMARK_HEIGHT];
+    uint8_t* mask = new uint8_t[BENCHMARK_WIDTH * BENCHMARK_HEIGHT];
+
+    // Translucent source over an opaque destination, as when compositing windows
+    for (int i = 0; i < BENCHMARK_WIDTH * BENCHMARK_HEIGHT; i++) {
+        src[i] = (rand() & 0xffffff) | ((i % 255) << 24);
+        dest[i] = rand() | 0xff000000;
+        mask[i] = i % 256;
+    }
+
+    printf("Raster kernels (Mpixels/s), CPU supports %s\n", Raster::ISAName(Raster::BestISA()));
+    printf("%-8s %10s %10s %10s %10s %10s %10s %10s\n", "", "fill", "gradient", "blend", "alphafill", "mask",
+           "composite", "colourkey");
+
+    for (int isa = 0; isa < Raster::ISACount; isa++) {
+        const Raster::Kernels* k = Raster::GetKernels(static_cast<Raster::ISA>(isa));
+        if (!k) {
+            continue;
+        }
+
+        double fill = BenchmarkKernel([&](int row) { k->fill(dest + row, 0xff336699, BENCHMARK_WIDTH); });
+        double gradient = BenchmarkKernel(
+            [&](int row) { k->gradient(dest + row, 0xff000000, 0xffffffff, BENCHMARK_WIDTH, BENCHMARK_WIDTH); });
+        double blend = BenchmarkKernel([&](int row) { k->alphaBlend(dest + row, src + row, BENCHMARK_WIDTH); });
+        double alphaFill = BenchmarkKernel([&](int row) { k->alphaFill(dest + row, 0x80336699, BENCHMARK_WIDTH); });
+        double maskBlend =
+            BenchmarkKernel([&](int row) { k->maskBlend(dest + row, 0xff336699, mask + row, BENCHMARK_WIDTH); });
+        double composite =
+            BenchmarkKernel([&](int row) { k->compositePremultiplied(dest + row, src + row, BENCHMARK_WIDTH); });
+        double colourKey =
+            BenchmarkKernel([&](int row) { k->blitColourKey(dest + row, src + row, src[0], BENCHMARK_WIDTH); });
+
+        printf("%-8s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", Raster::ISAName(static_cast<Raster::ISA>(isa)),
+               fill, gradient, blend, alphaFill, maskBlend, composite, colourKey);
+    }
+
+    delete[] dest;
+    delete[] src;
+    delete[] mask;
+    return 0;
+}
+
 void OnPaint(surface_t* surface){
     memset(surface->buffer, 0, surface->width * surface->height * 4);
     surface->Blit(&imageSurf, {0, 0});
 }
 
-int main(){
+int main(int argc, char** argv){
+    if (argc > 1 && !strcmp(argv[1], "--benchmark")) {
+        return Benchmark();
+    }
+
     Lemon::Graphics::LoadImage("/system/lemon/resources/alphatest.png", &imageSurf);
 
     Lemon::GUI::Window* win = new Lemon::GUI::Window("Test Window", {imageSurf.width, imageSurf.height}, WINDOW_FLAGS_TRANSPARENT, Lemon::GUI::WindowType::Basic);
@@ -14,7 +14,7 @@ Lemon::GUI::TextBox* textbox;
 Lemon::GUI::Button* okButton;
 
 void Run(){
-    std::string& text = textbox->contents.front();
+    std::string text = textbox->GetText();
     std::vector<char*> args;
 
     size_t argPos;
@@ -85,6 +85,7 @@ void OnPress(Lemon::GUI::Button* button){
 
 int main(int argc, char** argv){
     window = new Lemon::GUI::Window("Run...", {200, 78}, 0, Lemon::GUI::WindowType::GUI);
+    window->EnableDamageTracking();
 
     textbox = new Lemon::GUI::TextBox({10, 10, 10, 24}, false);
     textbox->SetLayout(Lemon::GUI::LayoutSize::Stretch, Lemon::GUI::LayoutSize::Fixed);
@@ -284,7 +284,7 @@ Lemon::GUI::Window* InitializeMenu() {
             menuModel.filter.OnSubmit(listView->selected);
         } else {
             filterBox->OnKeyPress(ev.key); // Send straight to textbox
-            menuModel.filter.SetFilter(filterBox->contents.front());
+            menuModel.filter.SetFilter(filterBox->GetText());
         }
         return true;
     });
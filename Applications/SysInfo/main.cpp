@@ -14,6 +14,7 @@ Lemon::GUI::Bitmap* bannerW;
 
 Lemon::GUI::Label* totalMem;
 Lemon::GUI::Label* usedMem;
+Lemon::GUI::Label* cacheMem[LEMON_SYSINFO_MAX_CACHES];
 
 char versionString[80];
 
@@ -49,6 +50,13 @@ int main(int argc, char** argv){
     window->AddWidget(usedMem);
     ypos += 16;
 
+    for(int i = 0; i < sysInfo.cacheCount; i++){
+        snprintf(buf, 64, "%s: %lu KB (%lu KB reclaimable)", sysInfo.caches[i].name, sysInfo.caches[i].usage, sysInfo.caches[i].reclaimable);
+        cacheMem[i] = new Lemon::GUI::Label(buf, {{12, ypos}, {200, 12}});
+        window->AddWidget(cacheMem[i]);
+        ypos += 16;
+    }
+
 	while(!window->closed){
 		Lemon::WindowServer::Instance()->Poll();
         
@@ -58,9 +66,15 @@ int main(int argc, char** argv){
         lemon_sysinfo_t _sysInfo = Lemon::SysInfo();
 
         if(_sysInfo.usedMem != sysInfo.usedMem){
-            snprintf(buf, 64, "Used System Memory: %lu MB (%lu KB)", sysInfo.usedMem / 1024, sysInfo.usedMem);
+            snprintf(buf, 64, "Used System Memory: %lu MB (%lu KB)", _sysInfo.usedMem / 1024, _sysInfo.usedMem);
             usedMem->label = buf;
-        } sysInfo = _sysInfo;
+        }
+
+        for(int i = 0; i < sysInfo.cacheCount && i < _sysInfo.cacheCount; i++){
+            snprintf(buf, 64, "%s: %lu KB (%lu KB reclaimable)", _sysInfo.caches[i].name, _sysInfo.caches[i].usage, _sysInfo.caches[i].reclaimable);
+            cacheMem[i]->label = buf;
+        }
+        sysInfo = _sysInfo;
 
         Lemon::WindowServer::Instance()->Wait();
 	}
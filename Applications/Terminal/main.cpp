@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <vector>
 
@@ -8,6 +10,7 @@
 #include <signal.h>
 #include <sys/ioctl.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <Lemon/Core/Keyboard.h>
@@ -17,7 +20,10 @@
 #include "colours.h"
 #include "escape.h"
 
+// Lines kept in the scrollback buffer, including the lines on screen
 #define SCROLLBACK_BUFFER_MAX 400
+// Whilst output keeps coming, paint at most this often (us)
+#define TERMINAL_FRAME_INTERVAL 16000
 
 using namespace Lemon;
 
@@ -47,58 +53,159 @@ struct TerminalChar {
     inline operator uint32_t() { return ch; }
 };
 
-using TerminalLine = std::vector<TerminalChar>;
+// Ring of scrollbackCapacity lines, each terminalSize.x characters.
+// Scrolling moves screenTop forward and reuses the oldest line for the new one.
+std::vector<TerminalChar> scrollbackBuffer;
+int scrollbackCapacity = 0;
+int scrollbackLines = 0; // Lines in use, including the screen
+int screenTop = 0;       // Line of the ring at the top of the screen
 
-std::vector<TerminalLine> scrollbackBuffer;
+// Painting state, the canvas holds the last painted frame
+// as the window buffers are swapped every paint
+Surface canvas;
+std::vector<uint8_t> dirtyLines; // Screen lines changed since the last paint
+int pendingScroll = 0;           // Lines scrolled since the last paint
+bool fullRepaint = true;
+Vector2i paintedCursorPosition = {1, 1};
 
-TerminalLine& GetLine(int cursorY) {
-    assert(scrollbackBuffer.size() >= static_cast<unsigned>(terminalSize.y));
+inline TerminalChar* GetLine(int cursorY) {
+    assert(cursorY >= 1 && cursorY <= terminalSize.y);
 
     // Cursor starts at (1, 1)
-    TerminalLine& ln = scrollbackBuffer[scrollbackBuffer.size() - terminalSize.y + (cursorY - 1)];
-
-    // Ensure the line is the right size
-    if (ln.size() != static_cast<unsigned>(terminalSize.x))
-        ln.resize(terminalSize.x);
-    return ln;
+    return &scrollbackBuffer[((screenTop + cursorY - 1) % scrollbackCapacity) * terminalSize.x];
 }
 
-inline auto FirstLine() { return scrollbackBuffer.begin() + (scrollbackBuffer.size() - terminalSize.y); }
+inline void MarkDirty(int cursorY) { dirtyLines[cursorY - 1] = 1; }
+
+// Blank the characters [start, end) of a line
+inline void ClearLine(int cursorY, int start, int end) {
+    TerminalChar* ln = GetLine(cursorY);
+    std::fill(ln + start, ln + end, TerminalChar(0));
+    MarkDirty(cursorY);
+}
 
 void OnPaint(Surface* surf) {
-    assert(scrollbackBuffer.size() >= static_cast<unsigned>(terminalSize.y));
-
-    Vector2i screenPos = {0, 0};
-    for (unsigned i = scrollbackBuffer.size() - terminalSize.y; i < scrollbackBuffer.size(); i++) {
-        screenPos.x = 0;
-        for (auto& c : scrollbackBuffer[i]) {
-            Lemon::Graphics::DrawRect(Rect{screenPos, characterSize}, c.background, surf);
-            Lemon::Graphics::DrawChar(c.ch, screenPos.x, screenPos.y, c.foreground, surf, terminalFont);
-            screenPos.x += characterSize.x;
+    if (canvas.width != surf->width || canvas.height != surf->height) {
+        delete[] canvas.buffer;
 
-            if(screenPos.x >= surf->width) {
-                break;
+        canvas.width = surf->width;
+        canvas.height = surf->height;
+        canvas.buffer = new uint8_t[canvas.BufferSize()];
+        fullRepaint = true;
+    }
+
+    if (fullRepaint || pendingScroll >= terminalSize.y) {
+        Lemon::Graphics::DrawRect(Rect{0, 0, canvas.width, canvas.height}, defaultBackgroundColour, &canvas);
+        std::fill(dirtyLines.begin(), dirtyLines.end(), 1);
+    } else if (pendingScroll > 0) {
+        // Move what is still on screen up, only the new lines have to be drawn
+        size_t pitch = canvas.width * 4;
+        size_t scrollBytes = pendingScroll * characterSize.y * pitch;
+        size_t screenBytes = terminalSize.y * characterSize.y * pitch;
+        memmove(canvas.buffer, canvas.buffer + scrollBytes, screenBytes - scrollBytes);
+
+        // Where the old cursor ended up after scrolling
+        paintedCursorPosition.y -= pendingScroll;
+    }
+
+    // Erase the cursor from where it was last painted
+    if (paintedCursorPosition.y >= 1 && paintedCursorPosition.y <= terminalSize.y) {
+        MarkDirty(paintedCursorPosition.y);
+    }
+    if (cursorPosition.y >= 1 && cursorPosition.y <= terminalSize.y) {
+        MarkDirty(cursorPosition.y);
+    }
+
+    for (int y = 1; y <= terminalSize.y; y++) {
+        if (!dirtyLines[y - 1]) {
+            continue;
+        }
+
+        Vector2i screenPos = {0, (y - 1) * characterSize.y};
+        TerminalChar* ln = GetLine(y);
+        for (int x = 0; x < terminalSize.x && screenPos.x < canvas.width; x++) {
+            const TerminalChar& c = ln[x];
+            Lemon::Graphics::DrawRect(Rect{screenPos, characterSize}, c.background, &canvas);
+            if (c.ch && c.ch != ' ') {
+                Lemon::Graphics::DrawChar(c.ch, screenPos.x, screenPos.y, c.foreground, &canvas, terminalFont);
             }
+            screenPos.x += characterSize.x;
         }
-        screenPos.y += characterSize.y;
+
+        dirtyLines[y - 1] = 0;
     }
 
     Lemon::Graphics::DrawRect(
         Rect{{(cursorPosition.x - 1) * characterSize.x, (cursorPosition.y - 1) * characterSize.y}, characterSize},
-        currentForegroundColour, surf);
+        currentForegroundColour, &canvas);
+
+    paintedCursorPosition = cursorPosition;
+    pendingScroll = 0;
+    fullRepaint = false;
+
+    memcpy(surf->buffer, canvas.buffer, canvas.BufferSize());
 }
 
 void ClearScrollbackBuffer() {
-    scrollbackBuffer = std::vector<TerminalLine>(terminalSize.y, TerminalLine(terminalSize.x, TerminalChar(0)));
+    scrollbackCapacity = std::max(SCROLLBACK_BUFFER_MAX, terminalSize.y);
+    scrollbackBuffer.assign(scrollbackCapacity * terminalSize.x, TerminalChar(0));
+    scrollbackLines = terminalSize.y;
+    screenTop = 0;
+
+    dirtyLines.assign(terminalSize.y, 1);
+    pendingScroll = 0;
+    fullRepaint = true;
 }
 
-void AddLine() {
-    if (scrollbackBuffer.size() < SCROLLBACK_BUFFER_MAX) {
-        scrollbackBuffer.push_back(TerminalLine(terminalSize.x, TerminalChar(0)));
-    } else {
-        scrollbackBuffer.erase(scrollbackBuffer.begin());
-        scrollbackBuffer.push_back(TerminalLine(terminalSize.x, TerminalChar(0)));
+// Change the dimensions of the scrollback buffer and screen,
+// keeping the cursor on screen
+void ResizeScrollbackBuffer(Vector2i newSize) {
+    std::vector<TerminalChar> old = std::move(scrollbackBuffer);
+    int oldCapacity = scrollbackCapacity;
+    int oldColumns = terminalSize.x;
+    int oldRows = terminalSize.y;
+    int historyLines = scrollbackLines - oldRows; // Lines above the screen
+
+    // If the screen gets shorter than the cursor position, scroll
+    int shift = std::max(0, cursorPosition.y - newSize.y);
+
+    terminalSize = newSize;
+    scrollbackCapacity = std::max(SCROLLBACK_BUFFER_MAX, terminalSize.y);
+    scrollbackBuffer.assign(scrollbackCapacity * terminalSize.x, TerminalChar(0));
+
+    // Unwrap the ring, oldest line first
+    int newHistory = std::min(historyLines + shift, scrollbackCapacity - terminalSize.y);
+    int columns = std::min(oldColumns, terminalSize.x);
+    for (int i = -newHistory; i < terminalSize.y && shift + i < oldRows; i++) {
+        int oldLine = (screenTop + shift + i + oldCapacity) % oldCapacity;
+        std::copy(old.begin() + oldLine * oldColumns, old.begin() + oldLine * oldColumns + columns,
+                  scrollbackBuffer.begin() + (newHistory + i) * terminalSize.x);
     }
+
+    screenTop = newHistory;
+    scrollbackLines = newHistory + terminalSize.y;
+
+    cursorPosition.y -= shift;
+    cursorPosition.x = std::min(cursorPosition.x, terminalSize.x);
+
+    dirtyLines.assign(terminalSize.y, 1);
+    pendingScroll = 0;
+    fullRepaint = true;
+}
+
+// Scroll the screen up by a line
+void AddLine() {
+    screenTop = (screenTop + 1) % scrollbackCapacity;
+    scrollbackLines = std::min(scrollbackLines + 1, scrollbackCapacity);
+
+    // Once the ring is full this overwrites the oldest line
+    TerminalChar* ln = GetLine(terminalSize.y);
+    std::fill(ln, ln + terminalSize.x, TerminalChar(0));
+
+    // The screen contents move up with the lines, keep the dirty state with them
+    std::copy(dirtyLines.begin() + 1, dirtyLines.end(), dirtyLines.begin());
+    dirtyLines.back() = 1;
+    pendingScroll++;
 }
 
 void AdvanceCursorY() {
@@ -125,8 +232,8 @@ void PutChar(uint32_t ch) {
         AdvanceCursorY();
     }
 
-    TerminalLine& line = GetLine(cursorPosition.y);
-    line.at(cursorPosition.x - 1) = TerminalChar(ch);
+    GetLine(cursorPosition.y)[cursorPosition.x - 1] = TerminalChar(ch);
+    MarkDirty(cursorPosition.y);
 }
 
 // Print a char on screen and advance the cursor
@@ -300,17 +407,13 @@ void ParseChar(char ch) {
             } break;
             case ANSI_CSI_ED: {
                 int num = atoi(escapeBuffer.c_str());
-                auto& ln = GetLine(cursorPosition.y);
                 switch (num) {
                 default:
                 case 0: // Clear entire screen from cursor
-                    ln.erase(ln.begin() + (cursorPosition.x - 1), ln.end());
-                    ln.insert(ln.end(), terminalSize.x - (cursorPosition.x - 1), TerminalChar(0));
-
-                    assert(ln.size() == static_cast<unsigned>(terminalSize.x));
-                    scrollbackBuffer.erase(FirstLine() + (cursorPosition.y - 1) + 1, scrollbackBuffer.end());
-                    scrollbackBuffer.insert(scrollbackBuffer.end(), terminalSize.y - (cursorPosition.y - 1),
-                                            TerminalLine(terminalSize.x, TerminalChar(0)));
+                    ClearLine(cursorPosition.y, std::min(cursorPosition.x, terminalSize.x) - 1, terminalSize.x);
+                    for (int y = cursorPosition.y + 1; y <= terminalSize.y; y++) {
+                        ClearLine(y, 0, terminalSize.x);
+                    }
                     break;
                 case 1: // Clear screen and move cursor
                 case 2: // Same as 1 but delete everything in the scrollback buffer
@@ -326,25 +429,20 @@ void ParseChar(char ch) {
                     n = atoi(escapeBuffer.c_str());
                 }
 
-                auto& ln = GetLine(cursorPosition.y);
+                int x = std::min(cursorPosition.x, terminalSize.x);
                 switch (n) {
                 case 2: // Clear entire screen
                     ClearScrollbackBuffer();
                     cursorPosition = {1, 1};
                     break;
                 case 1: // Clear from cursor to beginning of line
-                    ln.erase(ln.begin(), ln.begin() + (cursorPosition.x - 1));
-                    ln.insert(ln.begin(), cursorPosition.x, TerminalChar(0));
+                    ClearLine(cursorPosition.y, 0, x);
                     break;
                 case 0: // Clear from cursor to end of line
                 default:
-                    ln.erase(ln.begin() + (cursorPosition.x - 1), ln.end());
-                    ln.insert(ln.end(), terminalSize.x - (cursorPosition.x - 1), TerminalChar(0));
+                    ClearLine(cursorPosition.y, x - 1, terminalSize.x);
                     break;
                 }
-
-                if (ln.size() != static_cast<unsigned>(terminalSize.x))
-                    ln.resize(terminalSize.x);
                 break;
             }
             case ANSI_CSI_IL: // Insert blank lines
@@ -363,7 +461,10 @@ void ParseChar(char ch) {
                     amount = atoi(escapeBuffer.c_str());
                 }
 
-                scrollbackBuffer.insert(scrollbackBuffer.end(), amount, TerminalLine(terminalSize.x, TerminalChar(0)));
+                amount = std::min(amount, terminalSize.y);
+                while (amount-- > 0) {
+                    AddLine();
+                }
                 break;
             }
             case ANSI_CSI_SD: { // Scroll Down
@@ -372,7 +473,15 @@ void ParseChar(char ch) {
                     amount = atoi(escapeBuffer.c_str());
                 }
 
-                scrollbackBuffer.insert(FirstLine(), amount, TerminalLine(terminalSize.x, TerminalChar(0)));
+                amount = std::max(std::min(amount, terminalSize.y), 0);
+                for (int y = terminalSize.y; y > amount; y--) {
+                    std::copy(GetLine(y - amount), GetLine(y - amount) + terminalSize.x, GetLine(y));
+                    MarkDirty(y);
+                }
+
+                for (int y = 1; y <= amount; y++) {
+                    ClearLine(y, 0, terminalSize.x);
+                }
                 break;
             }
             default:
@@ -450,17 +559,48 @@ void SIGCHLDHandler(int){
     isOpen = false; // Shell has closed
 }
 
+static inline uint64_t Microseconds() {
+    timespec t;
+    clock_gettime(CLOCK_BOOTTIME, &t);
+    return t.tv_sec * 1000000ULL + t.tv_nsec / 1000;
+}
+
 void* PTYThread() {
     pollfd pollFd = {.fd = ptyMasterFd, .events = POLLIN};
+    char buf[4096];
+    uint64_t lastPaint = 0;
+
     while (isOpen) {
         if (poll(&pollFd, 1, 500000) > 0) {
-            char buf[512];
-            ssize_t r;
+            // Output arriving within a frame of the last paint is parsed before painting again,
+            // so large amounts of output are not painted for every read
+            uint64_t paintAt = lastPaint + TERMINAL_FRAME_INTERVAL;
+
             bufferMutex.lock();
-            while ((r = read(ptyMasterFd, buf, 512)) > 0) {
-                int i = 0;
-                while (r--) {
-                    ParseChar(buf[i++]);
+            while (isOpen) {
+                ssize_t r;
+                while ((r = read(ptyMasterFd, buf, sizeof(buf))) > 0) {
+                    for (ssize_t i = 0; i < r; i++) {
+                        ParseChar(buf[i]);
+                    }
+
+                    if (Microseconds() >= paintAt) {
+                        break;
+                    }
+                }
+
+                uint64_t now = Microseconds();
+                if (now >= paintAt) {
+                    break;
+                }
+
+                // Let the main thread in whilst waiting for more
+                bufferMutex.unlock();
+                int more = poll(&pollFd, 1, (paintAt - now + 999) / 1000);
+                bufferMutex.lock();
+
+                if (more <= 0) {
+                    break;
                 }
             }
             bufferMutex.unlock();
@@ -468,6 +608,8 @@ void* PTYThread() {
             std::unique_lock lock(paintMutex);
             terminalWindow->Paint();
             shouldPaint = false;
+
+            lastPaint = Microseconds();
         }
     }
 
@@ -490,8 +632,7 @@ int main(int argc, char** argv) {
         Vector2i{terminalWindow->GetSize().x / characterSize.x, terminalWindow->GetSize().y / characterSize.y};
 
     ClearScrollbackBuffer();
-    assert(FirstLine() == scrollbackBuffer.begin());
-    assert(&GetLine(1) == &scrollbackBuffer.at(0));
+    assert(GetLine(1) == &scrollbackBuffer.at(0));
 
     int ptySlaveFd = -1;
 
@@ -542,6 +683,13 @@ int main(int argc, char** argv) {
 
         close(ptySlaveFd);
 
+        // Run the command given on the command line instead of the shell
+        if (argc > 1) {
+            execvp(argv[1], argv + 1);
+            perror("execvp");
+            exit(1);
+        }
+
         char arg0[] = "/bin/lsh";
         char* const shArgv[] {
             arg0,
@@ -605,27 +753,11 @@ int main(int argc, char** argv) {
         }
 
         if (shouldResize) {
-            int linesToAdd = newSize.y / characterSize.y - terminalSize.y;
-            int colsToAdd = newSize.x / characterSize.x - terminalSize.x;
-
             // Make sure we repaint the window and stop other thread from painting
             std::unique_lock lock(bufferMutex);
             std::unique_lock lockPaint(paintMutex);
 
-            terminalSize = Vector2i{newSize.x / characterSize.x, newSize.y / characterSize.y};
-
-            for (auto it = FirstLine(); it != scrollbackBuffer.end(); ++it) {
-                if (colsToAdd > 0) {
-                    it->insert(it->end(), colsToAdd, TerminalChar(0));
-                }
-
-                it->resize(terminalSize.x);
-            }
-
-            while (linesToAdd > 0) {
-                AddLine();
-                linesToAdd--;
-            }
+            ResizeScrollbackBuffer(Vector2i{newSize.x / characterSize.x, newSize.y / characterSize.y});
 
             // Round to nearest character
             terminalWindow->Resize({terminalSize.x * characterSize.x, terminalSize.y * characterSize.y});
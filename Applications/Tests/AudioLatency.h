@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Test.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+
+#include <Lemon/System/ABI/Audio.h>
+
+// Feed two streams in small chunks for a couple of seconds,
+// keeping as little audio buffered as possible
+#define AUDIO_LATENCY_PERIOD_FRAMES 256
+#define AUDIO_LATENCY_CHUNKS 200
+// Chunks written before pacing starts
+#define AUDIO_LATENCY_PREROLL_CHUNKS 10
+
+int RunAudioLatency() {
+    int mixer = open("/dev/snd/mixer", O_RDWR);
+    int fd = open("/dev/snd/pcm", O_WRONLY);
+    int fd2 = open("/dev/snd/pcm", O_WRONLY);
+    if (mixer == -1 || fd == -1 || fd2 == -1) {
+        perror("/dev/snd:");
+        return 1;
+    }
+
+    int outputRate = ioctl(fd, IoCtlOutputGetSampleRate);
+    if (outputRate <= 0) {
+        printf("No audio output, skipping\n");
+        return 0;
+    }
+
+    int oldPeriod = ioctl(mixer, IoCtlMixerGetPeriodSize);
+    if (ioctl(mixer, IoCtlMixerSetPeriodSize, AUDIO_LATENCY_PERIOD_FRAMES) ||
+        ioctl(mixer, IoCtlMixerGetPeriodSize) != AUDIO_LATENCY_PERIOD_FRAMES) {
+        printf("Failed to set period size\n");
+        return 2;
+    }
+
+    // First stream needs resampling, second needs resampling and upmixing
+    const int rate = 44100;
+    const int rate2 = 22050;
+    if (ioctl(fd, IoCtlOutputSetSampleRate, rate) || ioctl(fd2, IoCtlOutputSetSampleRate, rate2) ||
+        ioctl(fd2, IoCtlOutputSetNumberOfChannels, 1) || ioctl(fd2, IoCtlOutputSetVolume, 50)) {
+        printf("Failed to set stream format\n");
+        return 2;
+    }
+
+    // 10ms of audio per chunk
+    const int chunkFrames = rate / 100;
+    const int chunkFrames2 = rate2 / 100;
+    int16_t samples[chunkFrames * 2];
+    int16_t samples2[chunkFrames2];
+
+    // Write another chunk once less than 8 periods (~40ms) are buffered
+    const int target = AUDIO_LATENCY_PERIOD_FRAMES * 8;
+
+    int maxBuffered = 0;
+    long totalBuffered = 0;
+
+    timespec start, end;
+    clock_gettime(CLOCK_BOOTTIME, &start);
+
+    for (int chunk = 0; chunk < AUDIO_LATENCY_CHUNKS; chunk++) {
+        if (chunk >= AUDIO_LATENCY_PREROLL_CHUNKS) {
+            int buffered;
+            while ((buffered = ioctl(fd, IoCtlOutputGetBufferedFrames)) > target) {
+                usleep(1000);
+            }
+
+            if (buffered < 0) {
+                printf("Failed to get buffered frames\n");
+                return 3;
+            }
+
+            totalBuffered += buffered;
+            if (buffered > maxBuffered) {
+                maxBuffered = buffered;
+            }
+        }
+
+        // 441Hz and 220.5Hz square waves
+        for (int i = 0; i < chunkFrames; i++) {
+            samples[i * 2] = samples[i * 2 + 1] = ((i / 50) % 2) ? 0x2000 : -0x2000;
+        }
+
+        for (int i = 0; i < chunkFrames2; i++) {
+            samples2[i] = ((i / 50) % 2) ? 0x2000 : -0x2000;
+        }
+
+        if (write(fd, samples, sizeof(samples)) != sizeof(samples) ||
+            write(fd2, samples2, sizeof(samples2)) != sizeof(samples2)) {
+            perror("write:");
+            return 3;
+        }
+    }
+
+    clock_gettime(CLOCK_BOOTTIME, &end);
+
+    int underruns = ioctl(fd, IoCtlOutputGetUnderruns);
+    int underruns2 = ioctl(fd2, IoCtlOutputGetUnderruns);
+
+    printf("Played %d chunks in %ldms\n", AUDIO_LATENCY_CHUNKS, uSecondsFromTimespec(end - start) / 1000);
+    long avgBuffered = totalBuffered / (AUDIO_LATENCY_CHUNKS - AUDIO_LATENCY_PREROLL_CHUNKS);
+    printf("Buffered: avg %ld frames, max %d frames (%dus), underruns: %d, %d\n", avgBuffered, maxBuffered,
+           maxBuffered * 1000 / (outputRate / 1000), underruns, underruns2);
+
+    close(fd);
+    close(fd2);
+
+    ioctl(mixer, IoCtlMixerSetPeriodSize, oldPeriod);
+    close(mixer);
+
+    if (underruns || underruns2) {
+        return 4;
+    }
+
+    return 0;
+}
+
+static Test audioLatencyTest = {
+    .func = RunAudioLatency,
+    .prettyName = "Audio Latency Test"
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Test.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <Lemon/System/Filesystem.h>
+
+#define DIRLIST_BENCHMARK_PATH "/tmp/dirlistbenchmark"
+#define DIRLIST_BENCHMARK_FILES 5000
+
+static void DirListBenchmarkCleanup() {
+    char path[128];
+    for (int i = 0; i < DIRLIST_BENCHMARK_FILES; i++) {
+        snprintf(path, sizeof(path), DIRLIST_BENCHMARK_PATH "/file%d", i);
+        unlink(path);
+    }
+    rmdir(DIRLIST_BENCHMARK_PATH);
+}
+
+int RunDirListBenchmark() {
+    if (mkdir(DIRLIST_BENCHMARK_PATH, 0755) && errno != EEXIST) {
+        perror(DIRLIST_BENCHMARK_PATH ": ");
+        return 1;
+    }
+
+    char path[128];
+    for (int i = 0; i < DIRLIST_BENCHMARK_FILES; i++) {
+        snprintf(path, sizeof(path), DIRLIST_BENCHMARK_PATH "/file%d", i);
+
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0) {
+            perror("open: ");
+            DirListBenchmarkCleanup();
+            return 1;
+        }
+
+        // Give every file a different size to check the attributes
+        if (write(fd, path, i % 64) != i % 64) {
+            perror("write: ");
+            close(fd);
+            DirListBenchmarkCleanup();
+            return 1;
+        }
+        close(fd);
+    }
+
+    timespec t1;
+    timespec t2;
+
+    // What FileView and ls used to do, readdir then lstat every entry by path
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    DIR* dir = opendir(DIRLIST_BENCHMARK_PATH);
+    if (!dir) {
+        perror("opendir: ");
+        DirListBenchmarkCleanup();
+        return 1;
+    }
+
+    int statCount = 0;
+    off_t statTotalSize = 0;
+    std::string absPath;
+    while (struct dirent* ent = readdir(dir)) {
+        absPath = DIRLIST_BENCHMARK_PATH "/";
+        absPath += ent->d_name;
+
+        struct stat st;
+        if (!lstat(absPath.c_str(), &st) && S_ISREG(st.st_mode)) {
+            statCount++;
+            statTotalSize += st.st_size;
+        }
+    }
+    closedir(dir);
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long statTime = uSecondsFromTimespec(t2 - t1);
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    std::vector<DirectoryEntryPlus> entries;
+    int ret = Lemon::ListDirectory(DIRLIST_BENCHMARK_PATH, entries);
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long plusTime = uSecondsFromTimespec(t2 - t1);
+
+    DirListBenchmarkCleanup();
+
+    if (ret) {
+        perror("ListDirectory: ");
+        return 1;
+    }
+
+    int plusCount = 0;
+    off_t plusTotalSize = 0;
+    for (const DirectoryEntryPlus& entry : entries) {
+        if (S_ISREG(entry.mode)) {
+            plusCount++;
+            plusTotalSize += entry.size;
+        }
+    }
+
+    if (plusCount != DIRLIST_BENCHMARK_FILES || plusCount != statCount || plusTotalSize != statTotalSize) {
+        printf("Listing mismatch: readdir+lstat %d files (%ld bytes), readdirplus %d files (%ld bytes)\n", statCount,
+               statTotalSize, plusCount, plusTotalSize);
+        return 1;
+    }
+
+    printf("%d entries: readdir+lstat %ld us, readdirplus %ld us\n", DIRLIST_BENCHMARK_FILES, statTime, plusTime);
+    return 0;
+}
+
+static Test dirListTest = {
+    .func = RunDirListBenchmark,
+    .prettyName = "Directory Listing Benchmark"
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Test.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#define EXT2_BENCHMARK_DIRECTORY "/system/ext2benchmark"
+#define EXT2_BENCHMARK_FILE_COUNT 256
+#define EXT2_BENCHMARK_FILE_SIZE 4096
+
+int RunExt2Benchmark() {
+    if (mkdir(EXT2_BENCHMARK_DIRECTORY, 0755)) {
+        perror(EXT2_BENCHMARK_DIRECTORY ": ");
+        return 1;
+    }
+
+    uint8_t data[EXT2_BENCHMARK_FILE_SIZE];
+    char path[64];
+
+    timespec t1;
+    timespec t2;
+
+    // Every small file write used to hit the disk synchronously,
+    // several times over for the inode, bitmaps and directory
+    int ret = 0;
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int i = 0; i < EXT2_BENCHMARK_FILE_COUNT; i++) {
+        snprintf(path, sizeof(path), EXT2_BENCHMARK_DIRECTORY "/%d", i);
+        for (int j = 0; j < EXT2_BENCHMARK_FILE_SIZE; j++) {
+            data[j] = (i + j) & 0xff;
+        }
+
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0) {
+            perror("open: ");
+            ret = 1;
+            break;
+        }
+
+        if (write(fd, data, EXT2_BENCHMARK_FILE_SIZE) != EXT2_BENCHMARK_FILE_SIZE) {
+            perror("write: ");
+            close(fd);
+            ret = 1;
+            break;
+        }
+
+        close(fd);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long createTime = uSecondsFromTimespec(t2 - t1);
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int i = 0; i < EXT2_BENCHMARK_FILE_COUNT && !ret; i++) {
+        snprintf(path, sizeof(path), EXT2_BENCHMARK_DIRECTORY "/%d", i);
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror("open: ");
+            ret = 1;
+            break;
+        }
+
+        if (read(fd, data, EXT2_BENCHMARK_FILE_SIZE) != EXT2_BENCHMARK_FILE_SIZE) {
+            perror("read: ");
+            ret = 1;
+        } else {
+            for (int j = 0; j < EXT2_BENCHMARK_FILE_SIZE; j++) {
+                if (data[j] != ((i + j) & 0xff)) {
+                    printf("Read unexpected data from %s!\n", path);
+                    ret = 1;
+                    break;
+                }
+            }
+        }
+
+        close(fd);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long readTime = uSecondsFromTimespec(t2 - t1);
+
+    for (int i = 0; i < EXT2_BENCHMARK_FILE_COUNT; i++) {
+        snprintf(path, sizeof(path), EXT2_BENCHMARK_DIRECTORY "/%d", i);
+        unlink(path);
+    }
+    rmdir(EXT2_BENCHMARK_DIRECTORY);
+
+    if (!ret) {
+        printf("ext2 create+write: %ld files/s, read: %ld files/s (%d files, %d bytes each)\n",
+               EXT2_BENCHMARK_FILE_COUNT * 1000000L / (createTime + 1),
+               EXT2_BENCHMARK_FILE_COUNT * 1000000L / (readTime + 1), EXT2_BENCHMARK_FILE_COUNT,
+               EXT2_BENCHMARK_FILE_SIZE);
+    }
+
+    return ret;
+}
+
+static Test ext2Test = {
+    .func = RunExt2Benchmark,
+    .prettyName = "ext2 Small File Benchmark"
+};
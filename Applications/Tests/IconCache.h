@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Lemon/Core/IconManager.h>
+
+// Icons FileView loads when FileManager starts
+static const std::pair<const char*, Lemon::IconManager::IconSize> fileViewIcons[] = {
+    {"disk", Lemon::IconManager::IconSize64x64},     {"folder", Lemon::IconManager::IconSize64x64},
+    {"file", Lemon::IconManager::IconSize64x64},     {"filetext", Lemon::IconManager::IconSize64x64},
+    {"filejson", Lemon::IconManager::IconSize64x64}, {"ram", Lemon::IconManager::IconSize64x64},
+    {"disk", Lemon::IconManager::IconSize16x16},     {"folder", Lemon::IconManager::IconSize16x16},
+};
+
+// Compare the icon loading done at FileManager startup with and without the icon cache service
+int RunIconCacheTest() {
+    timespec t1;
+    timespec t2;
+
+    // What every process used to do, decode each icon from its PNG
+    Surface decoded[sizeof(fileViewIcons) / sizeof(fileViewIcons[0])];
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (unsigned i = 0; i < sizeof(fileViewIcons) / sizeof(fileViewIcons[0]); i++) {
+        Lemon::IconManager::DecodeIcon(fileViewIcons[i].first, fileViewIcons[i].second, &decoded[i]);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long decodeTime = uSecondsFromTimespec(t2 - t1);
+
+    // Connecting to the icon cache and mapping the atlas is part of it
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    const Surface* cached[sizeof(fileViewIcons) / sizeof(fileViewIcons[0])];
+    for (unsigned i = 0; i < sizeof(fileViewIcons) / sizeof(fileViewIcons[0]); i++) {
+        cached[i] = Lemon::IconManager::Instance()->GetIcon(fileViewIcons[i].first, fileViewIcons[i].second);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long cacheTime = uSecondsFromTimespec(t2 - t1);
+
+    for (unsigned i = 0; i < sizeof(fileViewIcons) / sizeof(fileViewIcons[0]); i++) {
+        if (!decoded[i].buffer) {
+            continue; // Icon does not exist, IconManager gives the filler icon
+        }
+
+        if (cached[i]->width != decoded[i].width || cached[i]->height != decoded[i].height ||
+            memcmp(cached[i]->buffer, decoded[i].buffer, decoded[i].BufferSize())) {
+            printf("Icon '%s' does not match the decoded icon\n", fileViewIcons[i].first);
+            return 1;
+        }
+    }
+
+    printf("FileView icons: decoding %ld us, icon cache %ld us\n", decodeTime, cacheTime);
+
+    // Other processes must not be able to write to the atlas
+    pid_t child = fork();
+    if (!child) {
+        cached[0]->buffer[0] = ~cached[0]->buffer[0];
+        exit(0); // Should have been killed by the page fault
+    }
+
+    int status;
+    waitpid(child, &status, 0);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        printf("Icon memory is writable (is lemon.iconcache running?)\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static Test iconCacheTest = {
+    .func = RunIconCacheTest,
+    .prettyName = "Icon Cache Benchmark",
+};
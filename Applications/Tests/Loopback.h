@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Lemon/System/Socket.h>
+
+#define LOOPBACK_TEST_PORT 5556
+#define LOOPBACK_TEST_PACKETS 65536
+// Receive after every batch so the socket queue stays short
+#define LOOPBACK_TEST_BATCH 64
+
+static int LoopbackTestRun(int sender, int receiver, size_t size) {
+    uint8_t buffer[2048];
+
+    sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(LOOPBACK_TEST_PORT);
+    dest.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    timespec t1;
+    timespec t2;
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int i = 0; i < LOOPBACK_TEST_PACKETS; i += LOOPBACK_TEST_BATCH) {
+        for (int j = 0; j < LOOPBACK_TEST_BATCH; j++) {
+            memset(buffer, (i + j) & 0xff, size);
+            if (sendto(sender, buffer, size, 0, (sockaddr*)&dest, sizeof(dest)) != (ssize_t)size) {
+                perror("sendto: ");
+                return 1;
+            }
+        }
+
+        for (int j = 0; j < LOOPBACK_TEST_BATCH; j++) {
+            sockaddr_in src;
+            socklen_t srcLen = sizeof(src);
+            ssize_t len = recvfrom(receiver, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*)&src, &srcLen);
+            if (len != (ssize_t)size) {
+                printf("Expected %lu bytes, got %ld\n", size, len);
+                return 1;
+            }
+
+            if (buffer[0] != ((i + j) & 0xff) || buffer[size - 1] != ((i + j) & 0xff)) {
+                printf("Received packets out of order or corrupted!\n");
+                return 1;
+            }
+
+            if (src.sin_addr.s_addr != inet_addr("127.0.0.1")) {
+                printf("Unexpected source address %s\n", inet_ntoa(src.sin_addr));
+                return 1;
+            }
+        }
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+
+    long elapsed = uSecondsFromTimespec(t2 - t1);
+    printf("loopback udp: %ld packets/s, %ld MB/s (%lu bytes each)\n",
+           LOOPBACK_TEST_PACKETS * 1000000L / (elapsed + 1),
+           (long)(LOOPBACK_TEST_PACKETS * size / (elapsed + 1)), size);
+
+    return 0;
+}
+
+// Same as LoopbackTestRun but a whole batch per syscall
+static int LoopbackTestRunBatched(int sender, int receiver, size_t size) {
+    static uint8_t buffers[LOOPBACK_TEST_BATCH][2048];
+    iovec iovecs[LOOPBACK_TEST_BATCH];
+    lemon_mmsghdr_t messages[LOOPBACK_TEST_BATCH];
+
+    sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(LOOPBACK_TEST_PORT);
+    dest.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    timespec t1;
+    timespec t2;
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int i = 0; i < LOOPBACK_TEST_PACKETS; i += LOOPBACK_TEST_BATCH) {
+        memset(messages, 0, sizeof(messages));
+        for (int j = 0; j < LOOPBACK_TEST_BATCH; j++) {
+            memset(buffers[j], (i + j) & 0xff, size);
+
+            iovecs[j].iov_base = buffers[j];
+            iovecs[j].iov_len = size;
+            messages[j].msg_hdr.msg_iov = &iovecs[j];
+            messages[j].msg_hdr.msg_iovlen = 1;
+            messages[j].msg_hdr.msg_name = &dest;
+            messages[j].msg_hdr.msg_namelen = sizeof(dest);
+        }
+
+        if (Lemon::SendMultipleMessages(sender, messages, LOOPBACK_TEST_BATCH, 0) != LOOPBACK_TEST_BATCH) {
+            perror("sendmmsg: ");
+            return 1;
+        }
+
+        memset(messages, 0, sizeof(messages));
+        for (int j = 0; j < LOOPBACK_TEST_BATCH; j++) {
+            iovecs[j].iov_base = buffers[j];
+            iovecs[j].iov_len = sizeof(buffers[j]);
+            messages[j].msg_hdr.msg_iov = &iovecs[j];
+            messages[j].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = 0;
+        while (received < LOOPBACK_TEST_BATCH) {
+            int ret = Lemon::ReceiveMultipleMessages(receiver, messages + received, LOOPBACK_TEST_BATCH - received, 0);
+            if (ret <= 0) {
+                perror("recvmmsg: ");
+                return 1;
+            }
+            received += ret;
+        }
+
+        for (int j = 0; j < LOOPBACK_TEST_BATCH; j++) {
+            if (messages[j].msg_len != size || buffers[j][0] != ((i + j) & 0xff) ||
+                buffers[j][size - 1] != ((i + j) & 0xff)) {
+                printf("Received packets out of order or corrupted!\n");
+                return 1;
+            }
+        }
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+
+    long elapsed = uSecondsFromTimespec(t2 - t1);
+    printf("loopback udp (batches of %d): %ld packets/s, %ld MB/s (%lu bytes each)\n", LOOPBACK_TEST_BATCH,
+           LOOPBACK_TEST_PACKETS * 1000000L / (elapsed + 1),
+           (long)(LOOPBACK_TEST_PACKETS * size / (elapsed + 1)), size);
+
+    return 0;
+}
+
+int RunLoopbackTest() {
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    if (receiver < 0 || sender < 0) {
+        perror("socket: ");
+        return 1;
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(LOOPBACK_TEST_PORT);
+    local.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    if (bind(receiver, (sockaddr*)&local, sizeof(local))) {
+        perror("bind: ");
+        close(receiver);
+        close(sender);
+        return 1;
+    }
+
+    // Loopback is not limited to Ethernet sized packets
+    int ret = LoopbackTestRun(sender, receiver, 64);
+    if (!ret) {
+        ret = LoopbackTestRunBatched(sender, receiver, 64);
+    }
+
+    if (!ret) {
+        ret = LoopbackTestRun(sender, receiver, 2048);
+    }
+
+    if (!ret) {
+        ret = LoopbackTestRunBatched(sender, receiver, 2048);
+    }
+
+    close(receiver);
+    close(sender);
+    return ret;
+}
+
+static Test loopbackTest = {
+    .func = RunLoopbackTest,
+    .prettyName = "Loopback UDP Test"
+};
@@ -6,15 +6,42 @@
 #include <unistd.h>
 
 #include "Audio.h"
+#include "AudioLatency.h"
+#include "DirList.h"
+#include "Ext2.h"
+#include "IconCache.h"
+#include "Loopback.h"
+#include "NetPPS.h"
+#include "PageFault.h"
 #include "Pipe.h"
+#include "ProcessTable.h"
+#include "Raster.h"
+#include "Reclaim.h"
 #include "Terminal.h"
+#include "TextBuffer.h"
+#include "Threads.h"
+#include "TmpFS.h"
 #include "Syscall.h"
 
 const std::unordered_map<std::string, Test> tests = {
     {"pipe", pipeTest},
     {"terminal", termTest},
+    {"termthroughput", termThroughputTest},
     {"audio", audioTest},
+    {"audiolatency", audioLatencyTest},
     {"syscall", syscallTest},
+    {"pagefault", pageFaultTest},
+    {"tmpfs", tmpfsTest},
+    {"ext2", ext2Test},
+    {"reclaim", reclaimTest},
+    {"netpps", netppsTest},
+    {"loopback", loopbackTest},
+    {"dirlist", dirListTest},
+    {"iconcache", iconCacheTest},
+    {"threads", threadTest},
+    {"textbuffer", textBufferTest},
+    {"raster", rasterTest},
+    {"proctable", processTableTest},
 };
 
 void ExecuteTest(const Test& test) {
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// QEMU user networking host address, port 9 is discard
+#define NETPPS_TX_ADDRESS "10.0.2.2"
+#define NETPPS_TX_PORT 9
+#define NETPPS_TX_TIME 1000000 // 1s
+
+// Forwarded from the host by qemunetbench in Scripts/run.sh
+#define NETPPS_RX_PORT 5555
+#define NETPPS_RX_TIME 5000000 // 5s
+#define NETPPS_RX_IDLE_TIMEOUT 1000 // Give up if nothing arrives for 1s once packets have started
+
+#define NETPPS_PACKET_SIZE 64
+
+int RunNetPPSBenchmark() {
+    uint8_t buffer[1500];
+    memset(buffer, 0x5a, sizeof(buffer));
+
+    timespec t1;
+    timespec t2;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket: ");
+        return 1;
+    }
+
+    sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(NETPPS_TX_PORT);
+    dest.sin_addr.s_addr = inet_addr(NETPPS_TX_ADDRESS);
+
+    long sent = 0;
+    long elapsed = 0;
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    while (elapsed < NETPPS_TX_TIME) {
+        if (sendto(sock, buffer, NETPPS_PACKET_SIZE, 0, (sockaddr*)&dest, sizeof(dest)) < 0) {
+            perror("sendto: ");
+            close(sock);
+            return 1;
+        }
+        sent++;
+
+        clock_gettime(CLOCK_BOOTTIME, &t2);
+        elapsed = uSecondsFromTimespec(t2 - t1);
+    }
+    close(sock);
+
+    printf("netpps tx: %ld packets/s (%d bytes each)\n", sent * 1000000L / (elapsed + 1), NETPPS_PACKET_SIZE);
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket: ");
+        return 1;
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(NETPPS_RX_PORT);
+    local.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(sock, (sockaddr*)&local, sizeof(local))) {
+        perror("bind: ");
+        close(sock);
+        return 1;
+    }
+
+    pollfd pfd = {.fd = sock, .events = POLLIN, .revents = 0};
+
+    // Wait for the host to start sending
+    if (poll(&pfd, 1, NETPPS_RX_TIME / 1000) <= 0) {
+        printf("netpps rx: no packets received, skipping. Run with './Scripts/run.sh qemunetbench' and send UDP to "
+               "localhost:%d from the host, e.g. with 'iperf3 -u -c localhost -p %d -b 0 -l %d' or a netcat loop.\n",
+               NETPPS_RX_PORT, NETPPS_RX_PORT, NETPPS_PACKET_SIZE);
+        close(sock);
+        return 0;
+    }
+
+    long received = 0;
+    long bytes = 0;
+    elapsed = 0;
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    while (elapsed < NETPPS_RX_TIME) {
+        if (poll(&pfd, 1, NETPPS_RX_IDLE_TIMEOUT) <= 0) {
+            break;
+        }
+
+        ssize_t len = recv(sock, buffer, sizeof(buffer), 0);
+        if (len < 0) {
+            perror("recv: ");
+            close(sock);
+            return 1;
+        }
+
+        received++;
+        bytes += len;
+
+        clock_gettime(CLOCK_BOOTTIME, &t2);
+        elapsed = uSecondsFromTimespec(t2 - t1);
+    }
+    close(sock);
+
+    printf("netpps rx: %ld packets/s, %ld KB/s (%ld packets)\n", received * 1000000L / (elapsed + 1),
+           bytes * 1000L / 1024 / (elapsed / 1000 + 1), received);
+
+    return 0;
+}
+
+static Test netppsTest = {
+    .func = RunNetPPSBenchmark,
+    .prettyName = "Network Packets Per Second Benchmark"
+};
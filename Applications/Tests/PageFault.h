@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Test.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/mman.h>
+
+namespace PageFaultTest {
+
+// Touch every page in a fresh anonymous mapping
+// Returns the average time taken per page fault in nanoseconds
+long TouchAnonymousRegion(size_t size) {
+    uint8_t* region = reinterpret_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+    if(region == MAP_FAILED) {
+        perror("mmap: ");
+        return -1;
+    }
+
+    timespec t1;
+    timespec t2;
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for(size_t i = 0; i < size; i += 4096) {
+        region[i] = 1;
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+
+    munmap(region, size);
+    return nSecondsFromTimespec(t2 - t1) / (size / 4096);
+}
+
+};
+
+int RunPageFaultBenchmark() {
+    using namespace PageFaultTest;
+
+    // Large enough to drain the kernel's pre-zeroed page pool,
+    // most of the faults will have to zero their page synchronously
+    long coldTime = TouchAnonymousRegion(64 * 1024 * 1024);
+    if(coldTime < 0) {
+        return 1;
+    }
+
+    // Give the idle threads and page zeroing thread time to refill the pool
+    usleep(1000000);
+
+    long warmTime = TouchAnonymousRegion(2 * 1024 * 1024);
+    if(warmTime < 0) {
+        return 1;
+    }
+
+    printf("anonymous page fault: drained pool avg %ld ns, filled pool avg %ld ns\n", coldTime, warmTime);
+    return 0;
+}
+
+static Test pageFaultTest = {
+    .func = RunPageFaultBenchmark,
+    .prettyName = "Page Fault Benchmark"
+};
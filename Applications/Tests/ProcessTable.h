@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Test.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Lemon/System/Util.h>
+
+#define PROCESS_TABLE_TEST_CHILDREN 64
+#define PROCESS_TABLE_TEST_LOOKUPS 10000
+
+namespace ProcessTableTest {
+static pid_t children[PROCESS_TABLE_TEST_CHILDREN];
+
+static void KillChildren(int count) {
+    for (int i = 0; i < count; i++) {
+        kill(children[i], SIGKILL);
+    }
+
+    for (int i = 0; i < count; i++) {
+        waitpid(children[i], nullptr, 0);
+    }
+}
+
+// Processes are removed from the table shortly after waitpid() can see them exit
+static bool WaitForRemoval(pid_t pid) {
+    lemon_process_info_t info;
+    for (int i = 0; i < 100; i++) {
+        if (Lemon::GetProcessInfo(pid, info)) {
+            return true;
+        }
+
+        usleep(10000);
+    }
+
+    return false;
+}
+
+// Enumeration should be in PID order and see every child,
+// lookups should not slow down as the process count grows
+int Run() {
+    timespec t1;
+    timespec t2;
+    lemon_process_info_t info;
+
+    pid_t self = getpid();
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int i = 0; i < PROCESS_TABLE_TEST_LOOKUPS; i++) {
+        Lemon::GetProcessInfo(self, info);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long lookupTime = nSecondsFromTimespec(t2 - t1) / PROCESS_TABLE_TEST_LOOKUPS;
+
+    for (int i = 0; i < PROCESS_TABLE_TEST_CHILDREN; i++) {
+        children[i] = fork();
+        if (children[i] < 0) {
+            perror("fork");
+            KillChildren(i);
+            return 1;
+        } else if (!children[i]) {
+            for (;;) {
+                pause();
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int i = 0; i < PROCESS_TABLE_TEST_LOOKUPS; i++) {
+        Lemon::GetProcessInfo(self, info);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long loadedLookupTime = nSecondsFromTimespec(t2 - t1) / PROCESS_TABLE_TEST_LOOKUPS;
+
+    int found = 0;
+    pid_t pid = 0;
+    pid_t last = 0;
+    while (!Lemon::GetNextProcessInfo(&pid, info)) {
+        if (pid <= last || info.pid != pid) {
+            printf("Process %d enumerated after %d\n", pid, last);
+            KillChildren(PROCESS_TABLE_TEST_CHILDREN);
+            return 1;
+        }
+
+        // Children are forked in order so their PIDs ascend
+        if (found < PROCESS_TABLE_TEST_CHILDREN && pid == children[found]) {
+            found++;
+        }
+
+        last = pid;
+    }
+
+    KillChildren(PROCESS_TABLE_TEST_CHILDREN);
+
+    if (found != PROCESS_TABLE_TEST_CHILDREN) {
+        printf("Only found %d/%d children\n", found, PROCESS_TABLE_TEST_CHILDREN);
+        return 1;
+    }
+
+    for (int i = 0; i < PROCESS_TABLE_TEST_CHILDREN; i++) {
+        if (!WaitForRemoval(children[i])) {
+            printf("Process %d still exists after exiting\n", children[i]);
+            return 1;
+        }
+    }
+
+    printf("process lookup: %ld ns, with %d more processes: %ld ns\n", lookupTime, PROCESS_TABLE_TEST_CHILDREN,
+           loadedLookupTime);
+    return 0;
+}
+} // namespace ProcessTableTest
+
+static Test processTableTest = {
+    .func = ProcessTableTest::Run,
+    .prettyName = "Process Table",
+};
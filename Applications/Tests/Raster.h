@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Test.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Lemon/Graphics/Raster.h>
+
+// Odd so every kernel has to handle a tail
+#define RASTER_TEST_PIXELS 1037
+#define RASTER_TEST_ITERATIONS 100
+
+namespace RasterTest {
+using namespace Lemon::Graphics;
+
+static uint32_t src[RASTER_TEST_PIXELS];
+static uint32_t dest[RASTER_TEST_PIXELS];
+static uint8_t mask[RASTER_TEST_PIXELS];
+static uint32_t expected[RASTER_TEST_PIXELS];
+static uint32_t result[RASTER_TEST_PIXELS];
+
+// Mix of transparent, opaque and translucent pixels over mostly opaque destinations
+static void Generate() {
+    for (int i = 0; i < RASTER_TEST_PIXELS; i++) {
+        src[i] = rand();
+        dest[i] = rand() | 0xff000000;
+        mask[i] = rand();
+
+        switch (rand() % 4) {
+        case 0:
+            src[i] &= 0xffffff;
+            mask[i] = 0;
+            break;
+        case 1:
+            src[i] |= 0xff000000;
+            mask[i] = 0xff;
+            break;
+        }
+
+        if (rand() % 16 == 0) {
+            dest[i] &= 0xffffff;
+        }
+    }
+}
+
+static void RunKernel(const Raster::Kernels* k, int kernel, uint32_t* out, size_t offset, size_t count) {
+    uint32_t colour = src[0];
+    switch (kernel) {
+    case 0:
+        k->fill(out + offset, colour, count);
+        break;
+    case 1:
+        k->gradient(out + offset, colour, src[1], count + 5, count);
+        break;
+    case 2:
+        k->alphaBlend(out + offset, src, count);
+        break;
+    case 3:
+        k->alphaFill(out + offset, (colour & 0xffffff) | 0x80000000, count);
+        break;
+    case 4:
+        k->maskBlend(out + offset, colour, mask, count);
+        break;
+    case 5:
+        k->compositePremultiplied(out + offset, src, count);
+        break;
+    case 6:
+        k->blitColourKey(out + offset, src, src[3], count);
+        break;
+    }
+}
+
+// Every SIMD variant should give exactly the same result as the scalar kernels
+int Run() {
+    static const char* kernelNames[] = {"fill",      "gradient",  "alphaBlend", "alphaFill",
+                                        "maskBlend", "composite", "colourKey"};
+
+    const Raster::Kernels* reference = Raster::GetKernels(Raster::ISAScalar);
+    printf("Using %s raster kernels\n", Raster::ISAName(Raster::BestISA()));
+
+    for (int i = 0; i < RASTER_TEST_ITERATIONS; i++) {
+        Generate();
+
+        // Vary the alignment and the length of the tail
+        size_t offset = i % 7;
+        size_t count = RASTER_TEST_PIXELS - offset - i % 5;
+        for (int isa = Raster::ISASSE2; isa < Raster::ISACount; isa++) {
+            const Raster::Kernels* k = Raster::GetKernels(static_cast<Raster::ISA>(isa));
+            if (!k) {
+                continue;
+            }
+
+            for (int kernel = 0; kernel < 7; kernel++) {
+                memcpy(expected, dest, sizeof(dest));
+                memcpy(result, dest, sizeof(dest));
+
+                RunKernel(reference, kernel, expected, offset, count);
+                RunKernel(k, kernel, result, offset, count);
+
+                if (memcmp(expected, result, sizeof(result))) {
+                    int p = 0;
+                    while (expected[p] == result[p]) {
+                        p++;
+                    }
+
+                    printf("%s %s: pixel %d is %x, expected %x\n", Raster::ISAName(static_cast<Raster::ISA>(isa)),
+                           kernelNames[kernel], p, result[p], expected[p]);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+} // namespace RasterTest
+
+static Test rasterTest = {
+    .func = RasterTest::Run,
+    .prettyName = "Raster Kernels",
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "Test.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <Lemon/System/Info.h>
+
+#define RECLAIM_TEST_DIRECTORY "/system/reclaimtest"
+#define RECLAIM_TEST_FILE_SIZE (16 * 1024 * 1024)
+#define RECLAIM_TEST_CHUNK_SIZE (64 * 1024)
+// Read a file set this much larger than RAM
+#define RECLAIM_TEST_EXTRA_SIZE (64 * 1024 * 1024)
+#define RECLAIM_TEST_MAX_FILES 1024
+#define RECLAIM_TEST_ANON_CHUNK (1024 * 1024)
+
+static uint64_t ReclaimTestCacheUsage(const lemon_sysinfo_t& info, const char* name) {
+    for (int i = 0; i < info.cacheCount; i++) {
+        if (!strcmp(info.caches[i].name, name)) {
+            return info.caches[i].usage;
+        }
+    }
+
+    return 0;
+}
+
+static void ReclaimTestPrintCaches(const lemon_sysinfo_t& info) {
+    printf("Used: %lu/%lu KB\n", info.usedMem, info.totalMem);
+    for (int i = 0; i < info.cacheCount; i++) {
+        printf("    %s: %lu KB (%lu KB reclaimable)\n", info.caches[i].name, info.caches[i].usage,
+               info.caches[i].reclaimable);
+    }
+}
+
+static void ReclaimTestCleanup(int fileCount) {
+    char path[64];
+    for (int i = 0; i < fileCount; i++) {
+        snprintf(path, sizeof(path), RECLAIM_TEST_DIRECTORY "/%d", i);
+        unlink(path);
+    }
+    rmdir(RECLAIM_TEST_DIRECTORY);
+}
+
+int RunReclaimTest() {
+    lemon_sysinfo_t info = Lemon::SysInfo();
+    ReclaimTestPrintCaches(info);
+
+    if (mkdir(RECLAIM_TEST_DIRECTORY, 0755)) {
+        perror(RECLAIM_TEST_DIRECTORY ": ");
+        return 1;
+    }
+
+    uint8_t* chunk = new uint8_t[RECLAIM_TEST_CHUNK_SIZE];
+    char path[64];
+
+    // Write a file set larger than RAM, or as much as fits on the disk
+    uint64_t target = info.totalMem * 1024 + RECLAIM_TEST_EXTRA_SIZE;
+    uint64_t written = 0;
+    int fileCount = 0;
+    while (written < target && fileCount < RECLAIM_TEST_MAX_FILES) {
+        snprintf(path, sizeof(path), RECLAIM_TEST_DIRECTORY "/%d", fileCount);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0) {
+            break;
+        }
+        fileCount++;
+
+        bool full = false;
+        for (int i = 0; i < RECLAIM_TEST_FILE_SIZE / RECLAIM_TEST_CHUNK_SIZE; i++) {
+            memset(chunk, (fileCount + i) & 0xff, RECLAIM_TEST_CHUNK_SIZE);
+            if (write(fd, chunk, RECLAIM_TEST_CHUNK_SIZE) != RECLAIM_TEST_CHUNK_SIZE) {
+                full = true;
+                break;
+            }
+            written += RECLAIM_TEST_CHUNK_SIZE;
+        }
+
+        close(fd);
+        if (full) {
+            // The last file is incomplete, do not read it back
+            unlink(path);
+            fileCount--;
+            break;
+        }
+    }
+
+    if (!fileCount) {
+        printf("Failed to write any files to " RECLAIM_TEST_DIRECTORY "\n");
+        ReclaimTestCleanup(fileCount);
+        delete[] chunk;
+        return 1;
+    }
+
+    if (written < target) {
+        printf("Disk full, only wrote %lu MB (RAM: %lu MB)\n", written / 1024 / 1024, info.totalMem / 1024);
+    }
+
+    // Read everything back twice, the block cache has to keep evicting to make room
+    int ret = 0;
+    uint64_t maxBlockCache = 0;
+    uint64_t minFree = info.totalMem;
+    for (int pass = 0; pass < 2 && !ret; pass++) {
+        for (int f = 1; f <= fileCount && !ret; f++) {
+            snprintf(path, sizeof(path), RECLAIM_TEST_DIRECTORY "/%d", f - 1);
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) {
+                perror("open: ");
+                ret = 1;
+                break;
+            }
+
+            for (int i = 0; i < RECLAIM_TEST_FILE_SIZE / RECLAIM_TEST_CHUNK_SIZE; i++) {
+                if (read(fd, chunk, RECLAIM_TEST_CHUNK_SIZE) != RECLAIM_TEST_CHUNK_SIZE ||
+                    chunk[i & 0xff] != ((f + i) & 0xff)) {
+                    printf("Read unexpected data from %s!\n", path);
+                    ret = 1;
+                    break;
+                }
+            }
+            close(fd);
+
+            info = Lemon::SysInfo();
+            uint64_t blockCache = ReclaimTestCacheUsage(info, "ext2-blocks");
+            if (blockCache > maxBlockCache) {
+                maxBlockCache = blockCache;
+            }
+
+            if (info.totalMem - info.usedMem < minFree) {
+                minFree = info.totalMem - info.usedMem;
+            }
+        }
+    }
+
+    delete[] chunk;
+
+    printf("Read %d files (%lu MB) twice, max block cache: %lu KB, min free: %lu KB\n", fileCount,
+           written / 1024 / 1024, maxBlockCache, minFree);
+    ReclaimTestPrintCaches(info);
+
+    // Now fill memory so that caches have to give memory back
+    uint64_t cacheBefore = ReclaimTestCacheUsage(info, "ext2-blocks");
+    uint64_t freeBefore = info.totalMem - info.usedMem;
+    // Stay above zero, but below where background reclaim kicks in
+    uint64_t minFreeKB = info.totalMem / 128 > 2048 ? info.totalMem / 128 : 2048;
+
+    uint8_t* anon[4096];
+    int anonCount = 0;
+    uint64_t anonTarget = freeBefore + cacheBefore / 2;
+    while (!ret && anonCount < 4096 && (uint64_t)anonCount * RECLAIM_TEST_ANON_CHUNK / 1024 < anonTarget) {
+        info = Lemon::SysInfo();
+        if (info.totalMem - info.usedMem < minFreeKB) {
+            // Give the reclaim thread a chance
+            usleep(100000);
+
+            info = Lemon::SysInfo();
+            if (info.totalMem - info.usedMem < minFreeKB) {
+                break;
+            }
+        }
+
+        anon[anonCount] = (uint8_t*)malloc(RECLAIM_TEST_ANON_CHUNK);
+        if (!anon[anonCount]) {
+            break;
+        }
+
+        // Touch every page
+        memset(anon[anonCount], 1, RECLAIM_TEST_ANON_CHUNK);
+        anonCount++;
+    }
+
+    info = Lemon::SysInfo();
+    uint64_t cacheAfter = ReclaimTestCacheUsage(info, "ext2-blocks");
+
+    printf("Allocated %d MB, block cache: %lu KB -> %lu KB\n", anonCount * (RECLAIM_TEST_ANON_CHUNK / 1024 / 1024),
+           cacheBefore, cacheAfter);
+    ReclaimTestPrintCaches(info);
+
+    uint64_t anonAllocated = (uint64_t)anonCount * RECLAIM_TEST_ANON_CHUNK / 1024;
+    while (anonCount--) {
+        free(anon[anonCount]);
+    }
+
+    ReclaimTestCleanup(fileCount);
+
+    // Allocating more than was free should have forced the block cache to shrink
+    if (!ret && anonAllocated > freeBefore && cacheAfter >= cacheBefore) {
+        printf("Block cache did not shrink under memory pressure!\n");
+        ret = 2;
+    }
+
+    return ret;
+}
+
+static Test reclaimTest = {
+    .func = RunReclaimTest,
+    .prettyName = "Memory Pressure Reclaim Test"
+};
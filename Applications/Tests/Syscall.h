@@ -8,14 +8,6 @@
 
 #include <lemon/syscall.h>
 
-inline static timespec operator-(const timespec& l, const timespec& r) {
-    return {l.tv_sec - r.tv_sec, l.tv_nsec - r.tv_nsec};
-}
-
-inline static long uSecondsFromTimespec(const timespec& t) {
-    return t.tv_sec * 1000000 - t.tv_nsec / 1000;
-}
-
 int RunSyscallTest() {
     int tempFile = open("/tmp/syscallbenchmark", O_RDWR | O_CREAT);
     if(tempFile < 0) {
@@ -1,8 +1,12 @@
 #pragma once
 
-#include <unistd.h>
-#include <stdlib.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "Test.h"
 
@@ -43,3 +47,84 @@ static Test termTest = {
     .func = RunTerminalTest,
     .prettyName = "Terminal open/close test",
 };
+
+#define TERMINAL_THROUGHPUT_FILE "/tmp/terminalthroughput.log"
+#define TERMINAL_THROUGHPUT_SIZE (4 * 1024 * 1024)
+#define TERMINAL_THROUGHPUT_TIMEOUT 120 // Seconds
+
+// Time how long the terminal takes to display a large log with cat
+int RunTerminalThroughputTest() {
+    int fd = open(TERMINAL_THROUGHPUT_FILE, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        perror(TERMINAL_THROUGHPUT_FILE ": ");
+        return 1;
+    }
+
+    // Log lines of varying length, some of them coloured
+    char line[160];
+    size_t written = 0;
+    for (int i = 0; written < TERMINAL_THROUGHPUT_SIZE; i++) {
+        int len;
+        if (i % 8 == 0) {
+            len = snprintf(line, sizeof(line), "\e[93m[%08d] warning:\e[0m something happened %.*s\n", i, i % 64,
+                           "................................................................");
+        } else {
+            len = snprintf(line, sizeof(line), "[%08d] info: processed request %d in %d us %.*s\n", i, i * 7,
+                           i % 1000, i % 48, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+        }
+
+        if (write(fd, line, len) != len) {
+            perror("write: ");
+            close(fd);
+            unlink(TERMINAL_THROUGHPUT_FILE);
+            return 1;
+        }
+        written += len;
+    }
+    close(fd);
+
+    const char* const argv[] = {"/system/bin/terminal.lef", "cat", TERMINAL_THROUGHPUT_FILE, nullptr};
+
+    timespec t1;
+    timespec t2;
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp("/system/bin/terminal.lef", const_cast<char* const*>(argv));
+        exit(1);
+    } else if (pid < 0) {
+        perror("fork: ");
+        unlink(TERMINAL_THROUGHPUT_FILE);
+        return 1;
+    }
+
+    // The terminal exits once cat has
+    int status = 0;
+    while (waitpid(pid, &status, WNOHANG) == 0) {
+        clock_gettime(CLOCK_BOOTTIME, &t2);
+        if ((t2 - t1).tv_sec >= TERMINAL_THROUGHPUT_TIMEOUT) {
+            printf("Terminal did not finish within %d seconds\n", TERMINAL_THROUGHPUT_TIMEOUT);
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            unlink(TERMINAL_THROUGHPUT_FILE);
+            return 1;
+        }
+
+        usleep(1000);
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+
+    unlink(TERMINAL_THROUGHPUT_FILE);
+
+    long time = uSecondsFromTimespec(t2 - t1);
+    printf("terminal cat: %lu bytes in %ld ms, %ld KB/s\n", written, time / 1000,
+           static_cast<long>(written / 1024 * 1000000 / (time + 1)));
+
+    return WEXITSTATUS(status);
+}
+
+static Test termThroughputTest = {
+    .func = RunTerminalThroughputTest,
+    .prettyName = "Terminal throughput benchmark",
+};
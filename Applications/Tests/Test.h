@@ -2,9 +2,27 @@
 
 #include <string>
 
+#include <time.h>
+
 using TestFunction = int(*)();
 
 struct Test {
     TestFunction func;
     std::string prettyName;
 };
+
+inline static timespec operator-(const timespec& l, const timespec& r) {
+    if (l.tv_nsec < r.tv_nsec) {
+        return {l.tv_sec - r.tv_sec - 1, l.tv_nsec + 1000000000 - r.tv_nsec};
+    }
+
+    return {l.tv_sec - r.tv_sec, l.tv_nsec - r.tv_nsec};
+}
+
+inline static long uSecondsFromTimespec(const timespec& t) {
+    return t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+inline static long nSecondsFromTimespec(const timespec& t) {
+    return t.tv_sec * 1000000000 + t.tv_nsec;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Test.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Lemon/GUI/TextBuffer.h>
+#include <Lemon/System/Info.h>
+
+// Lines visible in a maximized TextEdit window
+#define TEXTBUFFER_TEST_VIEWPORT_LINES 60
+
+static std::unique_ptr<char[]> TextBufferTestGenerate(size_t size) {
+    std::unique_ptr<char[]> text(new char[size]);
+
+    size_t pos = 0;
+    unsigned line = 0;
+    while (pos < size) {
+        char buf[128];
+        int len = snprintf(buf, sizeof(buf), "[%8u.%06u] service%u: request %u completed with status %u\n", line / 1000,
+                           line % 1000 * 997, line % 7, line, line % 5);
+
+        size_t count = std::min<size_t>(len, size - pos);
+        memcpy(text.get() + pos, buf, count);
+        pos += count;
+        line++;
+    }
+
+    return text;
+}
+
+// Time to open a log file and show the first page, against splitting it into lines up front
+// like TextBox used to
+int RunTextBufferTest() {
+    for (size_t size : {1 << 20, 16 << 20, 64 << 20}) {
+        std::unique_ptr<char[]> text = TextBufferTestGenerate(size);
+
+        timespec t1;
+        timespec t2;
+
+        uint64_t usedBefore = Lemon::SysInfo().usedMem;
+
+        std::unique_ptr<char[]> copy(new char[size]);
+        memcpy(copy.get(), text.get(), size);
+
+        clock_gettime(CLOCK_BOOTTIME, &t1);
+        size_t lineCount;
+        {
+            Lemon::GUI::TextBuffer buffer;
+            buffer.Load(std::move(copy), size);
+
+            std::string line;
+            for (int i = 0; i < TEXTBUFFER_TEST_VIEWPORT_LINES; i++) {
+                buffer.GetLine(i, line);
+            }
+            clock_gettime(CLOCK_BOOTTIME, &t2);
+            long openTime = uSecondsFromTimespec(t2 - t1);
+
+            clock_gettime(CLOCK_BOOTTIME, &t1);
+            while (!buffer.IndexLines(4 << 20))
+                ;
+            lineCount = buffer.LineCount();
+            clock_gettime(CLOCK_BOOTTIME, &t2);
+            long indexTime = uSecondsFromTimespec(t2 - t1);
+
+            uint64_t used = Lemon::SysInfo().usedMem - usedBefore;
+            printf("%lu MB piece table: first page %ld us, indexed %lu lines in %ld us, %lu KB\n", size >> 20,
+                   openTime, lineCount, indexTime, used);
+        }
+
+        usedBefore = Lemon::SysInfo().usedMem;
+
+        clock_gettime(CLOCK_BOOTTIME, &t1);
+        {
+            std::vector<std::string> lines;
+            const char* pos = text.get();
+            const char* end = text.get() + size;
+            while (pos < end) {
+                const char* lineEnd = reinterpret_cast<const char*>(memchr(pos, '\n', end - pos));
+                if (!lineEnd) {
+                    lineEnd = end;
+                }
+
+                lines.push_back(std::string(pos, lineEnd - pos));
+                pos = lineEnd + 1;
+            }
+
+            if (end[-1] == '\n') {
+                lines.push_back(std::string()); // Empty last line
+            }
+
+            clock_gettime(CLOCK_BOOTTIME, &t2);
+            long splitTime = uSecondsFromTimespec(t2 - t1);
+
+            uint64_t used = Lemon::SysInfo().usedMem - usedBefore;
+            printf("%lu MB line vector: first page %ld us, %lu KB\n", size >> 20, splitTime, used);
+
+            if (lines.size() != lineCount) {
+                printf("Line count mismatch (%lu, expected %lu)\n", lineCount, lines.size());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static Test textBufferTest = {
+    .func = RunTextBufferTest,
+    .prettyName = "Text Buffer Benchmark",
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Test.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Lemon/System/Info.h>
+
+#define THREAD_TEST_ROUNDS 10
+#define THREAD_TEST_THREADS_PER_ROUND 500
+// Threads alive at once in the concurrent part
+#define THREAD_TEST_CONCURRENT 32
+
+static void* ThreadTestEntry(void* arg) {
+    return arg;
+}
+
+static uint64_t ThreadTestStackUsage() {
+    lemon_sysinfo_t info = Lemon::SysInfo();
+    for (int i = 0; i < info.cacheCount; i++) {
+        if (!strcmp(info.caches[i].name, "kernel-stacks")) {
+            return info.caches[i].usage;
+        }
+    }
+
+    return 0;
+}
+
+// Throughput of creating and joining short lived threads,
+// kernel memory used by thread stacks should not grow between rounds
+int RunThreadTest() {
+    timespec t1;
+    timespec t2;
+
+    uint64_t usedBefore = Lemon::SysInfo().usedMem;
+    uint64_t stacksBefore = ThreadTestStackUsage();
+
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int round = 0; round < THREAD_TEST_ROUNDS; round++) {
+        for (int i = 0; i < THREAD_TEST_THREADS_PER_ROUND; i++) {
+            pthread_t thread;
+            if (pthread_create(&thread, nullptr, ThreadTestEntry, (void*)(uintptr_t)i)) {
+                perror("pthread_create");
+                return 1;
+            }
+
+            void* ret;
+            pthread_join(thread, &ret);
+            if (ret != (void*)(uintptr_t)i) {
+                printf("Thread returned %p, expected %d\n", ret, i);
+                return 1;
+            }
+        }
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long serialTime = uSecondsFromTimespec(t2 - t1);
+
+    pthread_t threads[THREAD_TEST_CONCURRENT];
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for (int round = 0; round < THREAD_TEST_ROUNDS; round++) {
+        for (int i = 0; i < THREAD_TEST_THREADS_PER_ROUND; i += THREAD_TEST_CONCURRENT) {
+            for (int j = 0; j < THREAD_TEST_CONCURRENT; j++) {
+                if (pthread_create(&threads[j], nullptr, ThreadTestEntry, nullptr)) {
+                    perror("pthread_create");
+                    return 1;
+                }
+            }
+
+            for (int j = 0; j < THREAD_TEST_CONCURRENT; j++) {
+                pthread_join(threads[j], nullptr);
+            }
+        }
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long concurrentTime = uSecondsFromTimespec(t2 - t1);
+
+    const long threadCount = THREAD_TEST_ROUNDS * THREAD_TEST_THREADS_PER_ROUND;
+    printf("create/join: %ld threads in %ld us (%ld threads/s)\n", threadCount, serialTime,
+           threadCount * 1000000 / (serialTime ? serialTime : 1));
+    printf("create/join %d at a time: %ld threads in %ld us (%ld threads/s)\n", THREAD_TEST_CONCURRENT, threadCount,
+           concurrentTime, threadCount * 1000000 / (concurrentTime ? concurrentTime : 1));
+
+    // Give the kernel a moment to reap the last threads
+    usleep(500000);
+
+    uint64_t usedAfter = Lemon::SysInfo().usedMem;
+    uint64_t stacksAfter = ThreadTestStackUsage();
+    printf("Kernel stacks: %lu KB before, %lu KB after. Used memory: %lu KB before, %lu KB after\n", stacksBefore,
+           stacksAfter, usedBefore, usedAfter);
+
+    // Exited threads are cached, but the caches are bounded
+    if (usedAfter > usedBefore && usedAfter - usedBefore > 16 * 1024) {
+        printf("Leaked %lu KB over %ld threads\n", usedAfter - usedBefore, threadCount * 2);
+        return 1;
+    }
+
+    return 0;
+}
+
+static Test threadTest = {
+    .func = RunThreadTest,
+    .prettyName = "Thread Create/Join Benchmark",
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Test.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define TMPFS_BENCHMARK_FILE_SIZE (128 * 1024 * 1024)
+#define TMPFS_BENCHMARK_CHUNK_SIZE (64 * 1024)
+
+int RunTmpFSBenchmark() {
+    int fd = open("/tmp/tmpfsbenchmark", O_RDWR | O_CREAT | O_TRUNC);
+    if(fd < 0) {
+        perror("/tmp/tmpfsbenchmark: ");
+        return 1;
+    }
+
+    uint8_t* chunk = new uint8_t[TMPFS_BENCHMARK_CHUNK_SIZE];
+    uint8_t* expected = new uint8_t[TMPFS_BENCHMARK_CHUNK_SIZE];
+    for(int i = 0; i < TMPFS_BENCHMARK_CHUNK_SIZE; i++) {
+        expected[i] = i & 0xff;
+    }
+
+    timespec t1;
+    timespec t2;
+
+    // Appending used to reallocate and copy the whole file every time it grew
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for(int i = 0; i < TMPFS_BENCHMARK_FILE_SIZE / TMPFS_BENCHMARK_CHUNK_SIZE; i++) {
+        if(write(fd, expected, TMPFS_BENCHMARK_CHUNK_SIZE) != TMPFS_BENCHMARK_CHUNK_SIZE) {
+            perror("write: ");
+            close(fd);
+            unlink("/tmp/tmpfsbenchmark");
+            delete[] chunk;
+            delete[] expected;
+            return 1;
+        }
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long appendTime = uSecondsFromTimespec(t2 - t1);
+
+    lseek(fd, 0, SEEK_SET);
+
+    int ret = 0;
+    clock_gettime(CLOCK_BOOTTIME, &t1);
+    for(int i = 0; i < TMPFS_BENCHMARK_FILE_SIZE / TMPFS_BENCHMARK_CHUNK_SIZE; i++) {
+        // Clear the chunk so stale data from the last read cannot pass the check
+        memset(chunk, 0, TMPFS_BENCHMARK_CHUNK_SIZE);
+        if(read(fd, chunk, TMPFS_BENCHMARK_CHUNK_SIZE) != TMPFS_BENCHMARK_CHUNK_SIZE ||
+            memcmp(chunk, expected, TMPFS_BENCHMARK_CHUNK_SIZE)) {
+            printf("Read unexpected data from /tmp/tmpfsbenchmark!\n");
+            ret = 1;
+            break;
+        }
+    }
+    clock_gettime(CLOCK_BOOTTIME, &t2);
+    long readTime = uSecondsFromTimespec(t2 - t1);
+
+    close(fd);
+    unlink("/tmp/tmpfsbenchmark");
+    delete[] chunk;
+    delete[] expected;
+
+    if(!ret) {
+        printf("tmpfs append: %ld MB/s, read: %ld MB/s\n", (TMPFS_BENCHMARK_FILE_SIZE / 1024 / 1024) * 1000000L / (appendTime + 1),
+            (TMPFS_BENCHMARK_FILE_SIZE / 1024 / 1024) * 1000000L / (readTime + 1));
+    }
+
+    return ret;
+}
+
+static Test tmpfsTest = {
+    .func = RunTmpFSBenchmark,
+    .prettyName = "tmpfs Append/Read Benchmark"
+};
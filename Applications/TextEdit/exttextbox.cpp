@@ -13,7 +13,8 @@ ExtendedTextBox::ExtendedTextBox(rect_t bounds) : Lemon::GUI::TextBox(bounds, tr
 
 void ExtendedTextBox::Paint(surface_t* surface){
     char num[10];
-    for(int i = (sBar.scrollPos) / (font->lineHeight); i < static_cast<int>(contents.size()) && i * font->lineHeight < textBoxBounds.height + textBoxBounds.y; i++){
+    int lineCount = static_cast<int>(document.LineCount());
+    for(int i = (sBar.scrollPos) / (font->lineHeight); i < lineCount && i * font->lineHeight < textBoxBounds.height + textBoxBounds.y; i++){
         int yPos = fixedBounds.y + (i * font->lineHeight) - sBar.scrollPos;
         snprintf(num, 10, "%d", i + 1);
         int textSz = Lemon::Graphics::GetTextLength(num);
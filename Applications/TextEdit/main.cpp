@@ -17,14 +17,15 @@
 #define TEXTEDIT_SAVEAS 2
 #define TEXTEDIT_SAVE 3
 
+// Bytes of the open file scanned for lines between polling events
+#define TEXTEDIT_INDEX_CHUNK (4 * 1024 * 1024)
+
 ExtendedTextBox* textBox;
 Lemon::GUI::Window* window;
 Lemon::GUI::WindowMenu fileMenu;
 std::string openPath = "";
 
 void LoadFile(const char* path){
-	textBox->contents.clear();
-
 	FILE* textFile = fopen(path, "r");
 
 	if(!textFile){
@@ -36,15 +37,12 @@ void LoadFile(const char* path){
 	long textFileSize = ftell(textFile);
 	fseek(textFile, 0, SEEK_SET);
 
-	char* textBuffer = (char*)malloc(textFileSize + 1);
+	// The text box takes the buffer as is, lines are indexed in the background
+	std::unique_ptr<char[]> textBuffer(new char[textFileSize]);
+	size_t read = fread(textBuffer.get(), 1, textFileSize, textFile);
+	fclose(textFile);
 
-	fread(textBuffer, textFileSize, 1, textFile);
-	for(int i = 0; i < textFileSize; i++){ if(textBuffer[i] == 0) textBuffer[i] = ' ';}
-	textBuffer[textFileSize] = 0;
-	
-	textBox->LoadText(textBuffer);
-	
-	free(textBuffer);
+	textBox->LoadText(std::move(textBuffer), read);
 
 	openPath = path;
 
@@ -76,10 +74,9 @@ void SaveFile(const char* path){
 
 	fseek(textFile, 0, SEEK_SET);
 
-	for(std::string& str : textBox->contents){
-		fwrite(str.c_str(), 1, str.length(), textFile);
-		fwrite("\n", 1, 1, textFile); // Line ending
-	}
+	textBox->document.ForEachSpan([textFile](const char* text, size_t length){
+		fwrite(text, 1, length, textFile);
+	});
 
 	fclose(textFile);
 
@@ -166,8 +163,19 @@ int main(int argc, char** argv){
 		Lemon::WindowServer::Instance()->Poll();
 		
 		window->GUIPollEvents();
+
+		// Keep indexing the file between events, only wait once there is nothing left to do
+		bool indexing = !textBox->document.IsIndexed();
+		if(indexing){
+			textBox->document.IndexLines(TEXTEDIT_INDEX_CHUNK);
+			textBox->ResetScrollBar();
+		}
+
 		window->Paint();
-        Lemon::WindowServer::Instance()->Wait();
+
+		if(!indexing){
+			Lemon::WindowServer::Instance()->Wait();
+		}
 	}
 
 	delete window;
@@ -3,6 +3,8 @@
 #include <Fs/FsVolume.h>
 #include <Hash.h>
 #include <Lock.h>
+#include <MM/Shrinker.h>
+#include <Objects/Process.h>
 #include <String.h>
 #include <Vector.h>
 
@@ -45,8 +47,22 @@
 #define EXT2_DOUBLY_INDIRECT_INDEX 13
 #define EXT2_TRIPLY_INDIRECT_INDEX 14
 
-// When block cache reaches 96MB, use existing cached blocks
-#define EXT2_BLOCKCACHE_LIMIT 96 * 1024 * 1024
+// Once the block cache uses a quarter of RAM, or when memory is low, reuse existing cached blocks.
+// Clean blocks are given back by the block cache shrinker under memory pressure.
+#define EXT2_BLOCKCACHE_LIMIT_DIVISOR 4
+// Most inodes evicted in one pass of the inode cache shrinker
+#define EXT2_INODE_SHRINK_BATCH 64
+
+// How often the flusher thread checks for dirty blocks (us)
+#define EXT2_WRITEBACK_INTERVAL 1000000
+// Dirty blocks older than this are written back by the flusher thread (us)
+#define EXT2_DIRTY_EXPIRE 5000000
+// Flusher thread writes back once this many blocks are dirty
+#define EXT2_DIRTY_BACKGROUND_BLOCKS 1024
+// Writers flush themselves once this many blocks are dirty
+#define EXT2_DIRTY_LIMIT_BLOCKS 8192
+// Most blocks coalesced into one write
+#define EXT2_FLUSH_MAX_BLOCKS 64
 
 //#define EXT2_NO_CACHE
 
@@ -217,6 +233,10 @@ public:
         // Cache directory entries
         HashMap<String, uint32_t> directoryCache;
 
+        // Lookups not yet followed by an open. Whoever looked the node up
+        // holds it with no handle, so it cannot be evicted until they open it
+        unsigned pendingLookups = 0;
+
     public:
         Ext2Node(Ext2Volume* vol, ext2_inode_t& ino, ino_t inode);
 
@@ -224,6 +244,7 @@ public:
         ssize_t Write(size_t, size_t, uint8_t*);
         int ReadDir(DirectoryEntry*, uint32_t);
         FsNode* FindDir(const char* name);
+        ErrorOr<UNIXOpenFile*> Open(size_t flags);
         int Create(DirectoryEntry*, uint32_t);
         int CreateDirectory(DirectoryEntry*, uint32_t);
 
@@ -263,11 +284,30 @@ public:
         lock_t m_blocksLock = 0;
         HashMap<uint32_t, Ext2Node*> inodeCache;
 
+        // Dirty blocks are written back in this order so that on disk
+        // nothing points to a block before the block itself has been written
+        enum BlockWriteOrder : uint8_t {
+            WriteOrderData = 0,      // File data, indirect blocks and bitmaps
+            WriteOrderInode = 1,     // Inode tables
+            WriteOrderDirectory = 2, // Directory entries
+            WriteOrderSummary = 3,   // Superblock and block group descriptors
+        };
+
         struct CachedBlock {
             // When last accessed
             uint64_t timestamp = 0;
+            // When first dirtied since last written back
+            uint64_t dirtyTimestamp = 0;
             uint32_t block = 0;
 
+            uint8_t writeOrder = WriteOrderData;
+            bool dirty = false;
+            // Being written back, the block cannot be evicted until the write completes
+            bool writeback = false;
+            // Being read in from disk, the block is in the cache but not the LRU list
+            // and its data is not valid until the read completes
+            bool reading = false;
+
             CachedBlock* prev = nullptr;
             CachedBlock* next = nullptr;
 
@@ -282,10 +322,23 @@ public:
             return cb;
         }
 
+        // Get a block to cache into, either newly allocated
+        // or the least recently used clean block. Called with m_blocksLock held.
+        CachedBlock* GetFreeCachedBlock();
+        // Drop a freed block from the cache, discarding any unwritten changes
+        void EvictCachedBlock(uint32_t block);
+
         HashMap<uint32_t, CachedBlock*> blockCache = HashMap<uint32_t, CachedBlock*>(1024);
         FastList<CachedBlock*> cachedBlockList;
+        // Dirty blocks in the order they were dirtied
+        Vector<CachedBlock*> dirtyBlocks;
+
+        // Serializes flushes, protects m_flushBuffer
+        Semaphore m_flushLock = Semaphore(1);
+        uint8_t* m_flushBuffer = nullptr;
+        FancyRefPtr<Process> m_flusher;
         HashMap<uint32_t, uint8_t*> bitmapCache = HashMap<uint32_t, uint8_t*>(256);
-        unsigned blockCacheMemoryUsage = 0;
+        size_t blockCacheMemoryUsage = 0;
 
         inline uint32_t LocationToBlock(uint64_t l) { return (l >> super.logBlockSize) >> 10; }
         inline uint32_t BlockToLocation(uint64_t b) { return (b << super.logBlockSize) << 10; }
@@ -312,7 +365,9 @@ public:
         int ReadBlockCached(uint32_t block, void* buffer);
 
         int WriteBlock(uint32_t block, void* buffer);
-        int WriteBlockCached(uint32_t block, void* buffer);
+        // Update the cached copy of a block and mark it dirty,
+        // it gets written to disk by FlushBlocks
+        int WriteBlockCached(uint32_t block, void* buffer, BlockWriteOrder order = WriteOrderData);
 
         Ext2Node* CreateNode();
         int EraseInode(ext2_inode_t& e2inode, uint32_t inode);
@@ -332,7 +387,10 @@ public:
         ssize_t Read(Ext2Node* node, size_t offset, size_t size, uint8_t* buffer);
         ssize_t Write(Ext2Node* node, size_t offset, size_t size, uint8_t* buffer);
         int ReadDir(Ext2Node* node, DirectoryEntry* dirent, uint32_t index);
-        FsNode* FindDir(Ext2Node* node, const char* name);
+        // pin counts as a lookup, keeping the node cached until it is opened
+        FsNode* FindDir(Ext2Node* node, const char* name, bool pin = true);
+        ErrorOr<UNIXOpenFile*> Open(Ext2Node* node, size_t flags);
+        void Close(Ext2Node* node);
         int Create(Ext2Node* node, DirectoryEntry* ent, uint32_t mode);
         int CreateDirectory(Ext2Node* node, DirectoryEntry* ent, uint32_t mode);
         ssize_t ReadLink(Ext2Node* node, char* pathBuffer, size_t bufSize);
@@ -343,11 +401,44 @@ public:
         void SyncNode(Ext2Node* node);
         void CleanNode(Ext2Node* node);
 
+        // Write all dirty cached blocks to disk,
+        // adjacent blocks of the same write order are coalesced into one write
+        int FlushBlocks();
+        // Writes back dirty blocks periodically or when too many blocks are dirty
+        void FlusherThread();
+
+        // Free clean cached blocks, least recently used first
+        size_t ShrinkBlockCache(size_t bytes);
+        size_t ReclaimableBlockCacheMemory();
+        // Evict inodes with no handles and no lookups waiting to open them
+        size_t ShrinkInodeCache(size_t count);
+        size_t InodeCacheMemoryUsage();
+        // Memory used by cached inodes which could be evicted
+        size_t ReclaimableInodeCacheMemory();
+
         int Error() { return error; }
     };
 
+    class BlockCacheShrinker final : public Memory::Shrinker {
+    public:
+        BlockCacheShrinker() : Shrinker("ext2-blocks") {}
+
+        size_t MemoryUsage() override;
+        size_t ReclaimableMemory() override;
+        size_t Shrink(size_t pages) override;
+    };
+
+    class InodeCacheShrinker final : public Memory::Shrinker {
+    public:
+        InodeCacheShrinker() : Shrinker("ext2-inodes") {}
+
+        size_t MemoryUsage() override;
+        size_t ReclaimableMemory() override;
+        size_t Shrink(size_t pages) override;
+    };
+
 public:
-    unsigned totalBlockCacheMemoryUsage = 0;
+    size_t totalBlockCacheMemoryUsage = 0;
 
     Ext2();
     ~Ext2() override;
@@ -362,6 +453,11 @@ public:
 
 private:
     List<FsVolume*> m_extVolumes;
+    // Protects m_extVolumes
+    lock_t m_volumesLock = 0;
+
+    BlockCacheShrinker m_blockCacheShrinker;
+    InodeCacheShrinker m_inodeCacheShrinker;
 
     static lock_t m_instanceLock;
     static Ext2* m_instance;
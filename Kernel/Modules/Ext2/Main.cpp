@@ -5,13 +5,11 @@
 #include <Logging.h>
 #include <Math.h>
 #include <Module.h>
+#include <Scheduler.h>
+#include <Timer.h>
 
 #include <Debug.h>
 
-#ifdef EXT2_ENABLE_TIMER
-#include <Timer.h>
-#endif
-
 namespace fs {
 
 static int ModuleInit() {
@@ -31,8 +29,19 @@ DECLARE_MODULE("ext2fs", "Ext2 Filesystem Driver", ModuleInit, ModuleExit);
 lock_t Ext2::m_instanceLock = 0;
 Ext2* Ext2::m_instance = nullptr;
 
-Ext2::Ext2() { fs::RegisterDriver(this); }
-Ext2::~Ext2() { fs::UnregisterDriver(this); }
+Ext2::Ext2() {
+    fs::RegisterDriver(this);
+
+    Memory::RegisterShrinker(&m_blockCacheShrinker);
+    Memory::RegisterShrinker(&m_inodeCacheShrinker);
+}
+
+Ext2::~Ext2() {
+    Memory::UnregisterShrinker(&m_blockCacheShrinker);
+    Memory::UnregisterShrinker(&m_inodeCacheShrinker);
+
+    fs::UnregisterDriver(this);
+}
 
 Ext2& Ext2::Instance() {
     if (m_instance) {
@@ -55,6 +64,7 @@ FsVolume* Ext2::Mount(FsNode* device, const char* name) {
         return nullptr; // Error mounting volume
     }
 
+    ScopedSpinLock lockVolumes(m_volumesLock);
     m_extVolumes.add_back(vol);
     return vol;
 }
@@ -76,6 +86,86 @@ int Ext2::Identify(FsNode* device) {
 
 const char* Ext2::ID() const { return "ext2"; }
 
+size_t Ext2::BlockCacheShrinker::MemoryUsage() { return Ext2::Instance().totalBlockCacheMemoryUsage; }
+
+size_t Ext2::BlockCacheShrinker::ReclaimableMemory() {
+    Ext2& ext2 = Ext2::Instance();
+    ScopedSpinLock lockVolumes(ext2.m_volumesLock);
+
+    size_t reclaimable = 0;
+    for (FsVolume* vol : ext2.m_extVolumes) {
+        reclaimable += static_cast<Ext2Volume*>(vol)->ReclaimableBlockCacheMemory();
+    }
+
+    return reclaimable;
+}
+
+size_t Ext2::BlockCacheShrinker::Shrink(size_t pages) {
+    Ext2& ext2 = Ext2::Instance();
+    // Volumes only get added from Mount, which allocates
+    if (acquireTestLock(&ext2.m_volumesLock)) {
+        return 0;
+    }
+
+    size_t freed = 0;
+    for (FsVolume* vol : ext2.m_extVolumes) {
+        if (freed >= pages * PAGE_SIZE_4K) {
+            break;
+        }
+
+        freed += static_cast<Ext2Volume*>(vol)->ShrinkBlockCache(pages * PAGE_SIZE_4K - freed);
+    }
+
+    releaseLock(&ext2.m_volumesLock);
+    return freed / PAGE_SIZE_4K;
+}
+
+size_t Ext2::InodeCacheShrinker::MemoryUsage() {
+    Ext2& ext2 = Ext2::Instance();
+    ScopedSpinLock lockVolumes(ext2.m_volumesLock);
+
+    size_t usage = 0;
+    for (FsVolume* vol : ext2.m_extVolumes) {
+        usage += static_cast<Ext2Volume*>(vol)->InodeCacheMemoryUsage();
+    }
+
+    return usage;
+}
+
+size_t Ext2::InodeCacheShrinker::ReclaimableMemory() {
+    Ext2& ext2 = Ext2::Instance();
+    ScopedSpinLock lockVolumes(ext2.m_volumesLock);
+
+    size_t reclaimable = 0;
+    for (FsVolume* vol : ext2.m_extVolumes) {
+        reclaimable += static_cast<Ext2Volume*>(vol)->ReclaimableInodeCacheMemory();
+    }
+
+    return reclaimable;
+}
+
+size_t Ext2::InodeCacheShrinker::Shrink(size_t pages) {
+    Ext2& ext2 = Ext2::Instance();
+    if (acquireTestLock(&ext2.m_volumesLock)) {
+        return 0;
+    }
+
+    size_t wanted = pages * PAGE_SIZE_4K / sizeof(Ext2Node) + 1;
+    size_t evicted = 0;
+    for (FsVolume* vol : ext2.m_extVolumes) {
+        if (evicted >= wanted) {
+            break;
+        }
+
+        evicted += static_cast<Ext2Volume*>(vol)->ShrinkInodeCache(wanted - evicted);
+    }
+
+    releaseLock(&ext2.m_volumesLock);
+    return evicted * sizeof(Ext2Node) / PAGE_SIZE_4K;
+}
+
+static void FlusherThreadEntry(Ext2::Ext2Volume* vol) { vol->FlusherThread(); }
+
 Ext2::Ext2Volume::Ext2Volume(FsNode* device, const char* name) {
     m_device = device;
     assert(device->IsCharDevice() || device->IsBlockDevice());
@@ -181,6 +271,14 @@ Ext2::Ext2Volume::Ext2Volume(FsNode* device, const char* name) {
     mountPointDirent.node = mountPoint;
     mountPointDirent.flags = DT_DIR;
     strcpy(mountPointDirent.name, name);
+
+    if (!readOnly) {
+        m_flushBuffer = (uint8_t*)kmalloc(EXT2_FLUSH_MAX_BLOCKS * blocksize);
+
+        m_flusher = Process::CreateKernelProcess((void*)FlusherThreadEntry, "Ext2Flusher", nullptr);
+        m_flusher->GetMainThread()->registers.rdi = reinterpret_cast<uintptr_t>(this);
+        m_flusher->Start();
+    }
 }
 
 void Ext2::Ext2Volume::WriteSuperblock() {
@@ -195,7 +293,7 @@ void Ext2::Ext2Volume::WriteSuperblock() {
     memcpy(buffer + (EXT2_SUPERBLOCK_LOCATION % blocksize), &super,
            sizeof(ext2_superblock_t) + sizeof(ext2_superblock_extended_t));
 
-    if (WriteBlockCached(superindex, buffer)) {
+    if (WriteBlockCached(superindex, buffer, WriteOrderSummary)) {
         Log::Info("[Ext2] WriteBlock: Error writing block %d", superindex);
         return;
     }
@@ -214,7 +312,7 @@ void Ext2::Ext2Volume::WriteBlockGroupDescriptor(uint32_t index) {
     memcpy(buffer + ((index * sizeof(ext2_blockgrp_desc_t)) % blocksize), &blockGroups[index],
            sizeof(ext2_blockgrp_desc_t));
 
-    if (WriteBlockCached(block, buffer)) {
+    if (WriteBlockCached(block, buffer, WriteOrderSummary)) {
         Log::Info("[Ext2] WriteBlock: Error writing block %d", block);
         return;
     }
@@ -429,15 +527,17 @@ void Ext2::Ext2Volume::SetInodeBlock(uint32_t index, ext2_inode_t& ino, uint32_t
 }
 
 int Ext2::Ext2Volume::ReadInode(uint32_t num, ext2_inode_t& inode) {
-    uint8_t buf[512];
+    uint8_t buf[blocksize];
+    uint64_t off = InodeOffset(num);
 
-    if (int e = fs::Read(m_device, InodeOffset(num) & (~511U), 512, buf); e != 512) {
+    // Go through the block cache so we see inodes which have not been written back
+    if (int e = ReadBlockCached(LocationToBlock(off), buf)) {
         Log::Error("[Ext2] Disk Error (%d) Reading Inode %d", e, num);
         error = DiskReadError;
         return e;
     }
 
-    inode = *(ext2_inode_t*)(buf + ((ResolveInodeBlockGroupIndex(num) * inodeSize) & (512 - 1)));
+    inode = *(ext2_inode_t*)(buf + (off & (blocksize - 1)));
     return 0;
 }
 
@@ -470,47 +570,68 @@ int Ext2::Ext2Volume::ReadBlockCached(uint32_t block, void* buffer) {
         return -EINVAL;
 
 #ifndef EXT2_NO_CACHE
-    ScopedSpinLock lockBlockCache(m_blocksLock);
-
     CachedBlock* cachedBlock;
-    if (blockCache.get(block, cachedBlock)) {
-        cachedBlock->timestamp = Timer::UsecondsSinceBoot();
-        memcpy(buffer, cachedBlock->data, blocksize);
-
-        // Move block to the end of the list
-        cachedBlockList.remove(cachedBlock);
-        cachedBlockList.add_back(cachedBlock);
-    } else {
-        if(blockCacheMemoryUsage >= EXT2_BLOCKCACHE_LIMIT) {
-            // Remove cached blocks until we are at the trim value
-            cachedBlock = cachedBlockList.remove_at(0);
-
-            assert(blockCache.find(cachedBlock->block));
-            blockCache.remove(cachedBlock->block);
-        } else {
-            cachedBlock = AllocateCachedBlock();
+    for (;;) {
+        {
+            ScopedSpinLock lockBlockCache(m_blocksLock);
+
+            if (!blockCache.get(block, cachedBlock)) {
+                // Claim a block and mark it as being read so racing readers wait for us,
+                // the lock is not held whilst we wait on the disk
+                cachedBlock = GetFreeCachedBlock();
+                if (cachedBlock) {
+                    cachedBlock->block = block;
+                    cachedBlock->reading = true;
+                    blockCache.insert(block, cachedBlock);
+                }
+                break;
+            } else if (!cachedBlock->reading) {
+                cachedBlock->timestamp = Timer::UsecondsSinceBoot();
+                memcpy(buffer, cachedBlock->data, blocksize);
 
-            blockCacheMemoryUsage += blocksize;
-            Ext2::Instance().totalBlockCacheMemoryUsage += blocksize;
+                // Move block to the end of the list
+                cachedBlockList.remove(cachedBlock);
+                cachedBlockList.add_back(cachedBlock);
+                return 0;
+            }
         }
 
-        cachedBlock->block = block;
-        cachedBlock->timestamp = Timer::UsecondsSinceBoot();
+        // Someone else is reading the block in
+        Scheduler::Yield();
+    }
 
-        if (int e = fs::Read(m_device, BlockToLocation(block), blocksize, cachedBlock->data); e != blocksize) {
+    if (!cachedBlock) {
+        // Every cached block is waiting to be written back
+        if (int e = fs::Read(m_device, BlockToLocation(block), blocksize, buffer); e != blocksize) {
             Log::Error("[Ext2] Disk error (%d) reading block %d (blocksize: %d)", e, block, blocksize);
-            
-            // Since we didnt end up using this block, place it at the front of the list
-            // so it gets reused first
-            cachedBlockList.add_front(cachedBlock);
             return e;
         }
-        
-        cachedBlockList.add_back(cachedBlock);
-        blockCache.insert(block, cachedBlock);
+        return 0;
+    }
+
+    int e = fs::Read(m_device, BlockToLocation(block), blocksize, cachedBlock->data);
+
+    ScopedSpinLock lockBlockCache(m_blocksLock);
+    cachedBlock->reading = false;
+
+    if (e != blocksize) {
+        Log::Error("[Ext2] Disk error (%d) reading block %d (blocksize: %d)", e, block, blocksize);
+
+        // The block may have been evicted whilst we were reading
+        if (CachedBlock* b; blockCache.get(block, b) && b == cachedBlock) {
+            blockCache.remove(block);
+        }
 
-        memcpy(buffer, cachedBlock->data, blocksize);
+        // Since we didnt end up using this block, place it at the front of the list
+        // so it gets reused first
+        cachedBlockList.add_front(cachedBlock);
+        return e;
     }
+
+    cachedBlock->timestamp = Timer::UsecondsSinceBoot();
+    cachedBlockList.add_back(cachedBlock);
+
+    memcpy(buffer, cachedBlock->data, blocksize);
 #else
     if (int e = fs::Read(m_device, BlockToLocation(block), blocksize, buffer); e != blocksize) {
         Log::Error("[Ext2] Disk error (%d) reading block %d (blocksize: %d)", e, block, blocksize);
@@ -520,28 +641,313 @@ int Ext2::Ext2Volume::ReadBlockCached(uint32_t block, void* buffer) {
     return 0;
 }
 
-int Ext2::Ext2Volume::WriteBlockCached(uint32_t block, void* buffer) {
+Ext2::Ext2Volume::CachedBlock* Ext2::Ext2Volume::GetFreeCachedBlock() {
+    if (blockCacheMemoryUsage < Memory::usablePhysicalBlocks * PAGE_SIZE_4K / EXT2_BLOCKCACHE_LIMIT_DIVISOR &&
+        !Memory::IsUnderMemoryPressure()) {
+        blockCacheMemoryUsage += blocksize;
+        __atomic_add_fetch(&Ext2::Instance().totalBlockCacheMemoryUsage, blocksize, __ATOMIC_RELAXED);
+
+        return AllocateCachedBlock();
+    }
+
+    // Reuse the least recently used block that does not need writing back
+    CachedBlock* cachedBlock = cachedBlockList.get_front();
+    for (unsigned i = 0; i < cachedBlockList.get_length(); i++, cachedBlock = cachedBlock->next) {
+        if (cachedBlock->dirty || cachedBlock->writeback) {
+            continue;
+        }
+
+        cachedBlockList.remove(cachedBlock);
+
+        // Blocks which failed to read or were evicted are no longer in the cache
+        if (CachedBlock* b; blockCache.get(cachedBlock->block, b) && b == cachedBlock) {
+            blockCache.remove(cachedBlock->block);
+        }
+
+        return cachedBlock;
+    }
+
+    return nullptr;
+}
+
+size_t Ext2::Ext2Volume::ShrinkBlockCache(size_t bytes) {
+    // We may have been called by something allocating with the lock held
+    if (acquireTestLock(&m_blocksLock)) {
+        return 0;
+    }
+
+    size_t freed = 0;
+    CachedBlock* cachedBlock = cachedBlockList.get_front();
+    unsigned count = cachedBlockList.get_length();
+    for (unsigned i = 0; i < count && freed < bytes; i++) {
+        CachedBlock* next = cachedBlock->next;
+        if (!cachedBlock->dirty && !cachedBlock->writeback) {
+            cachedBlockList.remove(cachedBlock);
+            if (CachedBlock* b; blockCache.get(cachedBlock->block, b) && b == cachedBlock) {
+                blockCache.remove(cachedBlock->block);
+            }
+
+            kfree(cachedBlock);
+            freed += blocksize;
+        }
+
+        cachedBlock = next;
+    }
+
+    blockCacheMemoryUsage -= freed;
+    __atomic_sub_fetch(&Ext2::Instance().totalBlockCacheMemoryUsage, freed, __ATOMIC_RELAXED);
+
+    releaseLock(&m_blocksLock);
+    return freed;
+}
+
+size_t Ext2::Ext2Volume::ReclaimableBlockCacheMemory() {
+    size_t dirty = dirtyBlocks.size() * blocksize;
+    return blockCacheMemoryUsage > dirty ? blockCacheMemoryUsage - dirty : 0;
+}
+
+size_t Ext2::Ext2Volume::InodeCacheMemoryUsage() { return inodeCache.get_length() * sizeof(Ext2Node); }
+
+size_t Ext2::Ext2Volume::ReclaimableInodeCacheMemory() {
+    ScopedSpinLock lockInodes(m_inodesLock);
+
+    size_t reclaimable = 0;
+    for (Ext2Node* node : inodeCache) {
+        if (node != mountPoint && !node->handleCount && !node->pendingLookups && node->e2inode.linkCount) {
+            reclaimable += sizeof(Ext2Node);
+        }
+    }
+
+    return reclaimable;
+}
+
+size_t Ext2::Ext2Volume::ShrinkInodeCache(size_t count) {
+    if (acquireTestLock(&m_inodesLock)) {
+        return 0;
+    }
+
+    // Collect first, the cache cannot be modified whilst iterating
+    Ext2Node* evict[EXT2_INODE_SHRINK_BATCH];
+    unsigned evictCount = 0;
+
+    for (Ext2Node* node : inodeCache) {
+        if (evictCount >= count || evictCount >= EXT2_INODE_SHRINK_BATCH) {
+            break;
+        }
+
+        // Whoever looked up a node may still be holding it until they open it
+        if (node == mountPoint || node->handleCount > 0 || node->pendingLookups || node->e2inode.linkCount == 0) {
+            continue;
+        }
+
+        evict[evictCount++] = node;
+    }
+
+    for (unsigned i = 0; i < evictCount; i++) {
+        inodeCache.remove(evict[i]->inode);
+        delete evict[i];
+    }
+
+    releaseLock(&m_inodesLock);
+    return evictCount;
+}
+
+void Ext2::Ext2Volume::EvictCachedBlock(uint32_t block) {
+    ScopedSpinLock lockBlockCache(m_blocksLock);
+
+    CachedBlock* cachedBlock;
+    if (!blockCache.get(block, cachedBlock)) {
+        return;
+    }
+
+    blockCache.remove(block);
+
+    // The block may get reallocated, make sure the stale copy never gets written over it
+    if (cachedBlock->dirty) {
+        cachedBlock->dirty = false;
+        for (unsigned i = 0; i < dirtyBlocks.size(); i++) {
+            if (dirtyBlocks[i] == cachedBlock) {
+                dirtyBlocks.erase(i);
+                break;
+            }
+        }
+    }
+}
+
+int Ext2::Ext2Volume::WriteBlockCached(uint32_t block, void* buffer, BlockWriteOrder order) {
     if (block > super.blockCount)
         return -EINVAL;
 
 #ifndef EXT2_NO_CACHE
-    ScopedSpinLock lockBlockCache(m_blocksLock);
-    
-    CachedBlock* cachedBlock;
-    if ((blockCache.get(block, cachedBlock))) {
-        memcpy(cachedBlock->data, buffer, blocksize);
-        cachedBlock->timestamp = Timer::UsecondsSinceBoot();
+    for (;;) {
+        {
+            ScopedSpinLock lockBlockCache(m_blocksLock);
+
+            CachedBlock* cachedBlock;
+            if (!blockCache.get(block, cachedBlock)) {
+                if ((cachedBlock = GetFreeCachedBlock())) {
+                    cachedBlock->block = block;
+
+                    cachedBlockList.add_back(cachedBlock);
+                    blockCache.insert(block, cachedBlock);
+                }
+            } else if (!cachedBlock->reading) {
+                // Move block to the end of the list
+                cachedBlockList.remove(cachedBlock);
+                cachedBlockList.add_back(cachedBlock);
+            } else {
+                goto wait; // Being read in
+            }
+
+            if (cachedBlock) {
+                memcpy(cachedBlock->data, buffer, blocksize);
+                cachedBlock->timestamp = Timer::UsecondsSinceBoot();
+                cachedBlock->writeOrder = order;
+
+                if (!cachedBlock->dirty) {
+                    cachedBlock->dirty = true;
+                    cachedBlock->dirtyTimestamp = cachedBlock->timestamp;
+                    dirtyBlocks.add_back(cachedBlock);
+                }
+
+                return 0;
+            }
+
+            break;
+        }
+
+    wait:
+        // The block is being read in, wait so the read does not overwrite our data
+        Scheduler::Yield();
     }
+    // Every cached block is waiting to be written back,
+    // fall back to writing straight to disk
 #endif
 
     if (int e = fs::Write(m_device, BlockToLocation(block), blocksize, buffer); e != blocksize) {
-        Log::Error("[Ext2] Disk error (%d) reading block %d (blocksize: %d)", e, block, blocksize);
+        Log::Error("[Ext2] Disk error (%d) writing block %d (blocksize: %d)", e, block, blocksize);
         return e;
     }
 
     return 0;
 }
 
+int Ext2::Ext2Volume::FlushBlocks() {
+    if (readOnly) {
+        return 0;
+    }
+
+    if (m_flushLock.Wait()) {
+        return -EINTR;
+    }
+
+    Vector<CachedBlock*> blocks;
+    {
+        ScopedSpinLock lockBlockCache(m_blocksLock);
+
+        // Blocks dirtied from here on get written by the next flush
+        blocks.reserve(dirtyBlocks.size());
+        for (CachedBlock* cachedBlock : dirtyBlocks) {
+            cachedBlock->dirty = false;
+            cachedBlock->writeback = true;
+
+            blocks.add_back(cachedBlock);
+        }
+        dirtyBlocks.clear();
+    }
+
+    // Sort by write order, then by block number so adjacent blocks can be coalesced.
+    // Shell sort, the dirty list is usually close to sorted already
+    auto key = [](CachedBlock* b) -> uint64_t { return (static_cast<uint64_t>(b->writeOrder) << 32) | b->block; };
+    for (size_t gap = blocks.size() / 2; gap > 0; gap /= 2) {
+        for (size_t i = gap; i < blocks.size(); i++) {
+            CachedBlock* b = blocks[i];
+
+            size_t j = i;
+            for (; j >= gap && key(blocks[j - gap]) > key(b); j -= gap) {
+                blocks[j] = blocks[j - gap];
+            }
+            blocks[j] = b;
+        }
+    }
+
+    int ret = 0;
+    size_t i = 0;
+    while (i < blocks.size()) {
+        CachedBlock* first = blocks[i];
+
+        // Coalesce a run of adjacent blocks with the same write order
+        size_t count = 1;
+        while (i + count < blocks.size() && count < EXT2_FLUSH_MAX_BLOCKS &&
+               blocks[i + count]->writeOrder == first->writeOrder && blocks[i + count]->block == first->block + count) {
+            count++;
+        }
+
+        {
+            // Copy under the lock as the blocks may be written to again
+            ScopedSpinLock lockBlockCache(m_blocksLock);
+            for (size_t j = 0; j < count; j++) {
+                memcpy(m_flushBuffer + j * blocksize, blocks[i + j]->data, blocksize);
+            }
+        }
+
+        if (ssize_t e = fs::Write(m_device, BlockToLocation(first->block), count * blocksize, m_flushBuffer);
+            e != (ssize_t)(count * blocksize)) {
+            Log::Error("[Ext2] Disk error (%d) writing back blocks %d-%d", e, first->block, first->block + count - 1);
+            error = DiskWriteError;
+            ret = -EIO;
+
+            // Stop here so nothing of an equal or later write order can reach disk
+            // before the blocks it depends on, keep the rest dirty so the writes get retried
+            ScopedSpinLock lockBlockCache(m_blocksLock);
+            for (size_t j = i; j < blocks.size(); j++) {
+                CachedBlock* cachedBlock = blocks[j];
+                if (!cachedBlock->dirty) {
+                    cachedBlock->dirty = true;
+                    cachedBlock->dirtyTimestamp = Timer::UsecondsSinceBoot();
+                    dirtyBlocks.add_back(cachedBlock);
+                }
+            }
+            break;
+        }
+
+        i += count;
+    }
+
+    {
+        ScopedSpinLock lockBlockCache(m_blocksLock);
+        for (CachedBlock* cachedBlock : blocks) {
+            cachedBlock->writeback = false;
+        }
+    }
+
+    m_flushLock.Signal();
+    return ret;
+}
+
+void Ext2::Ext2Volume::FlusherThread() {
+    for (;;) {
+        Thread::Current()->Sleep(EXT2_WRITEBACK_INTERVAL);
+
+        bool flush = false;
+        {
+            ScopedSpinLock lockBlockCache(m_blocksLock);
+
+            // Blocks are in the order they were dirtied
+            if (dirtyBlocks.size() >= EXT2_DIRTY_BACKGROUND_BLOCKS) {
+                flush = true;
+            } else if (dirtyBlocks.size() &&
+                       Timer::UsecondsSinceBoot() - dirtyBlocks[0]->dirtyTimestamp >= EXT2_DIRTY_EXPIRE) {
+                flush = true;
+            }
+        }
+
+        if (flush) {
+            FlushBlocks();
+        }
+    }
+}
+
 uint32_t Ext2::Ext2Volume::AllocateBlock() {
     for (unsigned i = 0; i < blockGroupCount; i++) {
         ext2_blockgrp_desc_t& group = blockGroups[i];
@@ -749,9 +1155,7 @@ int Ext2::Ext2Volume::EraseInode(ext2_inode_t& e2inode, uint32_t inode) {
     for (unsigned i = 0; i < e2inode.blockCount * (blocksize / 512); i++) {
         uint32_t block = GetInodeBlock(i, e2inode);
         FreeBlock(block);
-        if (blockCache.find(block)) {
-            blockCache.remove(block);
-        }
+        EvictCachedBlock(block);
     }
 
     if (e2inode.blocks[EXT2_SINGLY_INDIRECT_INDEX]) {
@@ -767,9 +1171,7 @@ int Ext2::Ext2Volume::EraseInode(ext2_inode_t& e2inode, uint32_t inode) {
 
             for (unsigned i = 0; i < (blocksize / sizeof(uint32_t)) && blockPointers[i] != 0; i++) {
                 FreeBlock(blockPointers[i]);
-                if (blockCache.find(blockPointers[i])) {
-                    blockCache.remove(blockPointers[i]);
-                }
+                EvictCachedBlock(blockPointers[i]);
             }
 
             FreeBlock(e2inode.blocks[EXT2_DOUBLY_INDIRECT_INDEX]);
@@ -945,7 +1347,7 @@ int Ext2::Ext2Volume::WriteDir(Ext2Node* node, List<DirectoryEntry>& entries) {
         totalOffset += e2dirent->recordLength;
 
         if (blockOffset >= blocksize) {
-            if (WriteBlockCached(GetInodeBlock(currentBlockIndex, ino), buffer)) {
+            if (WriteBlockCached(GetInodeBlock(currentBlockIndex, ino), buffer, WriteOrderDirectory)) {
                 Log::Error("[Ext2] WriteDir: Failed to write directory block");
                 error = DiskWriteError;
                 return -1;
@@ -1092,7 +1494,7 @@ int Ext2::Ext2Volume::ReadDir(Ext2Node* node, DirectoryEntry* dirent, uint32_t i
     return 1;
 }
 
-FsNode* Ext2::Ext2Volume::FindDir(Ext2Node* node, const char* name) {
+FsNode* Ext2::Ext2Volume::FindDir(Ext2Node* node, const char* name, bool pin) {
     if ((node->flags & FS_NODE_TYPE) != FS_NODE_DIRECTORY) {
         return nullptr;
     }
@@ -1201,6 +1603,9 @@ FsNode* Ext2::Ext2Volume::FindDir(Ext2Node* node, const char* name) {
     }
 
     assert(returnNode);
+    if (pin) {
+        returnNode->pendingLookups++;
+    }
     return returnNode;
 }
 
@@ -1416,22 +1821,28 @@ ssize_t Ext2::Ext2Volume::Write(Ext2Node* node, size_t offset, size_t size, uint
         ret -= size;
     }
 
+    // Throttle writers when the flusher thread cannot keep up
+    if (dirtyBlocks.size() >= EXT2_DIRTY_LIMIT_BLOCKS) {
+        FlushBlocks();
+    }
+
     return ret;
 }
 
 void Ext2::Ext2Volume::SyncInode(ext2_inode_t& e2inode, uint32_t inode) {
     uint8_t buf[blocksize];
     uint64_t off = InodeOffset(inode);
+    uint32_t block = LocationToBlock(off);
 
-    if (int e = fs::Read(m_device, off & (~511U), blocksize, buf); e != blocksize) {
+    if (int e = ReadBlockCached(block, buf)) {
         Log::Error("[Ext2] Sync: Disk Error (%d) Reading Inode %d", e, inode);
         error = DiskReadError;
         return;
     }
 
-    *(ext2_inode_t*)(buf + (off & (511U))) = e2inode;
+    *(ext2_inode_t*)(buf + (off & (blocksize - 1))) = e2inode;
 
-    if (int e = fs::Write(m_device, off & (~511U), blocksize, buf); e != blocksize) {
+    if (int e = WriteBlockCached(block, buf, WriteOrderInode)) {
         Log::Error("[Ext2] Sync: Disk Error (%d) Writing Inode %d", e, inode);
         error = DiskWriteError;
         return;
@@ -1448,7 +1859,7 @@ int Ext2::Ext2Volume::Create(Ext2Node* node, DirectoryEntry* ent, uint32_t mode)
         return -ENOTDIR; // Ensure the directory node is actually a directory
 
     // Make sure the filename does not already exist under the directory
-    if (FindDir(node, ent->name)) {
+    if (FindDir(node, ent->name, false)) {
         Log::Info("[Ext2] Create: Entry %s already exists!", ent->name);
         return -EEXIST;
     }
@@ -1466,6 +1877,8 @@ int Ext2::Ext2Volume::Create(Ext2Node* node, DirectoryEntry* ent, uint32_t mode)
     // File is only references by one directory
     file->nlink = 1;
     file->e2inode.linkCount = 1;
+    // The caller gets the node through ent
+    file->pendingLookups = 1;
     inodeCache.insert(file->inode, file);
 
     // Update the directory entry with the inode
@@ -1490,7 +1903,7 @@ int Ext2::Ext2Volume::CreateDirectory(Ext2Node* node, DirectoryEntry* ent, uint3
         return -ENOTDIR;
     }
 
-    if (FindDir(node, ent->name)) {
+    if (FindDir(node, ent->name, false)) {
         Log::Info("[Ext2] CreateDirectory: Entry %s already exists!", ent->name);
         return -EEXIST;
     }
@@ -1505,6 +1918,8 @@ int Ext2::Ext2Volume::CreateDirectory(Ext2Node* node, DirectoryEntry* ent, uint3
     dir->e2inode.mode = EXT2_S_IFDIR;
     dir->flags = FS_NODE_DIRECTORY;
     dir->e2inode.linkCount = 1;
+    // The caller gets the node through ent
+    dir->pendingLookups = 1;
 
     inodeCache.insert(dir->inode, dir);
     ent->node = dir;
@@ -1687,6 +2102,38 @@ int Ext2::Ext2Volume::Truncate(Ext2Node* node, off_t length) {
     return 0;
 }
 
+ErrorOr<UNIXOpenFile*> Ext2::Ext2Volume::Open(Ext2Node* node, size_t flags) {
+    UNIXOpenFile* fDesc = new UNIXOpenFile;
+
+    fDesc->pos = 0;
+    fDesc->mode = flags;
+    fDesc->node = node;
+
+    ScopedSpinLock lockInodes(m_inodesLock);
+    node->handleCount++;
+
+    // The handle now keeps the node cached in place of the lookup
+    if (node->pendingLookups) {
+        node->pendingLookups--;
+    }
+
+    return fDesc;
+}
+
+void Ext2::Ext2Volume::Close(Ext2Node* node) {
+    {
+        ScopedSpinLock lockInodes(m_inodesLock);
+        node->handleCount--;
+
+        // Linked nodes stay cached, the inode cache shrinker frees them
+        if (node->handleCount || node->e2inode.linkCount) {
+            return;
+        }
+    }
+
+    CleanNode(node); // Erase the unlinked inode and remove from the cache
+}
+
 void Ext2::Ext2Volume::CleanNode(Ext2Node* node) {
     if (node->handleCount > 0) {
         Log::Warning("[Ext2] CleanNode: Node (inode %d) is referenced by %d handles", node->inode, node->handleCount);
@@ -1809,14 +2256,12 @@ int Ext2::Ext2Node::Truncate(off_t length) {
     return ret;
 }
 
-void Ext2::Ext2Node::Sync() { vol->SyncNode(this); }
+void Ext2::Ext2Node::Sync() {
+    vol->SyncNode(this);
+    vol->FlushBlocks();
+}
 
-void Ext2::Ext2Node::Close() {
-    handleCount--;
+ErrorOr<UNIXOpenFile*> Ext2::Ext2Node::Open(size_t flags) { return vol->Open(this, flags); }
 
-    if (handleCount == 0) {
-        vol->CleanNode(this); // Remove from the cache
-        return;
-    }
-}
+void Ext2::Ext2Node::Close() { vol->Close(this); }
 } // namespace fs
\ No newline at end of file
@@ -12,6 +12,7 @@
 #define I8254_REGISTER_CTRL_EXT     0x18
 #define I8254_REGISTER_INT_READ     0xC0
 #define I8254_REGISTER_INT_MASK     0xD0
+#define I8254_REGISTER_INT_MASK_CLEAR 0xD8
 
 #define I8254_REGISTER_RCTRL        0x100
 #define I8254_REGISTER_RDESC_LO     0x2800
@@ -66,6 +67,14 @@
 #define TSTATUS_EC (1 << 1) // Excess Collisions
 #define TSTATUS_LC (1 << 2) // Late collision
 
+#define RSTATUS_DD (1 << 0) // Descriptor Done
+
+#define INT_LSC (1 << 2)    // Link Status Change
+#define INT_RXDMT0 (1 << 4) // Receive Descriptor Minimum Threshold
+#define INT_RXO (1 << 6)    // Receiver Overrun
+#define INT_RXT0 (1 << 7)   // Receiver Timer
+#define INT_RX (INT_RXDMT0 | INT_RXO | INT_RXT0)
+
 #define STATUS_LINK_UP (1 << 1)
 #define STATUS_SPEED (3 << 6)   // 00b - 10Mb/s, 01b - 100MB/s, 10b/11b - 1000Mb/s
 
@@ -83,6 +92,8 @@ public:
 
     void SendPacket(void* data, size_t len);
 
+    int Poll(int budget) override;
+
 private:
     typedef struct {
         uint64_t addr; // Buffer Address
@@ -107,10 +118,11 @@ private:
     r_desc_t* rxDescriptors;
     t_desc_t* txDescriptors;
     void** txDescriptorsVirt;
-    void** rxDescriptorsVirt;
+    // The card DMAs straight into packet buffers
+    NetworkPacket* rxPackets[RX_DESC_COUNT];
 
     unsigned txTail = 0;
-    unsigned rxTail = 0;
+    unsigned rxTail = 0; // Last descriptor given to the card
 
     uint64_t memBase;
     void* memBaseVirt;
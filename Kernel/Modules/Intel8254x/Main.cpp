@@ -97,40 +97,68 @@ bool Intel8254x::CheckForEEPROM() {
 void Intel8254x::OnInterrupt() {
     uint32_t status = ReadMem32(I8254_REGISTER_INT_READ);
 
-    if (status & 0x4) {
+    if (status & INT_LSC) {
         Log::Info("[i8254x] Initializing Link...");
 
         WriteMem32(I8254_REGISTER_CTRL, ReadMem32(I8254_REGISTER_CTRL) | CTRL_SLU | CTRL_ASDE);
 
         UpdateLink();
-    } else if (status & 0x80) {
-        do {
-            rxTail = ReadMem32(I8254_REGISTER_RDESC_TAIL);
-            if (rxTail == ReadMem32(I8254_REGISTER_RDESC_HEAD))
-                return;
-            rxTail = (rxTail + 1) % RX_DESC_COUNT;
+    }
 
-            if (!(rxDescriptors[rxTail].status & 0x1))
-                break;
+    if (status & INT_RX) {
+        // Mask receive interrupts until the network thread has emptied the ring
+        WriteMem32(I8254_REGISTER_INT_MASK_CLEAR, INT_RX);
+        ScheduleReceive();
+    }
+}
 
-            rxDescriptors[rxTail].status = 0;
+int Intel8254x::Poll(int budget) {
+    int received = 0;
+    while (received < budget) {
+        unsigned next = (rxTail + 1) % RX_DESC_COUNT;
+        r_desc_t* rxd = &rxDescriptors[next];
+        if (!(rxd->status & RSTATUS_DD)) {
+            break;
+        }
+
+        NetworkPacket* pkt = rxPackets[next];
+        NetworkPacket* replacement = nullptr;
+        if (rxd->length <= ETHERNET_MAX_PACKET_SIZE) {
+            replacement = Network::AllocatePacket();
+        }
+
+        if (replacement) {
+            pkt->length = rxd->length;
+            pkt->adapter = this;
+
+            // Hand the card a fresh buffer and pass the filled one up without copying
+            rxPackets[next] = replacement;
+            rxd->addr = replacement->physicalAddress;
+
+            Network::OnReceive(pkt);
+            pkt->Release();
+        } // Otherwise drop the packet and give the buffer back to the card
 
-            if (rxDescriptors[rxTail].length <= ETHERNET_MAX_PACKET_SIZE && cache.get_length()) {
-                NetworkPacket* pkt = cache.remove_at(0);
+        rxd->status = 0;
+        rxTail = next;
+        received++;
+    }
 
-                pkt->length = rxDescriptors[rxTail].length;
-                memcpy(pkt->data, rxDescriptorsVirt[rxTail], pkt->length);
+    if (received) {
+        WriteMem32(I8254_REGISTER_RDESC_TAIL, rxTail);
+    }
 
-                queue.add_back(pkt);
-                packetSemaphore.Signal();
-                Network::packetQueueSemaphore.Signal();
-            } else {
-                // TODO: Do something that isn't dropping the packet when the cache is empty
-            }
+    if (received < budget) {
+        WriteMem32(I8254_REGISTER_INT_MASK, INT_RX);
 
-            WriteMem32(I8254_REGISTER_RDESC_TAIL, rxTail);
-        } while (1);
+        // A packet may have arrived after we checked but before receive interrupts were unmasked
+        if (rxDescriptors[(rxTail + 1) % RX_DESC_COUNT].status & RSTATUS_DD) {
+            WriteMem32(I8254_REGISTER_INT_MASK_CLEAR, INT_RX);
+            ScheduleReceive();
+        }
     }
+
+    return received;
 }
 
 int Intel8254x::GetSpeed() {
@@ -179,8 +207,7 @@ void Intel8254x::InitializeRx() {
     uint32_t rxLen = 4096; // Memory block size
     uint32_t rxHead = 0;
     uint32_t _rxTail = RX_DESC_COUNT - 1; // Offset from base
-
-    rxDescriptorsVirt = (void**)kmalloc(RX_DESC_COUNT * sizeof(void*));
+    rxTail = _rxTail;
 
     WriteMem32(I8254_REGISTER_RDESC_LO, rxLow);
     WriteMem32(I8254_REGISTER_RDESC_HI, rxHigh);
@@ -190,12 +217,11 @@ void Intel8254x::InitializeRx() {
 
     for (int i = 0; i < RX_DESC_COUNT; i++) {
         r_desc_t* rxd = &rxDescriptors[i];
-        uint64_t phys = Memory::AllocatePhysicalMemoryBlock();
-        rxd->addr = phys;
-        rxd->status = 0;
+        rxPackets[i] = Network::AllocatePacket();
+        assert(rxPackets[i]);
 
-        rxDescriptorsVirt[i] = Memory::KernelAllocate4KPages(1);
-        Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)rxDescriptorsVirt[i], 1);
+        rxd->addr = rxPackets[i]->physicalAddress;
+        rxd->status = 0;
     }
 
     WriteMem32(I8254_REGISTER_RCTRL,
@@ -306,11 +332,6 @@ Intel8254x::Intel8254x(const PCIInfo& device)
 
     dState = DriverState::OK;
 
-    maxCache = 256;
-    for (unsigned i = 0; i < maxCache; i++) {
-        cache.add_back(new NetworkPacket()); // Fill the cache
-    }
-
     WriteMem32(I8254_REGISTER_INT_MASK, 0x1F6DF); // Set the interrupt mask to enable all interrupts
     UpdateLink();
 }
@@ -6,6 +6,8 @@
 
 namespace Audio {
 
+void AC97IRQ(void* c, RegisterContext*);
+
 AC97Controller::AC97Controller(const PCIInfo& info) : PCIDevice(info) {
     SetDeviceName("AC97 Audio Controller");
 
@@ -25,6 +27,12 @@ AC97Controller::AC97Controller(const PCIInfo& info) : PCIDevice(info) {
 
     m_nabmPort = m_busMasterBaseAddress;
 
+    uint8_t v = AllocateVector(PCIVectorLegacy);
+    assert(v != 0xff);
+
+    IDT::RegisterInterruptHandler(v, AC97IRQ, this);
+    EnableInterrupts();
+
     outportw(m_ioPort + NAMMasterVolume, AC97_MIXER_VOLUME(AC97_VOLUME_MAX, AC97_VOLUME_MAX, 0));
     outportw(m_ioPort + NAMPCMVolume, AC97_MIXER_VOLUME(AC97_VOLUME_MAX, AC97_VOLUME_MAX, 0));
 
@@ -67,12 +75,11 @@ AC97Controller::AC97Controller(const PCIInfo& info) : PCIDevice(info) {
     while (i--) {
         KernelAllocateMappedBlock<uint16_t>(&sampleBuffersPhys[i], &sampleBuffers[i]);
 
+        // Sample count is set as each period gets queued
         bufferDescriptorList[i] =
-            BufferDescriptor{.address = (uint32_t)sampleBuffersPhys[i],
-                             // At two channels, 16-bit samples this is 4096/2/2 = 1024 samples/channel
-                             .sampleCount = (uint16_t)(PAGE_SIZE_4K / m_pcmSampleSize),
-                             .flags = 0};
+            BufferDescriptor{.address = (uint32_t)sampleBuffersPhys[i], .sampleCount = 0, .flags = 0};
     }
+    // At two channels, 16-bit samples this is 4096/2/2 = 1024 samples/channel
     m_samplesPerBuffer = PAGE_SIZE_4K / m_pcmSampleSize / m_pcmNumChannels;
 
     outportl(m_nabmPort + PO_BufferDescriptorList, bufferDescriptorListPhys);
@@ -119,111 +126,98 @@ int AC97Controller::OutputSampleRate(void* output) const { return AC97_SAMPLE_RA
 
 int AC97Controller::OutputSetNumberOfChannels(int channels) { return -ENOSYS; }
 
-int AC97Controller::WriteSamples(void* output, uint8_t* buffer, size_t size, bool async) {
-    // TODO: Ensure exclusive access to /dev/pcm,
-    // currently if two threads attempt to play audio directly
-    // they may deadlock
-    if (size % (m_pcmSampleSize * m_pcmNumChannels)) {
-        Log::Info("[AC97] invalid write: not an exact frame");
-        return -EINVAL; // Must be writing exact frame
+void AC97Controller::OutputStart(void*) {
+    ScopedSpinLock<true> lockController(m_lock);
+    if (m_running) {
+        return; // Periods get refilled as the hardware completes them
     }
 
-    int totalSamplesWritten = 0;
-    int buffersToWrite = (((int)size + PAGE_SIZE_4K - 1) >> PAGE_SHIFT_4K);
-
-    while (size > 0) {
-        uint8_t isDMARunning = !(inportw(m_nabmPort + PO_TransferStatus) & NBDMAStatus);
-        if (isDMARunning) {
-            int remainingBuffers = 0;
-            do {
-                int currentBuffer = inportb(m_nabmPort + PO_CurrentEntry);
-                int lastValidEntry = inportb(m_nabmPort + PO_LastValidEntry);
-
-                // Get the remaining buffers to be processed
-                remainingBuffers = lastValidEntry - currentBuffer;
-                if (remainingBuffers < 0) {
-                    remainingBuffers += AC97_BDL_ENTRIES;
-                }
-                remainingBuffers += 1;
-
-                if (remainingBuffers >= AC97_BDL_ENTRIES - 1) {
-                    // We can not fit any buffers,
-                    // Wait for the samples to finish processing, give 10ms leeway
-                    long samples =
-                        bufferDescriptorList[(currentBuffer + 1) % AC97_BDL_ENTRIES].sampleCount / m_pcmNumChannels;
-
-                    // Sleep whilst the next buffer gets processed
-                    if (samples > 0) {
-                        Thread::Current()->Sleep(samples * 1000000 / AC97_SAMPLE_RATE);
-                    }
-                }
-            } while (remainingBuffers >= AC97_BDL_ENTRIES - 1 && IsDMARunning());
-        }
+    Start();
+}
+
+int AC97Controller::OutputQueuedFrames(void*) const { return m_queuedFrames; }
+
+void AC97Controller::Start() {
+    uint16_t nabmTransferControl = m_nabmPort + PO_TransferControl;
 
-        int samplesWritten = 0;
-        {
-            ScopedSpinLock lockController(m_lock);
-
-            int currentBuffer = inportb(m_nabmPort + PO_CurrentEntry);
-            int lastValidEntry = inportb(m_nabmPort + PO_LastValidEntry);
-
-            int nextBuffer = lastValidEntry % AC97_BDL_ENTRIES;
-            isDMARunning = !(inportw(m_nabmPort + PO_TransferStatus) & NBDMAStatus);
-            if (isDMARunning) {
-                nextBuffer = (lastValidEntry + 1) % AC97_BDL_ENTRIES;
-                if (nextBuffer == currentBuffer) {
-                    continue;
-                }
-            }
-
-            do {
-                int written = MIN(PAGE_SIZE_4K, size);
-                // Copy audio data to our mapped buffers which will be sent
-                // to the hardware
-                memcpy(sampleBuffers[nextBuffer], buffer, written);
-                bufferDescriptorList[nextBuffer].flags = 0;
-
-                samplesWritten += written / m_pcmSampleSize / m_pcmNumChannels;
-
-                // Increment the source buffer
-                buffer += written;
-                size -= written;
-
-                // Make sure we update this value in case the buffer isnt full
-                // to make sure the AC97 doesn't play old audio
-                bufferDescriptorList[nextBuffer].sampleCount = written / m_pcmSampleSize;
-                buffersToWrite--;
-
-                nextBuffer = (nextBuffer + 1) % AC97_BDL_ENTRIES;
-            } while (buffersToWrite-- && nextBuffer != currentBuffer);
-
-            outportb(m_nabmPort + PO_LastValidEntry, nextBuffer - 1);
-
-            isDMARunning = !(inportw(m_nabmPort + PO_TransferStatus) & NBDMAStatus);
-            if (!isDMARunning) {
-                StartDMA(); // Ensure DMA is running
-            }
+    // Resetting the box puts the current and last valid entries back to 0
+    outportb(nabmTransferControl, inportb(nabmTransferControl) | NBTransferReset);
+    while (inportb(nabmTransferControl) & NBTransferReset)
+        ;
+
+    outportl(m_nabmPort + PO_BufferDescriptorList, bufferDescriptorListPhys);
+
+    m_playingEntry = 0;
+    m_nextEntry = 0;
+    m_queued = 0;
+    m_queuedFrames = 0;
+
+    FillPeriods();
+    if (!m_queued) {
+        return; // Nothing to play
+    }
+
+    m_running = true;
+    outportb(nabmTransferControl, NBTransferDMAControl | NBLastEntryInterrupt | NBInterruptOnCompletion |
+                                      NBFIFOErrorInterrupt);
+}
+
+void AC97Controller::FillPeriods() {
+    unsigned frames = MIN(m_pcm->periodFrames, (unsigned)m_samplesPerBuffer);
+
+    while (m_queued < AC97_PERIODS_QUEUED) {
+        if (!MixPeriod(m_pcm, sampleBuffers[m_nextEntry], frames)) {
+            break; // Let the hardware run dry
         }
-        totalSamplesWritten += samplesWritten;
+
+        bufferDescriptorList[m_nextEntry].sampleCount = frames * m_pcmNumChannels;
+        bufferDescriptorList[m_nextEntry].flags = BDInterruptOnCompletion;
+        outportb(m_nabmPort + PO_LastValidEntry, m_nextEntry);
+
+        m_nextEntry = (m_nextEntry + 1) % AC97_BDL_ENTRIES;
+        m_queued++;
+        m_queuedFrames += frames;
     }
+}
+
+void AC97Controller::RetireEntries(unsigned count) {
+    while (count-- && m_queued) {
+        m_queuedFrames -= bufferDescriptorList[m_playingEntry].sampleCount / m_pcmNumChannels;
+        m_queued--;
 
-    return totalSamplesWritten;
+        m_playingEntry = (m_playingEntry + 1) % AC97_BDL_ENTRIES;
+    }
 }
 
+void AC97IRQ(void* c, RegisterContext*) { reinterpret_cast<AC97Controller*>(c)->OnIRQ(); }
+
 void AC97Controller::OnIRQ() {
-    Log::Info("AC97 IRQ!!");
+    ScopedSpinLock<true> lockController(m_lock);
+    uint16_t status = inportw(m_nabmPort + PO_TransferStatus);
+    if (!(status & (NBLastEntryInterrupt | NBInterruptOnCompletion | NBFifoError))) {
+        return; // Interrupt is for another device
+    }
 
-    ScopedSpinLock lockController(m_lock);
-    uint16_t status = inportw(m_ioPort + PO_TransferStatus);
+    // Clear the interrupt flags
+    outportw(m_nabmPort + PO_TransferStatus, NBLastEntryInterrupt | NBInterruptOnCompletion | NBFifoError);
 
-    if (status & NBInterruptOnCompletion) {
-        Log::Info("IOC");
-    } else if (status & NBLastEntryInterrupt) {
-        Log::Info("End of transfer!!");
-        StopDMA();
+    if (!m_running) {
+        return;
     }
 
-    // Clear all flags
-    outportw(m_ioPort + PO_TransferStatus, 0xffff);
+    if (status & NBDMAStatus) {
+        // DMA halted after the last valid entry, everything queued has been played.
+        // Restart if more samples arrived in the meantime.
+        RetireEntries(m_queued);
+        m_running = false;
+
+        Start();
+        return;
+    }
+
+    unsigned current = inportb(m_nabmPort + PO_CurrentEntry);
+    RetireEntries((current + AC97_BDL_ENTRIES - m_playingEntry) % AC97_BDL_ENTRIES);
+
+    FillPeriods();
 }
-} // namespace Audio
\ No newline at end of file
+} // namespace Audio
@@ -25,6 +25,8 @@
 
 // amount of buffer descriptor list entries
 #define AC97_BDL_ENTRIES 32
+// amount of periods queued ahead of the one playing
+#define AC97_PERIODS_QUEUED 4
 
 #define AC97_SAMPLE_RATE 48000
 
@@ -47,11 +49,20 @@ public:
     int OutputSampleRate(void* output) const override;
     int OutputSetNumberOfChannels(int channels) override;
 
-    int WriteSamples(void* output, uint8_t* buffer, size_t size, bool async) override;
+    void OutputStart(void* output) override;
+    int OutputQueuedFrames(void* output) const override;
 
     void OnIRQ();
 
 private:
+    // Reset the PCM out box and start DMA if there is audio to play,
+    // called with m_lock held
+    void Start();
+    // Queue mixed periods until AC97_PERIODS_QUEUED are queued or there is nothing to play
+    void FillPeriods();
+    // Remove played entries from the queue
+    void RetireEntries(unsigned count);
+
     inline void StartDMA() {
         outportb(m_nabmPort + PO_TransferControl, inportb(m_nabmPort + PO_TransferControl) | NBTransferDMAControl);
     }
@@ -167,11 +178,19 @@ private:
     uintptr_t bufferDescriptorListPhys;
     BufferDescriptor* bufferDescriptorList;
 
-    // For now use two buffer entries
-    uintptr_t sampleBuffersPhys[32];
-    uint16_t* sampleBuffers[32];
+    uintptr_t sampleBuffersPhys[AC97_BDL_ENTRIES];
+    uint16_t* sampleBuffers[AC97_BDL_ENTRIES];
     // Amount of samples per channel in each buffer
     int m_samplesPerBuffer;
+
+    bool m_running = false;
+    // Entry being played by the hardware
+    unsigned m_playingEntry = 0;
+    // Entry to fill next
+    unsigned m_nextEntry = 0;
+    // Entries (and frames) queued, including the one playing
+    unsigned m_queued = 0;
+    unsigned m_queuedFrames = 0;
 };
 
 }
\ No newline at end of file
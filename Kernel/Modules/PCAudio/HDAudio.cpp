@@ -7,13 +7,33 @@
 
 namespace Audio {
 
-int IntelHDAudioController::SetMasterVolume(int percentage) { return 0; }
+int IntelHDAudioController::SetMasterVolume(int percentage) {
+    m_masterVolume = percentage;
 
-int IntelHDAudioController::GetMasterVolume() const { return 0; }
+    for (HDAOutput* out : m_outputs) {
+        UpdateOutputAmp(out);
+    }
+    return 0;
+}
 
-int IntelHDAudioController::OutputSetVolume(void* output, int percentage) { return 0; }
+int IntelHDAudioController::GetMasterVolume() const { return m_masterVolume; }
 
-int IntelHDAudioController::OutputGetVolume(void* output) const { return 0; }
+int IntelHDAudioController::OutputSetVolume(void* output, int percentage) {
+    // Every converter plays the PCM out stream
+    for (HDAOutput* out : m_outputs) {
+        out->volume = percentage;
+        UpdateOutputAmp(out);
+    }
+    return 0;
+}
+
+int IntelHDAudioController::OutputGetVolume(void* output) const {
+    if(m_outputs.get_length()) {
+        return m_outputs[0]->volume;
+    }
+
+    return -ENODEV;
+}
 
 SoundEncoding IntelHDAudioController::OutputGetEncoding(void* output) const {
     if(m_outputs.get_length()) {
@@ -41,13 +61,103 @@ int IntelHDAudioController::OutputSampleRate(void* output) const {
 
 int IntelHDAudioController::OutputSetNumberOfChannels(int channels) { return -ENOSYS; }
 
-int IntelHDAudioController::WriteSamples(void*, uint8_t* buffer, size_t size, bool) {
-    return -ENOSYS;
+void IntelHDAudioController::OutputStart(void*) {
+    ScopedSpinLock<true> lockController(m_lock);
+    if (!m_running) {
+        StartOutput();
+    }
+}
+
+int IntelHDAudioController::OutputQueuedFrames(void*) const {
+    if (!m_running) {
+        return 0;
+    }
+
+    // Everything in the cyclic buffer is yet to be played,
+    // apart from what has already been read of the current period
+    uint32_t periodBytes = m_periodFrames * m_outputs[0]->sampleSize * m_outputs[0]->channels;
+    uint32_t position = m_cRegs->streams[m_outputStream->descriptor].linkPosInCurrentBuffer;
+
+    return m_periodFrames * m_outputStream->bdlEntries -
+           (position % periodBytes) / (m_outputs[0]->sampleSize * m_outputs[0]->channels);
+}
+
+void IntelHDAudioController::StartOutput() {
+    if (!m_outputStream.get()) {
+        return;
+    }
+
+    HDAOutput* out = m_outputs[0];
+    uint32_t frameSize = out->sampleSize * out->channels;
+
+    m_periodFrames = MIN(m_pcmOut.periodFrames, PAGE_SIZE_4K / frameSize);
+
+    ProgramStream(m_outputStream.get(), m_periodFrames * frameSize);
+
+    unsigned audible = 0;
+    for (unsigned i = 0; i < m_outputStream->bdlEntries; i++) {
+        audible += MixPeriod(&m_pcmOut, m_outputStream->buffers[i], m_periodFrames);
+    }
+
+    if (!audible) {
+        return; // Nothing to play
+    }
+
+    m_nextPeriod = 0;
+    m_idlePeriods = 0;
+    m_running = true;
+
+    m_cRegs->intControl |= HDA_INTCTL_SIE(m_outputStream->descriptor);
+    m_cRegs->streams[m_outputStream->descriptor].control |= HDA_STREAM_CTL_RUN;
+}
+
+void IntelHDAudioController::RefillOutput() {
+    StreamDescriptor* desc = &m_cRegs->streams[m_outputStream->descriptor];
+
+    HDAOutput* out = m_outputs[0];
+    uint32_t periodBytes = m_periodFrames * out->sampleSize * out->channels;
+    unsigned current = (desc->linkPosInCurrentBuffer / periodBytes) % m_outputStream->bdlEntries;
+
+    // Refill every period the hardware has moved past
+    while (m_nextPeriod != current) {
+        if (MixPeriod(&m_pcmOut, m_outputStream->buffers[m_nextPeriod], m_periodFrames)) {
+            m_idlePeriods = 0;
+        } else {
+            m_idlePeriods++;
+        }
+
+        m_nextPeriod = (m_nextPeriod + 1) % m_outputStream->bdlEntries;
+    }
+
+    if (m_idlePeriods >= m_outputStream->bdlEntries) {
+        // The whole cyclic buffer is silence, stop until there are samples again
+        desc->control &= ~HDA_STREAM_CTL_RUN;
+        m_running = false;
+    }
 }
 
 void HDAIRQ(void* c, RegisterContext*) { ((IntelHDAudioController*)c)->OnInterrupt(); }
 
 void IntelHDAudioController::OnInterrupt() {
+    uint32_t intStatus = m_cRegs->intStatus;
+
+    if (m_outputStream.get() && (intStatus & HDA_INTCTL_SIE(m_outputStream->descriptor))) {
+        ScopedSpinLock<true> lockController(m_lock);
+
+        StreamDescriptor* desc = &m_cRegs->streams[m_outputStream->descriptor];
+        uint8_t status = desc->status;
+        // Clear the status bits
+        desc->status = status;
+
+        if (status & (HDA_STREAM_STS_FIFO_ERROR | HDA_STREAM_STS_DESC_ERROR)) {
+            Log::Warning("[HDAudio] Output stream error (status: %x)", status);
+        }
+
+        if (m_running) {
+            RefillOutput();
+        }
+    }
+
     if (m_cRegs->rirbStatus & 0x4) {
         Log::Warning("[HDAudio] RIRB Overrun");
     }
@@ -170,7 +280,7 @@ IntelHDAudioController::IntelHDAudioController(const PCIInfo& info) : PCIDevice(
 
     // Enable interrupts and unsolicited repsonses
     m_cRegs->globalControl |= (1 << 8);
-    m_cRegs->intControl = (1U << 31) | (1U << 30);
+    m_cRegs->intControl = HDA_INTCTL_GIE | HDA_INTCTL_CIE;
 
     m_cRegs->rIntCount = 1;
 
@@ -197,6 +307,11 @@ IntelHDAudioController::IntelHDAudioController(const PCIInfo& info) : PCIDevice(
         }
     }
 
+    if (!m_outputStream.get()) {
+        Log::Warning("[HDAudio] No outputs found");
+        return;
+    }
+
     m_pcmOut.c = this;
     m_pcmOut.output = nullptr;
 
@@ -222,22 +337,33 @@ void IntelHDAudioController::DetectCodec(uint32_t i) {
 
     Log::Info("[HDAudio] Codec %d, VendorID: %x, RevisionID: %x, Sub Nodes: %d", i, vID, rID, subNodes & 0xff);
 
-    for (uint32_t n = codec.firstNode; n < codec.firstNode + codec.subnodes; n++) {
-        uint32_t f = GetCodecParameter(i, n, WidgetParameterFunctionGroupType);
+    // Sub nodes of the root node are function groups,
+    // the widgets are sub nodes of the audio function group
+    for (uint32_t fg = codec.firstNode; fg < codec.firstNode + codec.subnodes; fg++) {
+        uint32_t f = GetCodecParameter(i, fg, WidgetParameterFunctionGroupType);
         uint8_t ftype = f & 0xff;
         if (ftype != WidgetFunctionGroupAudio) {
-            codec.widgets.add_back({n, 0, 0});
             continue;
         }
 
-        uint32_t cap = GetCodecParameter(i, n, WidgetParameterAudioWidgetCapabilities);
-        uint8_t type = HDA_W_AUDIO_TYPE(cap);
-        if (type == HDA_W_AUDIO_OUTPUT) {
-            Log::Info("[HDAudio] Found audio output at %d:%d", i, n);
-            AddCodecOutput(i, n);
+        uint64_t response;
+        // Power up the function group (D0)
+        SendVerb(MakeVerb(CodecSetPowerState << 8, fg, i), &response);
+
+        uint32_t widgetNodes = GetCodecParameter(i, fg, WidgetParameterSubNodeCount);
+        uint32_t firstWidget = (widgetNodes >> 16) & 0xff;
+        for (uint32_t n = firstWidget; n < firstWidget + (widgetNodes & 0xff); n++) {
+            uint32_t cap = GetCodecParameter(i, n, WidgetParameterAudioWidgetCapabilities);
+            uint8_t type = HDA_W_AUDIO_TYPE(cap);
+            if (type == HDA_W_AUDIO_OUTPUT) {
+                Log::Info("[HDAudio] Found audio output at %d:%d", i, n);
+                AddCodecOutput(i, n, fg, cap);
+            } else if (type == HDA_W_AUDIO_PIN_COMPLEX) {
+                EnableOutputPin(i, n, fg, cap);
+            }
+
+            codec.widgets.add_back({n, type, cap});
         }
-
-        codec.widgets.add_back({n, type, cap});
     }
 }
 
@@ -261,7 +387,17 @@ uint32_t IntelHDAudioController::GetCodecParameter(uint32_t codec, uint32_t node
     return value;
 }
 
-void IntelHDAudioController::AddCodecOutput(int codec, int node) {
+uint32_t IntelHDAudioController::GetAmpCapabilities(uint32_t codec, uint32_t node, uint32_t functionGroup,
+                                                     uint32_t parameter) {
+    uint32_t caps = GetCodecParameter(codec, node, parameter);
+    if (!caps || caps == 0xffffffff) {
+        caps = GetCodecParameter(codec, functionGroup, parameter);
+    }
+
+    return caps;
+}
+
+void IntelHDAudioController::AddCodecOutput(int codec, int node, int functionGroup, uint32_t widgetCap) {
     HDAOutput* out = new HDAOutput;
     out->codec = codec;
     out->node = node;
@@ -270,69 +406,151 @@ void IntelHDAudioController::AddCodecOutput(int codec, int node) {
     out->sampleSize = 2;
     out->sampleRate = STREAM_SAMPLE_RATE_BASE_0;
     out->channels = 2;
+    out->volume = 100;
 
     StreamFormat fmt;
     fmt.value = 0;
-    // 24-bit audio samples (011b)
-    fmt.bits = 3;
+    // 16-bit audio samples (001b)
+    fmt.bits = 1;
+    // 2 channels
+    fmt.numOfChannels = out->channels - 1;
 
     // 48000hz
     fmt.div = 0;
     fmt.mult = 0;
     fmt.base = 0;
 
-    out->stream = CreateStream(codec, STREAM_ID_PCMOUT, fmt, StreamType::Output);
+    // Every converter is given the same stream number,
+    // so only one DMA stream is needed for all outputs
+    if (!m_outputStream.get()) {
+        m_outputStream = CreateStream(0, STREAM_ID_PCMOUT, fmt, StreamType::Output);
+    }
+    out->stream = m_outputStream;
 
     uint64_t response;
+    SendVerb(MakeVerb(CodecSetPowerState << 8, node, codec), &response);
+    SendVerb(MakeVerb(CodecSetConverterFormat << 16 | fmt.value, node, codec), &response);
+
     int result =
         SendVerb(MakeVerb(CodecSetConverterStreamChannel << 8 | HDA_CODEC_SET_STREAM_CHAN_PAYLOAD(STREAM_ID_PCMOUT, 0),
                           node, codec),
                  &response);
     assert(!result);
 
+    out->ampSteps = 0;
+    if (widgetCap & HDA_W_AUDIO_AMP_OUT) {
+        out->ampSteps =
+            HDA_AMP_CAP_STEPS(GetAmpCapabilities(codec, node, functionGroup, WidgetParameterAmpOutputCapabilities));
+    }
+    UpdateOutputAmp(out);
+
     m_outputs.add_back(out);
 }
 
-FancyRefPtr<HDAStream> IntelHDAudioController::CreateStream(int codec, int num, StreamFormat fmt, StreamType type) {
+void IntelHDAudioController::EnableOutputPin(int codec, int node, int functionGroup, uint32_t widgetCap) {
+    uint32_t pinCap = GetCodecParameter(codec, node, WidgetParameterPinCapabilities);
+    if (pinCap == 0xffffffff || !(pinCap & HDA_PIN_CAP_OUTPUT)) {
+        return;
+    }
+
+    uint64_t response;
+    SendVerb(MakeVerb(CodecSetPowerState << 8, node, codec), &response);
+
+    uint8_t control = HDA_PIN_CTL_OUT_ENABLE;
+    if (pinCap & HDA_PIN_CAP_HEADPHONE) {
+        control |= HDA_PIN_CTL_HP_ENABLE;
+    }
+    SendVerb(MakeVerb(CodecSetPinWidgetControl << 8 | control, node, codec), &response);
+
+    if (pinCap & HDA_PIN_CAP_EAPD) {
+        SendVerb(MakeVerb(CodecSetEAPD << 8 | HDA_EAPD_ENABLE, node, codec), &response);
+    }
+
+    if (widgetCap & HDA_W_AUDIO_AMP_OUT) {
+        // Volume is controlled at the converter, leave the pin at full gain
+        uint32_t steps =
+            HDA_AMP_CAP_STEPS(GetAmpCapabilities(codec, node, functionGroup, WidgetParameterAmpOutputCapabilities));
+        SendVerb(MakeVerb(CodecSetAmpGainMute << 16 | HDA_AMP_SET_OUTPUT | HDA_AMP_SET_LEFT | HDA_AMP_SET_RIGHT | steps,
+                          node, codec),
+                 &response);
+    }
+}
+
+void IntelHDAudioController::UpdateOutputAmp(HDAOutput* out) {
+    if (!out->ampSteps) {
+        return;
+    }
+
+    uint32_t gain = out->ampSteps * m_masterVolume * out->volume / 10000;
+    uint32_t payload = HDA_AMP_SET_OUTPUT | HDA_AMP_SET_LEFT | HDA_AMP_SET_RIGHT | (gain & HDA_AMP_GAIN_MASK);
+    if (!m_masterVolume || !out->volume) {
+        payload |= HDA_AMP_MUTE;
+    }
+
+    uint64_t response;
+    SendVerb(MakeVerb(CodecSetAmpGainMute << 16 | payload, out->node, out->codec), &response);
+}
+
+FancyRefPtr<HDAStream> IntelHDAudioController::CreateStream(int index, int num, StreamFormat fmt, StreamType type) {
     HDAStream* stream = new HDAStream;
-    if (type == StreamType::Output) {
-        stream->descriptor = codec;
-    } else if (type == StreamType::Input) {
-        stream->descriptor = m_numOutputStreams + codec;
+    // Input stream descriptors come first, followed by output then bidirectional
+    if (type == StreamType::Input) {
+        stream->descriptor = index;
+    } else if (type == StreamType::Output) {
+        stream->descriptor = m_numInputStreams + index;
     } else if (type == StreamType::Bidirectional) {
-        stream->descriptor = m_numOutputStreams + m_numInputStreams + codec;
+        stream->descriptor = m_numInputStreams + m_numOutputStreams + index;
     }
 
     stream->streamNumber = num;
+    stream->format = fmt.value;
 
-    StreamDescriptor* desc = &m_cRegs->streams[stream->descriptor];
-
-    stream->bdlEntries = PAGE_SIZE_4K / sizeof(HDABufferDescriptorEntry);
+    stream->bdlEntries = HDA_OUTPUT_PERIODS;
     KernelAllocateMappedBlock(&stream->bdlPhys, &stream->bdl);
 
-    for (int i = 0; i < stream->bdlEntries; i++) {
+    for (unsigned i = 0; i < stream->bdlEntries; i++) {
+        // Length is set when the stream gets programmed
         stream->bdl[i].length = PAGE_SIZE_4K;
-        stream->bdl[i].ioc = 0;
+        stream->bdl[i].ioc = 1;
 
         void* buffer;
         KernelAllocateMappedBlock(&stream->bdl[i].address, &buffer);
+        memset(buffer, 0, PAGE_SIZE_4K);
 
         stream->buffers.add_back(buffer);
     }
 
-    desc->bufferDescListPtr = stream->bdlPhys;
-    desc->bufferDescListPtrHigh = stream->bdlPhys >> 32;
+    ProgramStream(stream, PAGE_SIZE_4K);
+
+    return stream;
+}
+
+void IntelHDAudioController::ProgramStream(HDAStream* stream, uint32_t periodBytes) {
+    StreamDescriptor* desc = &m_cRegs->streams[stream->descriptor];
+
+    // Enter stream reset, then wait for the stream to acknowledge
+    desc->control |= HDA_STREAM_CTL_RST;
+    int timer = HDA_STREAM_RESET_TIMEOUT;
+    while (!(desc->control & HDA_STREAM_CTL_RST) && timer--)
+        asm volatile("pause");
 
     // Exit stream reset
     desc->control &= ~HDA_STREAM_CTL_RST;
 
-    int timer = 200;
-    while ((desc->control & HDA_STREAM_CTL_RST) && timer--) {
-        Timer::Wait(2);
-    }
+    timer = HDA_STREAM_RESET_TIMEOUT;
+    while ((desc->control & HDA_STREAM_CTL_RST) && timer--)
+        asm volatile("pause");
     // Make sure we didnt time out waiting for stream to exit reset
     assert(timer > 0);
 
+    for (unsigned i = 0; i < stream->bdlEntries; i++) {
+        stream->bdl[i].length = periodBytes;
+        stream->bdl[i].ioc = 1;
+    }
+
+    desc->bufferDescListPtr = stream->bdlPhys;
+    desc->bufferDescListPtrHigh = stream->bdlPhys >> 32;
+
     // Clear run, stripe control, stream number, etc.
     desc->control = desc->control &
                     ~(HDA_STREAM_CTL_RST | HDA_STREAM_CTL_RUN | HDA_STREAM_CTL_STREAM_NUM_MASK |
@@ -340,20 +558,21 @@ FancyRefPtr<HDAStream> IntelHDAudioController::CreateStream(int codec, int num,
     // Enable intrrupts
     desc->control |= HDA_STREAM_CTL_ICOE | HDA_STREAM_CTL_FEIE | HDA_STREAM_CTL_DEIE;
     // Set stream number
-    desc->control |= HDA_STREAM_CTL_STREAM_NUM(num);
+    desc->control |= HDA_STREAM_CTL_STREAM_NUM(stream->streamNumber);
 
     // Clear status bits
     desc->status |= HDA_STREAM_STS_BCIS | HDA_STREAM_STS_FIFO_ERROR | HDA_STREAM_STS_DESC_ERROR;
 
-    desc->cyclicBufferLength = stream->bdlEntries;
-    desc->lastValidIndex = (desc->lastValidIndex & ~0xff) | stream->bdlEntries;
+    // Length of the cyclic buffer is in bytes
+    desc->cyclicBufferLength = periodBytes * stream->bdlEntries;
+    desc->lastValidIndex = (desc->lastValidIndex & ~0xff) | (stream->bdlEntries - 1);
     // Save bit 7 (reserved)
-    desc->format = (desc->format & (1 << 7)) | fmt.value;
-
-    return stream;
+    desc->format = (desc->format & (1 << 7)) | stream->format;
 }
 
 int IntelHDAudioController::SendVerb(uint32_t verb, uint64_t* response) {
+    ScopedSpinLock lockVerbs(m_verbLock);
+
     uint16_t writePointer = (m_cRegs->corbWriteP + 1) % m_corbEntries;
     uint16_t readPointer = m_cRegs->rirbWriteP;
 
@@ -69,6 +69,16 @@
 
 #define HDA_MAX_CODECS 15
 
+// Interrupt control
+#define HDA_INTCTL_GIE (1U << 31) // Global interrupt enable
+#define HDA_INTCTL_CIE (1U << 30) // Controller interrupt enable
+#define HDA_INTCTL_SIE(x) (1U << (x)) // Stream interrupt enable
+
+// Amount of periods in the cyclic buffer of the output stream
+#define HDA_OUTPUT_PERIODS 4
+// Polling iterations to wait for a stream to enter/leave reset
+#define HDA_STREAM_RESET_TIMEOUT 100000
+
 // Payload for set stream, channel command
 #define HDA_CODEC_SET_STREAM_CHAN_PAYLOAD(stream, chan) (((stream & 0xf) << 4) | (chan & 0xf))
 
@@ -79,6 +89,27 @@
 #define HDA_W_AUDIO_FORMAT_OVERRIDE 0x8
 #define HDA_W_AUDIO_STRIPE 0x10
 
+// Pin capabilities
+#define HDA_PIN_CAP_HEADPHONE (1U << 3)
+#define HDA_PIN_CAP_OUTPUT (1U << 4)
+#define HDA_PIN_CAP_EAPD (1U << 16)
+
+// Pin widget control
+#define HDA_PIN_CTL_OUT_ENABLE 0x40
+#define HDA_PIN_CTL_HP_ENABLE 0x80
+
+#define HDA_EAPD_ENABLE 0x2
+
+// Amplifier capabilities
+#define HDA_AMP_CAP_STEPS(x) ((x >> 8) & 0x7f)
+
+// Payload for set amplifier gain/mute command
+#define HDA_AMP_SET_OUTPUT (1U << 15)
+#define HDA_AMP_SET_LEFT (1U << 13)
+#define HDA_AMP_SET_RIGHT (1U << 12)
+#define HDA_AMP_MUTE (1U << 7)
+#define HDA_AMP_GAIN_MASK 0x7f
+
 #define HDA_W_AUDIO_TYPE(x) ((x >> 20) & 0xf)
 #define HDA_W_AUDIO_OUTPUT 0
 #define HDA_W_AUDIO_INPUT 1
@@ -129,6 +160,7 @@ static_assert(!(PAGE_SIZE_4K % sizeof(HDABufferDescriptorEntry)));
 struct HDAStream {
     int descriptor;
     int streamNumber;
+    uint16_t format;
 
     uintptr_t bdlPhys;
     uint32_t bdlEntries;
@@ -147,6 +179,10 @@ struct HDAOutput {
     int channels;
     int sampleRate;
     SoundEncoding sampleFmt;
+
+    // Amount of output amplifier steps, 0 if there is no amplifier
+    int ampSteps;
+    int volume;
 };
 
 class IntelHDAudioController : public AudioController, PCIDevice {
@@ -168,8 +204,12 @@ class IntelHDAudioController : public AudioController, PCIDevice {
         CodecSetPowerState = 0x705,
         CodecGetConverterStreamChannel = 0xf06,
         CodecSetConverterStreamChannel = 0x706,
+        CodecGetPinWidgetControl = 0xf07,
+        CodecSetPinWidgetControl = 0x707,
         CodecGetBeepGeneration = 0xf0a,
         CodecSetBeepGeneration = 0x70a,
+        CodecGetEAPD = 0xf0c,
+        CodecSetEAPD = 0x70c,
         CodecGetVolumeKnob = 0xf0f,
         CodecSetVolumeKnob = 0x70f,
         CodecGetConfigurationDefault = 0xf1c,
@@ -329,16 +369,31 @@ public:
     int OutputSampleRate(void* output) const override;
     int OutputSetNumberOfChannels(int channels) override;
 
-    int WriteSamples(void* output, uint8_t* buffer, size_t size, bool async) override;
+    void OutputStart(void* output) override;
+    int OutputQueuedFrames(void* output) const override;
 
     void OnInterrupt();
 
 private:
     void DetectCodec(uint32_t index);
     uint32_t GetCodecParameter(uint32_t codec, uint32_t node, uint32_t parameter);
+    // Get the amplifier capabilities of a widget,
+    // falls back to the defaults of the function group
+    uint32_t GetAmpCapabilities(uint32_t codec, uint32_t node, uint32_t functionGroup, uint32_t parameter);
+
+    void AddCodecOutput(int codec, int node, int functionGroup, uint32_t widgetCap);
+    // Enable output on a pin complex, unmuting its amplifier
+    void EnableOutputPin(int codec, int node, int functionGroup, uint32_t widgetCap);
+    void UpdateOutputAmp(HDAOutput* out);
+
+	FancyRefPtr<HDAStream> CreateStream(int index, int num, StreamFormat fmt, StreamType type);
+    // Reset the stream and program the buffer descriptor list, format and stream number.
+    // Resetting also puts the link position back to the start of the cyclic buffer.
+    void ProgramStream(HDAStream* stream, uint32_t periodBytes);
 
-    void AddCodecOutput(int codec, int node);
-	FancyRefPtr<HDAStream> CreateStream(int codec, int num, StreamFormat fmt, StreamType type);
+    // Called with m_lock held
+    void StartOutput();
+    void RefillOutput();
 
     // Verb:
     // 31:28 - codec address
@@ -369,6 +424,20 @@ private:
     int m_numOutputStreams;
     int m_numBidStreams;
 
+    lock_t m_verbLock = 0;
+
+    // All converters play the same stream (STREAM_ID_PCMOUT)
+    FancyRefPtr<HDAStream> m_outputStream;
+    int m_masterVolume = 100;
+
+    lock_t m_lock = 0;
+    bool m_running = false;
+    unsigned m_periodFrames = 0;
+    // Next period to refill once the hardware has played it
+    unsigned m_nextPeriod = 0;
+    // Consecutive periods which were silent
+    unsigned m_idlePeriods = 0;
+
     PCMOutput m_pcmOut;
 };
 } // namespace Audio
\ No newline at end of file
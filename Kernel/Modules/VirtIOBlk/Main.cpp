@@ -0,0 +1,431 @@
+#include "VirtIOBlk.h"
+
+#include <Module.h>
+
+#include <CPU.h>
+#include <Errno.h>
+#include <IDT.h>
+#include <Logging.h>
+#include <Math.h>
+#include <PhysicalAllocator.h>
+#include <SMP.h>
+#include <Scheduler.h>
+#include <Storage/GPT.h>
+#include <Vector.h>
+
+static Vector<VirtIOBlk*>* disks = nullptr;
+static int ModuleInit() {
+    disks = new Vector<VirtIOBlk*>();
+
+    PCI::EnumeratePCIDevices(VIRTIO_BLK_DEVICE_ID, VIRTIO_VENDOR_ID, [](const PCIInfo& dev) -> void {
+        VirtIOBlk* disk = new VirtIOBlk(dev);
+
+        if (disk->status == VirtIOBlk::Status::Active) {
+            disks->add_back(disk);
+        } else {
+            delete disk;
+        }
+    });
+
+    if (disks->get_length() == 0) {
+        return 1; // We haven't found or successfully initialized any disks so let the kernel unload us
+    }
+
+    return 0;
+}
+
+static int ModuleExit() {
+    for (const auto& disk : *disks) {
+        delete disk;
+    }
+
+    delete disks;
+
+    return 0;
+}
+
+DECLARE_MODULE("virtioblk", "VirtIO Block Device Driver", ModuleInit, ModuleExit);
+
+void VirtIOBlk::InterruptHandler(VirtIOBlk* disk, RegisterContext* r) { disk->OnInterrupt(); }
+
+void VirtIOBlk::QueueInterruptHandler(VirtQueue* queue, RegisterContext* r) {
+    queue->device->ProcessCompletions(*queue);
+}
+
+void VirtIOBlk::OnInterrupt() {
+    uint8_t isr = inportb(ioBase + VIRTIO_REGISTER_ISR_STATUS); // Reading clears it
+
+    if (isr & VIRTIO_ISR_QUEUE) {
+        for (unsigned i = 0; i < queueCount; i++) {
+            ProcessCompletions(queues[i]);
+        }
+    }
+}
+
+void* VirtIOBlk::AllocateDMA(size_t size, uintptr_t& phys) {
+    size = (size + PAGE_SIZE_4K - 1) & ~static_cast<size_t>(PAGE_SIZE_4K - 1);
+    if (dmaUsed + size > VIRTIO_BLK_DMA_SIZE) {
+        return nullptr;
+    }
+
+    phys = dmaPhys + dmaUsed;
+    void* virt = dmaVirt + dmaUsed;
+    dmaUsed += size;
+
+    memset(virt, 0, size);
+    return virt;
+}
+
+int VirtIOBlk::InitializeQueue(VirtQueue& queue, uint16_t index, uint16_t vector) {
+    outportw(ioBase + VIRTIO_REGISTER_QUEUE_SELECT, index);
+
+    uint16_t size = inportw(ioBase + VIRTIO_REGISTER_QUEUE_SIZE); // Fixed by the device with the legacy interface
+    if (size < VIRTIO_BLK_SLOTS) {
+        return -ENODEV; // Every slot needs its own descriptor
+    }
+
+    // The legacy interface wants the whole queue in one block
+    size_t usedOffset;
+    uintptr_t ringPhys;
+    uint8_t* ring = reinterpret_cast<uint8_t*>(AllocateDMA(VirtqSize(size, usedOffset), ringPhys));
+    if (!ring) {
+        return -ENOMEM;
+    }
+
+    queue.device = this;
+    queue.index = index;
+    queue.size = size;
+    queue.descriptors = reinterpret_cast<VirtqDescriptor*>(ring);
+    queue.available = reinterpret_cast<VirtqAvailable*>(ring + sizeof(VirtqDescriptor) * size);
+    queue.used = reinterpret_cast<VirtqUsed*>(ring + usedOffset);
+    queue.lastUsed = 0;
+
+    // Each request is a single descriptor pointing to the table of its slot
+    for (unsigned i = 0; i < VIRTIO_BLK_SLOTS; i++) {
+        queue.descriptors[i].address = slots[i].dmaPhys + offsetof(SlotDMA, table);
+        queue.descriptors[i].flags = VIRTQ_DESC_F_INDIRECT;
+    }
+
+    outportl(ioBase + VIRTIO_REGISTER_QUEUE_ADDRESS, ringPhys >> PAGE_SHIFT_4K);
+
+    if (useMSIX) {
+        outportw(ioBase + VIRTIO_REGISTER_QUEUE_VECTOR, vector);
+        if (inportw(ioBase + VIRTIO_REGISTER_QUEUE_VECTOR) != vector) {
+            Log::Error("[VirtIOBlk] Device refused MSI-X vector %hu for queue %hu", vector, index);
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+VirtIOBlk::VirtIOBlk(const PCIInfo& device) : DiskDevice(), PCIDevice(device.bus, device.slot, device.func) {
+    assert(device.vendorID != 0xFFFF);
+
+    SetDeviceName("VirtIO Block Device");
+
+    if (!BarIsIOPort(0)) {
+        Log::Error("[VirtIOBlk] BAR0 is not an I/O port, the legacy interface is disabled");
+        return;
+    }
+
+    ioBase = GetBaseAddressRegister(0);
+    configBase = ioBase + VIRTIO_REGISTER_DEVICE_CONFIG;
+
+    EnableIOSpace();
+    EnableBusMastering();
+
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, 0); // Reset the device
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    uint32_t deviceFeatures = inportl(ioBase + VIRTIO_REGISTER_DEVICE_FEATURES);
+    if (!(deviceFeatures & VIRTIO_RING_F_INDIRECT_DESC)) {
+        Log::Error("[VirtIOBlk] Device does not support indirect descriptors");
+        outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return;
+    }
+
+    features = deviceFeatures & (VIRTIO_RING_F_INDIRECT_DESC | VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO |
+                                 VIRTIO_BLK_F_BLK_SIZE | VIRTIO_BLK_F_MQ);
+    outportl(ioBase + VIRTIO_REGISTER_GUEST_FEATURES, features);
+
+    dmaPhys = Memory::AllocateLargePhysicalMemoryBlock();
+    if (!dmaPhys) {
+        Log::Error("[VirtIOBlk] Failed to allocate memory for queues");
+        outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return;
+    }
+    dmaVirt = reinterpret_cast<uint8_t*>(Memory::GetDirectMapping(dmaPhys));
+
+    for (unsigned i = 0; i < VIRTIO_BLK_SLOTS; i++) {
+        slots[i].buffer = reinterpret_cast<uint8_t*>(AllocateDMA(VIRTIO_BLK_SLOT_SIZE, slots[i].bufferPhys));
+        slots[i].dma = reinterpret_cast<SlotDMA*>(AllocateDMA(sizeof(SlotDMA), slots[i].dmaPhys));
+        assert(slots[i].buffer && slots[i].dma);
+
+        slotLocks[i] = 0;
+    }
+
+    // MSI-X entry i is for queue i, config changes are of no interest to us
+    if (MSIXCapable()) {
+        queues[0].vector = AllocateMSIXVector(0, SMP::cpus[0]->id);
+        if (queues[0].vector != 0xFF) {
+            useMSIX = true;
+            configBase = ioBase + VIRTIO_REGISTER_DEVICE_CONFIG_MSIX;
+
+            outportw(ioBase + VIRTIO_REGISTER_CONFIG_VECTOR, VIRTIO_MSI_NO_VECTOR);
+        }
+    }
+
+    capacity = ReadConfig64(VIRTIO_BLK_CONFIG_CAPACITY);
+
+    if (features & VIRTIO_BLK_F_BLK_SIZE) {
+        uint32_t deviceBlockSize = ReadConfig32(VIRTIO_BLK_CONFIG_BLK_SIZE);
+        if (deviceBlockSize >= VIRTIO_BLK_SECTOR_SIZE && deviceBlockSize <= PAGE_SIZE_4K &&
+            !(deviceBlockSize & (deviceBlockSize - 1))) {
+            blocksize = deviceBlockSize;
+        }
+    }
+
+    if (features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t segMax = ReadConfig32(VIRTIO_BLK_CONFIG_SEG_MAX);
+        if (segMax && segMax * PAGE_SIZE_4K < maxTransfer) {
+            maxTransfer = segMax * PAGE_SIZE_4K;
+        }
+    }
+
+    uint16_t maxQueues = 1;
+    if (features & VIRTIO_BLK_F_MQ) {
+        maxQueues = ReadConfig16(VIRTIO_BLK_CONFIG_NUM_QUEUES);
+    }
+
+    queueCount = MIN(maxQueues, VIRTIO_BLK_MAX_QUEUES);
+    queueCount = MIN(queueCount, SMP::processorCount);
+    if (useMSIX) {
+        queueCount = MIN(queueCount, MSIXVectorCount());
+    } else {
+        uint8_t irq = AllocateVector(PCIVectors::PCIVectorLegacy);
+        if (irq == 0xFF) {
+            Log::Error("[VirtIOBlk] Failed to allocate interrupt");
+            outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+            return;
+        }
+
+        IDT::RegisterInterruptHandler(irq, reinterpret_cast<isr_t>(&VirtIOBlk::InterruptHandler), this);
+    }
+
+    for (unsigned i = 0; i < queueCount; i++) {
+        uint16_t vector = VIRTIO_MSI_NO_VECTOR;
+        if (useMSIX) {
+            // Complete requests on the processor which submitted them
+            if (i > 0) {
+                queues[i].vector = AllocateMSIXVector(i, SMP::cpus[i]->id);
+            }
+
+            if (queues[i].vector != 0xFF) {
+                IDT::RegisterInterruptHandler(queues[i].vector,
+                                              reinterpret_cast<isr_t>(&VirtIOBlk::QueueInterruptHandler), &queues[i]);
+                vector = i;
+            }
+        }
+
+        if ((useMSIX && vector == VIRTIO_MSI_NO_VECTOR) || InitializeQueue(queues[i], i, vector)) {
+            if (i == 0) {
+                Log::Error("[VirtIOBlk] Failed to initialize queues");
+                outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+                return;
+            }
+
+            Log::Warning("[VirtIOBlk] Only using %u of %u queues", i, queueCount);
+            queueCount = i;
+            break;
+        }
+    }
+
+    // Let the block queue call us from as many threads as we have queues
+    hardwareQueues = queueCount;
+
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS,
+             VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+    status = Status::Active;
+
+    Log::Info("[VirtIOBlk] Capacity: %u MB, Block size: %d, Features: %x, Queues: %u, MSI-X: %Y",
+              capacity * VIRTIO_BLK_SECTOR_SIZE / 1024 / 1024, blocksize, features, queueCount, useMSIX);
+
+    switch (GPT::Parse(this)) {
+    case 0:
+        Log::Error("[VirtIOBlk] Disk has a corrupted or non-existant GPT. MBR disks are NOT supported.");
+        break;
+    case -1:
+        Log::Error("[VirtIOBlk] Disk Error while Parsing GPT");
+        break;
+    }
+    Log::Info("[VirtIOBlk] Found %d partitions!", partitions.get_length());
+
+    InitializePartitions();
+}
+
+VirtIOBlk::~VirtIOBlk() {
+    if (ioBase) {
+        outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, 0); // Reset the device so it lets go of our buffers
+    }
+
+    if (dmaPhys) {
+        for (uintptr_t page = 0; page < VIRTIO_BLK_DMA_SIZE; page += PAGE_SIZE_4K) {
+            Memory::FreePhysicalMemoryBlock(dmaPhys + page);
+        }
+    }
+}
+
+int VirtIOBlk::AcquireSlot() {
+    if (slotAvailability.Wait()) {
+        return -EINTR;
+    }
+
+    for (unsigned i = 0; i < VIRTIO_BLK_SLOTS; i++) {
+        if (!acquireTestLock(&slotLocks[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void VirtIOBlk::ReleaseSlot(int slot) {
+    assert(slot >= 0 && slot < VIRTIO_BLK_SLOTS);
+    releaseLock(&slotLocks[slot]);
+
+    slotAvailability.Signal();
+}
+
+void VirtIOBlk::Notify(VirtQueue& queue) {
+    // Make sure the device sees the new available index before we check whether it wants a notification
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (!(queue.used->flags & VIRTQ_USED_F_NO_NOTIFY)) {
+        outportw(ioBase + VIRTIO_REGISTER_QUEUE_NOTIFY, queue.index);
+    }
+}
+
+void VirtIOBlk::ProcessCompletions(VirtQueue& queue) {
+    ScopedSpinLock lockQueue(queue.lock);
+
+    while (queue.lastUsed != queue.used->index) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        uint32_t slot = queue.used->ring[queue.lastUsed % queue.size].id;
+        queue.lastUsed++;
+
+        if (slot >= VIRTIO_BLK_SLOTS) {
+            Log::Warning("[VirtIOBlk] Completion for unknown descriptor %u", slot);
+            continue;
+        }
+
+        __atomic_store_n(&slots[slot].done, true, __ATOMIC_RELEASE);
+        slots[slot].completion.Signal();
+    }
+}
+
+int VirtIOBlk::Execute(int slotIndex, uint32_t type, uint64_t sector, uint32_t length) {
+    Slot& slot = slots[slotIndex];
+    SlotDMA* dma = slot.dma;
+
+    dma->header.type = type;
+    dma->header.reserved = 0;
+    dma->header.sector = sector;
+    dma->status = 0xFF;
+
+    uint16_t dataFlags = VIRTQ_DESC_F_NEXT | ((type == VIRTIO_BLK_T_IN) ? VIRTQ_DESC_F_WRITE : 0);
+
+    unsigned count = 0;
+    dma->table[count++] = {slot.dmaPhys + offsetof(SlotDMA, header), sizeof(RequestHeader), VIRTQ_DESC_F_NEXT, 1};
+
+    // A descriptor for each page, the device may limit the size of a segment
+    for (uint32_t offset = 0; offset < length; offset += PAGE_SIZE_4K) {
+        uint32_t segment = MIN(length - offset, static_cast<uint32_t>(PAGE_SIZE_4K));
+        dma->table[count] = {slot.bufferPhys + offset, segment, dataFlags, static_cast<uint16_t>(count + 1)};
+        count++;
+    }
+
+    dma->table[count++] = {slot.dmaPhys + offsetof(SlotDMA, status), sizeof(uint8_t), VIRTQ_DESC_F_WRITE, 0};
+
+    slot.done = false;
+    // An interrupted wait on the last request of the slot can leave its completion signal behind
+    slot.completion.SetValue(0);
+
+    // Each processor submits on its own queue so they do not fight over the lock
+    VirtQueue& queue = queues[GetCPULocal()->id % queueCount];
+    {
+        ScopedSpinLock<true> lockQueue(queue.lock);
+
+        queue.descriptors[slotIndex].length = count * sizeof(VirtqDescriptor);
+
+        queue.available->ring[queue.available->index % queue.size] = slotIndex;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        queue.available->index = queue.available->index + 1;
+
+        Notify(queue);
+    }
+
+    // Only done says this request has finished, a wakeup may come from a stale signal
+    while (!__atomic_load_n(&slot.done, __ATOMIC_ACQUIRE)) {
+        if (slot.completion.Wait()) {
+            // Interrupted, the device still owns the buffer so we have to wait regardless
+            Scheduler::Yield();
+        }
+    }
+
+    return (dma->status == VIRTIO_BLK_S_OK) ? 0 : -EIO;
+}
+
+int VirtIOBlk::Transfer(bool write, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    uint64_t sector = lba * (blocksize / VIRTIO_BLK_SECTOR_SIZE);
+    if (sector + (count + VIRTIO_BLK_SECTOR_SIZE - 1) / VIRTIO_BLK_SECTOR_SIZE > capacity) {
+        return -EINVAL;
+    }
+
+    if (write && (features & VIRTIO_BLK_F_RO)) {
+        return -EROFS;
+    }
+
+    int slotIndex = AcquireSlot();
+    if (slotIndex == -EINTR) {
+        return -EINTR;
+    }
+    assert(slotIndex >= 0);
+    Slot& slot = slots[slotIndex];
+
+    int e = 0;
+    while (count && !e) {
+        uint32_t chunk = MIN(count, maxTransfer);
+        // The device works in whole blocks
+        uint32_t length = (chunk + blocksize - 1) & ~static_cast<uint32_t>(blocksize - 1);
+
+        if (write) {
+            memcpy(slot.buffer, buffer, chunk);
+            memset(slot.buffer + chunk, 0, length - chunk);
+        }
+
+        e = Execute(slotIndex, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, sector, length);
+
+        if (!write && !e) {
+            memcpy(buffer, slot.buffer, chunk);
+        }
+
+        sector += length / VIRTIO_BLK_SECTOR_SIZE;
+        buffer += chunk;
+        count -= chunk;
+    }
+
+    ReleaseSlot(slotIndex);
+    return e;
+}
+
+int VirtIOBlk::ReadDiskBlock(uint64_t lba, uint32_t count, void* buffer) {
+    return Transfer(false, lba, count, reinterpret_cast<uint8_t*>(buffer));
+}
+
+int VirtIOBlk::WriteDiskBlock(uint64_t lba, uint32_t count, void* buffer) {
+    return Transfer(true, lba, count, reinterpret_cast<uint8_t*>(buffer));
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <Device.h>
+#include <IOPorts.h>
+#include <Lock.h>
+#include <PCI.h>
+#include <Paging.h>
+#include <Storage/BlockQueue.h>
+#include <VirtIO.h>
+
+#define VIRTIO_BLK_DEVICE_ID 0x1001 // Transitional device, which still has the legacy I/O interface
+
+#define VIRTIO_BLK_F_SEG_MAX (1U << 2) // Limit on data descriptors in a request
+#define VIRTIO_BLK_F_RO (1U << 5)
+#define VIRTIO_BLK_F_BLK_SIZE (1U << 6)
+#define VIRTIO_BLK_F_MQ (1U << 12) // Multiple request queues
+
+// Device config offsets
+#define VIRTIO_BLK_CONFIG_CAPACITY 0x0 // In 512 byte sectors
+#define VIRTIO_BLK_CONFIG_SEG_MAX 0xC
+#define VIRTIO_BLK_CONFIG_BLK_SIZE 0x14
+#define VIRTIO_BLK_CONFIG_NUM_QUEUES 0x22
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+
+#define VIRTIO_BLK_S_OK 0
+
+// Addresses and capacity are always in 512 byte sectors whatever the block size
+#define VIRTIO_BLK_SECTOR_SIZE 512
+
+// One request queue per CPU, up to this many
+#define VIRTIO_BLK_MAX_QUEUES 8
+// Requests in flight across all queues, each has its own DMA buffer
+#define VIRTIO_BLK_SLOTS 8
+// The block queue does not merge past this so it is the most we usually get
+#define VIRTIO_BLK_SLOT_SIZE BLOCK_QUEUE_MAX_MERGE_SIZE
+// Request header, a descriptor for each page of data, then the status
+#define VIRTIO_BLK_MAX_DESCRIPTORS (VIRTIO_BLK_SLOT_SIZE / PAGE_SIZE_4K + 2)
+// Physically contiguous memory for rings, request buffers and descriptor tables
+#define VIRTIO_BLK_DMA_SIZE PAGE_SIZE_2M
+
+class VirtIOBlk final : public DiskDevice, private PCIDevice {
+public:
+    enum class Status {
+        Error,
+        Active,
+    };
+
+    VirtIOBlk(const PCIInfo& device);
+    ~VirtIOBlk();
+
+    int ReadDiskBlock(uint64_t lba, uint32_t count, void* buffer) override;
+    int WriteDiskBlock(uint64_t lba, uint32_t count, void* buffer) override;
+
+    Status status = Status::Error;
+
+private:
+    struct RequestHeader {
+        uint32_t type;
+        uint32_t reserved;
+        uint64_t sector;
+    } __attribute__((packed));
+
+    // Lives in DMA memory, the ring descriptor of a request points to the table
+    struct SlotDMA {
+        VirtqDescriptor table[VIRTIO_BLK_MAX_DESCRIPTORS];
+        RequestHeader header;
+        uint8_t status;
+    } __attribute__((packed));
+
+    /////////////////////////////
+    /// \brief Buffer and descriptor table for one request
+    ///
+    /// Every queue uses the descriptor with the index of the slot
+    /// so completions can be matched to slots without a lookup.
+    /////////////////////////////
+    struct Slot {
+        SlotDMA* dma;
+        uintptr_t dmaPhys;
+
+        uint8_t* buffer;
+        uintptr_t bufferPhys;
+
+        Semaphore completion = Semaphore(0);
+        bool done = false;
+    };
+
+    struct VirtQueue {
+        VirtIOBlk* device;
+        uint16_t index; // Index of the queue on the device
+        uint16_t size = 0; // Amount of descriptors, 0 if not set up
+
+        volatile VirtqDescriptor* descriptors;
+        volatile VirtqAvailable* available;
+        volatile VirtqUsed* used;
+        uint16_t lastUsed = 0; // Used ring entries we have processed
+
+        uint8_t vector = 0xFF; // MSI-X interrupt, 0xFF if none
+
+        lock_t lock = 0;
+    };
+
+    uint16_t ioBase = 0;
+    uint16_t configBase; // Moves up when MSI-X is enabled
+
+    uint32_t features;
+    bool useMSIX = false;
+
+    uint64_t capacity; // In sectors
+    uint32_t maxTransfer = VIRTIO_BLK_SLOT_SIZE; // Largest request we give the device
+
+    unsigned queueCount = 1;
+    VirtQueue queues[VIRTIO_BLK_MAX_QUEUES];
+
+    Slot slots[VIRTIO_BLK_SLOTS];
+    lock_t slotLocks[VIRTIO_BLK_SLOTS];
+    Semaphore slotAvailability = Semaphore(VIRTIO_BLK_SLOTS);
+
+    uintptr_t dmaPhys = 0;
+    uint8_t* dmaVirt = nullptr;
+    size_t dmaUsed = 0;
+
+    void* AllocateDMA(size_t size, uintptr_t& phys);
+
+    int InitializeQueue(VirtQueue& queue, uint16_t index, uint16_t vector);
+
+    int AcquireSlot();
+    void ReleaseSlot(int slot);
+
+    int Transfer(bool write, uint64_t lba, uint32_t count, uint8_t* buffer);
+    // Send a request using the buffer of a slot and wait for it
+    int Execute(int slot, uint32_t type, uint64_t sector, uint32_t length);
+
+    void Notify(VirtQueue& queue);
+    void ProcessCompletions(VirtQueue& queue);
+
+    void OnInterrupt();
+    static void InterruptHandler(VirtIOBlk* disk, RegisterContext* r);
+    static void QueueInterruptHandler(VirtQueue* queue, RegisterContext* r);
+
+    inline uint16_t ReadConfig16(uint16_t offset) { return inportw(configBase + offset); }
+    inline uint32_t ReadConfig32(uint16_t offset) { return inportl(configBase + offset); }
+    inline uint64_t ReadConfig64(uint16_t offset) {
+        return ReadConfig32(offset) | (static_cast<uint64_t>(ReadConfig32(offset + 4)) << 32);
+    }
+};
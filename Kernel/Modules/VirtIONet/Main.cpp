@@ -0,0 +1,648 @@
+#include "VirtIONet.h"
+
+#include <Module.h>
+
+#include <CPU.h>
+#include <Errno.h>
+#include <IDT.h>
+#include <Logging.h>
+#include <Net/Net.h>
+#include <PhysicalAllocator.h>
+#include <SMP.h>
+#include <Timer.h>
+#include <Vector.h>
+
+#define VIRTIO_NET_CONTROL_TIMEOUT 1000000 // 1s
+
+static Vector<VirtIONet*>* adapters = nullptr;
+static int ModuleInit() {
+    adapters = new Vector<VirtIONet*>();
+
+    PCI::EnumeratePCIDevices(VIRTIO_NET_DEVICE_ID, VIRTIO_VENDOR_ID, [](const PCIInfo& dev) -> void {
+        VirtIONet* card = new VirtIONet(dev);
+
+        if (card->dState == VirtIONet::DriverState::OK) {
+            Network::NetFS::GetInstance()->RegisterAdapter(card);
+            adapters->add_back(card);
+        } else {
+            delete card;
+        }
+    });
+
+    if (adapters->get_length() == 0) {
+        return 1; // We haven't found or successfully initialized any cards so let the kernel unload us
+    }
+
+    return 0;
+}
+
+static int ModuleExit() {
+    for (const auto& card : *adapters) {
+        Network::NetFS::GetInstance()->RemoveAdapter(card);
+        delete card;
+    }
+
+    delete adapters;
+
+    return 0;
+}
+
+DECLARE_MODULE("virtionet", "VirtIO Network Adapter Driver", ModuleInit, ModuleExit);
+
+void VirtIONet::InterruptHandler(VirtIONet* card, RegisterContext* r) { card->OnInterrupt(); }
+
+void VirtIONet::QueueInterruptHandler(VirtQueue* queue, RegisterContext* r) {
+    // Mask the queue until the network thread has emptied it
+    queue->available->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    queue->device->ScheduleReceive();
+}
+
+void VirtIONet::ConfigInterruptHandler(VirtIONet* card, RegisterContext* r) { card->UpdateLink(); }
+
+void VirtIONet::OnInterrupt() {
+    uint8_t isr = inportb(ioBase + VIRTIO_REGISTER_ISR_STATUS); // Reading clears it
+
+    if (isr & VIRTIO_ISR_CONFIG) {
+        UpdateLink();
+    }
+
+    if (isr & VIRTIO_ISR_QUEUE) {
+        for (unsigned i = 0; i < queuePairs; i++) {
+            rxQueues[i].available->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+        }
+
+        ScheduleReceive();
+    }
+}
+
+void VirtIONet::UpdateLink() {
+    if (features & VIRTIO_NET_F_STATUS) {
+        linkState = (ReadConfig16(VIRTIO_NET_CONFIG_STATUS) & VIRTIO_NET_S_LINK_UP) ? LinkUp : LinkDown;
+    } else {
+        linkState = LinkUp;
+    }
+
+    Log::Info("[VirtIONet] Link %s", (linkState == LinkUp) ? "Up" : "Down");
+}
+
+void* VirtIONet::AllocateDMA(size_t size, uintptr_t& phys) {
+    size = (size + PAGE_SIZE_4K - 1) & ~static_cast<size_t>(PAGE_SIZE_4K - 1);
+    if (dmaUsed + size > VIRTIO_NET_DMA_SIZE) {
+        return nullptr;
+    }
+
+    phys = dmaPhys + dmaUsed;
+    void* virt = dmaVirt + dmaUsed;
+    dmaUsed += size;
+
+    memset(virt, 0, size);
+    return virt;
+}
+
+int VirtIONet::InitializeQueue(VirtQueue& queue, uint16_t index, uint16_t vector) {
+    outportw(ioBase + VIRTIO_REGISTER_QUEUE_SELECT, index);
+
+    uint16_t size = inportw(ioBase + VIRTIO_REGISTER_QUEUE_SIZE); // Fixed by the device with the legacy interface
+    if (!size) {
+        return -ENODEV;
+    }
+
+    // The legacy interface wants the whole queue in one block
+    size_t usedOffset;
+    uintptr_t ringPhys;
+    uint8_t* ring = reinterpret_cast<uint8_t*>(AllocateDMA(VirtqSize(size, usedOffset), ringPhys));
+    if (!ring) {
+        return -ENOMEM;
+    }
+
+    queue.headers = reinterpret_cast<NetHeader*>(AllocateDMA(sizeof(NetHeader) * size, queue.headersPhys));
+    if (!queue.headers) {
+        return -ENOMEM;
+    }
+
+    queue.device = this;
+    queue.index = index;
+    queue.size = size;
+    queue.descriptors = reinterpret_cast<VirtqDescriptor*>(ring);
+    queue.available = reinterpret_cast<VirtqAvailable*>(ring + sizeof(VirtqDescriptor) * size);
+    queue.used = reinterpret_cast<VirtqUsed*>(ring + usedOffset);
+    queue.lastUsed = 0;
+
+    queue.packets = new NetworkPacket*[size];
+    for (unsigned i = 0; i < size; i++) {
+        queue.packets[i] = nullptr;
+        queue.descriptors[i].next = i + 1;
+    }
+    queue.freeHead = 0;
+    queue.freeCount = size;
+
+    outportl(ioBase + VIRTIO_REGISTER_QUEUE_ADDRESS, ringPhys >> PAGE_SHIFT_4K);
+
+    if (useMSIX) {
+        outportw(ioBase + VIRTIO_REGISTER_QUEUE_VECTOR, vector);
+        if (inportw(ioBase + VIRTIO_REGISTER_QUEUE_VECTOR) != vector) {
+            Log::Error("[VirtIONet] Device refused MSI-X vector %hu for queue %hu", vector, index);
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+void VirtIONet::InitializeRx(VirtQueue& queue) {
+    // Each slot is a header descriptor followed by a packet buffer
+    for (unsigned i = 0; i + 1 < queue.size; i += 2) {
+        NetworkPacket* packet = Network::AllocatePacket();
+        assert(packet);
+        queue.packets[i + 1] = packet;
+
+        queue.descriptors[i].address = queue.headersPhys + i * sizeof(NetHeader);
+        queue.descriptors[i].length = sizeof(NetHeader);
+        queue.descriptors[i].flags = VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_NEXT;
+        queue.descriptors[i].next = i + 1;
+
+        queue.descriptors[i + 1].address = packet->physicalAddress;
+        queue.descriptors[i + 1].length = NETWORK_PACKET_BUFFER_SIZE;
+        queue.descriptors[i + 1].flags = VIRTQ_DESC_F_WRITE;
+
+        queue.available->ring[i / 2] = i;
+    }
+
+    queue.freeCount = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    queue.available->index = queue.size / 2;
+}
+
+void VirtIONet::InitializeTx(VirtQueue& queue) {
+    // We clean up sent packets whenever we send, so no need for interrupts
+    queue.available->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+int VirtIONet::SetQueuePairs(unsigned pairs) {
+    if (!controlQueue.size) {
+        return -ENODEV;
+    }
+
+    controlCommand->commandClass = VIRTIO_NET_CTRL_MQ;
+    controlCommand->command = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET;
+    controlCommand->data = pairs;
+    controlCommand->ack = 0xFF;
+
+    // Class and command, then the amount of pairs, then the ack written by the device
+    controlQueue.descriptors[0].address = controlCommandPhys;
+    controlQueue.descriptors[0].length = sizeof(uint8_t) * 2;
+    controlQueue.descriptors[0].flags = VIRTQ_DESC_F_NEXT;
+    controlQueue.descriptors[0].next = 1;
+
+    controlQueue.descriptors[1].address = controlCommandPhys + offsetof(ControlCommand, data);
+    controlQueue.descriptors[1].length = sizeof(uint16_t);
+    controlQueue.descriptors[1].flags = VIRTQ_DESC_F_NEXT;
+    controlQueue.descriptors[1].next = 2;
+
+    controlQueue.descriptors[2].address = controlCommandPhys + offsetof(ControlCommand, ack);
+    controlQueue.descriptors[2].length = sizeof(uint8_t);
+    controlQueue.descriptors[2].flags = VIRTQ_DESC_F_WRITE;
+
+    controlQueue.available->ring[controlQueue.available->index % controlQueue.size] = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    controlQueue.available->index = controlQueue.available->index + 1;
+    Notify(controlQueue);
+
+    timeval t1 = Timer::GetSystemUptimeStruct();
+    while (controlQueue.used->index == controlQueue.lastUsed) {
+        if (Timer::TimeDifference(Timer::GetSystemUptimeStruct(), t1) > VIRTIO_NET_CONTROL_TIMEOUT) {
+            return -ETIMEDOUT;
+        }
+    }
+    controlQueue.lastUsed++;
+
+    return (controlCommand->ack == VIRTIO_NET_OK) ? 0 : -EIO;
+}
+
+VirtIONet::VirtIONet(const PCIInfo& device)
+    : NetworkAdapter(NetworkAdapterEthernet), PCIDevice(device.bus, device.slot, device.func) {
+    assert(device.vendorID != 0xFFFF);
+
+    if (!BarIsIOPort(0)) {
+        Log::Error("[VirtIONet] BAR0 is not an I/O port, the legacy interface is disabled");
+        dState = DriverState::Error;
+        return;
+    }
+
+    ioBase = GetBaseAddressRegister(0);
+    configBase = ioBase + VIRTIO_REGISTER_DEVICE_CONFIG;
+
+    EnableIOSpace();
+    EnableBusMastering();
+
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, 0); // Reset the device
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    uint32_t deviceFeatures = inportl(ioBase + VIRTIO_REGISTER_DEVICE_FEATURES);
+    features = deviceFeatures & (VIRTIO_NET_F_MAC | VIRTIO_NET_F_STATUS | VIRTIO_NET_F_CSUM | VIRTIO_NET_F_HOST_TSO4 |
+                                 VIRTIO_NET_F_CTRL_VQ | VIRTIO_NET_F_MQ);
+    if (!(features & VIRTIO_NET_F_CSUM)) {
+        features &= ~VIRTIO_NET_F_HOST_TSO4; // Segmentation offload depends on checksum offload
+    }
+
+    if (!(features & VIRTIO_NET_F_CTRL_VQ)) {
+        features &= ~VIRTIO_NET_F_MQ; // Queue pairs are set through the control queue
+    }
+    outportl(ioBase + VIRTIO_REGISTER_GUEST_FEATURES, features);
+
+    dmaPhys = Memory::AllocateLargePhysicalMemoryBlock();
+    if (!dmaPhys) {
+        Log::Error("[VirtIONet] Failed to allocate memory for queues");
+        outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        dState = DriverState::Error;
+        return;
+    }
+    dmaVirt = reinterpret_cast<uint8_t*>(Memory::GetDirectMapping(dmaPhys));
+
+    // MSI-X entry 0 is for config changes, then one entry for each receive queue
+    if (MSIXCapable() && MSIXVectorCount() >= 2) {
+        uint8_t vector = AllocateMSIXVector(0, SMP::cpus[0]->id);
+        if (vector != 0xFF) {
+            useMSIX = true;
+            configBase = ioBase + VIRTIO_REGISTER_DEVICE_CONFIG_MSIX;
+
+            IDT::RegisterInterruptHandler(vector, reinterpret_cast<isr_t>(&VirtIONet::ConfigInterruptHandler), this);
+            outportw(ioBase + VIRTIO_REGISTER_CONFIG_VECTOR, 0);
+        }
+    }
+
+    uint16_t maxQueuePairs = 1;
+    if (features & VIRTIO_NET_F_MQ) {
+        maxQueuePairs = ReadConfig16(VIRTIO_NET_CONFIG_MAX_QUEUE_PAIRS);
+    }
+
+    queuePairs = maxQueuePairs;
+    if (queuePairs > VIRTIO_NET_MAX_QUEUE_PAIRS) {
+        queuePairs = VIRTIO_NET_MAX_QUEUE_PAIRS;
+    }
+
+    if (queuePairs > SMP::processorCount) {
+        queuePairs = SMP::processorCount;
+    }
+
+    if (useMSIX && queuePairs > MSIXVectorCount() - 1) {
+        queuePairs = MSIXVectorCount() - 1;
+    }
+
+    if (!useMSIX) {
+        uint8_t irq = AllocateVector(PCIVectors::PCIVectorLegacy);
+        if (irq == 0xFF) {
+            Log::Error("[VirtIONet] Failed to allocate interrupt");
+            outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+            dState = DriverState::Error;
+            return;
+        }
+
+        IDT::RegisterInterruptHandler(irq, reinterpret_cast<isr_t>(&VirtIONet::InterruptHandler), this);
+    }
+
+    for (unsigned i = 0; i < queuePairs; i++) {
+        uint16_t rxVector = VIRTIO_MSI_NO_VECTOR;
+        if (useMSIX) {
+            // Spread receive interrupts over the processors
+            rxQueues[i].vector = AllocateMSIXVector(1 + i, SMP::cpus[i % SMP::processorCount]->id);
+            if (rxQueues[i].vector != 0xFF) {
+                IDT::RegisterInterruptHandler(rxQueues[i].vector,
+                                              reinterpret_cast<isr_t>(&VirtIONet::QueueInterruptHandler), &rxQueues[i]);
+                rxVector = 1 + i;
+            }
+        }
+
+        if ((useMSIX && rxVector == VIRTIO_MSI_NO_VECTOR) || InitializeQueue(rxQueues[i], i * 2, rxVector) ||
+            InitializeQueue(txQueues[i], i * 2 + 1, VIRTIO_MSI_NO_VECTOR)) {
+            if (i == 0) {
+                Log::Error("[VirtIONet] Failed to initialize queues");
+                outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+                dState = DriverState::Error;
+                return;
+            }
+
+            Log::Warning("[VirtIONet] Only using %u of %u queue pairs", i, queuePairs);
+            queuePairs = i;
+            break;
+        }
+    }
+
+    if (features & VIRTIO_NET_F_CTRL_VQ) {
+        // The control queue comes after every queue pair the device has, not just the ones we use
+        uint16_t controlIndex = (features & VIRTIO_NET_F_MQ) ? maxQueuePairs * 2 : 2;
+        if (InitializeQueue(controlQueue, controlIndex, VIRTIO_MSI_NO_VECTOR)) {
+            controlQueue.size = 0;
+        } else {
+            controlQueue.available->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+        }
+
+        controlCommand = reinterpret_cast<ControlCommand*>(AllocateDMA(sizeof(ControlCommand), controlCommandPhys));
+        if (!controlCommand) {
+            controlQueue.size = 0;
+        }
+    }
+
+    for (int i = 0; i < 6; i++) {
+        mac[i] = ReadConfig8(VIRTIO_NET_CONFIG_MAC + i);
+    }
+
+    Log::Info("[VirtIONet] MAC Address: %x:%x:%x:%x:%x:%x, Features: %x, Queue Pairs: %u, MSI-X: %Y", mac[0], mac[1],
+              mac[2], mac[3], mac[4], mac[5], features, queuePairs, useMSIX);
+
+    char tempName[NAME_MAX];
+    char busS[16];
+    char slotS[16];
+
+    itoa(Bus(), busS, 10);
+    itoa(Slot(), slotS, 10);
+
+    strcpy(tempName, "vnet");
+    strcat(tempName, busS);
+    strcat(tempName, "s");
+    strcat(tempName, slotS);
+
+    SetInstanceName(tempName); // Name format: vnet%pciBus%s%pciSlot%
+    SetDeviceName("VirtIO Network Adapter");
+
+    for (unsigned i = 0; i < queuePairs; i++) {
+        InitializeRx(rxQueues[i]);
+        InitializeTx(txQueues[i]);
+    }
+
+    if (features & VIRTIO_NET_F_CSUM) {
+        offloads |= OffloadTCPChecksum;
+    }
+
+    if (features & VIRTIO_NET_F_HOST_TSO4) {
+        offloads |= OffloadTCPSegmentation;
+    }
+
+    outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS,
+             VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+    if (queuePairs > 1) {
+        // The device only uses the first pair until told otherwise
+        if (int e = SetQueuePairs(queuePairs); e) {
+            Log::Warning("[VirtIONet] Failed to enable %u queue pairs (error %i)", queuePairs, e);
+            queuePairs = 1;
+        }
+    }
+
+    for (unsigned i = 0; i < queuePairs; i++) {
+        Notify(rxQueues[i]);
+    }
+
+    dState = DriverState::OK;
+    UpdateLink();
+}
+
+VirtIONet::~VirtIONet() {
+    if (ioBase) {
+        outportb(ioBase + VIRTIO_REGISTER_DEVICE_STATUS, 0); // Reset the device so it lets go of our buffers
+    }
+
+    auto freeQueue = [](VirtQueue& queue) {
+        if (!queue.packets) {
+            return;
+        }
+
+        for (unsigned i = 0; i < queue.size; i++) {
+            if (queue.packets[i]) {
+                queue.packets[i]->Release();
+            }
+        }
+
+        delete[] queue.packets;
+    };
+
+    for (unsigned i = 0; i < VIRTIO_NET_MAX_QUEUE_PAIRS; i++) {
+        freeQueue(rxQueues[i]);
+        freeQueue(txQueues[i]);
+    }
+    freeQueue(controlQueue);
+
+    if (dmaPhys) {
+        for (uintptr_t page = 0; page < VIRTIO_NET_DMA_SIZE; page += PAGE_SIZE_4K) {
+            Memory::FreePhysicalMemoryBlock(dmaPhys + page);
+        }
+    }
+}
+
+void VirtIONet::Notify(VirtQueue& queue) {
+    // Make sure the device sees the new available index before we check whether it wants a notification
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (!(queue.used->flags & VIRTQ_USED_F_NO_NOTIFY)) {
+        outportw(ioBase + VIRTIO_REGISTER_QUEUE_NOTIFY, queue.index);
+    }
+}
+
+int VirtIONet::PollQueue(VirtQueue& queue, int budget) {
+    int received = 0;
+    while (received < budget && queue.lastUsed != queue.used->index) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        volatile VirtqUsedElement& element = queue.used->ring[queue.lastUsed % queue.size];
+        uint16_t head = element.id;
+        uint32_t length = element.length;
+
+        NetworkPacket* pkt = queue.packets[head + 1];
+        NetworkPacket* replacement = nullptr;
+        if (length > sizeof(NetHeader) && length - sizeof(NetHeader) <= ETHERNET_MAX_PACKET_SIZE) {
+            replacement = Network::AllocatePacket();
+        }
+
+        if (replacement) {
+            pkt->length = length - sizeof(NetHeader);
+            pkt->adapter = this;
+
+            // Hand the device a fresh buffer and pass the filled one up without copying
+            queue.packets[head + 1] = replacement;
+            queue.descriptors[head + 1].address = replacement->physicalAddress;
+
+            Network::OnReceive(pkt);
+            pkt->Release();
+        } // Otherwise drop the packet and give the buffer back to the device
+
+        queue.available->ring[queue.available->index % queue.size] = head;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        queue.available->index = queue.available->index + 1;
+
+        queue.lastUsed++;
+        received++;
+    }
+
+    if (received) {
+        Notify(queue);
+    }
+
+    if (received < budget) {
+        queue.available->flags = 0;
+
+        // A packet may have arrived after we checked but before the interrupt was unmasked
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (queue.lastUsed != queue.used->index) {
+            queue.available->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+            ScheduleReceive();
+        }
+    }
+
+    return received;
+}
+
+int VirtIONet::Poll(int budget) {
+    int received = 0;
+    bool exhausted = false;
+    for (unsigned i = 0; i < queuePairs; i++) {
+        // Share what is left of the budget between the remaining queues
+        int share = (budget - received) / static_cast<int>(queuePairs - i);
+        if (share <= 0) {
+            exhausted = true;
+            break;
+        }
+
+        int queueReceived = PollQueue(rxQueues[i], share);
+        if (queueReceived >= share) {
+            exhausted = true; // Queue still has packets and interrupts masked
+        }
+
+        received += queueReceived;
+    }
+
+    // Have the network thread come back for the queues we did not empty
+    return exhausted ? budget : received;
+}
+
+void VirtIONet::ReclaimTx(VirtQueue& queue) {
+    while (queue.lastUsed != queue.used->index) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        uint16_t head = queue.used->ring[queue.lastUsed % queue.size].id;
+        uint16_t desc = head;
+        unsigned count = 1;
+        for (;;) {
+            if (queue.packets[desc]) {
+                queue.packets[desc]->Release();
+                queue.packets[desc] = nullptr;
+            }
+
+            if (!(queue.descriptors[desc].flags & VIRTQ_DESC_F_NEXT)) {
+                break;
+            }
+
+            desc = queue.descriptors[desc].next;
+            count++;
+        }
+
+        // Put the whole chain back on the free list
+        queue.descriptors[desc].next = queue.freeHead;
+        queue.freeHead = head;
+        queue.freeCount += count;
+
+        queue.lastUsed++;
+    }
+}
+
+void VirtIONet::Transmit(void* data, size_t len, const NetHeader& header) {
+    NetworkPacket* buffers[VIRTIO_NET_MAX_TX_DESCRIPTORS];
+    unsigned bufferCount = (len + NETWORK_PACKET_BUFFER_SIZE - 1) / NETWORK_PACKET_BUFFER_SIZE;
+    assert(bufferCount < VIRTIO_NET_MAX_TX_DESCRIPTORS);
+
+    // Copy the frame out before taking the queue lock
+    for (unsigned i = 0; i < bufferCount; i++) {
+        buffers[i] = Network::AllocatePacket();
+        if (!buffers[i]) {
+            while (i--) {
+                buffers[i]->Release();
+            }
+
+            __atomic_add_fetch(&txDropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        size_t offset = i * NETWORK_PACKET_BUFFER_SIZE;
+        buffers[i]->length = (len - offset > NETWORK_PACKET_BUFFER_SIZE) ? NETWORK_PACKET_BUFFER_SIZE : len - offset;
+        memcpy(buffers[i]->data, reinterpret_cast<uint8_t*>(data) + offset, buffers[i]->length);
+    }
+
+    // Each processor sends on its own queue so they do not fight over the lock
+    VirtQueue& queue = txQueues[GetCPULocal()->id % queuePairs];
+    ScopedSpinLock<true> lockQueue(queue.lock);
+
+    if (queue.freeCount < bufferCount + 1) {
+        ReclaimTx(queue);
+
+        if (queue.freeCount < bufferCount + 1) {
+            for (unsigned i = 0; i < bufferCount; i++) {
+                buffers[i]->Release();
+            }
+
+            __atomic_add_fetch(&txDropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    // The chain follows the free list
+    uint16_t head = queue.freeHead;
+    queue.headers[head] = header;
+    queue.descriptors[head].address = queue.headersPhys + head * sizeof(NetHeader);
+    queue.descriptors[head].length = sizeof(NetHeader);
+    queue.descriptors[head].flags = VIRTQ_DESC_F_NEXT;
+
+    uint16_t desc = queue.descriptors[head].next;
+    for (unsigned i = 0; i < bufferCount; i++) {
+        uint16_t next = queue.descriptors[desc].next;
+
+        queue.packets[desc] = buffers[i];
+        queue.descriptors[desc].address = buffers[i]->physicalAddress;
+        queue.descriptors[desc].length = buffers[i]->length;
+        queue.descriptors[desc].flags = (i + 1 < bufferCount) ? VIRTQ_DESC_F_NEXT : 0;
+
+        if (i + 1 < bufferCount) {
+            desc = next;
+        } else {
+            queue.freeHead = next;
+        }
+    }
+    queue.freeCount -= bufferCount + 1;
+
+    queue.available->ring[queue.available->index % queue.size] = head;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    queue.available->index = queue.available->index + 1;
+
+    Notify(queue);
+}
+
+void VirtIONet::SendPacket(void* data, size_t len) {
+    NetHeader header;
+    memset(&header, 0, sizeof(NetHeader));
+    header.gsoType = VIRTIO_NET_HDR_GSO_NONE;
+
+    Transmit(data, len, header);
+}
+
+void VirtIONet::SendOffloadedPacket(void* data, size_t len, const NetworkTransmitOffload& offload) {
+    NetHeader header;
+    memset(&header, 0, sizeof(NetHeader));
+    header.gsoType = VIRTIO_NET_HDR_GSO_NONE;
+
+    if (offload.flags & NetworkTransmitOffload::NeedsChecksum) {
+        assert(offloads & OffloadTCPChecksum);
+
+        header.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        header.checksumStart = offload.checksumStart;
+        header.checksumOffset = offload.checksumOffset;
+    }
+
+    if (offload.flags & NetworkTransmitOffload::Segment) {
+        assert(offloads & OffloadTCPSegmentation);
+
+        header.gsoType = VIRTIO_NET_HDR_GSO_TCPV4;
+        header.headerLength = offload.headerLength;
+        header.gsoSize = offload.segmentSize;
+    }
+
+    Transmit(data, len, header);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <IOPorts.h>
+#include <Lock.h>
+#include <Net/Adapter.h>
+#include <PCI.h>
+#include <Paging.h>
+#include <VirtIO.h>
+
+#define VIRTIO_NET_DEVICE_ID 0x1000 // Transitional device, which still has the legacy I/O interface
+
+#define VIRTIO_NET_F_CSUM (1U << 0) // Device finishes checksums for us
+#define VIRTIO_NET_F_MAC (1U << 5)
+#define VIRTIO_NET_F_HOST_TSO4 (1U << 11) // Device segments TCP over IPv4
+#define VIRTIO_NET_F_STATUS (1U << 16) // Link status in the device config
+#define VIRTIO_NET_F_CTRL_VQ (1U << 17)
+#define VIRTIO_NET_F_MQ (1U << 22) // Multiple queue pairs
+
+// Device config offsets
+#define VIRTIO_NET_CONFIG_MAC 0x0
+#define VIRTIO_NET_CONFIG_STATUS 0x6
+#define VIRTIO_NET_CONFIG_MAX_QUEUE_PAIRS 0x8
+
+#define VIRTIO_NET_S_LINK_UP 0x1
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM 0x1
+#define VIRTIO_NET_HDR_GSO_NONE 0
+#define VIRTIO_NET_HDR_GSO_TCPV4 1
+
+#define VIRTIO_NET_CTRL_MQ 4
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET 0
+#define VIRTIO_NET_OK 0
+
+// One queue pair per CPU, up to this many
+#define VIRTIO_NET_MAX_QUEUE_PAIRS 8
+// Enough to cover a 64KB segment in packet buffers, and the header
+#define VIRTIO_NET_MAX_TX_DESCRIPTORS (IPV4_MAX_PACKET_SIZE / NETWORK_PACKET_BUFFER_SIZE + 3)
+// Physically contiguous memory for rings and headers
+#define VIRTIO_NET_DMA_SIZE PAGE_SIZE_2M
+
+class VirtIONet final : public Network::NetworkAdapter, private PCIDevice {
+public:
+    VirtIONet(const PCIInfo& device);
+    ~VirtIONet();
+
+    void SendPacket(void* data, size_t len) override;
+    void SendOffloadedPacket(void* data, size_t len, const NetworkTransmitOffload& offload) override;
+
+    int Poll(int budget) override;
+
+private:
+    // Precedes every frame, in its own descriptor
+    struct NetHeader {
+        uint8_t flags;
+        uint8_t gsoType;
+        uint16_t headerLength;
+        uint16_t gsoSize;
+        uint16_t checksumStart;
+        uint16_t checksumOffset;
+    } __attribute__((packed));
+
+    struct ControlCommand {
+        uint8_t commandClass;
+        uint8_t command;
+        uint16_t data;
+        uint8_t ack;
+    } __attribute__((packed));
+
+    /////////////////////////////
+    /// \brief Split virtqueue
+    ///
+    /// Receive queues keep a fixed header/buffer descriptor pair for each slot.
+    /// Transmit queues hand out descriptors from a free list and are cleaned up when sending.
+    /////////////////////////////
+    struct VirtQueue {
+        VirtIONet* device;
+        uint16_t index; // Index of the queue on the device
+        uint16_t size = 0; // Amount of descriptors, 0 if not set up
+
+        volatile VirtqDescriptor* descriptors;
+        volatile VirtqAvailable* available;
+        volatile VirtqUsed* used;
+        uint16_t lastUsed = 0; // Used ring entries we have processed
+
+        uint16_t freeHead = 0;
+        uint16_t freeCount = 0;
+
+        NetHeader* headers; // One for every descriptor, only the chain heads are used
+        uintptr_t headersPhys;
+        NetworkPacket** packets = nullptr; // Packet buffer given to each descriptor
+
+        uint8_t vector = 0xFF; // MSI-X interrupt, 0xFF if none
+
+        lock_t lock = 0;
+    };
+
+    uint16_t ioBase = 0;
+    uint16_t configBase; // Moves up when MSI-X is enabled
+
+    uint32_t features;
+    bool useMSIX = false;
+
+    unsigned queuePairs = 1;
+    VirtQueue rxQueues[VIRTIO_NET_MAX_QUEUE_PAIRS];
+    VirtQueue txQueues[VIRTIO_NET_MAX_QUEUE_PAIRS];
+    VirtQueue controlQueue;
+
+    uintptr_t dmaPhys = 0;
+    uint8_t* dmaVirt = nullptr;
+    size_t dmaUsed = 0;
+
+    ControlCommand* controlCommand;
+    uintptr_t controlCommandPhys;
+
+    unsigned txDropped = 0;
+
+    void* AllocateDMA(size_t size, uintptr_t& phys);
+
+    int InitializeQueue(VirtQueue& queue, uint16_t index, uint16_t vector);
+    void InitializeRx(VirtQueue& queue);
+    void InitializeTx(VirtQueue& queue);
+    int SetQueuePairs(unsigned pairs);
+
+    void Notify(VirtQueue& queue);
+    void ReclaimTx(VirtQueue& queue);
+    int PollQueue(VirtQueue& queue, int budget);
+    void Transmit(void* data, size_t len, const NetHeader& header);
+
+    void UpdateLink();
+    void OnInterrupt();
+    static void InterruptHandler(VirtIONet* card, RegisterContext* r);
+    static void QueueInterruptHandler(VirtQueue* queue, RegisterContext* r);
+    static void ConfigInterruptHandler(VirtIONet* card, RegisterContext* r);
+
+    inline uint8_t ReadConfig8(uint16_t offset) { return inportb(configBase + offset); }
+    inline uint16_t ReadConfig16(uint16_t offset) { return inportw(configBase + offset); }
+};
@@ -154,6 +154,9 @@ typedef struct {
     uint8_t xmm[16][16]; // XMM Registers
 } __attribute__((packed)) fx_state_t;
 
+// fxsave64 writes a 512 byte area, the rest is reserved
+#define FX_STATE_SIZE 512
+
 ALWAYS_INLINE static bool CheckInterrupts() {
     volatile unsigned long flags;
     asm volatile("pushfq;"
@@ -178,6 +181,15 @@ ALWAYS_INLINE uintptr_t GetCR3() {
     return val;
 }
 
+// The TSC is assumed to be invariant and synchronized between CPUs
+ALWAYS_INLINE static uint64_t ReadTSC() {
+    uint32_t low;
+    uint32_t high;
+
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
 static ALWAYS_INLINE void SetCPULocal(CPU* val) {
     val->self = val;
     asm volatile("wrmsr" ::"a"((uintptr_t)val & 0xFFFFFFFF) /*Value low*/,
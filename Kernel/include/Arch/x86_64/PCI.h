@@ -75,6 +75,14 @@
 #define PCI_CAP_MSI_CONTROL_MMC(x) ((x >> 1) & 0x7) // Multiple Message Capable
 #define PCI_CAP_MSI_CONTROL_ENABLE (1 << 0) // MSI Enable
 
+#define PCI_CAP_MSIX_CONTROL_TABLE_SIZE(x) ((x & 0x7FF) + 1) // Amount of table entries
+#define PCI_CAP_MSIX_CONTROL_FUNCTION_MASK (1 << 14) // Mask all vectors
+#define PCI_CAP_MSIX_CONTROL_ENABLE (1 << 15) // MSI-X Enable
+#define PCI_CAP_MSIX_BIR(x) (x & 0x7) // BAR containing the table
+#define PCI_CAP_MSIX_OFFSET(x) (x & ~0x7U) // Offset of the table within the BAR
+
+#define PCI_MSIX_VECTOR_CONTROL_MASKED (1 << 0)
+
 enum PCIConfigRegisters{
 	PCIDeviceID = 0x2,
 	PCIVendorID = 0x0,
@@ -107,6 +115,7 @@ enum PCIConfigRegisters{
 
 enum PCICapabilityIDs{
 	PCICapMSI = 0x5,
+	PCICapMSIX = 0x11,
 };
 
 enum PCIVectors{
@@ -164,6 +173,13 @@ struct PCIMSICapability{
 	}
 } __attribute__((packed));
 
+struct PCIMSIXTableEntry{
+	uint32_t addressLow;
+	uint32_t addressHigh;
+	uint32_t data;
+	uint32_t vectorControl;
+} __attribute__((packed));
+
 struct PCIInfo{
 	uint16_t deviceID;
 	uint16_t vendorID;
@@ -186,6 +202,7 @@ namespace PCI{
 	uint16_t ReadWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
 
 	uint32_t ConfigReadDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+	void ConfigWriteDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t data);
 
 	uint16_t ConfigReadWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
 	void ConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t data);
@@ -216,7 +233,7 @@ public:
 
 		uintptr_t bar = PCI::ConfigReadDword(bus, slot, func, PCIBAR0 + (idx * sizeof(uint32_t)));
 		if(!(bar & 0x1) /* Not IO */ && bar & 0x4 /* 64-bit */ && idx < 5){
-			bar |= static_cast<uintptr_t>(PCI::ConfigReadDword(bus, slot, func, PCIBAR0 + ((bar + 1) * sizeof(uint32_t)))) << 32;
+			bar |= static_cast<uintptr_t>(PCI::ConfigReadDword(bus, slot, func, PCIBAR0 + ((idx + 1) * sizeof(uint32_t)))) << 32;
 		}
 
 		return (bar & 0x1) ? (bar & 0xFFFFFFFFFFFFFFFC) : (bar & 0xFFFFFFFFFFFFFFF0);
@@ -238,7 +255,7 @@ public:
 	inline uint8_t GetProgIF() { return PCI::ConfigReadByte(bus, slot, func, PCIProgIF); }
 	inline uint16_t Status() { return PCI::ConfigReadWord(bus, slot, func, PCIStatus); }
 
-	inline bool HasCapability(uint16_t capability){ return false; }
+	bool HasCapability(uint16_t capability);
 
 	inline uint8_t Bus() { return bus; }
 	inline uint8_t Slot() { return slot; }
@@ -248,6 +265,21 @@ public:
 	inline uint16_t VendorID() { return vendorID; }
 
 	uint8_t AllocateVector(PCIVectors type);
+
+	inline bool MSIXCapable() const { return msixCapable; }
+	inline unsigned MSIXVectorCount() const { return msixCapable ? PCI_CAP_MSIX_CONTROL_TABLE_SIZE(msixControl) : 0; }
+
+	/////////////////////////////
+	/// \brief Allocate an MSI-X vector
+	///
+	/// Enables MSI-X on the first call, which also disables legacy and MSI interrupts for the device.
+	///
+	/// \param entry Index into the MSI-X table
+	/// \param cpu APIC ID of the processor which will handle the interrupt
+	///
+	/// \return Interrupt vector, 0xFF on failure
+	/////////////////////////////
+	uint8_t AllocateMSIXVector(unsigned entry, uint8_t cpu);
 private:
 	uint16_t deviceID = 0xffff;
 	uint16_t vendorID = 0xffff;
@@ -265,4 +297,9 @@ private:
 	uint8_t msiPtr;
 	PCIMSICapability msiCap;
 	bool msiCapable = false;
+
+	uint8_t msixPtr;
+	uint16_t msixControl;
+	volatile PCIMSIXTableEntry* msixTable = nullptr;
+	bool msixCapable = false;
 };
\ No newline at end of file
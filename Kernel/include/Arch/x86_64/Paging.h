@@ -5,6 +5,8 @@
 
 #define KERNEL_VIRTUAL_BASE 0xFFFFFFFF80000000ULL
 #define IO_VIRTUAL_BASE (KERNEL_VIRTUAL_BASE - 0x100000000ULL) // KERNEL_VIRTUAL_BASE - 4GB
+#define DIRECT_MAP_VIRTUAL_BASE 0xFFFF800000000000ULL // Start of the higher half, all physical memory is mapped here
+#define DIRECT_MAP_SIZE_GB 64 // Matches the 64GB limit of the physical allocator
 
 #define PML4_GET_INDEX(addr) (((addr) >> 39) & 0x1FF)
 #define PDPT_GET_INDEX(addr) (((addr) >> 30) & 0x1FF)
@@ -36,6 +38,7 @@
 #define PAGE_CACHE_DISABLED (1 << 4)
 #define PAGE_FRAME 0xFFFFFFFFFF000ULL
 #define PAGE_PAT (1 << 7)
+#define PAGE_KERNEL_GUARD (1 << 9) // Available to software, marks kernel heap pages which are reserved but not present
 #define PAGE_PAT_WRITE_COMBINING                                                                                       \
     (PAGE_PAT | PAGE_CACHE_DISABLED |                                                                                  \
      PAGE_WRITETHROUGH) // We set PA7 to write combining, PAGE_PAT is the high bit of the PAT index
@@ -147,6 +150,10 @@ void MapVirtualMemory4K(uint64_t phys, uint64_t virt, uint64_t amount, uint64_t
 
 uintptr_t GetIOMapping(uintptr_t addr);
 
+// Get the address of physical memory in the kernel's direct map
+// Zeroing and copying physical pages should go through here rather than temporary mappings
+inline void* GetDirectMapping(uintptr_t phys) { return reinterpret_cast<void*>(phys + DIRECT_MAP_VIRTUAL_BASE); }
+
 bool CheckKernelPointer(uintptr_t addr, uint64_t len);
 bool CheckUsermodePointer(uintptr_t addr, uint64_t len, AddressSpace* addressSpace);
 uint64_t VirtualToPhysicalAddress(uint64_t addr);
@@ -42,4 +42,11 @@ void FreePhysicalMemoryBlock(uint64_t addr);
 // Used Blocks of Memory
 extern uint64_t usedPhysicalBlocks;
 extern uint64_t maxPhysicalBlocks;
+// Blocks of usable RAM reported by the bootloader
+extern uint64_t usablePhysicalBlocks;
+
+// Free blocks of usable RAM
+inline uint64_t FreePhysicalBlocks() {
+    return usablePhysicalBlocks > usedPhysicalBlocks ? usablePhysicalBlocks - usedPhysicalBlocks : 0;
+}
 } // namespace Memory
\ No newline at end of file
@@ -26,12 +26,17 @@ class ProcessStateThreadBlocker;
 }
 
 namespace Scheduler {
-extern lock_t processesLock;
+// Held whilst run queues are being balanced, processes take it to stop threads being moved whilst they die
+extern lock_t runQueueBalanceLock;
 extern lock_t destroyedProcessesLock;
 extern List<FancyRefPtr<Process>>* destroyedProcesses;
+extern lock_t destroyedThreadsLock;
+extern List<FancyRefPtr<Thread>>* destroyedThreads;
 
 void RegisterProcess(FancyRefPtr<Process> proc);
 void MarkProcessForDestruction(Process* proc);
+// Threads are freed once they are no longer scheduled on any CPU
+void MarkThreadForDestruction(FancyRefPtr<Thread> thread);
 
 ALWAYS_INLINE static Process* GetCurrentProcess() {
     return Thread::Current()->parent;
@@ -48,7 +53,10 @@ void Schedule(void* data, RegisterContext* r);
 void DoSwitch(CPU* cpu);
 
 pid_t GetNextPID();
+// Lookups and iteration do not take any locks
 FancyRefPtr<Process> FindProcessByPID(pid_t pid);
+// Process with the lowest PID greater than pid, pid is set to its PID
+FancyRefPtr<Process> GetNextProcess(pid_t& pid);
 pid_t GetNextProcessPID(pid_t pid);
 void InsertNewThreadIntoQueue(Thread* thread);
 void BalanceRunQueues();
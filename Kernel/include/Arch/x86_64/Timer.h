@@ -16,6 +16,10 @@ namespace Timer{
     uint64_t UsecondsSinceBoot();
     uint32_t GetFrequency();
 
+    // Frequency of the TSC in Hz, measured against the first ticks of the timer.
+    // Returns 0 until it has been measured.
+    uint64_t TSCFrequency();
+
     timeval GetSystemUptimeStruct();
     long TimeDifference(const timeval& newTime, const timeval& oldTime);
 
@@ -3,12 +3,34 @@
 #include <ABI/Audio.h>
 
 #include <Device.h>
+#include <List.h>
+
+// Default amount of frames mixed into each hardware period
+#define AUDIO_DEFAULT_PERIOD_FRAMES 512
+#define AUDIO_MIN_PERIOD_FRAMES 64
+// Drivers use page sized period buffers,
+// at 16-bit stereo one page holds 1024 frames
+#define AUDIO_MAX_PERIOD_FRAMES 1024
+
+// Periods a stream needs buffered before it starts the output,
+// drivers should queue no more than this many periods ahead
+#define AUDIO_START_PERIODS 4
+
+// Amount of (device rate) frames buffered by each stream, must be a power of two
+#define AUDIO_STREAM_BUFFER_FRAMES 8192
 
 namespace Audio {
 
+class PCMStream;
+
 struct PCMOutput {
     class AudioController* c;
     void* output;
+
+    // Mixer state, managed by the audio system
+    lock_t streamsLock = 0;
+    List<PCMStream*> streams;
+    unsigned periodFrames = AUDIO_DEFAULT_PERIOD_FRAMES;
 };
 
 class AudioController : public Device {
@@ -29,9 +51,13 @@ public:
     virtual int OutputSampleRate(void* output) const = 0;
     virtual int OutputSetNumberOfChannels(int channels) = 0;
 
-    virtual int WriteSamples(void* output, uint8_t* buffer, size_t size, bool async) = 0;
-private:
-
+    // Called by the audio system when samples have been queued on the output.
+    // If the output is not already running, the controller should queue periods
+    // filled by MixPeriod and start DMA. The controller keeps requesting periods
+    // from its interrupt handler until MixPeriod reports silence.
+    virtual void OutputStart(void* output) = 0;
+    // Amount of frames queued in hardware buffers which have not been played yet
+    virtual int OutputQueuedFrames(void* output) const = 0;
 };
 
 void InitializeSystem();
@@ -39,4 +65,18 @@ void InitializeSystem();
 void RegisterPCMOut(PCMOutput* out);
 Error UnregisterPCMOut(PCMOutput* out);
 
-}
+/////////////////////////////
+/// \brief Mix all streams playing on an output into a hardware period
+///
+/// Safe to call from interrupt context. The buffer is filled with frames in the encoding
+/// and channel count of the output, frames past the end of the stream data are silence.
+///
+/// \param out Output to mix
+/// \param buffer Period buffer
+/// \param frames Amount of frames in the period
+///
+/// \return Amount of frames containing audio from at least one stream, 0 if the period is silent
+/////////////////////////////
+unsigned MixPeriod(PCMOutput* out, void* buffer, unsigned frames);
+
+} // namespace Audio
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// Maximum amount of boot phases recorded, any more are dropped
+#define BOOT_TRACE_MAX_PHASES 128
+// Maximum length of a phase name (including null terminator), longer names are truncated
+#define BOOT_TRACE_NAME_MAX 48
+// Interval (in us) to check whether the timer has measured the TSC frequency when dumping the trace
+#define BOOT_TRACE_CALIBRATION_WAIT 10000
+
+namespace BootTrace {
+/////////////////////////////
+/// \brief Record the start of a boot phase
+///
+/// Safe to call from any CPU, before or after the scheduler has started.
+///
+/// \param name Name of the phase, copied into the trace
+///
+/// \return Phase ID to pass to End(), or -1 if the trace is full
+/////////////////////////////
+int Begin(const char* name);
+
+/////////////////////////////
+/// \brief Record the end of a boot phase
+/////////////////////////////
+void End(int phase);
+
+/////////////////////////////
+/// \brief Write the recorded phases to the kernel log (and /dev/kernellog)
+///
+/// Sleeps until the TSC frequency is known, so must be called from a thread.
+/////////////////////////////
+void Dump();
+
+class ScopedPhase final {
+public:
+    inline ScopedPhase(const char* name) : m_phase(Begin(name)) {}
+    inline ~ScopedPhase() { End(m_phase); }
+
+private:
+    int m_phase;
+};
+} // namespace BootTrace
@@ -91,6 +91,8 @@ protected:
 };
 
 class PartitionDevice;
+class BlockQueue;
+struct BlockRequest;
 
 class DiskDevice : public Device {
     friend class PartitionDevice;
@@ -103,18 +105,51 @@ public:
 
     int InitializePartitions();
 
+    /////////////////////////////
+    /// \brief Read blocks straight from the driver
+    ///
+    /// Called by the block queue, everything else should use SubmitRequest or QueuedRead.
+    ///
+    /// \param count Amount of bytes
+    /////////////////////////////
     virtual int ReadDiskBlock(uint64_t lba, uint32_t count, void* buffer);
     virtual int WriteDiskBlock(uint64_t lba, uint32_t count, void* buffer);
 
+    /////////////////////////////
+    /// \brief Queue a request on the disk
+    ///
+    /// \return 0 on success, negative error code if the request is malformed
+    /////////////////////////////
+    int SubmitRequest(BlockRequest* request);
+
+    /////////////////////////////
+    /// \brief Read or write through the block queue and wait for completion
+    ///
+    /// \param count Amount of bytes
+    ///
+    /// \return 0 on success, negative error code on failure
+    /////////////////////////////
+    int QueuedRead(uint64_t lba, uint32_t count, void* buffer);
+    int QueuedWrite(uint64_t lba, uint32_t count, void* buffer);
+
     virtual ssize_t Read(size_t off, size_t size, uint8_t* buffer);
     virtual ssize_t Write(size_t off, size_t size, uint8_t* buffer);
 
+    int Ioctl(uint64_t cmd, uint64_t arg) override;
+
     virtual ~DiskDevice();
 
     List<PartitionDevice*> partitions;
     int blocksize = 512;
+    // Amount of threads which may call ReadDiskBlock/WriteDiskBlock at once,
+    // the block queue dispatches with this many threads
+    unsigned hardwareQueues = 1;
 
 private:
+    BlockQueue* Queue();
+    int QueuedTransfer(bool write, uint64_t lba, uint32_t count, void* buffer);
+
+    BlockQueue* m_queue = nullptr; // Created on the first request
 };
 
 class PartitionDevice final : public Device {
@@ -128,6 +163,8 @@ public:
     ssize_t Read(size_t off, size_t size, uint8_t* buffer) override;
     ssize_t Write(size_t off, size_t size, uint8_t* buffer) override;
 
+    int Ioctl(uint64_t cmd, uint64_t arg) override;
+
     virtual ~PartitionDevice();
 
     DiskDevice* parentDisk;
@@ -5,6 +5,8 @@
 #include <Device.h>
 #include <Fs/Filesystem.h>
 #include <Fs/FsVolume.h>
+#include <Lock.h>
+#include <Vector.h>
 
 #define FAT_ATTR_READ_ONLY 0x1
 #define FAT_ATTR_HIDDEN 0x2
@@ -13,6 +15,14 @@
 #define FAT_ATTR_DIRECTORY 0x10
 #define FAT_ATTR_ARCHIVE 0x20
 
+#define FAT32_CLUSTER_MASK 0x0FFFFFFF
+#define FAT32_CLUSTER_EOC 0x0FFFFFF8 // Clusters from here on mark the end of a chain
+
+// Size of the blocks of the FAT read from disk and cached
+#define FAT32_FAT_BLOCK_SIZE 4096
+// The FAT cache is direct mapped, 256KB covers the chains of 16GB of files with 4KB clusters
+#define FAT32_FAT_CACHE_BLOCKS 64
+
 typedef struct {
     uint8_t jmp[3]; // Can be ignored
     int8_t oem[8]; // OEM identifier
@@ -93,8 +103,19 @@ typedef struct
 namespace fs::FAT32{
     class Fat32Volume;
 
+    /////////////////////////////
+    /// \brief Run of contiguous clusters in a cluster chain
+    /////////////////////////////
+    struct ClusterExtent {
+        uint32_t start; // Index of the first cluster within the chain
+        uint32_t cluster; // First cluster on disk
+        uint32_t count;
+    };
+
     class Fat32Node : public FsNode {
     public:
+        ~Fat32Node();
+
         ssize_t Read(size_t, size_t, uint8_t *);
         ssize_t Write(size_t, size_t, uint8_t *);
         //fs_fd_t* Open(size_t flags);
@@ -103,11 +124,15 @@ namespace fs::FAT32{
         FsNode* FindDir(const char* name);
 
         Fat32Volume* vol;
+
+        // Cluster chain of the node, built on first access
+        Vector<ClusterExtent>* extents = nullptr;
     };
 
     class Fat32Volume : public FsVolume {
     public:
         Fat32Volume(PartitionDevice* part, char* name);
+        ~Fat32Volume();
 
         ssize_t Read(Fat32Node* node, size_t offset, size_t size, uint8_t *buffer);
         ssize_t Write(Fat32Node* node, size_t offset, size_t size, uint8_t *buffer);
@@ -117,15 +142,49 @@ namespace fs::FAT32{
         FsNode* FindDir(Fat32Node* node, const char* name);
 
     private:
+        struct CachedFATBlock {
+            uint32_t block = 0xFFFFFFFF;
+            uint32_t* data = nullptr;
+        };
+
         uint64_t ClusterToLBA(uint32_t cluster);
-        List<uint32_t>* GetClusterChain(uint32_t cluster);
-        void* ReadClusterChain(uint32_t cluster, int* count);
-        void* ReadClusterChain(uint32_t cluster, int* count, size_t max);
+
+        /////////////////////////////
+        /// \brief Look up the next cluster in a chain
+        ///
+        /// \return 0 on success, otherwise a negative error code
+        /////////////////////////////
+        int ReadFATEntry(uint32_t cluster, uint32_t& next);
+
+        /////////////////////////////
+        /// \brief Get the cluster chain of a node as extents
+        ///
+        /// \return Extents of the chain, nullptr on disk error
+        /////////////////////////////
+        Vector<ClusterExtent>* GetExtents(Fat32Node* node);
+
+        /////////////////////////////
+        /// \brief Read a byte range of a cluster chain
+        ///
+        /// Only the clusters covering the range are read,
+        /// whole clusters which are contiguous on disk are read in a single request.
+        ///
+        /// \return Bytes read, less than size if the chain ends first, or a negative error code
+        /////////////////////////////
+        ssize_t ReadExtents(const Vector<ClusterExtent>& extents, size_t offset, size_t size, uint8_t* buffer);
+
+        // Read all the entries of a directory, the buffer has to be freed with kfree
+        fat_entry_t* ReadDirectory(Fat32Node* node, unsigned& entryCount);
 
         PartitionDevice* part;
-        fat32_boot_record_t* bootRecord;
+        fat32_boot_record_t* bootRecord = nullptr;
+
+        unsigned clusterSizeBytes;
+        uint32_t clusterCount; // Data clusters on the volume, numbered from 2
+
+        lock_t fatCacheLock = 0;
+        CachedFATBlock fatCache[FAT32_FAT_CACHE_BLOCKS];
 
-        int clusterSizeBytes;
         Fat32Node fat32MountPoint;
     };
 
@@ -126,7 +126,6 @@ static inline void FD_SET(int fd, fd_set_t* fds) {
     fds->fds_bits[fd / 8] |= 1 << (fd % 8);
 }
 
-class FilesystemWatcher;
 class DirectoryEntry;
 
 class UNIXOpenFile : public KernelObject {
@@ -134,6 +133,14 @@ class UNIXOpenFile : public KernelObject {
 public:
     ~UNIXOpenFile();
 
+    /////////////////////////////
+    /// \brief Wait for the file to become readable
+    ///
+    /// Allows file descriptors to be waited on alongside other kernel objects.
+    /////////////////////////////
+    void Watch(KernelObjectWatcher& watcher, int events) override;
+    void Unwatch(KernelObjectWatcher& watcher) override;
+
     lock_t dataLock = 0;
 
     class FsNode* node = nullptr;
@@ -206,8 +213,8 @@ public:
     virtual bool CanRead() { return true; }
     virtual bool CanWrite() { return true; }
 
-    virtual void Watch(FilesystemWatcher& watcher, int events);
-    virtual void Unwatch(FilesystemWatcher& watcher);
+    virtual void Watch(KernelObjectWatcher& watcher, int events);
+    virtual void Unwatch(KernelObjectWatcher& watcher);
 
     virtual inline bool IsFile() { return (flags & FS_NODE_TYPE) == FS_NODE_FILE; }
     virtual inline bool IsDirectory() { return (flags & FS_NODE_TYPE) == FS_NODE_DIRECTORY; }
@@ -236,6 +243,11 @@ public:
 
     mode_t flags = 0;
 
+    // Set by filesystems which fill in the inode and size whilst reading the directory,
+    // so readdirplus does not have to look up every entry
+    bool hasAttributes = false;
+    size_t size = 0;
+
     DirectoryEntry(FsNode* node, const char* name);
     DirectoryEntry() {}
 
@@ -269,11 +281,10 @@ public:
 // FilesystemWatcher is a semaphore initialized to 0.
 // A thread can wait on it like any semaphore,
 // and when a file is ready it will signal and waiting thread(s) will get woken
-class FilesystemWatcher : public Semaphore {
+class FilesystemWatcher : public KernelObjectWatcher {
     List<UNIXOpenFile*> watching;
 
 public:
-    FilesystemWatcher() : Semaphore(0) {}
 
     inline void WatchNode(FsNode* node, int events) {
         ErrorOr<UNIXOpenFile*> desc = node->Open(0);
@@ -487,3 +498,7 @@ int Rename(FsNode* olddir, const char* oldpath, FsNode* newdir, const char* newp
 } // namespace fs
 
 ALWAYS_INLINE UNIXOpenFile::~UNIXOpenFile() { fs::Close(this); }
+
+// Kernel object waits have no event mask, so wait for the file to be readable
+ALWAYS_INLINE void UNIXOpenFile::Watch(KernelObjectWatcher& watcher, int) { node->Watch(watcher, POLLIN); }
+ALWAYS_INLINE void UNIXOpenFile::Unwatch(KernelObjectWatcher& watcher) { node->Unwatch(watcher); }
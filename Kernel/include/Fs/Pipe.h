@@ -11,8 +11,8 @@ public:
     ssize_t Read(size_t off, size_t size, uint8_t* buffer);
     ssize_t Write(size_t off, size_t size, uint8_t* buffer);
 
-    void Watch(FilesystemWatcher& watcher, int events);
-    void Unwatch(FilesystemWatcher& watcher);
+    void Watch(KernelObjectWatcher& watcher, int events);
+    void Unwatch(KernelObjectWatcher& watcher);
 
     void Close();
 
@@ -29,6 +29,6 @@ protected:
 
     FancyRefPtr<DataStream> stream;
     
-    List<FilesystemWatcher*> watching;
+    List<KernelObjectWatcher*> watching;
     lock_t watchingLock = 0;
 };
\ No newline at end of file
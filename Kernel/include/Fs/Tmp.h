@@ -4,10 +4,14 @@
 #include <Fs/FsVolume.h>
 
 #include <Hash.h>
+#include <Paging.h>
 #include <Spinlock.h>
 
-#define TEMP_BUFFER_CHUNK_SIZE 1024UL // Must be power of two
-static_assert((TEMP_BUFFER_CHUNK_SIZE & (TEMP_BUFFER_CHUNK_SIZE - 1)) == 0);
+// Files are stored as sparse arrays of 4KB physical pages
+#define TEMP_PAGE_SIZE PAGE_SIZE_4K
+#define TEMP_PAGE_SHIFT PAGE_SHIFT_4K
+// tmpfs may use at most (1 / TEMP_MEMORY_LIMIT_DIVISOR) of free memory at mount time
+#define TEMP_MEMORY_LIMIT_DIVISOR 2
 
 namespace fs::Temp{
     class TempVolume;
@@ -18,18 +22,21 @@ namespace fs::Temp{
         TempVolume* vol;
         TempNode* parent;
 
-        union {
-            struct{
-                List<DirectoryEntry> children;
-            };
-            struct {
-                ReadWriteLock bufferLock;
-                uint8_t* buffer;
-                size_t bufferSize;
-            };
-        };
+        // Directory
+        List<DirectoryEntry> children;
+
+        // Regular file
+        ReadWriteLock bufferLock;
+        uint32_t* pages = nullptr; // Physical block numbers (physical address >> 12), 0 indicates a hole
+        size_t pageArraySize = 0; // Capacity of the pages array
 
         TempNode* Find(const char* name);
+
+        // Get the direct mapping of the page at index, allocating it if requested
+        // Returns nullptr for holes or when the volume is out of space
+        uint8_t* GetPage(size_t index, bool allocate);
+        // Free every page from index onwards
+        void FreePages(size_t index);
     public:
         TempNode(TempVolume* v, int flags);
         ~TempNode();
@@ -58,15 +65,21 @@ namespace fs::Temp{
         uint32_t nextInode = 1;
         HashMap<uint32_t, TempNode*> nodes;
         TempNode* tempMountPoint;
-        unsigned memoryUsage = 0;
 
-        void ReallocateNode(TempNode* node, size_t old);
+        lock_t memoryLock = 0;
+        size_t memoryUsage = 0; // Memory used by file data in bytes
+        size_t memoryLimit = 0;
+
+        // Allocate a zeroed page for file data, returns 0 when the memory limit has been reached
+        uint64_t AllocatePage();
+        void FreePage(uint64_t phys);
     public:
 
         TempVolume(const char* name);
 
         void SetVolumeID(volume_id_t id);
 
-        inline unsigned GetMemoryUsage() { return memoryUsage; }
+        inline size_t GetMemoryUsage() const { return memoryUsage; }
+        inline size_t GetMemoryLimit() const { return memoryLimit; }
     };
 }
\ No newline at end of file
@@ -39,6 +39,14 @@ public:
 		List<KeyValuePair>* bucket;
 
 		ListIterator<KeyValuePair> listIt;
+
+		// Move to the next bucket with items in it, or the end of the last bucket
+		void SkipEmptyBuckets(){
+			while(listIt == bucket->end() && bucketIndex < map->bucketCount - 1){
+				bucket = &map->buckets[++bucketIndex];
+				listIt = bucket->begin();
+			}
+		}
 	public:
 		HashMapIterator() = default;
 		HashMapIterator(const HashMapIterator&) = default;
@@ -47,26 +55,15 @@ public:
 			assert(listIt != bucket->end());
 
 			listIt++;
-
-			if(listIt == bucket->end() && bucketIndex < map->bucketCount - 1){
-				bucket = map->buckets[++bucketIndex];
-				listIt = bucket->begin();
-			}
+			SkipEmptyBuckets();
 
 			return *this;
 		}
 
-		HashMapIterator& operator++(int){
-			ListIterator<KeyValuePair> v = ListIterator<KeyValuePair>(*this);
+		HashMapIterator operator++(int){
+			HashMapIterator v = *this;
 
-			assert(listIt != bucket->end());
-
-			listIt++;
-
-			if(listIt == bucket->end() && bucketIndex < map->bucketCount - 1){
-				bucket = map->buckets[++bucketIndex];
-				listIt = bucket->begin();
-			}
+			++(*this);
 
 			return v;
 		}
@@ -204,12 +201,13 @@ public:
 	HashMapIterator begin(){
 		HashMapIterator it;
 
-		it.bucket = buckets[0];
+		it.bucket = &buckets[0];
 		it.bucketIndex = 0;
 
 		it.map = this;
 
 		it.listIt = it.bucket->begin();
+		it.SkipEmptyBuckets();
 
 		return it;
 	}
@@ -217,7 +215,7 @@ public:
 	HashMapIterator end(){
 		HashMapIterator it;
 
-		it.bucket = buckets[bucketCount - 1];
+		it.bucket = &buckets[bucketCount - 1];
 		it.bucketIndex = bucketCount - 1;
 
 		it.map = this;
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <ABI/Input.h>
+
+#include <stdint.h>
+
+// Amount of events queued for /dev/input, must be a power of two
+#define INPUT_QUEUE_SIZE 256
+
+namespace Input {
+/////////////////////////////
+/// \brief Queue a key event for /dev/input
+///
+/// Called from interrupt handlers.
+///
+/// \param keyCode Key code, with the high bit set if the key was released
+/////////////////////////////
+void PostKey(uint8_t keyCode);
+
+/////////////////////////////
+/// \brief Queue a mouse packet for /dev/input
+///
+/// Called from interrupt handlers. If the last queued event has not been read
+/// and has the same button state, the motion is added to it instead.
+/////////////////////////////
+void PostMouse(uint8_t buttons, int xMovement, int yMovement, int8_t verticalScroll);
+} // namespace Input
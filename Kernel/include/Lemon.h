@@ -1,11 +1,24 @@
 #pragma once
 
+#include <stdint.h>
+
+#define LEMON_SYSINFO_MAX_CACHES 16
+
+typedef struct {
+	char name[32];
+	uint64_t usage; // Memory used by the cache in KB
+	uint64_t reclaimable; // Memory the cache could give back in KB
+} lemon_cache_info_t;
+
 typedef struct {
 	uint64_t totalMem;
 	uint64_t usedMem;
 	uint16_t cpuCount;
+
+	uint16_t cacheCount;
+	lemon_cache_info_t caches[LEMON_SYSINFO_MAX_CACHES];
 } lemon_sysinfo_t;
 
 namespace Lemon{
 	extern char* versionString;
-}
\ No newline at end of file
+}
@@ -5,16 +5,50 @@
 
 #include <Debug.h>
 
+// Size of each per-CPU log ring, must be a power of two
+#define LOG_RING_SIZE 0x8000
+// Maximum size of a single log record (including its header), longer messages are truncated
+#define LOG_RECORD_MAX 1024
+// Amount of formatted log text kept for /dev/kernellog, must be a power of two
+#define LOG_HISTORY_SIZE 0x40000
+// Interval (in us) at which the log thread checks the log rings
+#define LOG_DRAIN_INTERVAL 10000
+
 namespace Log{
+    enum LogLevel : uint8_t {
+        LogLevelPrint, // Continuation of a previous message, no prefix
+        LogLevelInfo,
+        LogLevelWarning,
+        LogLevelError,
+        LogLevelDebug,
+        LogLevelPadding, // Fills the end of a log ring, never output
+    };
+
     extern VideoConsole* console;
 
     void LateInitialize();
     void SetVideoConsole(VideoConsole* con);
 
+    /////////////////////////////
+    /// \brief Write log output synchronously
+    ///
+    /// Any buffered records are flushed first.
+    /// Used when the system is about to halt and the log thread will not run again.
+    /////////////////////////////
     void DisableBuffer();
+    /////////////////////////////
+    /// \brief Allocate the per-CPU log rings
+    ///
+    /// Output is written synchronously until the log thread has been started
+    /////////////////////////////
     void EnableBuffer();
+    /////////////////////////////
+    /// \brief Start the thread which drains the log rings to the serial port, video console and /dev/kernellog
+    /////////////////////////////
+    void StartLogThread();
 
     void WriteF(const char* __restrict format, va_list args);
+    void WriteF(LogLevel level, const char* __restrict format, va_list args);
 
     void Write(const char* str, uint8_t r = 255, uint8_t g = 255, uint8_t b = 255);
     void Write(unsigned long long num, bool hex = true, uint8_t r = 255, uint8_t g = 255, uint8_t b = 255);
@@ -36,10 +70,9 @@ namespace Log{
     #ifdef KERNEL_DEBUG
     __attribute__((always_inline)) inline static void Debug(const int& var, const int lvl, const char* __restrict fmt, ...){
         if(var >= lvl){
-		    Write("\r\n[INFO]    ");
             va_list args;
             va_start(args, fmt);
-            WriteF(fmt, args);
+            WriteF(LogLevelDebug, fmt, args);
             va_end(args);
         }
     }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+// Size of each thread's kernel stack, must be a multiple of the page size
+#ifndef KERNEL_STACK_SIZE
+#define KERNEL_STACK_SIZE (64 * 1024)
+#endif
+// Unmapped pages below each stack so an overflow faults instead of corrupting whatever is below it
+#define KERNEL_STACK_GUARD_PAGES 1
+// Free stacks kept by each CPU before they are given back to the shared pool
+#define KERNEL_STACK_CPU_CACHE_SIZE 8
+// Maximum amount of free stacks kept in the shared pool (4MB with 64KB stacks)
+#define KERNEL_STACK_POOL_SIZE 64
+
+static_assert(!(KERNEL_STACK_SIZE & 0xfff), "KERNEL_STACK_SIZE must be page aligned");
+
+namespace Memory {
+
+/////////////////////////////
+/// \brief Register the kernel stack pool with the reclaimer
+/////////////////////////////
+void InitializeKernelStackPool();
+
+/////////////////////////////
+/// \brief Allocate a kernel stack
+///
+/// Recycled stacks are taken from the current CPU's cache, then the shared pool.
+/// Otherwise a new stack is mapped with guard pages below it.
+///
+/// \return Base (lowest address) of the stack, the stack grows down from base + KERNEL_STACK_SIZE
+/////////////////////////////
+void* AllocateKernelStack();
+
+/////////////////////////////
+/// \brief Free a kernel stack
+///
+/// The stack must no longer be in use by any CPU.
+///
+/// \param base Base of the stack as returned by AllocateKernelStack
+/////////////////////////////
+void FreeKernelStack(void* base);
+
+// Amount of stacks currently handed out
+extern unsigned kernelStacksInUse;
+} // namespace Memory
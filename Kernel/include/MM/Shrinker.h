@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Lemon.h>
+
+// Background reclaim starts when less than 1/64 of memory is free
+// and stops once 1/32 of memory is free
+#define RECLAIM_LOW_WATERMARK_DIVISOR 64
+#define RECLAIM_HIGH_WATERMARK_DIVISOR 32
+// Never let the watermarks drop below 4MB and 8MB
+#define RECLAIM_MIN_LOW_WATERMARK 1024
+#define RECLAIM_MIN_HIGH_WATERMARK 2048
+
+// Pages asked of each shrinker in one pass
+#define RECLAIM_BATCH_PAGES 256
+// Longest the allocator waits for the reclaim thread before giving up (in us)
+#define RECLAIM_WAIT_TIMEOUT 1000000
+
+namespace Memory {
+
+/////////////////////////////
+/// \brief Cache which can give memory back when the system runs low
+///
+/// Shrinkers are called from the reclaim thread, and shrinkers marked
+/// as direct are also called by the physical allocator right before it would fail.
+/////////////////////////////
+class Shrinker {
+public:
+    Shrinker(const char* name, bool direct = false);
+    virtual ~Shrinker();
+
+    /////////////////////////////
+    /// \brief Amount of memory used by the cache in bytes
+    /////////////////////////////
+    virtual size_t MemoryUsage() = 0;
+
+    /////////////////////////////
+    /// \brief Amount of memory the cache could give back in bytes
+    /////////////////////////////
+    virtual size_t ReclaimableMemory() = 0;
+
+    /////////////////////////////
+    /// \brief Free memory held by the cache, least recently used first
+    ///
+    /// Must not sleep. Locks which could be held by whoever is allocating should
+    /// only be try-locked, if a lock cannot be acquired the shrinker should give up.
+    /// Direct shrinkers may be called with interrupts disabled and the kernel heap
+    /// locked, so they must free physical pages without going through kfree.
+    ///
+    /// \param pages Amount of pages to try and free
+    ///
+    /// \return Amount of pages freed
+    /////////////////////////////
+    virtual size_t Shrink(size_t pages) = 0;
+
+    inline const char* Name() const { return m_name; }
+    inline bool IsDirect() const { return m_direct; }
+
+protected:
+    const char* m_name;
+    bool m_direct;
+};
+
+/////////////////////////////
+/// \brief Start the reclaim thread
+/////////////////////////////
+void InitializeReclaim();
+
+/////////////////////////////
+/// \brief Register a shrinker, called when memory is low
+/////////////////////////////
+void RegisterShrinker(Shrinker* shrinker);
+
+/////////////////////////////
+/// \brief Unregister a shrinker
+///
+/// Waits for any reclaim pass using the shrinker to finish.
+/////////////////////////////
+void UnregisterShrinker(Shrinker* shrinker);
+
+/////////////////////////////
+/// \brief Free memory held by caches
+///
+/// \param pages Amount of pages to try and free
+/// \param direct Only call direct shrinkers, used by the physical allocator
+///
+/// \return Amount of pages freed
+/////////////////////////////
+size_t ReclaimMemory(size_t pages, bool direct = false);
+
+/////////////////////////////
+/// \brief Wake the reclaim thread and wait for it to finish a pass
+///
+/// Used by the physical allocator once direct reclaim has failed,
+/// so caches which can only be shrunk by the reclaim thread get a chance.
+/// Only waits if the caller could be preempted anyway (interrupts enabled)
+/// and is not the reclaim thread itself.
+///
+/// \return Whether the reclaim thread finished a pass
+/////////////////////////////
+bool WaitForReclaim();
+
+/////////////////////////////
+/// \brief Whether free memory is below the low watermark
+///
+/// Caches should reuse their own memory instead of growing when under pressure.
+/////////////////////////////
+bool IsUnderMemoryPressure();
+
+/////////////////////////////
+/// \brief Fill info about registered shrinkers
+///
+/// \param info Array to fill
+/// \param max Maximum amount of shrinkers to report
+///
+/// \return Amount of shrinkers reported
+/////////////////////////////
+unsigned GetShrinkerInfo(lemon_cache_info_t* info, unsigned max);
+
+// Pages freed by the reclaim thread and by the allocator
+extern uint64_t reclaimedPages;
+extern uint64_t directReclaimedPages;
+} // namespace Memory
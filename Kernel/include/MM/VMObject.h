@@ -32,6 +32,8 @@ public:
     ALWAYS_INLINE bool IsReclaimable() const { return reclaimable; }
 
     ALWAYS_INLINE virtual bool CanMunmap() const { return false; }
+    // Whether the object may be mapped writable in pMap, checked on write faults
+    virtual bool CanWrite(PageMap*) const { return true; }
     ALWAYS_INLINE size_t ReferenceCount() const { return refCount; }
 protected:
     size_t size;
@@ -50,7 +52,7 @@ public:
     PhysicalVMObject(size_t size, bool anonymous, bool shared);
     virtual ~PhysicalVMObject();
 
-    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap) final;
+    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap) override;
     void ForceAllocate(); // Force allocate all blocks
     virtual void MapAllocatedBlocks(uintptr_t base, PageMap* pMap);
 
@@ -59,6 +61,9 @@ public:
     virtual size_t UsedPhysicalMemory() const;
 
 protected:
+    // Allocate (if necessary) and map the block at offset with pageFlags
+    int MapBlock(uintptr_t base, uintptr_t offset, PageMap* pMap, uint64_t pageFlags);
+
     uint32_t* physicalBlocks = nullptr; // A bit of an optimization, since one physical block is 4KB, we can shift by 12
 };
 
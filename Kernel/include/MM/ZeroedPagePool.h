@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// Maximum amount of pre-zeroed pages kept in the pool (4MB)
+#define ZEROED_PAGE_POOL_SIZE 1024
+// The background thread starts zeroing pages when the pool drops below this
+#define ZEROED_PAGE_POOL_LOW_WATERMARK (ZEROED_PAGE_POOL_SIZE / 2)
+
+namespace Memory {
+
+/////////////////////////////
+/// \brief Start the background page zeroing thread
+/////////////////////////////
+void InitializeZeroedPagePool();
+
+/////////////////////////////
+/// \brief Allocate a zeroed block of physical memory
+///
+/// Takes a page from the pool when one is available,
+/// otherwise allocates a block and zeroes it through the direct map.
+///
+/// \return Physical address of the zeroed block
+/////////////////////////////
+uint64_t AllocateZeroedPhysicalMemoryBlock();
+
+/////////////////////////////
+/// \brief Zero pages into the pool
+///
+/// Called from the idle thread of each CPU and the background zeroing thread.
+///
+/// \param maxPages Maximum amount of pages to zero
+///
+/// \return Amount of pages added to the pool
+/////////////////////////////
+unsigned RefillZeroedPagePool(unsigned maxPages);
+
+/////////////////////////////
+/// \brief Return all pages in the pool to the physical allocator
+///
+/// \return Amount of pages freed
+/////////////////////////////
+unsigned DrainZeroedPagePool();
+
+/////////////////////////////
+/// \brief Zero a physical page using non-temporal stores
+///
+/// Bypasses the cache so zeroing pages in the background does not evict the working set of other threads.
+/////////////////////////////
+void ZeroPhysicalPageNonTemporal(uint64_t phys);
+
+// Amount of pages currently in the pool
+extern unsigned zeroedPageCount;
+// Allocations satisfied from the pool and those which had to zero a page synchronously
+extern uint64_t zeroedPagePoolHits;
+extern uint64_t zeroedPagePoolMisses;
+} // namespace Memory
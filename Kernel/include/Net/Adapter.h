@@ -19,6 +19,11 @@ namespace Network{
             NetworkAdapterEthernet,
         };
 
+        enum Offloads{
+            OffloadTCPChecksum = 0x1, // Adapter finishes TCP checksums
+            OffloadTCPSegmentation = 0x2, // Adapter splits TCP segments larger than the MTU
+        };
+
         enum DriverState{
             OK,
             Uninitialized,
@@ -33,6 +38,8 @@ namespace Network{
         IPv4Address gatewayIP = 0; // 0.0.0.0
         IPv4Address subnetMask = 0xFFFFFFFF; // 255.255.255.255 (no subnet)
         int adapterIndex = 0; // Index in the adapters list
+
+        unsigned offloads = 0; // Work the adapter can take off the stack when sending
         
         NetworkAdapter(AdapterType aType);
 
@@ -40,12 +47,40 @@ namespace Network{
         
         virtual void SendPacket(void* data, size_t len);
 
+        /////////////////////////////
+        /// \brief Send a frame, leaving checksumming and segmentation to the adapter
+        ///
+        /// Only called with offloads the adapter has advertised.
+        /// Offsets in offload are relative to the start of the Ethernet frame.
+        /////////////////////////////
+        virtual void SendOffloadedPacket(void* data, size_t len, const NetworkTransmitOffload& offload);
+
         virtual int GetLink() const;
-        virtual int QueueSize() const;
 
-        virtual NetworkPacket* Dequeue();
-        virtual NetworkPacket* DequeueBlocking();
-        virtual void CachePacket(NetworkPacket* pkt);
+        inline bool IsLoopback() const { return type == NetworkAdapterLoopback; }
+
+        /////////////////////////////
+        /// \brief Receive packets
+        ///
+        /// Called from the network thread after the driver has called ScheduleReceive.
+        /// The driver should pass up to budget received packets to Network::OnReceive.
+        /// If the driver runs out of packets before using up the budget,
+        /// it should enable its receive interrupt again.
+        ///
+        /// \return Amount of packets received
+        /////////////////////////////
+        virtual int Poll(int budget);
+
+        /////////////////////////////
+        /// \brief Have the network thread poll the adapter
+        ///
+        /// Called by the driver from its interrupt handler,
+        /// after disabling its receive interrupt.
+        /////////////////////////////
+        void ScheduleReceive();
+
+        // Set when the adapter needs polling
+        bool pollScheduled = false;
 
         void BindToSocket(IPSocket* sock);
         void UnbindSocket(IPSocket* sock);
@@ -55,20 +90,9 @@ namespace Network{
 
     protected:
         static int nextDeviceNumber;
-        unsigned maxCache = 256; // Maximum amount of cached packets, NIC drivers are free to change this
     
         int linkState = LinkDown;
 
-        FastList<NetworkPacket*> cache;
-        FastList<NetworkPacket*> queue;
-
-        Semaphore packetSemaphore = Semaphore(0);
-
-        lock_t cacheLock = 0;
-        lock_t queueLock = 0;
-
-        lock_t threadLock = 0;
-
         AdapterType type;
 
         lock_t boundSocketsLock = 0;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <List.h>
+#include <Lock.h>
+#include <Net/Adapter.h>
+
+// Loopback packets never go through a NIC so they can use the whole packet buffer
+#define LOOPBACK_MTU NETWORK_PACKET_BUFFER_SIZE
+
+namespace Network{
+    /////////////////////////////
+    /// \brief Loopback adapter (lo)
+    ///
+    /// Carries traffic to 127.0.0.0/8 and to the addresses of our own adapters.
+    /// Packets skip Ethernet framing and checksums and are handed
+    /// to the receiving end of the stack without being copied.
+    /////////////////////////////
+    class LoopbackAdapter final : public NetworkAdapter {
+    public:
+        LoopbackAdapter();
+
+        void SendPacket(void* data, size_t len) override;
+
+        int Poll(int budget) override;
+
+        /////////////////////////////
+        /// \brief Allocate a packet and fill in its IPv4 header
+        ///
+        /// The caller fills in the payload at packet->data + sizeof(IPv4Header).
+        ///
+        /// \param length Length of the payload
+        ///
+        /// \return Packet, nullptr if out of memory
+        /////////////////////////////
+        NetworkPacket* AllocateIPv4Packet(size_t length, const IPv4Address& source, const IPv4Address& destination, uint8_t protocol);
+
+        /////////////////////////////
+        /// \brief Pass a packet to the local stack
+        ///
+        /// Takes over the caller's reference. UDP is delivered to the socket straight away,
+        /// everything else is queued for the network thread.
+        /////////////////////////////
+        void Deliver(NetworkPacket* packet);
+
+        int SendIPv4(void* data, size_t length, const IPv4Address& source, const IPv4Address& destination, uint8_t protocol);
+
+    private:
+        lock_t queueLock = 0;
+        FastList<NetworkPacket*> queue;
+    };
+
+    extern LoopbackAdapter* loopbackAdapter;
+
+    /////////////////////////////
+    /// \brief Whether an address belongs to this machine
+    ///
+    /// \return true for 127.0.0.0/8 and addresses assigned to one of our adapters
+    /////////////////////////////
+    bool IsLocalAddress(const IPv4Address& address);
+
+    void InitializeLoopback();
+}
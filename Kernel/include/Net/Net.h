@@ -18,21 +18,59 @@ class Socket;
 #define EPHEMERAL_PORT_RANGE_END PORT_MAX
 
 #define ETHERNET_MAX_PACKET_SIZE 1518
+#define ETHERNET_MTU 1500
+
+// Largest packet which fits in the IPv4 length field,
+// adapters with segmentation offload accept TCP segments up to this size
+#define IPV4_MAX_PACKET_SIZE 65535
 
 #define TCP_RETRY_MIN 200000   // 200 ms minimum retry period
 #define TCP_RETRY_MAX 32000000 // 32s
 
+// Each packet buffer is one page, which NICs DMA straight into
+#define NETWORK_PACKET_BUFFER_SIZE 4096
+// Free packet buffers kept around for reuse
+#define NETWORK_PACKET_POOL_SIZE 1024
+
+// Maximum amount of packets an adapter processes per poll before letting other adapters run
+#define NETWORK_POLL_BUDGET 64
+
 namespace Network {
 class NetworkAdapter;
 }
+
+// Reference counted packet buffer which owns a page of physical memory.
+// Received packets are passed up the stack and queued on sockets without being copied,
+// the buffer goes back to the pool once the last reference is released.
 struct NetworkPacket {
+    uintptr_t physicalAddress; // Physical address of the buffer, for DMA
+    uint8_t* data;             // Buffer, mapped through the direct map
     size_t length;
-    uint8_t data[1518];
 
     Network::NetworkAdapter* adapter;
 
     NetworkPacket* next;
     NetworkPacket* prev;
+
+    int refCount;
+
+    inline void Acquire() { __atomic_add_fetch(&refCount, 1, __ATOMIC_RELAXED); }
+    void Release();
+};
+
+// Work left to the adapter when sending a packet.
+// Offsets are relative to the data given to SendIPv4, which adjusts them for the headers it adds.
+struct NetworkTransmitOffload {
+    enum {
+        NeedsChecksum = 0x1, // Checksum field holds the pseudo-header sum, the adapter finishes the checksum
+        Segment = 0x2,       // Split the TCP payload into segments of segmentSize bytes
+    };
+
+    int flags = 0;
+    uint16_t checksumStart = 0;  // Start of the checksummed data
+    uint16_t checksumOffset = 0; // Offset of the checksum field from checksumStart
+    uint16_t headerLength = 0;   // Headers copied in front of each segment
+    uint16_t segmentSize = 0;    // Payload of each segment
 };
 
 struct IPv4Address {
@@ -272,16 +310,42 @@ int Route(const IPv4Address& local, const IPv4Address& dest, MACAddress& mac, Ne
 
 void InitializeNetworkThread();
 
+void InitializePacketPool();
+
+/////////////////////////////
+/// \brief Allocate a packet buffer
+///
+/// Takes a buffer from the pool if one is available.
+///
+/// \return Packet buffer with a reference count of 1, nullptr if out of memory
+/////////////////////////////
+NetworkPacket* AllocatePacket();
+
+/////////////////////////////
+/// \brief Process a received frame
+///
+/// Called by the network thread from NetworkAdapter::Poll.
+/// Anything holding onto the packet past the call must take its own reference.
+/////////////////////////////
+void OnReceive(NetworkPacket* packet);
+
+/////////////////////////////
+/// \brief Process a received IPv4 packet
+///
+/// \param data IPv4 header within the packet
+/////////////////////////////
+void OnReceiveIPv4(NetworkPacket* packet, void* data, size_t length);
+
 void Send(void* data, size_t length, NetworkAdapter* adapter = nullptr);
 int SendIPv4(void* data, size_t length, IPv4Address& source, IPv4Address& destination, uint8_t protocol,
-             NetworkAdapter* adapter = nullptr);
+             NetworkAdapter* adapter = nullptr, const NetworkTransmitOffload* offload = nullptr);
 
 namespace UDP {
 class UDPSocket;
 
 int SendUDP(void* data, size_t length, IPv4Address& source, IPv4Address& destination, BigEndian<uint16_t> sourcePort,
             BigEndian<uint16_t> destinationPort, NetworkAdapter* adapter = nullptr);
-void OnReceiveUDP(IPv4Header& ipHeader, void* data, size_t length);
+void OnReceiveUDP(NetworkPacket* packet, IPv4Header& ipHeader, void* data, size_t length);
 } // namespace UDP
 
 namespace TCP {
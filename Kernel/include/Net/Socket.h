@@ -20,6 +20,18 @@
 
 #define STREAM_MAX_BUFSIZE 0x20000 // 128 KB
 
+// Datagrams queued on a UDP socket before new ones are dropped, must be a power of two
+#define UDP_RECEIVE_RING_SIZE 256
+
+// Maximum amount of messages in one sendmmsg or recvmmsg call
+#define SOCKET_MAX_MMSG 1024
+
+// Used by sendmmsg and recvmmsg
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len; // Amount of bytes sent or received
+};
+
 struct rtentry {
     unsigned long rt_pad1;
     struct sockaddr rt_dst;
@@ -119,14 +131,16 @@ class Socket : public FsNode {
     virtual ErrorOr<UNIXOpenFile*> Open(size_t flags);
     virtual void Close();
 
-    virtual void Watch(FilesystemWatcher& watcher, int events);
-    virtual void Unwatch(FilesystemWatcher& watcher);
+    virtual void Watch(KernelObjectWatcher& watcher, int events);
+    virtual void Unwatch(KernelObjectWatcher& watcher);
 
     virtual int GetType() const { return type; }
     virtual int GetDomain() const { return domain; }
     virtual int IsListening() const { return passive; }
     virtual int IsBlocking() const { return blocking; }
     virtual int IsConnected() = 0;
+    // Whether poll should report POLLHUP
+    virtual bool HasHungUp() { return !IsConnected() && !IsListening(); }
 
     virtual int PendingConnections() { return pending.get_length(); }
 };
@@ -136,7 +150,7 @@ class LocalSocket final : public Socket {
     lock_t m_slock = 0;
 
     lock_t m_watcherLock = 0;
-    List<FilesystemWatcher*> m_watching;
+    List<KernelObjectWatcher*> m_watching;
     bool m_connected = false; // Connected?
 
     sockaddr_un m_binding;
@@ -172,8 +186,8 @@ class LocalSocket final : public Socket {
     int64_t SendTo(void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
                    const void* ancillary = nullptr, size_t ancillaryLen = 0);
 
-    void Watch(FilesystemWatcher& watcher, int events);
-    void Unwatch(FilesystemWatcher& watcher);
+    void Watch(KernelObjectWatcher& watcher, int events);
+    void Unwatch(KernelObjectWatcher& watcher);
 
     bool CanRead() {
         if (inbound)
@@ -219,8 +233,6 @@ class IPSocket : public Socket {
 
     bool pktInfo = false; // Check for packet info field?
 
-    List<NetworkPacket> pQueue;
-
     virtual unsigned short AllocatePort() = 0;
     virtual int AcquirePort(uint16_t port) = 0;
     virtual int ReleasePort() = 0;
@@ -234,6 +246,9 @@ class UDPSocket final : public IPSocket {
     ~UDPSocket();
 
     int IsConnected() { return false; } // UDP sockets are connection less
+    bool HasHungUp() { return false; }
+
+    bool CanRead() { return m_ringCount > 0; }
 
     Socket* Accept(sockaddr* addr, socklen_t* addrlen, int mode);
     int Bind(const sockaddr* addr, socklen_t addrlen);
@@ -245,24 +260,36 @@ class UDPSocket final : public IPSocket {
     int64_t SendTo(void* buffer, size_t len, int flags, const sockaddr* src, socklen_t addrlen,
                    const void* ancillary = nullptr, size_t ancillaryLen = 0);
 
+    void Watch(KernelObjectWatcher& watcher, int events);
+    void Unwatch(KernelObjectWatcher& watcher);
+
   protected:
-    friend void OnReceiveUDP(IPv4Header& ipHeader, void* data, size_t length);
+    friend void OnReceiveUDP(NetworkPacket* packet, IPv4Header& ipHeader, void* data, size_t length);
 
     struct UDPPacket {
         IPv4Address sourceIP;
         BigEndian<uint16_t> sourcePort;
         size_t length;
-        uint8_t* data;
+        uint8_t* data; // Payload, points into packet
+        NetworkPacket* packet; // We hold a reference to the packet until it has been read
     };
 
+    // Received datagrams are kept in a fixed ring so queueing one never allocates
     lock_t packetsLock = 0;
-    List<UDPPacket> packets;
+    UDPPacket m_receiveRing[UDP_RECEIVE_RING_SIZE];
+    unsigned m_ringHead = 0; // Index of the oldest datagram
+    unsigned m_ringCount = 0;
+    uint64_t m_droppedPackets = 0; // Dropped as the ring was full
+
+    lock_t m_watcherLock = 0;
+    List<KernelObjectWatcher*> m_watching;
 
     unsigned short AllocatePort();
     int AcquirePort(uint16_t port);
     int ReleasePort();
 
-    int64_t OnReceive(IPv4Address& sourceIP, BigEndian<uint16_t> sourcePort, void* buffer, size_t len);
+    int64_t OnReceive(NetworkPacket* packet, IPv4Address& sourceIP, BigEndian<uint16_t> sourcePort, void* buffer,
+                      size_t len);
 };
 } // namespace Network::UDP
 
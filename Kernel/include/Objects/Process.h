@@ -23,6 +23,7 @@ class Process : public KernelObject {
     friend struct Thread;
     friend void KernelProcess();
     friend long SysExecve(RegisterContext* r);
+    friend long SysExitThread(RegisterContext* r);
     friend long SysFutexWait(RegisterContext* r);
     friend long SysFutexWake(RegisterContext* r);
 
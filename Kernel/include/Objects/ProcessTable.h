@@ -0,0 +1,100 @@
+#pragma once
+
+#include <abi-bits/pid_t.h>
+
+#include <atomic>
+#include <stdint.h>
+
+#include <Compiler.h>
+#include <RefPtr.h>
+#include <Spinlock.h>
+
+class Process;
+
+#define PROCESS_TABLE_RADIX_BITS 8
+#define PROCESS_TABLE_FANOUT (1 << PROCESS_TABLE_RADIX_BITS)
+#define PROCESS_TABLE_LEVELS 4 // Enough for any 32-bit PID
+
+/////////////////////////////
+/// \brief Table of processes indexed by PID
+///
+/// A radix tree keyed on the PID. PIDs are never reused, so each slot is
+/// filled and emptied exactly once.
+///
+/// Lookups and iteration take no locks. Entries and empty nodes are only freed
+/// once every reader that may have seen them has left its read-side section (RCU style).
+/// Readers run with interrupts disabled and never block, so writers wait a bounded time.
+/////////////////////////////
+class ProcessTable final {
+public:
+    /////////////////////////////
+    /// \brief Allocate a new PID
+    /////////////////////////////
+    ALWAYS_INLINE pid_t AllocatePID() { return m_nextPID.fetch_add(1); }
+
+    /////////////////////////////
+    /// \brief Add a process to the table, keyed on proc->PID()
+    /////////////////////////////
+    void Insert(FancyRefPtr<Process> proc);
+
+    /////////////////////////////
+    /// \brief Remove the process with PID pid from the table
+    ///
+    /// Waits for concurrent readers before returning.
+    ///
+    /// \return The reference held by the table, nullptr if there is no such process
+    /////////////////////////////
+    FancyRefPtr<Process> Remove(pid_t pid);
+
+    /////////////////////////////
+    /// \brief Find a process by PID
+    ///
+    /// \return Process with PID pid or nullptr
+    /////////////////////////////
+    FancyRefPtr<Process> Find(pid_t pid);
+
+    /////////////////////////////
+    /// \brief Cursor for iterating processes in PID order
+    ///
+    /// \param pid Last PID visited (0 to start), set to the PID of the returned process
+    ///
+    /// \return Process with the lowest PID greater than pid, nullptr once there are no more processes
+    /////////////////////////////
+    FancyRefPtr<Process> Next(pid_t& pid);
+
+    ALWAYS_INLINE unsigned Count() const { return m_count.load(std::memory_order_relaxed); }
+
+private:
+    struct Node {
+        // Child nodes, or FancyRefPtr<Process> entries in leaves
+        std::atomic<void*> slots[PROCESS_TABLE_FANOUT] = {};
+        unsigned live = 0; // Non-null slots, only touched by writers
+    };
+
+    class ReadGuard final {
+    public:
+        ReadGuard(ProcessTable& table);
+        ~ReadGuard();
+
+    private:
+        ProcessTable& m_table;
+        unsigned m_epoch;
+        bool m_irq;
+    };
+
+    void* NextFrom(Node* node, int level, uint32_t base, uint32_t start, pid_t& pid);
+    void Synchronize();
+
+    Node m_root;
+
+    // Serializes writers
+    lock_t m_lock = 0;
+
+    // Readers register against the current epoch, writers bump the epoch
+    // and wait for the readers of the old one to leave
+    std::atomic<unsigned> m_epoch = 0;
+    std::atomic<unsigned> m_readers[2] = {};
+
+    std::atomic<pid_t> m_nextPID = 1;
+    std::atomic<unsigned> m_count = 0;
+};
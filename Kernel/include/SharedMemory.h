@@ -6,24 +6,68 @@
 #include <Scheduler.h>
 
 #define SMEM_FLAGS_PRIVATE 1
+#define SMEM_FLAGS_HUGEPAGES 2 // Back the object with 2MB physically contiguous chunks where possible
+#define SMEM_FLAGS_READONLY 4 // Only the owner may write, other processes get a read only mapping
+
+#define SMEM_MAX_SIZE (1ULL << 30) // Largest size shared memory can be resized to
 
 class SharedVMObject : public PhysicalVMObject {
 public:
-    SharedVMObject(size_t size, int64_t key, pid_t owner, pid_t recipient, bool isPrivate);
+    SharedVMObject(size_t size, int64_t key, pid_t owner, pid_t recipient, bool isPrivate, bool hugePages,
+                   bool readOnly);
+
+    /////////////////////////////
+    /// \brief Allocate (if necessary) and map the page at offset
+    ///
+    /// Pages are allocated on first touch. When backed by hugepages,
+    /// the whole 2MB chunk containing offset is allocated and mapped at once.
+    /////////////////////////////
+    int Hit(uintptr_t base, uintptr_t offset, PageMap* pMap) override;
+    void MapAllocatedBlocks(uintptr_t base, PageMap* pMap) override;
+
+    /////////////////////////////
+    /// \brief Resize the object in place
+    ///
+    /// Pages below the new size are kept, pages above it are freed.
+    /// New pages are allocated lazily. The object must not be mapped anywhere.
+    ///
+    /// \param newSize New size of the object, must be page aligned
+    /////////////////////////////
+    void Resize(size_t newSize);
 
     ALWAYS_INLINE int64_t Key() const { return key; }
     ALWAYS_INLINE pid_t Owner() const { return owner; }
     ALWAYS_INLINE pid_t Recipient() const { return recipient; }
 
     ALWAYS_INLINE bool IsPrivate() const { return isPrivate; }
+    ALWAYS_INLINE bool HasHugePages() const { return hugePages; }
+    ALWAYS_INLINE bool IsReadOnly() const { return readOnly; }
     ALWAYS_INLINE bool CanMunmap() const override { return true; }
+
+    /////////////////////////////
+    /// \brief Whether the object may be mapped writable in pMap
+    ///
+    /// Read only objects are only writable in the address space of the owner,
+    /// so it has to be the current process doing the mapping.
+    /////////////////////////////
+    bool CanWrite(PageMap* pMap) const override;
 private:
+    int HitHugePage(uintptr_t base, uintptr_t offset, PageMap* pMap, uint64_t pageFlags);
+
+    ALWAYS_INLINE uint64_t PageFlags(PageMap* pMap) const {
+        return PAGE_USER | PAGE_PRESENT | (PAGE_WRITABLE * CanWrite(pMap));
+    }
+
     int64_t key; // Key
 
     pid_t owner; // Owner Process
     pid_t recipient; // Recipient Process (if private)
 
+    lock_t blocksLock = 0; // Prevents two processes from allocating the same block
+
     bool isPrivate : 1 = false;
+    bool hugePages : 1 = false;
+    bool readOnly : 1 = false;
 };
 
 namespace Memory{
@@ -33,4 +77,17 @@ namespace Memory{
     int64_t CreateSharedMemory(uint64_t size, uint64_t flags, pid_t owner, pid_t recipient);
     void* MapSharedMemory(int64_t key, Process* proc, uint64_t hint);
     void DestroySharedMemory(int64_t key);
-}
\ No newline at end of file
+
+    /////////////////////////////
+    /// \brief Resize shared memory in place
+    ///
+    /// Only the owner may resize shared memory and it must not be mapped by any other process.
+    /// If mapping points to an existing mapping of the object in proc,
+    /// it is unmapped before the resize and then remapped, mapping is updated with the new address.
+    /// The mapping is remapped even if the resize fails.
+    /// size must be non-zero and at most SMEM_MAX_SIZE.
+    ///
+    /// \return 0 on success, otherwise negative error code
+    /////////////////////////////
+    long ResizeSharedMemory(int64_t key, uint64_t size, Process* proc, uintptr_t* mapping);
+}
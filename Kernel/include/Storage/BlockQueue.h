@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ABI/Storage.h>
+#include <List.h>
+#include <Lock.h>
+#include <Thread.h>
+
+class DiskDevice;
+
+// Scatter-gather entries in one request
+#define BLOCK_REQUEST_MAX_SEGMENTS 16
+// Adjacent requests are merged until the command reaches this size
+#define BLOCK_QUEUE_MAX_MERGE_SIZE (128 * 1024)
+#define BLOCK_QUEUE_MAX_MERGE_REQUESTS 32
+// Time after which a request is dispatched ahead of the elevator order
+#define BLOCK_QUEUE_READ_EXPIRE 50000   // 50ms
+#define BLOCK_QUEUE_WRITE_EXPIRE 500000 // 500ms
+// Read commands dispatched whilst writes are waiting before writes get a turn
+#define BLOCK_QUEUE_WRITES_STARVED 4
+
+struct BlockSegment {
+    void* data;
+    size_t length;
+};
+
+/////////////////////////////
+/// \brief Read or write of a contiguous range of blocks
+///
+/// The data is described by a list of kernel buffers.
+/// Every segment but the last has to be a multiple of the block size.
+///
+/// Once submitted the request belongs to the queue until it completes.
+/// On completion the callback is run from the dispatch thread,
+/// requests without a callback are waited on with Wait().
+/////////////////////////////
+struct BlockRequest {
+    enum Operation {
+        Read = 0,
+        Write = 1,
+    };
+
+    using CompletionCallback = void (*)(BlockRequest* request, void* context);
+
+    BlockRequest(Operation op, uint64_t lba);
+    BlockRequest(Operation op, uint64_t lba, void* buffer, size_t length);
+
+    /////////////////////////////
+    /// \brief Append a buffer to the request
+    ///
+    /// \return false if there are no free segments left
+    /////////////////////////////
+    bool AddSegment(void* data, size_t length);
+
+    /////////////////////////////
+    /// \brief Wait for a request without a callback to complete
+    ///
+    /// Signals do not interrupt the wait, the buffers have to stay around until the disk is done with them.
+    ///
+    /// \return Status of the request
+    /////////////////////////////
+    int Wait();
+
+    Operation op;
+    uint64_t lba;
+    size_t length = 0; // Total length of all segments
+
+    BlockSegment segments[BLOCK_REQUEST_MAX_SEGMENTS];
+    unsigned segmentCount = 0;
+
+    int status = 0; // 0 on success, otherwise a negative error code
+
+    CompletionCallback callback = nullptr;
+    void* context = nullptr;
+
+    // Owned by the queue
+    uint64_t submitTime = 0;
+    uint64_t deadline = 0;
+
+    bool completed = false;
+    GenericThreadBlocker blocker;
+
+    BlockRequest* next = nullptr;
+    BlockRequest* prev = nullptr;
+};
+
+/////////////////////////////
+/// \brief Submission queue and I/O scheduler of a disk
+///
+/// Requests are dispatched to the driver by kernel threads, one for each hardware queue of the disk.
+/// Reads and writes are kept in separate queues, each dispatched in ascending LBA order
+/// until a request waits past its deadline. Reads are preferred over writes
+/// but writes are given a turn after BLOCK_QUEUE_WRITES_STARVED read commands.
+///
+/// Requests for adjacent blocks are merged into a single command to the driver.
+/////////////////////////////
+class BlockQueue {
+public:
+    BlockQueue(DiskDevice* disk);
+
+    /////////////////////////////
+    /// \brief Stop the dispatch threads
+    ///
+    /// Requests already queued are carried out first,
+    /// waits for every dispatch thread to exit.
+    /////////////////////////////
+    ~BlockQueue();
+
+    /////////////////////////////
+    /// \brief Queue a request
+    ///
+    /// \return 0 on success, -EINVAL if the request is malformed
+    /////////////////////////////
+    int Submit(BlockRequest* request);
+
+    void GetStatistics(DiskStatistics& stats);
+
+private:
+    static void DispatchThread(BlockQueue* queue);
+
+    // Pick the next request to go to the disk, m_lock has to be held
+    BlockRequest* NextRequest();
+    // Take requests adjacent to the batch out of the queue, m_lock has to be held
+    unsigned MergeAdjacent(BlockRequest** batch, unsigned count);
+
+    int Transfer(BlockRequest::Operation op, uint64_t lba, size_t length, void* buffer);
+    void Dispatch(BlockRequest** batch, unsigned count, uint8_t* bounceBuffer);
+    void Complete(BlockRequest* request, int status);
+
+    DiskDevice* m_disk;
+
+    lock_t m_lock = 0;
+    FastList<BlockRequest*> m_queued[2]; // Reads and writes in order of submission
+    Semaphore m_pending = Semaphore(0);
+
+    uint64_t m_headLBA = 0; // Where the last command ended
+    unsigned m_readsSinceWrite = 0;
+
+    bool m_stopping = false;
+    unsigned m_threadCount = 0;
+    unsigned m_runningThreads = 0; // Dispatch threads which have not exited yet
+
+    DiskStatistics m_stats;
+};
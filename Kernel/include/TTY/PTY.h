@@ -65,8 +65,8 @@ public:
     ssize_t Write(size_t, size_t, uint8_t *) override;
     int Ioctl(uint64_t cmd, uint64_t arg) override;
 
-    void Watch(FilesystemWatcher& watcher, int events) override;
-    void Unwatch(FilesystemWatcher& watcher) override;
+    void Watch(KernelObjectWatcher& watcher, int events) override;
+    void Unwatch(KernelObjectWatcher& watcher) override;
 
     bool CanRead() override;
 };
@@ -103,15 +103,15 @@ public:
 
     void Close();
 
-    void WatchMaster(FilesystemWatcher& watcher, int events);
-    void WatchSlave(FilesystemWatcher& watcher, int events);
-    void UnwatchMaster(FilesystemWatcher& watcher);
-    void UnwatchSlave(FilesystemWatcher& watcher);
+    void WatchMaster(KernelObjectWatcher& watcher, int events);
+    void WatchSlave(KernelObjectWatcher& watcher, int events);
+    void UnwatchMaster(KernelObjectWatcher& watcher);
+    void UnwatchSlave(KernelObjectWatcher& watcher);
 private:
     int m_id;
 
-    List<FilesystemWatcher*> m_watchingSlave;
-    List<FilesystemWatcher*> m_watchingMaster;
+    List<KernelObjectWatcher*> m_watchingSlave;
+    List<KernelObjectWatcher*> m_watchingMaster;
 };
 
 PTY* GrantPTY(uint64_t pid);
\ No newline at end of file
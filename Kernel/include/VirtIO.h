@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Shared by the VirtIO drivers, which all use the legacy (transitional) PCI interface
+
+#define VIRTIO_VENDOR_ID 0x1AF4
+
+// Legacy interface registers (BAR0)
+#define VIRTIO_REGISTER_DEVICE_FEATURES 0x00
+#define VIRTIO_REGISTER_GUEST_FEATURES 0x04
+#define VIRTIO_REGISTER_QUEUE_ADDRESS 0x08 // Page frame number of the queue
+#define VIRTIO_REGISTER_QUEUE_SIZE 0x0C
+#define VIRTIO_REGISTER_QUEUE_SELECT 0x0E
+#define VIRTIO_REGISTER_QUEUE_NOTIFY 0x10
+#define VIRTIO_REGISTER_DEVICE_STATUS 0x12
+#define VIRTIO_REGISTER_ISR_STATUS 0x13
+#define VIRTIO_REGISTER_CONFIG_VECTOR 0x14 // Only present with MSI-X enabled
+#define VIRTIO_REGISTER_QUEUE_VECTOR 0x16  // Only present with MSI-X enabled
+#define VIRTIO_REGISTER_DEVICE_CONFIG 0x14
+#define VIRTIO_REGISTER_DEVICE_CONFIG_MSIX 0x18
+
+#define VIRTIO_MSI_NO_VECTOR 0xFFFF
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x1
+#define VIRTIO_STATUS_DRIVER 0x2
+#define VIRTIO_STATUS_DRIVER_OK 0x4
+#define VIRTIO_STATUS_FAILED 0x80
+
+#define VIRTIO_ISR_QUEUE 0x1
+#define VIRTIO_ISR_CONFIG 0x2
+
+#define VIRTIO_RING_F_INDIRECT_DESC (1U << 28) // Descriptors may point to a table of descriptors
+
+#define VIRTQ_DESC_F_NEXT 0x1
+#define VIRTQ_DESC_F_WRITE 0x2 // Device writes to the buffer
+#define VIRTQ_DESC_F_INDIRECT 0x4
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 0x1
+#define VIRTQ_USED_F_NO_NOTIFY 0x1
+#define VIRTQ_ALIGN 4096 // Alignment of the used ring with the legacy interface
+
+struct VirtqDescriptor {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+struct VirtqAvailable {
+    uint16_t flags;
+    uint16_t index;
+    uint16_t ring[];
+} __attribute__((packed));
+
+struct VirtqUsedElement {
+    uint32_t id;     // Head of the descriptor chain
+    uint32_t length; // Bytes written by the device
+} __attribute__((packed));
+
+struct VirtqUsed {
+    uint16_t flags;
+    uint16_t index;
+    VirtqUsedElement ring[];
+} __attribute__((packed));
+
+/////////////////////////////
+/// \brief Size of a split virtqueue with the legacy interface
+///
+/// The descriptors and available ring come first, the used ring starts on the next page.
+///
+/// \param usedOffset Set to the offset of the used ring
+/////////////////////////////
+inline static size_t VirtqSize(uint16_t queueSize, size_t& usedOffset) {
+    usedOffset = (sizeof(VirtqDescriptor) * queueSize + sizeof(VirtqAvailable) + sizeof(uint16_t) * (queueSize + 1) +
+                  VIRTQ_ALIGN - 1) &
+                 ~static_cast<size_t>(VIRTQ_ALIGN - 1);
+    return usedOffset + sizeof(VirtqUsed) + sizeof(VirtqUsedElement) * queueSize + sizeof(uint16_t);
+}
@@ -3,6 +3,7 @@
 #include <ACPI.h>
 #include <APIC.h>
 #include <BootProtocols.h>
+#include <BootTrace.h>
 #include <CString.h>
 #include <Device.h>
 #include <IDT.h>
@@ -43,6 +44,9 @@ void InitCore() { // ALWAYS call this first
     asm volatile("cli");
 
     SMP::InitializeCPU0Context();
+
+    // The first phase is the start of the boot trace
+    BootTrace::ScopedPhase phase("Core");
     
     Serial::Initialize();
     Serial::Write("Initializing Lemon...\r\n");
@@ -58,6 +62,8 @@ void InitCore() { // ALWAYS call this first
 }
 
 void InitVideo() {
+    BootTrace::ScopedPhase phase("Video");
+
     Video::Initialize(videoMode);
     Video::DrawString("Starting Lemon x64...", 0, 0, 255, 255, 255);
 
@@ -87,23 +93,38 @@ void InitExtra() {
     Log::Write("OK");
 
     Log::Info("Initializing ACPI...");
-    ACPI::Init();
+    {
+        BootTrace::ScopedPhase phase("ACPI");
+        ACPI::Init();
+    }
     Log::Write("OK");
 
     Log::Info("Initializing PCI...");
-    PCI::Init();
+    {
+        BootTrace::ScopedPhase phase("PCI");
+        PCI::Init();
+    }
     Log::Write("OK");
 
     Log::Info("Initializing System Timer...");
-    Timer::Initialize(1600);
+    {
+        BootTrace::ScopedPhase phase("Timer");
+        Timer::Initialize(1600);
+    }
     Log::Write("OK");
 
     Log::Info("Initializing Local and I/O APIC...");
-    APIC::Initialize();
+    {
+        BootTrace::ScopedPhase phase("APIC");
+        APIC::Initialize();
+    }
     Log::Write("OK");
 
     Log::Info("Initializing SMP...");
-    SMP::Initialize();
+    {
+        BootTrace::ScopedPhase phase("SMP");
+        SMP::Initialize();
+    }
     Log::Write("OK");
 
     Memory::LateInitializeVirtualMemory();
@@ -171,6 +192,7 @@ void InitMultiboot2(uintptr_t _mbInfo) {
                     reinterpret_cast<multiboot2_mmap_entry_t*>((uintptr_t)currentEntry + mbMemMap->entrySize);
             }
             Memory::usedPhysicalBlocks = 0;
+            Memory::usablePhysicalBlocks = mem_info.totalMemory / PAGE_SIZE_4K;
             break;
         }
         case Mboot2FramebufferInfo: {
@@ -312,6 +334,7 @@ void InitStivale2(uintptr_t st2Info) {
             }
 
             Memory::usedPhysicalBlocks = 0;
+            Memory::usablePhysicalBlocks = mem_info.totalMemory / PAGE_SIZE_4K;
             break;
         }
         case Stivale2TagFramebufferInfo: {
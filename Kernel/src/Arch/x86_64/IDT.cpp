@@ -187,8 +187,10 @@ uint8_t ReserveUnusedInterrupt() {
     uint8_t interrupt = 0xFF;
     for (unsigned i = IRQ0 + 16 /* Ignore all legacy IRQs and exceptions */;
          i < 100 /* Ignore >100 */ && interrupt == 0xFF; i++) {
-        if (!interruptHandlers[i].handler) {
-            interruptHandlers[i].handler = InvalidInterruptHandler;
+        // Drivers can be probing on several CPUs at once
+        isr_t expected = nullptr;
+        if (__atomic_compare_exchange_n(&interruptHandlers[i].handler, &expected, &InvalidInterruptHandler, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
             interrupt = i;
         }
     }
@@ -217,6 +219,7 @@ extern "C" void isr_handler(int intNum, RegisterContext* regs) {
         // Kernel Panic so tell other processors to stop executing
         APIC::Local::SendIPI(0, ICR_DSH_OTHER /* Send to all other processors except us */, ICR_MESSAGE_TYPE_FIXED,
                              IPI_HALT);
+        Log::DisableBuffer(); // The log thread will not run again
 
         IF_DEBUG(debugLevelSyscalls >= DebugLevelVerbose, { DumpLastSyscall(Thread::Current()); });
         Log::Error("Fatal Kernel Exception: ");
@@ -379,12 +379,16 @@ ModuleLoadStatus LoadModule(const char* path) {
 
     if (len < sizeof(elf64_header_t) || !VerifyELF(&header)) { // Verify ELF header
         Log::Info("Module '%s' is not in ELF format!", path);
+
+        delete handle.Value();
         return {.status = ModuleLoadStatus::ModuleInvalid, .code = 0};
     }
 
     Module* module = new Module();
 
     if (int err = LoadModuleSegments(module, node, header); err) {
+        delete module;
+        delete handle.Value();
         return {.status = ModuleLoadStatus::ModuleFailure, .code = err};
     }
 
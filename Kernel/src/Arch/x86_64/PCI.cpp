@@ -6,6 +6,7 @@
 #include <IDT.h>
 #include <IOPorts.h>
 #include <Logging.h>
+#include <Paging.h>
 #include <Vector.h>
 
 namespace PCI {
@@ -15,10 +16,14 @@ PCIInfo* unknownDevice = nullptr;
 PCIMCFG* mcfgTable = nullptr;
 PCIConfigurationAccessMode configMode = PCIConfigurationAccessMode::Legacy;
 Vector<PCIMCFGBaseAddress>* enhancedBaseAddresses = nullptr; // Base addresses for enhanced (PCI Express) configuration mechanism
+// The address and data ports are shared, drivers may be probing devices on several CPUs
+lock_t configLock = 0;
 
 uint32_t ConfigReadDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xfc) | 0x80000000);
 
+    ScopedSpinLock<true> lockConfig(configLock);
+
     outportl(0xCF8, address);
 
     uint32_t data = inportl(0xCFC);
@@ -29,6 +34,8 @@ uint32_t ConfigReadDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset
 uint16_t ConfigReadWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xfc) | 0x80000000);
 
+    ScopedSpinLock<true> lockConfig(configLock);
+
     outportl(0xCF8, address);
 
     uint16_t data = (uint16_t)((inportl(0xCFC) >> ((offset & 2) * 8)) & 0xffff);
@@ -39,6 +46,8 @@ uint16_t ConfigReadWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
 uint8_t ConfigReadByte(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xfc) | 0x80000000);
 
+    ScopedSpinLock<true> lockConfig(configLock);
+
     outportl(0xCF8, address);
 
     uint8_t data;
@@ -47,9 +56,11 @@ uint8_t ConfigReadByte(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
     return data;
 }
 
-void ConfigWriteDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t data) {
+void ConfigWriteDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t data) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xfc) | 0x80000000);
 
+    ScopedSpinLock<true> lockConfig(configLock);
+
     outportl(0xCF8, address);
     outportl(0xCFC, data);
 }
@@ -57,6 +68,8 @@ void ConfigWriteDword(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, u
 void ConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint16_t data) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xfc) | 0x80000000);
 
+    ScopedSpinLock<true> lockConfig(configLock);
+
     outportl(0xCF8, address);
     outportl(0xCFC, (inportl(0xCFC) & (~(0xFFFF << ((offset & 2) * 8)))) |
                         (static_cast<uint32_t>(data) << ((offset & 2) * 8)));
@@ -65,6 +78,8 @@ void ConfigWriteWord(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, ui
 void ConfigWriteByte(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint8_t data) {
     uint32_t address = (uint32_t)((bus << 16) | (slot << 11) | (func << 8) | (offset & 0xfc) | 0x80000000);
 
+    ScopedSpinLock<true> lockConfig(configLock);
+
     outportl(0xCF8, address);
     outportb(0xCFC,
              (inportl(0xCFC) & (~(0xFF << ((offset & 3) * 8)))) | (static_cast<uint32_t>(data) << ((offset & 3) * 8)));
@@ -245,8 +260,10 @@ PCIDevice::PCIDevice(uint8_t _bus, uint8_t _slot, uint8_t _func) : bus(_bus), sl
     capabilities = new Vector<uint16_t>();
     if (Status() & PCI_STATUS_CAPABILITIES) {
         uint8_t ptr = PCI::ConfigReadWord(bus, slot, func, PCICapabilitiesPointer) & 0xFC;
-        uint16_t cap = PCI::ConfigReadDword(bus, slot, func, ptr);
-        do {
+        while (ptr) {
+            uint32_t cap = PCI::ConfigReadDword(bus, slot, func, ptr);
+            capabilities->add_back(cap & 0xFF);
+
             if ((cap & 0xFF) == PCICapabilityIDs::PCICapMSI) {
                 msiPtr = ptr;
                 msiCapable = true;
@@ -259,14 +276,63 @@ PCIDevice::PCIDevice(uint8_t _bus, uint8_t _slot, uint8_t _func) : bus(_bus), sl
                 }
 
                 msiCap.register4 = PCI::ConfigReadDword(bus, slot, func, ptr + sizeof(uint32_t) * 3);
+            } else if ((cap & 0xFF) == PCICapabilityIDs::PCICapMSIX) {
+                msixPtr = ptr;
+                msixControl = cap >> 16;
+
+                uint32_t table = PCI::ConfigReadDword(bus, slot, func, ptr + sizeof(uint32_t));
+                uint8_t bir = PCI_CAP_MSIX_BIR(table);
+                if (bir <= 5 && !BarIsIOPort(bir)) {
+                    uintptr_t tableAddress = GetBaseAddressRegister(bir) + PCI_CAP_MSIX_OFFSET(table);
+                    if (tableAddress <= 0xFFFFFFFF) { // Only MMIO below 4GB is mapped
+                        msixTable = reinterpret_cast<PCIMSIXTableEntry*>(Memory::GetIOMapping(tableAddress));
+                        msixCapable = true;
+                    }
+                }
             }
 
-            ptr = (cap >> 8);
-            cap = PCI::ConfigReadDword(bus, slot, func, ptr);
+            ptr = (cap >> 8) & 0xFC;
+        }
+    }
+}
 
-            capabilities->add_back(cap & 0xFF);
-        } while ((cap >> 8));
+bool PCIDevice::HasCapability(uint16_t capability) {
+    for (uint16_t cap : *capabilities) {
+        if (cap == capability) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint8_t PCIDevice::AllocateMSIXVector(unsigned entry, uint8_t cpu) {
+    if (!msixCapable) {
+        Log::Error("[PCIDevice] AllocateMSIXVector: Device not MSI-X capable!");
+        return 0xFF;
+    } else if (entry >= MSIXVectorCount()) {
+        Log::Error("[PCIDevice] AllocateMSIXVector: Entry %u out of range (%u entries)!", entry, MSIXVectorCount());
+        return 0xFF;
     }
+
+    uint8_t interrupt = IDT::ReserveUnusedInterrupt();
+    if (interrupt == 0xFF) {
+        Log::Error("[PCIDevice] AllocateMSIXVector: Could not reserve unused interrupt (no free interrupts?)!");
+        return interrupt;
+    }
+
+    volatile PCIMSIXTableEntry* tableEntry = &msixTable[entry];
+    tableEntry->addressLow = PCI_CAP_MSI_ADDRESS_BASE | (static_cast<uint32_t>(cpu) << 12);
+    tableEntry->addressHigh = 0;
+    tableEntry->data = ICR_VECTOR(interrupt) | ICR_MESSAGE_TYPE_FIXED;
+    tableEntry->vectorControl = tableEntry->vectorControl & ~PCI_MSIX_VECTOR_CONTROL_MASKED;
+
+    if (!(msixControl & PCI_CAP_MSIX_CONTROL_ENABLE)) {
+        msixControl = (msixControl | PCI_CAP_MSIX_CONTROL_ENABLE) & ~PCI_CAP_MSIX_CONTROL_FUNCTION_MASK;
+        PCI::ConfigWriteWord(bus, slot, func, msixPtr + sizeof(uint16_t), msixControl);
+    }
+
+    return interrupt;
 }
 
 uint8_t PCIDevice::AllocateVector(PCIVectors type) {
@@ -8,6 +8,7 @@
 #include <Fs/Filesystem.h>
 #include <IDT.h>
 #include <IOPorts.h>
+#include <Input.h>
 #include <Logging.h>
 #include <stddef.h>
 
@@ -147,6 +148,8 @@ void KBHandler(void*, RegisterContext* r) {
     keyIsExtended = false;
     keyWasReleased = false;
 
+    Input::PostKey(keyCode);
+
     if (keyCount >= KEY_QUEUE_SIZE)
         return; // Drop key
 
@@ -206,15 +209,10 @@ void MouseHandler(void*, RegisterContext* regs) {
         }
         mouseCycle = 0;
 
-        if (packetCount >= PACKET_QUEUE_SIZE)
-            break; // Drop packet
-
-        MousePacket pkt;
-        pkt.buttons = mouseData[0] & (MOUSE_BUTTON_LEFT | MOUSE_BUTTON_MIDDLE | MOUSE_BUTTON_RIGHT);
-
         // Set sign bit accoridng to mouse packet
+        // Both sign bits live in the status byte (mouseData[0])
         int x = mouseData[1] - ((mouseData[0] & MOUSE_X_SIGN) << 4);
-        int y = mouseData[2] - ((mouseData[1] & MOUSE_Y_SIGN) << 3);
+        int y = mouseData[2] - ((mouseData[0] & MOUSE_Y_SIGN) << 3);
 
         if (mouseData[0] & (MOUSE_X_OVERFLOW | MOUSE_Y_OVERFLOW)) {
             // If either overflow bit is set, discard movement
@@ -222,6 +220,15 @@ void MouseHandler(void*, RegisterContext* regs) {
             y = 0;
         }
 
+        uint8_t buttons = mouseData[0] & ((1 << MOUSE_BUTTON_LEFT) | (1 << MOUSE_BUTTON_RIGHT) | (1 << MOUSE_BUTTON_MIDDLE));
+        Input::PostMouse(buttons, x, -y, mouseData[3]);
+
+        if (packetCount >= PACKET_QUEUE_SIZE)
+            break; // Drop packet
+
+        MousePacket pkt;
+        pkt.buttons = mouseData[0] & (MOUSE_BUTTON_LEFT | MOUSE_BUTTON_MIDDLE | MOUSE_BUTTON_RIGHT);
+
         pkt.xMovement = x;
         pkt.yMovement = -y;
         pkt.verticalScroll = mouseData[3];
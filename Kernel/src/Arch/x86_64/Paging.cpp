@@ -27,6 +27,8 @@ page_dir_t kernelDir __attribute__((aligned(4096)));
 page_dir_t kernelHeapDir __attribute__((aligned(4096)));
 page_t kernelHeapDirTables[TABLES_PER_DIR][PAGES_PER_TABLE] __attribute__((aligned(4096)));
 page_dir_t ioDirs[4] __attribute__((aligned(4096)));
+pdpt_t directMapPDPT __attribute__((aligned(4096)));
+page_dir_t directMapDirs[DIRECT_MAP_SIZE_GB] __attribute__((aligned(4096)));
 
 lock_t kernelHeapDirLock = 0;
 
@@ -133,6 +135,18 @@ void InitializeVirtualMemory() {
     kernelPDPT[0] =
         kernelPDPT[PDPT_GET_INDEX(KERNEL_VIRTUAL_BASE)]; // Its important that we identity map low memory for SMP
 
+    // Map physical memory using 2MB pages,
+    // the PML4 entry gets copied into every new page map so this is visible from all address spaces
+    memset(directMapPDPT, 0, sizeof(pdpt_t));
+    for (int i = 0; i < DIRECT_MAP_SIZE_GB; i++) {
+        directMapPDPT[i] = ((uint64_t)directMapDirs[i] - KERNEL_VIRTUAL_BASE) | (PDPT_WRITABLE | PDPT_PRESENT);
+        for (int j = 0; j < TABLES_PER_DIR; j++) {
+            directMapDirs[i][j] = (PAGE_SIZE_1G * i + PAGE_SIZE_2M * j) | (PDE_2M | PDE_WRITABLE | PDE_PRESENT);
+        }
+    }
+    kernelPML4[PML4_GET_INDEX(DIRECT_MAP_VIRTUAL_BASE)] =
+        ((uint64_t)directMapPDPT - KERNEL_VIRTUAL_BASE) | (PML4_WRITABLE | PML4_PRESENT);
+
     for (int i = 0; i < TABLES_PER_DIR; i++) {
         memset(&(kernelHeapDirTables[i]), 0, sizeof(page_t) * PAGES_PER_TABLE);
     }
@@ -444,7 +458,7 @@ void* KernelAllocate4KPages(uint64_t amount) {
     for (int i = 0; i < TABLES_PER_DIR; i++) {
         if (kernelHeapDir[i] & 0x1 && !(kernelHeapDir[i] & 0x80)) {
             for (int j = 0; j < TABLES_PER_DIR; j++) {
-                if (kernelHeapDirTables[i][j] & 0x1) {
+                if (kernelHeapDirTables[i][j] & (PAGE_PRESENT | PAGE_KERNEL_GUARD)) {
                     pageDirOffset = i;
                     offset = j + 1;
                     counter = 0;
@@ -651,7 +665,6 @@ void PageFaultHandler(void*, RegisterContext* regs) {
 
     // We only want to dump fault information when it is fatal
     auto dumpFaultInformation = [&]() -> void {
-        Log::DisableBuffer();
         Log::SetVideoConsole(nullptr);
 
         Log::Info("Page Fault");
@@ -751,10 +764,15 @@ void PageFaultHandler(void*, RegisterContext* regs) {
                 }
             }
 
-            asm("sti");
-            int status = faultRegion->vmObject->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
+            int status = 1;
+            if (rw && !present && !vmo->CanWrite(addressSpace->GetPageMap())) {
+                faultRegion->lock.ReleaseRead(); // Write to a read only mapping, remapping will not help
+            } else {
+                asm("sti");
+                status = faultRegion->vmObject->Hit(faultRegion->Base(), faultAddress - faultRegion->Base(),
                                                     addressSpace->GetPageMap());
-            faultRegion->lock.ReleaseRead();
+                faultRegion->lock.ReleaseRead();
+            }
 
             if (!status) {
                 if ((regs->cs & 0x3)) {
@@ -788,6 +806,7 @@ void PageFaultHandler(void*, RegisterContext* regs) {
     }
 
     asm("cli");
+    Log::DisableBuffer(); // The log thread will not run again
     dumpFaultInformation();
 
     // Kernel Panic so tell other processors to stop executing
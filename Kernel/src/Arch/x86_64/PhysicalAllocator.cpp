@@ -4,6 +4,7 @@
 #include <CString.h>
 #include <Lock.h>
 #include <Logging.h>
+#include <MM/Shrinker.h>
 #include <Paging.h>
 #include <Panic.h>
 #include <Serial.h>
@@ -13,6 +14,7 @@ uint32_t physicalMemoryBitmap[PHYSALLOC_BITMAP_SIZE_DWORDS];
 
 uint64_t usedPhysicalBlocks = PHYSALLOC_BITMAP_SIZE_DWORDS * 32;
 uint64_t maxPhysicalBlocks = 0;
+uint64_t usablePhysicalBlocks = 0;
 
 uint64_t nextChunk = 1;
 
@@ -103,50 +105,74 @@ void MarkMemoryRegionFree(uint64_t base, size_t size) {
 
 // Allocates a block of physical memory
 uint64_t AllocatePhysicalMemoryBlock() {
-    ScopedSpinLock<true> lock(allocatorLock);
-
-    uint64_t index = GetFirstFreeMemoryBlock();
-    if (!index) {
-        asm("cli");
-        Log::Error("Out of memory!");
-        KernelPanic("Out of memory!");
-        for (;;)
-            ;
-    }
+    bool waitedForReclaim = false;
+    for (int attempt = 0;; attempt++) {
+        {
+            ScopedSpinLock<true> lock(allocatorLock);
 
-    SetBit(index);
-    usedPhysicalBlocks++;
+            uint64_t index = GetFirstFreeMemoryBlock();
+            if (index) {
+                SetBit(index);
+                usedPhysicalBlocks++;
 
-    return index << PHYSALLOC_BLOCK_SHIFT;
-}
+                return index << PHYSALLOC_BLOCK_SHIFT;
+            }
+        }
 
-// Allocates a block of 2MB physical memory
-/*uint64_t AllocateLargePhysicalMemoryBlock() {
-    uint64_t index = GetFirstFreeMemoryBlock();
-    uint64_t blockCount = 0x200000
-    uint64_t counter = 0;
-    while(counter < blockCount){
-        if(bit_test(index)){
-            index++;
-            counter = 0;
+        // Give caches which can free pages from here a chance,
+        // then let the reclaim thread shrink the rest before giving up
+        if (!attempt && ReclaimMemory(RECLAIM_BATCH_PAGES, true)) {
             continue;
         }
 
-        index++;
-        counter++;
+        if (!waitedForReclaim) {
+            waitedForReclaim = true;
+            if (WaitForReclaim()) {
+                continue;
+            }
+        }
+
+        break;
     }
 
-    if (index == 0)
-        return 0;
+    asm("cli");
+    Log::Error("Out of memory!");
+    KernelPanic("Out of memory!");
+    for (;;)
+        ;
+}
 
-    uint64_t addr = index * PHYSALLOC_BLOCK_SIZE;
+// Allocates a 2MB aligned, physically contiguous block of memory
+// Returns 0 if there is no free 2MB block
+uint64_t AllocateLargePhysicalMemoryBlock() {
+    ScopedSpinLock<true> lock(allocatorLock);
 
-    while(blockCount--)
-        bit_set(index++);
-    usedPhysicalBlocks += counter;
+    const uint64_t dwordsPerBlock = (PAGE_SIZE_2M / PHYSALLOC_BLOCK_SIZE) >> 5;
 
-    return addr;
-}*/
+    // Skip the first 2MB, the first block is always reserved
+    for (uint64_t i = dwordsPerBlock; i + dwordsPerBlock <= (maxPhysicalBlocks >> 5); i += dwordsPerBlock) {
+        bool isFree = true;
+        for (uint64_t j = 0; j < dwordsPerBlock; j++) {
+            if (physicalMemoryBitmap[i + j]) {
+                isFree = false;
+                break;
+            }
+        }
+
+        if (!isFree) {
+            continue;
+        }
+
+        for (uint64_t j = 0; j < dwordsPerBlock; j++) {
+            physicalMemoryBitmap[i + j] = 0xFFFFFFFF;
+        }
+        usedPhysicalBlocks += dwordsPerBlock * 32;
+
+        return (i << 5) << PHYSALLOC_BLOCK_SHIFT;
+    }
+
+    return 0;
+}
 
 // Frees a block of physical memory
 void FreePhysicalMemoryBlock(uint64_t addr) {
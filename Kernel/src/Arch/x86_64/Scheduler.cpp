@@ -1,7 +1,5 @@
 #include <Scheduler.h>
 
-#include <atomic>
-
 #include <ABI.h>
 #include <APIC.h>
 #include <CPU.h>
@@ -13,6 +11,7 @@
 #include <Lock.h>
 #include <Logging.h>
 #include <MM/KMalloc.h>
+#include <Objects/ProcessTable.h>
 #include <Paging.h>
 #include <Panic.h>
 #include <PhysicalAllocator.h>
@@ -30,14 +29,14 @@ namespace Scheduler {
 int schedulerLock = 0;
 bool schedulerReady = false;
 
-lock_t processesLock = 0;
-List<FancyRefPtr<Process>>* processes;
+lock_t runQueueBalanceLock = 0;
+ProcessTable processes;
 
 lock_t destroyedProcessesLock = 0;
 List<FancyRefPtr<Process>>* destroyedProcesses;
 
-unsigned processTableSize = 512;
-std::atomic<pid_t> nextPID = 1;
+lock_t destroyedThreadsLock = 0;
+List<FancyRefPtr<Thread>>* destroyedThreads;
 
 // When the run queue was last balanced
 uint64_t nextBalanceDue = 0;
@@ -68,8 +67,8 @@ void InsertNewThreadIntoQueue(Thread* thread) {
 }
 
 void Initialize() {
-    processes = new List<FancyRefPtr<Process>>();
     destroyedProcesses = new List<FancyRefPtr<Process>>();
+    destroyedThreads = new List<FancyRefPtr<Thread>>();
 
     CPU* cpu = GetCPULocal();
 
@@ -95,47 +94,34 @@ void Initialize() {
     assert(!"Failed to initiailze scheduler!");
 }
 
-void RegisterProcess(FancyRefPtr<Process> proc) {
-    ScopedSpinLock acq(processesLock);
-    processes->add_back(std::move(proc));
-}
+void RegisterProcess(FancyRefPtr<Process> proc) { processes.Insert(std::move(proc)); }
 
 void MarkProcessForDestruction(Process* proc) {
-    ScopedSpinLock lockProcesses(processesLock);
+    FancyRefPtr<Process> removed = processes.Remove(proc->PID());
+    assert(removed.get() == proc);
+
     ScopedSpinLock lockDestroyedProcesses(destroyedProcessesLock);
+    destroyedProcesses->add_back(std::move(removed));
+}
 
-    for (auto it = processes->begin(); it != processes->end(); it++) {
-        if (it->get() == proc) {
-            destroyedProcesses->add_back(*it);
-            processes->remove(it);
-            return;
-        }
-    }
+void MarkThreadForDestruction(FancyRefPtr<Thread> thread) {
+    ScopedSpinLock<true> lockDestroyedThreads(destroyedThreadsLock);
 
-    assert(!"Failed to mark process for destruction!");
+    destroyedThreads->add_back(std::move(thread));
 }
 
-pid_t GetNextPID() { return nextPID++; }
+pid_t GetNextPID() { return processes.AllocatePID(); }
 
-FancyRefPtr<Process> FindProcessByPID(pid_t pid) {
-    ScopedSpinLock lockProcesses(processesLock);
-    for (auto& proc : *processes) {
-        if (proc->PID() == pid)
-            return proc;
-    }
+FancyRefPtr<Process> FindProcessByPID(pid_t pid) { return processes.Find(pid); }
 
-    return nullptr;
-}
+FancyRefPtr<Process> GetNextProcess(pid_t& pid) { return processes.Next(pid); }
 
 pid_t GetNextProcessPID(pid_t pid) {
-    ScopedSpinLock lockProcesses(processesLock);
-    for (auto it = processes->begin(); it != processes->end(); it++) {
-        if (it->get()->PID() > pid) { // Found process with PID greater than pid
-            return it->get()->PID();
-        }
+    if (!processes.Next(pid).get()) {
+        return 0; // Could not find process, return as if end of list
     }
 
-    return 0; // Could not find process, return as if end of list
+    return pid;
 }
 
 void Yield() {
@@ -158,7 +144,7 @@ void Tick(RegisterContext* r) {
 }
 
 void BalanceRunQueues() {
-    assert(processesLock);
+    assert(runQueueBalanceLock);
     assert(!CheckInterrupts());
 
     if(Timer::UsecondsSinceBoot() - nextBalanceDue > 1000000) {
@@ -290,11 +276,11 @@ void Schedule(__attribute__((unused)) void* data, RegisterContext* r) {
     }
 
     if (SMP::processorCount > 1 && Timer::UsecondsSinceBoot() > nextBalanceDue) {
-        if(!__builtin_expect(acquireTestLock(&processesLock), 0)) {
+        if(!__builtin_expect(acquireTestLock(&runQueueBalanceLock), 0)) {
             if (Timer::UsecondsSinceBoot() > nextBalanceDue) {
                 BalanceRunQueues();
             }
-            releaseLock(&processesLock);
+            releaseLock(&runQueueBalanceLock);
         }
     }
 
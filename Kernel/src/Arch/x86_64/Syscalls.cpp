@@ -10,6 +10,7 @@
 #include <Lemon.h>
 #include <Lock.h>
 #include <Logging.h>
+#include <MM/Shrinker.h>
 #include <Math.h>
 #include <Modules.h>
 #include <Net/Socket.h>
@@ -67,6 +68,10 @@ long SysEPollCtl(RegisterContext* r);
 long SysEpollWait(RegisterContext* r);
 long SysPipe(RegisterContext* r);
 long SysFChdir(RegisterContext* r);
+long SysResizeSharedMemory(RegisterContext* r);
+long SysSendMMsg(RegisterContext* r);
+long SysRecvMMsg(RegisterContext* r);
+long SysReadDirPlus(RegisterContext* r);
 
 long SysExit(RegisterContext* r) {
     int code = SC_ARG0(r);
@@ -319,7 +324,7 @@ long SysExecve(RegisterContext* r) {
 
     r->rbp = r->rsp;
     r->rflags = 0x202; // IF - Interrupt Flag, bit 1 should be 1
-    memset(currentThread->fxState, 0, 4096);
+    memset(currentThread->fxState, 0, FX_STATE_SIZE);
 
     ((fx_state_t*)currentThread->fxState)->mxcsr = 0x1f80; // Default MXCSR (SSE Control Word) State
     ((fx_state_t*)currentThread->fxState)->mxcsrMask = 0xffbf;
@@ -589,6 +594,7 @@ long SysInfo(RegisterContext* r) {
     s->usedMem = Memory::usedPhysicalBlocks * 4;
     s->totalMem = HAL::mem_info.totalMemory / 1024;
     s->cpuCount = static_cast<uint16_t>(SMP::processorCount);
+    s->cacheCount = static_cast<uint16_t>(Memory::GetShrinkerInfo(s->caches, LEMON_SYSINFO_MAX_CACHES));
 
     return 0;
 }
@@ -704,6 +710,39 @@ long SysDestroySharedMemory(RegisterContext* r) {
     return 0;
 }
 
+/*
+ * SysResizeSharedMemory (ptr, key, size) - Resize Shared Memory
+ * ptr - Pointer to pointer of the existing mapping (can point to NULL),
+ *       updated with the new mapping
+ * key - Memory key
+ * size - New size of the memory, at most SMEM_MAX_SIZE
+ *
+ * The memory is resized in place, it must not be mapped by any other process
+ *
+ * On Success - return 0
+ * On Failure - return -EINVAL, -EPERM or -EBUSY
+ */
+long SysResizeSharedMemory(RegisterContext* r) {
+    Process* proc = Scheduler::GetCurrentProcess();
+
+    void** ptr = (void**)SC_ARG0(r);
+    int64_t key = SC_ARG1(r);
+    uint64_t size = SC_ARG2(r);
+
+    if (!Memory::CheckUsermodePointer(SC_ARG0(r), sizeof(void*), proc->addressSpace)) {
+        return -EFAULT;
+    }
+
+    uintptr_t mapping = reinterpret_cast<uintptr_t>(*ptr);
+    long ret = Memory::ResizeSharedMemory(key, size, proc, &mapping);
+    if (ret) {
+        return ret;
+    }
+
+    *ptr = reinterpret_cast<void*>(mapping);
+    return 0;
+}
+
 /*
  * SysSocket (domain, type, protocol) - Create socket
  * domain - socket domain
@@ -902,41 +941,8 @@ long SysSetUID(RegisterContext* r) {
     return 0;
 }
 
-/*
- * SysSend (sockfd, msg, flags) - Send data through a socket
- * sockfd - Socket file descriptor
- * msg - Message Header
- * flags - flags
- *
- * On Success - return amount of data sent
- * On Failure - return -1
- */
-long SysSendMsg(RegisterContext* r) {
-    Process* proc = Scheduler::GetCurrentProcess();
-
-    FancyRefPtr<UNIXOpenFile> handle = SC_TRY_OR_ERROR(proc->GetHandleAs<UNIXOpenFile>(SC_ARG0(r)));
-    if (!handle) {
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
-                 { Log::Warning("SysSendMsg: Invalid File Descriptor: %d", SC_ARG0(r)); });
-        return -EBADF;
-    }
-
-    msghdr* msg = (msghdr*)SC_ARG1(r);
-    uint64_t flags = SC_ARG3(r);
-
-    if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_SOCKET) {
-
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
-                 { Log::Warning("SysSendMsg: File (Descriptor: %d) is not a socket", SC_ARG0(r)); });
-        return -ENOTSOCK;
-    }
-
-    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(msghdr), proc->addressSpace)) {
-
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMsg: Invalid msg ptr"); });
-        return -EFAULT;
-    }
-
+// Send a message through a socket, msg must already have been checked
+static long SendMessage(Process* proc, Socket* sock, msghdr* msg, uint64_t flags) {
     if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov, sizeof(iovec) * msg->msg_iovlen, proc->addressSpace)) {
 
         IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMsg: msg: Invalid iovec ptr"); });
@@ -958,8 +964,6 @@ long SysSendMsg(RegisterContext* r) {
     }
 
     long sent = 0;
-    Socket* sock = (Socket*)handle->node;
-
     for (unsigned i = 0; i < msg->msg_iovlen; i++) {
         if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len,
                                           proc->addressSpace)) {
@@ -979,6 +983,89 @@ long SysSendMsg(RegisterContext* r) {
     return sent;
 }
 
+// Receive a message from a socket, msg must already have been checked
+static long ReceiveMessage(Process* proc, Socket* sock, msghdr* msg, uint64_t flags) {
+    if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov, sizeof(iovec) * msg->msg_iovlen, proc->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMsg: msg: Invalid iovec ptr"); });
+        return -EFAULT;
+    }
+
+    if (msg->msg_name && msg->msg_namelen &&
+        !Memory::CheckUsermodePointer((uintptr_t)msg->msg_name, msg->msg_namelen, proc->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
+                 { Log::Warning("SysRecvMsg: msg: Invalid name ptr and name not null"); });
+        return -EFAULT;
+    }
+
+    if (msg->msg_control && msg->msg_controllen &&
+        !Memory::CheckUsermodePointer((uintptr_t)msg->msg_control, msg->msg_controllen, proc->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
+                 { Log::Warning("SysRecvMsg: msg: Invalid control ptr and control null"); });
+        return -EFAULT;
+    }
+
+    long read = 0;
+    for (unsigned i = 0; i < msg->msg_iovlen; i++) {
+        if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len,
+                                          proc->addressSpace)) {
+            Log::Warning("SysRecvMsg: msg: Invalid iovec entry base");
+            return -EFAULT;
+        }
+
+        socklen_t len = msg->msg_namelen;
+        long ret =
+            sock->ReceiveFrom(msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len, flags,
+                              reinterpret_cast<sockaddr*>(msg->msg_name), &len, msg->msg_control, msg->msg_controllen);
+        msg->msg_namelen = len;
+
+        if (ret < 0) {
+            return ret;
+        }
+
+        read += ret;
+    }
+
+    return read;
+}
+
+/*
+ * SysSend (sockfd, msg, flags) - Send data through a socket
+ * sockfd - Socket file descriptor
+ * msg - Message Header
+ * flags - flags
+ *
+ * On Success - return amount of data sent
+ * On Failure - return -1
+ */
+long SysSendMsg(RegisterContext* r) {
+    Process* proc = Scheduler::GetCurrentProcess();
+
+    FancyRefPtr<UNIXOpenFile> handle = SC_TRY_OR_ERROR(proc->GetHandleAs<UNIXOpenFile>(SC_ARG0(r)));
+    if (!handle) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
+                 { Log::Warning("SysSendMsg: Invalid File Descriptor: %d", SC_ARG0(r)); });
+        return -EBADF;
+    }
+
+    msghdr* msg = (msghdr*)SC_ARG1(r);
+    uint64_t flags = SC_ARG3(r);
+
+    if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_SOCKET) {
+
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
+                 { Log::Warning("SysSendMsg: File (Descriptor: %d) is not a socket", SC_ARG0(r)); });
+        return -ENOTSOCK;
+    }
+
+    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(msghdr), proc->addressSpace)) {
+
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMsg: Invalid msg ptr"); });
+        return -EFAULT;
+    }
+
+    return SendMessage(proc, (Socket*)handle->node, msg, flags);
+}
+
 /*
  * SysRecvMsg (sockfd, msg, flags) - Recieve data through socket
  * sockfd - Socket file descriptor
@@ -1016,42 +1103,110 @@ long SysRecvMsg(RegisterContext* r) {
         return -EFAULT;
     }
 
-    if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov, sizeof(iovec) * msg->msg_iovlen, proc->addressSpace)) {
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMsg: msg: Invalid iovec ptr"); });
-        return -EFAULT;
+    return ReceiveMessage(proc, (Socket*)handle->node, msg, flags);
+}
+
+/*
+ * SysSendMMsg (sockfd, msgvec, vlen, flags) - Send multiple messages through a socket
+ * sockfd - Socket file descriptor
+ * msgvec - Array of mmsghdr, msg_len is set to the amount of data sent for each message
+ * vlen - Amount of messages (at most SOCKET_MAX_MMSG)
+ * flags - flags
+ *
+ * On Success - return amount of messages sent
+ * On Failure - return negative error code if no messages could be sent
+ */
+long SysSendMMsg(RegisterContext* r) {
+    Process* proc = Scheduler::GetCurrentProcess();
+
+    FancyRefPtr<UNIXOpenFile> handle = SC_TRY_OR_ERROR(proc->GetHandleAs<UNIXOpenFile>(SC_ARG0(r)));
+    if (!handle) {
+        return -EBADF;
     }
 
-    if (msg->msg_control && msg->msg_controllen &&
-        !Memory::CheckUsermodePointer((uintptr_t)msg->msg_control, msg->msg_controllen, proc->addressSpace)) {
-        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal,
-                 { Log::Warning("SysRecvMsg: msg: Invalid control ptr and control null"); });
+    mmsghdr* msgvec = (mmsghdr*)SC_ARG1(r);
+    unsigned vlen = SC_ARG2(r);
+    uint64_t flags = SC_ARG3(r);
+
+    if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_SOCKET) {
+        return -ENOTSOCK;
+    }
+
+    if (vlen > SOCKET_MAX_MMSG) {
+        vlen = SOCKET_MAX_MMSG;
+    }
+
+    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(mmsghdr) * vlen, proc->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysSendMMsg: Invalid msgvec ptr"); });
         return -EFAULT;
     }
 
-    long read = 0;
     Socket* sock = (Socket*)handle->node;
-
-    for (unsigned i = 0; i < msg->msg_iovlen; i++) {
-        if (!Memory::CheckUsermodePointer((uintptr_t)msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len,
-                                          proc->addressSpace)) {
-            Log::Warning("SysRecvMsg: msg: Invalid iovec entry base");
-            return -EFAULT;
+    for (unsigned i = 0; i < vlen; i++) {
+        long ret = SendMessage(proc, sock, &msgvec[i].msg_hdr, flags);
+        if (ret < 0) {
+            return i ? i : ret; // Only report an error if nothing was sent
         }
 
-        socklen_t len = msg->msg_namelen;
-        long ret =
-            sock->ReceiveFrom(msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len, flags,
-                              reinterpret_cast<sockaddr*>(msg->msg_name), &len, msg->msg_control, msg->msg_controllen);
-        msg->msg_namelen = len;
+        msgvec[i].msg_len = ret;
+    }
+
+    return vlen;
+}
 
+/*
+ * SysRecvMMsg (sockfd, msgvec, vlen, flags) - Receive multiple messages from a socket
+ * sockfd - Socket file descriptor
+ * msgvec - Array of mmsghdr, msg_len is set to the amount of data received for each message
+ * vlen - Amount of messages (at most SOCKET_MAX_MMSG)
+ * flags - flags
+ *
+ * Only waits for the first message, then receives whatever else is queued.
+ *
+ * On Success - return amount of messages received
+ * On Failure - return negative error code if no messages were received
+ */
+long SysRecvMMsg(RegisterContext* r) {
+    Process* proc = Scheduler::GetCurrentProcess();
+
+    FancyRefPtr<UNIXOpenFile> handle = SC_TRY_OR_ERROR(proc->GetHandleAs<UNIXOpenFile>(SC_ARG0(r)));
+    if (!handle) {
+        return -EBADF;
+    }
+
+    mmsghdr* msgvec = (mmsghdr*)SC_ARG1(r);
+    unsigned vlen = SC_ARG2(r);
+    uint64_t flags = SC_ARG3(r);
+
+    if (handle->mode & O_NONBLOCK) {
+        flags |= MSG_DONTWAIT; // Don't wait if socket marked as nonblock
+    }
+
+    if ((handle->node->flags & FS_NODE_TYPE) != FS_NODE_SOCKET) {
+        return -ENOTSOCK;
+    }
+
+    if (vlen > SOCKET_MAX_MMSG) {
+        vlen = SOCKET_MAX_MMSG;
+    }
+
+    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(mmsghdr) * vlen, proc->addressSpace)) {
+        IF_DEBUG(debugLevelSyscalls >= DebugLevelNormal, { Log::Warning("SysRecvMMsg: Invalid msgvec ptr"); });
+        return -EFAULT;
+    }
+
+    Socket* sock = (Socket*)handle->node;
+    for (unsigned i = 0; i < vlen; i++) {
+        long ret = ReceiveMessage(proc, sock, &msgvec[i].msg_hdr, flags);
         if (ret < 0) {
-            return ret;
+            return i ? i : ret; // Only report an error if nothing was received
         }
 
-        read += ret;
+        msgvec[i].msg_len = ret;
+        flags |= MSG_DONTWAIT; // Got one message, do not wait for the rest
     }
 
-    return read;
+    return vlen;
 }
 
 /////////////////////////////
@@ -1150,16 +1305,14 @@ long SysGetNextProcessInfo(RegisterContext* r) {
         return -EFAULT;
     }
 
-    *pidP = Scheduler::GetNextProcessPID(*pidP);
-
-    if (!(*pidP)) {
+    pid_t pid = *pidP;
+    FancyRefPtr<Process> reqProcess = Scheduler::GetNextProcess(pid);
+    if (!reqProcess.get()) {
+        *pidP = 0;
         return 1; // No more processes
     }
 
-    FancyRefPtr<Process> reqProcess;
-    if (!(reqProcess = Scheduler::FindProcessByPID(*pidP))) {
-        return -EINVAL;
-    }
+    *pidP = pid;
 
     pInfo->pid = *pidP;
 
@@ -1204,7 +1357,11 @@ long SysSpawnThread(RegisterContext* r) {
 /////////////////////////////
 long SysExitThread(RegisterContext* r) {
     Thread* thread = Thread::Current();
+    Process* process = thread->parent;
     thread->blocker = nullptr;
+
+    // Same lock order as Process::Die, so it never finds us running once we are off the thread list
+    acquireLock(&process->m_processLock);
     acquireLockIntDisable(&thread->stateLock);
 
     if (thread->state == ThreadStateRunning) {
@@ -1213,7 +1370,19 @@ long SysExitThread(RegisterContext* r) {
 
     thread->state = ThreadStateDying;
 
+    // The main thread is kept around until the process is destroyed
+    if (thread != process->m_mainThread.get()) {
+        for (auto it = process->m_threads.begin(); it != process->m_threads.end(); it++) {
+            if (it->get() == thread) {
+                Scheduler::MarkThreadForDestruction(*it);
+                process->m_threads.remove(it);
+                break;
+            }
+        }
+    }
+
     releaseLock(&thread->stateLock);
+    releaseLock(&process->m_processLock);
     releaseLock(&thread->kernelLock);
     asm volatile("sti");
 
@@ -2036,10 +2205,14 @@ long SysFork(RegisterContext* r) {
     FancyRefPtr<Thread> thread = newProcess->GetMainThread();
     void* threadKStack = thread->kernelStack; // Save the allocated kernel stack
     void* threadKStackBase = thread->kernelStackBase;
+    void* threadFxState = thread->fxState;
 
     *thread = *currentThread;
     thread->kernelStack = threadKStack;
     thread->kernelStackBase = threadKStackBase;
+    thread->fxState = threadFxState;
+    // The kernel does not touch the extended registers so they still hold our usermode state
+    asm volatile("fxsave64 (%0)" ::"r"((uintptr_t)thread->fxState) : "memory");
     thread->state = ThreadStateRunning;
     thread->parent = newProcess.get();
     thread->registers = *r;
@@ -2489,7 +2662,11 @@ syscall_t syscalls[NUM_SYSCALLS]{
     SysEpollCreate,
     SysEPollCtl,
     SysEpollWait, // 110
-    SysFChdir
+    SysFChdir,
+    SysResizeSharedMemory,
+    SysSendMMsg,
+    SysRecvMMsg,
+    SysReadDirPlus, // 115
 };
 // clang-format on
 
@@ -169,7 +169,7 @@ long SysEpollWait(RegisterContext* r) {
         }
 
         if (handle->node->IsSocket()) {
-            if (!((Socket*)handle->node)->IsConnected() && !((Socket*)handle->node)->IsListening()) {
+            if (((Socket*)handle->node)->HasHungUp()) {
                 ev |= EPOLLHUP;
             }
 
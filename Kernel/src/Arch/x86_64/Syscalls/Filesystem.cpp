@@ -1,6 +1,7 @@
 #include <Scheduler.h>
 #include <Syscalls.h>
 
+#include <ABI/Filesystem.h>
 #include <Fs/Pipe.h>
 #include <Net/Socket.h>
 
@@ -542,6 +543,89 @@ long SysReadDir(RegisterContext* r) {
     return ret;
 }
 
+/*
+ * SysReadDirPlus(fd, entries, count) - Read directory entries along with their attributes
+ *
+ * Continues from the file descriptor offset like SysReadDirNext.
+ * Attributes are looked up from the open directory rather than by path.
+ *
+ * fd - File descriptor of directory
+ * entries - Array of DirectoryEntryPlus
+ * count - Size of the array, at most READDIR_PLUS_MAX_ENTRIES
+ *
+ * Return Value:
+ * Amount of entries read, 0 on End of directory
+ * Negative value on failure
+ *
+ */
+long SysReadDirPlus(RegisterContext* r) {
+    Process* process = Scheduler::GetCurrentProcess();
+
+    FancyRefPtr<UNIXOpenFile> handle = SC_TRY_OR_ERROR(process->GetHandleAs<UNIXOpenFile>(SC_ARG0(r)));
+    if (!handle) {
+        return -EBADF;
+    }
+
+    DirectoryEntryPlus* entries = (DirectoryEntryPlus*)SC_ARG1(r);
+    unsigned count = SC_ARG2(r);
+    if (count > READDIR_PLUS_MAX_ENTRIES) {
+        count = READDIR_PLUS_MAX_ENTRIES;
+    }
+
+    if (!Memory::CheckUsermodePointer(SC_ARG1(r), sizeof(DirectoryEntryPlus) * count, process->addressSpace)) {
+        return -EFAULT;
+    }
+
+    FsNode* directory = handle->node;
+    if ((directory->flags & FS_NODE_TYPE) != FS_NODE_DIRECTORY) {
+        return -ENOTDIR;
+    }
+
+    unsigned i = 0;
+    for (; i < count; i++) {
+        DirectoryEntry tempent;
+        int ret = fs::ReadDir(directory, &tempent, handle->pos);
+        if (ret < 0) {
+            return i ? i : ret;
+        } else if (ret == 0) {
+            break; // End of directory
+        }
+        handle->pos++;
+
+        DirectoryEntryPlus& entry = entries[i];
+        strncpy(entry.name, tempent.name, sizeof(entry.name) - 1);
+        entry.name[sizeof(entry.name) - 1] = 0;
+        entry.type = tempent.flags;
+
+        // Symlinks are not followed, same as lstat.
+        // Only look up entries if the filesystem did not give us their attributes,
+        // some filesystems allocate a new node on every lookup
+        FsNode* node = nullptr;
+        if (!tempent.hasAttributes) {
+            node = fs::FindDir(directory, tempent.name);
+        }
+
+        if (node) {
+            entry.inode = node->inode;
+            entry.size = node->size;
+            entry.mode = (node->flags & FS_NODE_TYPE) | (node->pmask & 07777);
+            entry.uid = node->uid;
+            entry.nlink = node->nlink;
+        } else {
+            entry.inode = tempent.inode;
+            entry.size = tempent.size;
+            entry.mode = (tempent.flags & 0xF) << 12; // DT_* values are the S_IF* types shifted down
+            entry.uid = 0;
+            entry.nlink = 0;
+        }
+
+        // Nodes do not keep timestamps
+        entry.atime = entry.mtime = entry.ctime = 0;
+    }
+
+    return i;
+}
+
 long SysGetCWD(RegisterContext* r) {
     char* buf = (char*)SC_ARG0(r);
     size_t sz = SC_ARG1(r);
@@ -705,7 +789,7 @@ long SysPoll(RegisterContext* r) {
         bool hasEvent = 0;
 
         if ((files[i]->node->flags & FS_NODE_TYPE) == FS_NODE_SOCKET) {
-            if (!((Socket*)files[i]->node)->IsConnected() && !((Socket*)files[i]->node)->IsListening()) {
+            if (((Socket*)files[i]->node)->HasHungUp()) {
                 Log::Debug(debugLevelSyscalls, DebugLevelVerbose, "%s: SysPoll: fd %d disconnected!", proc->name,
                            fds[i].fd);
                 fds[i].revents |= POLLHUP;
@@ -766,7 +850,7 @@ long SysPoll(RegisterContext* r) {
 
                 bool hasEvent = 0;
                 if ((files[i]->node->flags & FS_NODE_TYPE) == FS_NODE_SOCKET) {
-                    if (!((Socket*)files[i]->node)->IsConnected() && !((Socket*)files[i]->node)->IsListening()) {
+                    if (((Socket*)files[i]->node)->HasHungUp()) {
                         fds[i].revents |= POLLHUP;
                         hasEvent = 1;
                     }
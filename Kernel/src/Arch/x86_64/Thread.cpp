@@ -2,6 +2,7 @@
 
 #include <CPU.h>
 #include <Debug.h>
+#include <MM/KernelStack.h>
 #include <Scheduler.h>
 #include <Timer.h>
 #include <TimerEvent.h>
@@ -41,20 +42,22 @@ Thread::Thread(Process* _parent, pid_t _tid)
     registers.cs = KERNEL_CS; // Kernel CS
     registers.ss = KERNEL_SS; // Kernel SS
 
-    fxState = Memory::KernelAllocate4KPages(1); // Allocate Memory for the FPU/Extended Register State
-    Memory::KernelMapVirtualMemory4K(Memory::AllocatePhysicalMemoryBlock(), (uintptr_t)fxState, 1);
+    kernelStackBase = Memory::AllocateKernelStack();
 
-    memset(fxState, 0, 4096);
+    // The FPU/Extended Register State lives at the top of the kernel stack
+    fxState = (uint8_t*)kernelStackBase + KERNEL_STACK_SIZE - FX_STATE_SIZE;
+    kernelStack = fxState;
+
+    memset(fxState, 0, FX_STATE_SIZE);
     ((fx_state_t*)fxState)->mxcsr = 0x1f80; // Default MXCSR (SSE Control Word) State
     ((fx_state_t*)fxState)->mxcsrMask = 0xffbf;
     ((fx_state_t*)fxState)->fcw = 0x33f; // Default FPU Control Word State
-
-    kernelStackBase = kmalloc(524288);
-    kernelStack = (uint8_t*)kernelStackBase + 524488;
 }
 
 Thread::~Thread() {
-    
+    if (kernelStackBase) {
+        Memory::FreeKernelStack(kernelStackBase);
+    }
 }
 
 void Thread::Signal(int signal) {
@@ -17,6 +17,11 @@ uint64_t ticks = 0; // System uptime in ticks since the timer was initialized
 uint64_t uptimeUs = 0; // System uptime in microseconds
 long pendingTicks = 0; // If the sleep queue is locked add ticks here
 
+// Timer ticks the TSC is measured over
+#define TSC_CALIBRATION_TICKS (frequency / 10)
+uint64_t tscCalibrationStart = 0;
+uint64_t tscFrequency = 0;
+
 lock_t sleepQueueLock = 0;
 
 // In the sleep queue, all waiting threads have a counter as an offset from the previous waiting thread.
@@ -92,6 +97,8 @@ uint64_t GetTicks() { return ticks; }
 
 uint32_t GetFrequency() { return frequency; }
 
+uint64_t TSCFrequency() { return __atomic_load_n(&tscFrequency, __ATOMIC_RELAXED); }
+
 inline uint64_t UsToTicks(long us) { return us * frequency / 1000000; }
 
 timeval GetSystemUptimeStruct() {
@@ -123,6 +130,15 @@ void Handler(void*, RegisterContext* r) {
     ticks++;
     __atomic_store_n(&uptimeUs, ticks * 1000000 / frequency, __ATOMIC_RELAXED);
 
+    if (__builtin_expect(!tscFrequency, 0)) {
+        if (ticks == 1) {
+            tscCalibrationStart = ReadTSC();
+        } else if (ticks == 1 + TSC_CALIBRATION_TICKS) {
+            __atomic_store_n(&tscFrequency, (ReadTSC() - tscCalibrationStart) * frequency / TSC_CALIBRATION_TICKS,
+                             __ATOMIC_RELAXED);
+        }
+    }
+
     pendingTicks++;
     if (!(acquireTestLock(&sleepQueueLock))) {
         while (sleeping.get_length() &&
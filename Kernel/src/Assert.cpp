@@ -14,6 +14,7 @@ extern "C" {
 
     APIC::Local::SendIPI(0, ICR_DSH_OTHER /* Send to all other processors except us */, ICR_MESSAGE_TYPE_FIXED,
                          IPI_HALT);
+    Log::DisableBuffer(); // The log thread will not run again
 
     Log::Error("Kernel Assertion Failed (%s) - file: %s, line: %d", msg, file, line);
 
@@ -1,78 +1,536 @@
 #include <Audio/Audio.h>
 
+#include <Lock.h>
+#include <Math.h>
+
+// Sample rate conversion is done in 16.16 fixed point
+#define AUDIO_FIXED_SHIFT 16
+#define AUDIO_FIXED_ONE (1U << AUDIO_FIXED_SHIFT)
+
+// Stream volume is applied as a gain out of 256
+#define AUDIO_GAIN_SHIFT 8
+#define AUDIO_GAIN_UNITY (1 << AUDIO_GAIN_SHIFT)
+
+// Frames mixed at a time, the accumulator lives on the stack of the interrupt handler
+#define AUDIO_MIX_CHUNK_FRAMES 128
+
+// How long to let a closing stream play out for
+#define AUDIO_DRAIN_TIMEOUT 1000000
+
+static_assert(!(AUDIO_STREAM_BUFFER_FRAMES & (AUDIO_STREAM_BUFFER_FRAMES - 1)));
+
 namespace Audio {
 
 lock_t pcmOutputsLock = 0;
 List<PCMOutput*> pcmOutputs;
 PCMOutput* currentOutput;
 
-class MixerDevice
-    : public FsNode {
+static inline unsigned EncodingSampleSize(SoundEncoding encoding) {
+    // 20, 24 and 32-bit samples take up a dword
+    return encoding == PCMS16LE ? 2 : 4;
+}
+
+static inline int16_t DecodeSample(const uint8_t* sample, SoundEncoding encoding) {
+    switch (encoding) {
+    case PCMS20LE:
+        return *reinterpret_cast<const int32_t*>(sample) >> 4;
+    case PCMS24LE:
+        return *reinterpret_cast<const int32_t*>(sample) >> 8;
+    case PCMS32LE:
+        return *reinterpret_cast<const int32_t*>(sample) >> 16;
+    default:
+        return *reinterpret_cast<const int16_t*>(sample);
+    }
+}
+
+static inline int16_t Clamp16(int32_t sample) {
+    if (sample > INT16_MAX) {
+        return INT16_MAX;
+    } else if (sample < INT16_MIN) {
+        return INT16_MIN;
+    }
+
+    return sample;
+}
+
+// Linearly interpolate between two samples, pos is 16.16 fixed point
+static inline int16_t Lerp(int16_t a, int16_t b, uint32_t pos) {
+    return a + (int16_t)(((int64_t)(b - a) * pos) >> AUDIO_FIXED_SHIFT);
+}
+
+// Convert mixed (stereo) frames to the output format
+static uint8_t* WriteFrames(uint8_t* dest, const int32_t* acc, unsigned frames, SoundEncoding encoding,
+                            int channels) {
+    if (encoding == PCMS16LE && channels == 2) {
+        int16_t* out = reinterpret_cast<int16_t*>(dest);
+        for (unsigned i = 0; i < frames * 2; i++) {
+            out[i] = Clamp16(acc[i]);
+        }
+
+        return reinterpret_cast<uint8_t*>(out + frames * 2);
+    }
+
+    int shift = 0;
+    if (encoding == PCMS20LE) {
+        shift = 4;
+    } else if (encoding == PCMS24LE) {
+        shift = 8;
+    } else if (encoding == PCMS32LE) {
+        shift = 16;
+    }
+
+    for (unsigned i = 0; i < frames; i++) {
+        int16_t left = Clamp16(acc[i * 2]);
+        int16_t right = Clamp16(acc[i * 2 + 1]);
+
+        for (int c = 0; c < channels; c++) {
+            int32_t sample;
+            if (channels == 1) {
+                sample = (left + right) / 2;
+            } else if (c == 0) {
+                sample = left;
+            } else if (c == 1) {
+                sample = right;
+            } else {
+                sample = 0; // Only left and right are mixed
+            }
+
+            if (encoding == PCMS16LE) {
+                *reinterpret_cast<int16_t*>(dest) = sample;
+                dest += 2;
+            } else {
+                *reinterpret_cast<int32_t*>(dest) = sample << shift;
+                dest += 4;
+            }
+        }
+    }
+
+    return dest;
+}
+
+// Each open of /dev/snd/pcm gets its own stream.
+// Writes are converted to 16-bit stereo at the output sample rate
+// and placed in a ring buffer which the mixer drains from the controller's interrupt handler.
+class PCMStream final : public FsNode {
 public:
-    MixerDevice () {
-        flags = FS_NODE_CHARDEVICE;
+    PCMStream(PCMOutput* out);
+    ~PCMStream();
+
+    ssize_t Write(size_t off, size_t size, uint8_t* buffer) override;
+    int Ioctl(uint64_t cmd, uint64_t arg) override;
+    void Close() override;
+
+    // Add up to frames frames to the accumulator,
+    // called with the output's stream lock held
+    unsigned Mix(int32_t* acc, unsigned frames);
+
+    // Called with pcmOutputsLock held when the output is removed
+    inline void Detach() { m_out = nullptr; }
+
+private:
+    struct Frame {
+        int16_t left;
+        int16_t right;
+    };
+
+    inline unsigned Buffered() const {
+        return __atomic_load_n(&m_writePos, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_readPos, __ATOMIC_ACQUIRE);
     }
 
-    int Ioctl(uint64_t cmd, uint64_t arg) override {
-        switch(cmd) {
-        default:
+    int SetFormat(SoundEncoding encoding, int channels, int sampleRate);
+    unsigned Resample(unsigned writePos, Frame frame);
+
+    // Make sure the output is running, unless force is false
+    // and there are less than AUDIO_START_PERIODS periods buffered.
+    // Returns the length of a period in microseconds or 0 if the stream has no output
+    long Kick(bool force);
+
+    PCMOutput* m_out;
+    Semaphore m_writeLock = Semaphore(1);
+
+    // The mixer only advances m_readPos,
+    // writers (serialized by m_writeLock) only advance m_writePos
+    Frame* m_ring;
+    unsigned m_readPos = 0;
+    unsigned m_writePos = 0;
+
+    SoundEncoding m_encoding;
+    int m_channels;
+    int m_sampleRate;
+    int m_outputRate;
+
+    // Input frames consumed per output frame (16.16 fixed point)
+    uint32_t m_step = AUDIO_FIXED_ONE;
+    // Position of the next output frame between m_last and the next input frame
+    uint32_t m_pos = 0;
+    Frame m_last = {0, 0};
+    // Most output frames one input frame can produce
+    unsigned m_maxFramesPerInput = 1;
+
+    int m_volume = 100;
+    int32_t m_gain = AUDIO_GAIN_UNITY;
+
+    bool m_async = false;
+    bool m_playing = false;
+    bool m_closing = false;
+    unsigned m_underruns = 0;
+};
+
+PCMStream::PCMStream(PCMOutput* out) : m_out(out) {
+    flags = FS_NODE_CHARDEVICE;
+
+    m_ring = new Frame[AUDIO_STREAM_BUFFER_FRAMES];
+
+    // Default to the format of the output so existing clients work unchanged
+    AudioController* c = out->c;
+    m_encoding = c->OutputGetEncoding(out->output);
+    m_channels = MIN(c->OutputNumberOfChannels(out->output), 2);
+    m_outputRate = c->OutputSampleRate(out->output);
+    m_sampleRate = m_outputRate;
+
+    ScopedSpinLock<true> lockStreams(out->streamsLock);
+    out->streams.add_back(this);
+}
+
+PCMStream::~PCMStream() {
+    {
+        ScopedSpinLock lockOutputs(pcmOutputsLock);
+        if (m_out) {
+            ScopedSpinLock<true> lockStreams(m_out->streamsLock);
+            m_out->streams.remove(this);
+        }
+    }
+
+    delete[] m_ring;
+}
+
+int PCMStream::SetFormat(SoundEncoding encoding, int channels, int sampleRate) {
+    if (encoding < PCMS16LE || encoding > PCMS32LE) {
+        return -EINVAL;
+    } else if (channels < 1 || channels > 2) {
+        return -EINVAL;
+    } else if (sampleRate < 4000 || sampleRate > 192000) {
+        return -EINVAL;
+    }
+
+    if (m_writeLock.Wait()) {
+        return -EINTR;
+    }
+
+    m_encoding = encoding;
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+
+    m_step = ((uint64_t)sampleRate << AUDIO_FIXED_SHIFT) / m_outputRate;
+    m_maxFramesPerInput = (AUDIO_FIXED_ONE + m_step - 1) / m_step + 1;
+    m_pos = 0;
+
+    m_writeLock.Signal();
+    return 0;
+}
+
+unsigned PCMStream::Resample(unsigned writePos, Frame frame) {
+    if (m_step == AUDIO_FIXED_ONE) {
+        m_ring[writePos++ & (AUDIO_STREAM_BUFFER_FRAMES - 1)] = frame;
+        return writePos;
+    }
+
+    while (m_pos < AUDIO_FIXED_ONE) {
+        m_ring[writePos++ & (AUDIO_STREAM_BUFFER_FRAMES - 1)] =
+            Frame{Lerp(m_last.left, frame.left, m_pos), Lerp(m_last.right, frame.right, m_pos)};
+        m_pos += m_step;
+    }
+
+    m_pos -= AUDIO_FIXED_ONE;
+    m_last = frame;
+    return writePos;
+}
+
+ssize_t PCMStream::Write(size_t, size_t size, uint8_t* buffer) {
+    unsigned sampleSize = EncodingSampleSize(m_encoding);
+    unsigned frameSize = sampleSize * m_channels;
+    if (size % frameSize) {
+        return -EINVAL; // Must be writing exact frames
+    }
+
+    if (m_writeLock.Wait()) {
+        return -EINTR;
+    }
+
+    size_t frames = size / frameSize;
+    size_t written = 0;
+    while (written < frames) {
+        unsigned space = AUDIO_STREAM_BUFFER_FRAMES - Buffered();
+        if (space < m_maxFramesPerInput) {
+            long periodLength = Kick(true);
+            if (!periodLength) {
+                // Output has gone, treat as a dummy device
+                written = frames;
+                break;
+            }
+
+            if (m_async || Thread::Current()->HasPendingSignals()) {
+                break;
+            }
+
+            // Wait for the mixer to consume a period
+            Thread::Current()->Sleep(periodLength);
+            continue;
+        }
+
+        uint8_t* data = buffer + written * frameSize;
+        unsigned writePos = m_writePos;
+        if (m_step == AUDIO_FIXED_ONE && m_encoding == PCMS16LE && m_channels == 2) {
+            // Stream is already in the mixer format, copy straight into the ring
+            unsigned count = MIN(frames - written, space);
+            unsigned index = writePos & (AUDIO_STREAM_BUFFER_FRAMES - 1);
+            unsigned first = MIN(count, AUDIO_STREAM_BUFFER_FRAMES - index);
+
+            memcpy(m_ring + index, data, first * sizeof(Frame));
+            memcpy(m_ring, data + first * sizeof(Frame), (count - first) * sizeof(Frame));
+
+            writePos += count;
+            written += count;
+        } else {
+            unsigned end = writePos + space;
+            while (written < frames && end - writePos >= m_maxFramesPerInput) {
+                Frame frame;
+                frame.left = DecodeSample(data, m_encoding);
+                frame.right = (m_channels == 2) ? DecodeSample(data + sampleSize, m_encoding) : frame.left;
+
+                writePos = Resample(writePos, frame);
+
+                data += frameSize;
+                written++;
+            }
+        }
+
+        __atomic_store_n(&m_writePos, writePos, __ATOMIC_RELEASE);
+        Kick(false);
+    }
+
+    m_writeLock.Signal();
+
+    if (!written && frames) {
+        return -EAGAIN;
+    }
+
+    return written * frameSize;
+}
+
+int PCMStream::Ioctl(uint64_t cmd, uint64_t arg) {
+    switch (cmd) {
+    case IoCtlOutputSetVolume:
+        if (arg > 100) {
             return -EINVAL;
         }
 
+        m_volume = arg;
+        __atomic_store_n(&m_gain, m_volume * AUDIO_GAIN_UNITY / 100, __ATOMIC_RELAXED);
+        return 0;
+    case IoCtlOutputGetVolume:
+        return m_volume;
+    case IoCtlOutputGetEncoding:
+        return m_encoding;
+    case IoCtlOutputGetSampleRate:
+        return m_sampleRate;
+    case IoCtlOutputGetNumberOfChannels:
+        return m_channels;
+    case IoCtlOutputSetNumberOfChannels:
+        return SetFormat(m_encoding, (int)arg, m_sampleRate);
+    case IoCtlOutputSetSampleRate:
+        return SetFormat(m_encoding, m_channels, (int)arg);
+    case IoCtlOutputSetEncoding:
+        return SetFormat((SoundEncoding)arg, m_channels, m_sampleRate);
+    case IoCtlOutputSetAsync:
+        m_async = (bool)arg;
+        return 0;
+    case IoCtlOutputGetBufferedFrames: {
+        int buffered = Buffered();
+
+        ScopedSpinLock lockOutputs(pcmOutputsLock);
+        if (m_out) {
+            buffered += m_out->c->OutputQueuedFrames(m_out->output);
+        }
+        return buffered;
+    }
+    case IoCtlOutputGetUnderruns:
+        return m_underruns;
+    default:
         return -EINVAL;
     }
-};
+}
 
-class PCMOutputDevice
+void PCMStream::Close() {
+    handleCount--;
+
+    if (handleCount > 0) {
+        return;
+    }
+
+    // Let the samples already written finish playing
+    m_closing = true;
+
+    long timeout = AUDIO_DRAIN_TIMEOUT;
+    while (Buffered() && timeout > 0) {
+        long periodLength = Kick(true);
+        if (!periodLength) {
+            break;
+        }
+
+        Thread::Current()->Sleep(periodLength);
+        timeout -= periodLength;
+    }
+
+    delete this;
+}
+
+unsigned PCMStream::Mix(int32_t* acc, unsigned frames) {
+    unsigned readPos = m_readPos;
+    unsigned count = MIN(__atomic_load_n(&m_writePos, __ATOMIC_ACQUIRE) - readPos, frames);
+
+    int32_t gain = __atomic_load_n(&m_gain, __ATOMIC_RELAXED);
+    for (unsigned i = 0; i < count; i++) {
+        const Frame& f = m_ring[(readPos + i) & (AUDIO_STREAM_BUFFER_FRAMES - 1)];
+
+        if (gain == AUDIO_GAIN_UNITY) {
+            acc[i * 2] += f.left;
+            acc[i * 2 + 1] += f.right;
+        } else {
+            acc[i * 2] += (f.left * gain) >> AUDIO_GAIN_SHIFT;
+            acc[i * 2 + 1] += (f.right * gain) >> AUDIO_GAIN_SHIFT;
+        }
+    }
+
+    __atomic_store_n(&m_readPos, readPos + count, __ATOMIC_RELEASE);
+
+    if (count) {
+        m_playing = true;
+    }
+
+    if (count < frames && m_playing) {
+        // Ran dry whilst playing, only count it if the client is still around
+        m_playing = false;
+        if (!m_closing) {
+            m_underruns++;
+        }
+    }
+
+    return count;
+}
+
+long PCMStream::Kick(bool force) {
+    ScopedSpinLock lockOutputs(pcmOutputsLock);
+    if (!m_out) {
+        return 0;
+    }
+
+    // Starting with less buffered would underrun straight away
+    if (force || Buffered() >= m_out->periodFrames * AUDIO_START_PERIODS) {
+        m_out->c->OutputStart(m_out->output);
+    }
+
+    return (long)m_out->periodFrames * 1000000 / m_outputRate;
+}
+
+unsigned MixPeriod(PCMOutput* out, void* buffer, unsigned frames) {
+    AudioController* c = out->c;
+    SoundEncoding encoding = c->OutputGetEncoding(out->output);
+    int channels = c->OutputNumberOfChannels(out->output);
+
+    uint8_t* dest = reinterpret_cast<uint8_t*>(buffer);
+    unsigned audible = 0;
+
+    int32_t acc[AUDIO_MIX_CHUNK_FRAMES * 2];
+
+    ScopedSpinLock<true> lockStreams(out->streamsLock);
+
+    unsigned done = 0;
+    while (done < frames) {
+        unsigned chunk = MIN(frames - done, AUDIO_MIX_CHUNK_FRAMES);
+        memset(acc, 0, chunk * 2 * sizeof(int32_t));
+
+        unsigned chunkAudible = 0;
+        for (PCMStream* stream : out->streams) {
+            chunkAudible = MAX(chunkAudible, stream->Mix(acc, chunk));
+        }
+
+        if (chunkAudible) {
+            audible = done + chunkAudible;
+        }
+
+        dest = WriteFrames(dest, acc, chunk, encoding, channels);
+        done += chunk;
+    }
+
+    return audible;
+}
+
+class MixerDevice
     : public FsNode {
 public:
-    PCMOutputDevice() {
+    MixerDevice () {
         flags = FS_NODE_CHARDEVICE;
     }
 
     int Ioctl(uint64_t cmd, uint64_t arg) override {
         ScopedSpinLock lockOutputs(pcmOutputsLock);
         if(!currentOutput) {
-            Log::Warning("no audio output!", size);
-            return 0;
+            return -ENODEV;
         }
 
         AudioController* c = currentOutput->c;
-        void* out = currentOutput->output;
-        switch (cmd)
-        {
-        case IoCtlOutputSetVolume:
-            return c->OutputSetVolume(out, (int)arg);
-        case IoCtlOutputGetVolume:
-            return c->OutputGetVolume(out);
-        case IoCtlOutputGetEncoding:
-            return c->OutputGetEncoding(out);
-        case IoCtlOutputGetSampleRate:
-            return c->OutputSampleRate(out);
-        case IoCtlOutputGetNumberOfChannels:
-            return c->OutputNumberOfChannels(out);
-        case IoCtlOutputSetAsync:
-            m_async = (bool)arg;
+        switch(cmd) {
+        case IoCtlMixerSetMasterVolume:
+            if(arg > 100) {
+                return -EINVAL;
+            }
+            return c->SetMasterVolume((int)arg);
+        case IoCtlMixerGetMasterVolume:
+            return c->GetMasterVolume();
+        case IoCtlMixerSetPeriodSize:
+            if(arg < AUDIO_MIN_PERIOD_FRAMES || arg > AUDIO_MAX_PERIOD_FRAMES) {
+                return -EINVAL;
+            }
+
+            // Used for periods queued from now on
+            currentOutput->periodFrames = arg;
             return 0;
-        case IoCtlOutputSetNumberOfChannels:
+        case IoCtlMixerGetPeriodSize:
+            return currentOutput->periodFrames;
         default:
             return -EINVAL;
         }
     }
+};
 
-    ssize_t Write(size_t off, size_t size, uint8_t* buffer) override {
+// Opening /dev/snd/pcm creates a new stream on the current output,
+// when there is no output the device discards any samples written.
+class PCMOutputDevice
+    : public FsNode {
+public:
+    PCMOutputDevice() {
+        flags = FS_NODE_CHARDEVICE;
+    }
+
+    ErrorOr<UNIXOpenFile*> Open(size_t flags) override {
         ScopedSpinLock lockOutputs(pcmOutputsLock);
         if(!currentOutput) {
-            // If no output treat as dummy device
-            Log::Warning("no audio output!", size);
-            return size;
+            Log::Warning("no audio output!");
+            return FsNode::Open(flags);
         }
 
-        AudioController* c = currentOutput->c;
-        return c->WriteSamples(currentOutput->output, buffer, size, m_async);
+        PCMStream* stream = new PCMStream(currentOutput);
+        return stream->Open(flags);
+    }
+
+    int Ioctl(uint64_t cmd, uint64_t arg) override {
+        return -ENODEV;
+    }
+
+    ssize_t Write(size_t off, size_t size, uint8_t* buffer) override {
+        return size;
     }
-private:
-    bool m_async = false;
 };
 
 class SoundFS
@@ -146,13 +604,20 @@ Error UnregisterPCMOut(PCMOutput* out) {
     for(auto it = pcmOutputs.begin(); it != pcmOutputs.end(); it++) {
         if(*it == out) {
             pcmOutputs.remove(it);
-            
+
             if(pcmOutputs.get_length()) {
                 currentOutput = pcmOutputs.get_front();
             } else {
                 currentOutput = nullptr;
             }
 
+            // Any streams left on the output become dummies
+            ScopedSpinLock<true> lockStreams(out->streamsLock);
+            for(PCMStream* stream : out->streams) {
+                stream->Detach();
+            }
+            out->streams.clear();
+
             return ErrorNone;
         }
     }
@@ -0,0 +1,89 @@
+#include <BootTrace.h>
+
+#include <CPU.h>
+#include <CString.h>
+#include <Logging.h>
+#include <Thread.h>
+#include <Timer.h>
+
+namespace BootTrace {
+struct Phase {
+    char name[BOOT_TRACE_NAME_MAX];
+    uint64_t start;
+    uint64_t end; // 0 until the phase has ended
+    uint64_t cpu;
+};
+
+Phase phases[BOOT_TRACE_MAX_PHASES];
+unsigned phaseCount = 0;
+
+int Begin(const char* name) {
+    unsigned index = __atomic_fetch_add(&phaseCount, 1, __ATOMIC_RELAXED);
+    if (index >= BOOT_TRACE_MAX_PHASES) {
+        return -1;
+    }
+
+    Phase& phase = phases[index];
+    strncpy(phase.name, name, BOOT_TRACE_NAME_MAX - 1);
+    phase.name[BOOT_TRACE_NAME_MAX - 1] = 0;
+    phase.cpu = GetCPULocal()->id;
+    phase.end = 0;
+    phase.start = ReadTSC();
+
+    return index;
+}
+
+void End(int phase) {
+    if (phase < 0) {
+        return;
+    }
+
+    __atomic_store_n(&phases[phase].end, ReadTSC(), __ATOMIC_RELEASE);
+}
+
+void Dump() {
+    while (!Timer::TSCFrequency()) {
+        Thread::Current()->Sleep(BOOT_TRACE_CALIBRATION_WAIT);
+    }
+
+    uint64_t ticksPerUs = Timer::TSCFrequency() / 1000000;
+    if (!ticksPerUs) {
+        ticksPerUs = 1;
+    }
+
+    unsigned count = __atomic_load_n(&phaseCount, __ATOMIC_RELAXED);
+    if (count > BOOT_TRACE_MAX_PHASES) {
+        Log::Warning("[BootTrace] Dropped %u phases", static_cast<uint64_t>(count - BOOT_TRACE_MAX_PHASES));
+        count = BOOT_TRACE_MAX_PHASES;
+    }
+
+    if (!count) {
+        return;
+    }
+
+    // Everything is relative to the first phase
+    uint64_t origin = phases[0].start;
+    uint64_t last = origin;
+
+    Log::Info("[BootTrace] %u phases, TSC %u MHz", static_cast<uint64_t>(count), ticksPerUs);
+    for (unsigned i = 0; i < count; i++) {
+        Phase& phase = phases[i];
+
+        uint64_t end = __atomic_load_n(&phase.end, __ATOMIC_ACQUIRE);
+        if (!end) {
+            Log::Info("[BootTrace] %s: started at %u us on CPU %u, still running", phase.name,
+                      (phase.start - origin) / ticksPerUs, phase.cpu);
+            continue;
+        }
+
+        if (end > last) {
+            last = end;
+        }
+
+        Log::Info("[BootTrace] %s: started at %u us on CPU %u, took %u us", phase.name,
+                  (phase.start - origin) / ticksPerUs, phase.cpu, (end - phase.start) / ticksPerUs);
+    }
+
+    Log::Info("[BootTrace] Total: %u us", (last - origin) / ticksPerUs);
+}
+} // namespace BootTrace
@@ -145,6 +145,8 @@ namespace DeviceManager {
 int64_t nextDeviceID = 1;
 List<Device*>* rootDevices;
 Vector<Device*>* devices;
+// Drivers may register devices from several threads at once during boot
+lock_t devicesLock = 0;
 
 class DevFS : public Device {
 public:
@@ -210,6 +212,8 @@ void RegisterFSVolume(){
 }
 
 void RegisterDevice(Device* dev) {
+    ScopedSpinLock lockDevices(devicesLock);
+
     dev->SetID(nextDeviceID++);
 
     devices->add_back(dev);
@@ -220,6 +224,8 @@ void RegisterDevice(Device* dev) {
 }
 
 void UnregisterDevice(Device* dev) {
+    ScopedSpinLock lockDevices(devicesLock);
+
     if (dev->IsRootDevice()) {
         rootDevices->remove(dev);
     }
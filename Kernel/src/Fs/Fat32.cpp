@@ -4,6 +4,7 @@
 #include <Device.h>
 #include <Errno.h>
 #include <Logging.h>
+#include <Math.h>
 #include <Memory.h>
 
 namespace fs::FAT32 {
@@ -53,6 +54,9 @@ Fat32Volume::Fat32Volume(PartitionDevice* _part, char* name) {
               (char*)bootRecord->bpb.oem, bootRecord->bpb.largeSectorCount * 512 / 1024 / 1024);
 
     clusterSizeBytes = bootRecord->bpb.sectorsPerCluster * part->parentDisk->blocksize;
+    clusterCount = (bootRecord->bpb.largeSectorCount -
+                    (bootRecord->bpb.reservedSectors + bootRecord->ebr.sectorsPerFAT * bootRecord->bpb.fatCount)) /
+                   bootRecord->bpb.sectorsPerCluster;
 
     fat32MountPoint.flags = FS_NODE_MOUNTPOINT | FS_NODE_DIRECTORY;
     fat32MountPoint.inode = bootRecord->ebr.rootClusterNum;
@@ -67,108 +71,202 @@ Fat32Volume::Fat32Volume(PartitionDevice* _part, char* name) {
     strcpy(mountPointDirent.name, name);
 }
 
-List<uint32_t>* Fat32Volume::GetClusterChain(uint32_t cluster) {
-    List<uint32_t>* list = new List<uint32_t>();
+Fat32Volume::~Fat32Volume() {
+    for (CachedFATBlock& cached : fatCache) {
+        if (cached.data) {
+            kfree(cached.data);
+        }
+    }
 
-    uint32_t* buf = (uint32_t*)kmalloc(4096);
+    if (bootRecord) {
+        kfree(bootRecord);
+    }
+}
 
-    uint32_t lastBlock = 0xFFFFFFFF;
+int Fat32Volume::ReadFATEntry(uint32_t cluster, uint32_t& next) {
+    uint32_t block = cluster / (FAT32_FAT_BLOCK_SIZE / sizeof(uint32_t));
+    uint32_t offset = cluster % (FAT32_FAT_BLOCK_SIZE / sizeof(uint32_t));
 
-    do {
-        list->add_back(cluster);
+    CachedFATBlock& cached = fatCache[block % FAT32_FAT_CACHE_BLOCKS];
+    {
+        ScopedSpinLock lock(fatCacheLock);
+        if (cached.block == block) {
+            next = cached.data[offset] & FAT32_CLUSTER_MASK;
+            return 0;
+        }
+    }
 
-        uint32_t block = ((cluster * 4) / 4096);
-        uint32_t offset = cluster % (4096 / 4);
+    // Read outside the lock, another thread may fill the entry in the meantime
+    uint32_t* data = (uint32_t*)kmalloc(FAT32_FAT_BLOCK_SIZE);
+    if (part->ReadBlock(bootRecord->bpb.reservedSectors +
+                            block * (FAT32_FAT_BLOCK_SIZE / part->parentDisk->blocksize) /* Get Sector of Block */,
+                        FAT32_FAT_BLOCK_SIZE, data)) {
+        kfree(data);
+        return -EIO;
+    }
 
-        if (block != lastBlock) {
-            if (part->ReadBlock(bootRecord->bpb.reservedSectors +
-                                    block * (4096 / part->parentDisk->blocksize) /* Get Sector of Block */,
-                                4096, buf)) {
-                delete list;
-                return nullptr;
-            }
+    next = data[offset] & FAT32_CLUSTER_MASK;
 
-            lastBlock = block;
-        }
+    ScopedSpinLock lock(fatCacheLock);
+    if (cached.data) {
+        kfree(cached.data);
+    }
 
-        cluster = buf[offset] & 0x0FFFFFFF;
+    cached.block = block;
+    cached.data = data;
+    return 0;
+}
 
-    } while (cluster && (cluster & 0x0FFFFFFF) < 0x0FFFFFF8);
+Vector<ClusterExtent>* Fat32Volume::GetExtents(Fat32Node* node) {
+    if (Vector<ClusterExtent>* extents = __atomic_load_n(&node->extents, __ATOMIC_ACQUIRE)) {
+        return extents;
+    }
 
-    return list;
-}
+    Vector<ClusterExtent>* extents = new Vector<ClusterExtent>();
 
-void* Fat32Volume::ReadClusterChain(uint32_t cluster, int* clusterCount, size_t max) {
-    uint32_t maxCluster = (max / (bootRecord->bpb.sectorsPerCluster * part->parentDisk->blocksize)) + 1;
-    List<uint32_t>* clusterChain = GetClusterChain(cluster);
+    uint32_t cluster = node->inode;
+    uint32_t length = 0;
+    while (cluster >= 2 && cluster < FAT32_CLUSTER_EOC) {
+        // A cycle or an out of range cluster means the FAT is corrupt
+        if (cluster >= clusterCount + 2 || length >= clusterCount) {
+            Log::Warning("[FAT32] Invalid cluster chain starting at %u", node->inode);
+            break;
+        }
 
-    if (!clusterChain)
-        return nullptr;
+        if (extents->get_length() && extents->at(extents->get_length() - 1).cluster +
+                                             extents->at(extents->get_length() - 1).count ==
+                                         cluster) {
+            extents->at(extents->get_length() - 1).count++;
+        } else {
+            extents->add_back({.start = length, .cluster = cluster, .count = 1});
+        }
+        length++;
+
+        if (ReadFATEntry(cluster, cluster)) {
+            delete extents;
+            return nullptr;
+        }
+    }
 
-    uint8_t* buf = reinterpret_cast<uint8_t*>(kmalloc(clusterChain->get_length() * clusterSizeBytes));
-    void* _buf = buf;
+    // The chain of a node does not change whilst the volume is read-only,
+    // if another thread got here first use its copy
+    Vector<ClusterExtent>* expected = nullptr;
+    if (!__atomic_compare_exchange_n(&node->extents, &expected, extents, false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE)) {
+        delete extents;
+        return expected;
+    }
 
-    for (unsigned i = 0; i < clusterChain->get_length() && maxCluster; i++) {
-        part->ReadBlock(ClusterToLBA(clusterChain->get_at(i)), clusterSizeBytes, buf);
+    return extents;
+}
 
-        buf += clusterSizeBytes;
+ssize_t Fat32Volume::ReadExtents(const Vector<ClusterExtent>& extents, size_t offset, size_t size,
+                                 uint8_t* buffer) {
+    uint32_t index = offset / clusterSizeBytes;
+    size_t clusterOffset = offset % clusterSizeBytes;
+
+    // Binary search for the extent containing the first cluster
+    unsigned e = 0;
+    unsigned high = extents.get_length();
+    while (e + 1 < high) {
+        unsigned mid = (e + high) / 2;
+        if (extents[mid].start <= index) {
+            e = mid;
+        } else {
+            high = mid;
+        }
     }
 
-    if (clusterCount)
-        *clusterCount = clusterChain->get_length();
+    uint8_t* clusterBuffer = nullptr; // For partial clusters
+    size_t done = 0;
+    while (done < size && e < extents.get_length()) {
+        const ClusterExtent& extent = extents[e];
+        if (index >= extent.start + extent.count) {
+            e++;
+            continue;
+        }
 
-    delete clusterChain;
+        uint32_t cluster = extent.cluster + (index - extent.start);
+        if (clusterOffset || size - done < clusterSizeBytes) {
+            if (!clusterBuffer) {
+                clusterBuffer = (uint8_t*)kmalloc(clusterSizeBytes);
+            }
 
-    return _buf;
-}
+            if (part->ReadBlock(ClusterToLBA(cluster), clusterSizeBytes, clusterBuffer)) {
+                kfree(clusterBuffer);
+                return -EIO;
+            }
 
-void* Fat32Volume::ReadClusterChain(uint32_t cluster, int* clusterCount) {
-    if (cluster == 0)
-        cluster = bootRecord->ebr.rootClusterNum;
-    List<uint32_t>* clusterChain = GetClusterChain(cluster);
+            size_t count = MIN(clusterSizeBytes - clusterOffset, size - done);
+            memcpy(buffer + done, clusterBuffer + clusterOffset, count);
 
-    if (!clusterChain)
-        return nullptr;
+            done += count;
+            clusterOffset = 0;
+            index++;
+            continue;
+        }
+
+        // Whole clusters go straight to the buffer, as many as are contiguous on disk
+        uint32_t count = MIN(extent.start + extent.count - index, (size - done) / clusterSizeBytes);
+        count = MIN(count, 0x40000000U / clusterSizeBytes); // Keep the request size within 32 bits
+        if (part->ReadBlock(ClusterToLBA(cluster), count * clusterSizeBytes, buffer + done)) {
+            if (clusterBuffer) {
+                kfree(clusterBuffer);
+            }
+            return -EIO;
+        }
+
+        done += count * clusterSizeBytes;
+        index += count;
+    }
+
+    if (clusterBuffer) {
+        kfree(clusterBuffer);
+    }
 
-    uint8_t* buf = reinterpret_cast<uint8_t*>(kmalloc(clusterChain->get_length() * clusterSizeBytes));
-    void* _buf = buf;
+    return done;
+}
 
-    for (unsigned i = 0; i < clusterChain->get_length(); i++) {
-        part->ReadBlock(ClusterToLBA(clusterChain->get_at(i)), clusterSizeBytes, buf);
+fat_entry_t* Fat32Volume::ReadDirectory(Fat32Node* node, unsigned& entryCount) {
+    entryCount = 0;
 
-        buf += clusterSizeBytes;
+    Vector<ClusterExtent>* extents = GetExtents(node);
+    if (!extents || !extents->get_length()) {
+        return nullptr;
     }
 
-    if (clusterCount)
-        *clusterCount = clusterChain->get_length();
+    const ClusterExtent& last = extents->at(extents->get_length() - 1);
+    size_t size = static_cast<size_t>(last.start + last.count) * clusterSizeBytes;
 
-    delete clusterChain;
+    fat_entry_t* entries = (fat_entry_t*)kmalloc(size);
+    if (ReadExtents(*extents, 0, size, (uint8_t*)entries) != static_cast<ssize_t>(size)) {
+        kfree(entries);
+        return nullptr;
+    }
 
-    return _buf;
+    entryCount = size / sizeof(fat_entry_t);
+    return entries;
 }
 
 ssize_t Fat32Volume::Read(Fat32Node* node, size_t offset, size_t size, uint8_t* buffer) {
-    if (!node->inode || node->flags & FS_NODE_DIRECTORY)
-        return -1;
+    if (node->flags & FS_NODE_DIRECTORY)
+        return -EISDIR;
 
-    int count;
-    void* _buf = ReadClusterChain(node->inode, &count, size);
-
-    if (static_cast<unsigned>(count) * bootRecord->bpb.sectorsPerCluster * part->parentDisk->blocksize < size)
+    if (offset >= node->size || !node->inode)
         return 0;
 
-    memcpy(buffer, _buf, size);
-    return size;
+    if (size > node->size - offset)
+        size = node->size - offset;
+
+    Vector<ClusterExtent>* extents = GetExtents(node);
+    if (!extents)
+        return -EIO;
+
+    return ReadExtents(*extents, offset, size, buffer);
 }
 
 ssize_t Fat32Volume::Write(Fat32Node* node, size_t offset, size_t size, uint8_t* buffer) {
     return -EROFS;
-
-    List<uint32_t>* clusters = GetClusterChain(node->inode);
-    if (offset + size > clusters->get_length() * bootRecord->bpb.sectorsPerCluster * part->parentDisk->blocksize) {
-        // TODO: Allocate clusters
-        Log::Info("[FAT32] Allocating Clusters");
-    }
 }
 
 void Fat32Volume::Open(Fat32Node* node, uint32_t flags) {}
@@ -179,17 +277,18 @@ int Fat32Volume::ReadDir(Fat32Node* node, DirectoryEntry* dirent, uint32_t index
     unsigned lfnCount = 0;
     unsigned entryCount = 0;
 
-    uint32_t cluster = node->inode;
-    int clusterCount = 0;
-
-    fat_entry_t* dirEntries = (fat_entry_t*)ReadClusterChain(cluster, &clusterCount);
+    unsigned dirEntryCount;
+    fat_entry_t* dirEntries = ReadDirectory(node, dirEntryCount);
+    if (!dirEntries) {
+        return -EIO;
+    }
 
     fat_entry_t* dirEntry;
     int dirEntryIndex = -1;
 
     fat_lfn_entry_t** lfnEntries;
 
-    for (unsigned i = 0; i < static_cast<unsigned>(clusterCount) * clusterSizeBytes / sizeof(fat_entry_t); i++) {
+    for (unsigned i = 0; i < dirEntryCount; i++) {
         if (dirEntries[i].filename[0] == 0)
             continue; // No Directory Entry at index
         else if (dirEntries[i].filename[0] == 0xE5) {
@@ -213,6 +312,7 @@ int Fat32Volume::ReadDir(Fat32Node* node, DirectoryEntry* dirent, uint32_t index
     }
 
     if (dirEntryIndex == -1) {
+        kfree(dirEntries);
         return 0;
     }
 
@@ -241,26 +341,31 @@ int Fat32Volume::ReadDir(Fat32Node* node, DirectoryEntry* dirent, uint32_t index
     else
         dirent->flags = DT_REG;
 
+    // FindDir allocates a new node every time, so give readdirplus what it needs here
+    dirent->inode = (((uint32_t)dirEntry->highClusterNum) << 16) | dirEntry->lowClusterNum;
+    dirent->size = dirEntry->fileSize;
+    dirent->hasAttributes = true;
+
+    kfree(lfnEntries);
+    kfree(dirEntries);
     return 1;
 }
 
 FsNode* Fat32Volume::FindDir(Fat32Node* node, const char* name) {
     unsigned lfnCount = 0;
 
-    uint32_t cluster = node->inode;
-    int clusterCount = 0;
-
-    fat_entry_t* dirEntries = (fat_entry_t*)ReadClusterChain(cluster, &clusterCount);
-
-    List<int> foundEntries;
-    List<int> foundEntriesLfnCount;
+    unsigned dirEntryCount;
+    fat_entry_t* dirEntries = ReadDirectory(node, dirEntryCount);
+    if (!dirEntries) {
+        return nullptr;
+    }
 
     fat_lfn_entry_t** lfnEntries;
     Fat32Node* _node = nullptr;
 
-    for (unsigned i = 0; i < static_cast<unsigned>(clusterCount) * clusterSizeBytes; i++) {
+    for (unsigned i = 0; i < dirEntryCount; i++) {
         if (dirEntries[i].filename[0] == 0)
-            return nullptr; // No Directory Entry at index
+            break; // No Directory Entry at index
         else if (dirEntries[i].filename[0] == 0xE5) {
             lfnCount = 0;
             continue; // Unused Entry
@@ -293,10 +398,16 @@ FsNode* Fat32Volume::FindDir(Fat32Node* node, const char* name) {
                 }
             }
 
-            if (strcmp(_name, name) == 0) {
+            bool match = strcmp(_name, name) == 0;
+            kfree(_name);
+
+            if (match) {
                 uint64_t clusterNum = (((uint32_t)dirEntries[i].highClusterNum) << 16) | dirEntries[i].lowClusterNum;
-                if (clusterNum == bootRecord->ebr.rootClusterNum || clusterNum == 0)
-                    return mountPoint; // Root Directory
+                if ((dirEntries[i].attributes & FAT_ATTR_DIRECTORY) &&
+                    (clusterNum == bootRecord->ebr.rootClusterNum || clusterNum == 0)) {
+                    _node = &fat32MountPoint; // Root Directory
+                    break;
+                }
                 _node = new Fat32Node();
                 _node->size = dirEntries[i].fileSize;
                 _node->inode = clusterNum;
@@ -310,6 +421,8 @@ FsNode* Fat32Volume::FindDir(Fat32Node* node, const char* name) {
         }
     }
 
+    kfree(dirEntries);
+
     if (_node) {
         _node->vol = this;
     }
@@ -317,6 +430,12 @@ FsNode* Fat32Volume::FindDir(Fat32Node* node, const char* name) {
     return _node;
 }
 
+Fat32Node::~Fat32Node() {
+    if (extents) {
+        delete extents;
+    }
+}
+
 ssize_t Fat32Node::Read(size_t offset, size_t size, uint8_t* buffer) { return vol->Read(this, offset, size, buffer); }
 
 ssize_t Fat32Node::Write(size_t offset, size_t size, uint8_t* buffer) { return vol->Write(this, offset, size, buffer); }
@@ -76,8 +76,11 @@ namespace fs {
 volume_id_t nextVID = 1; // Next volume ID
 
 List<FsDriver*> drivers;
+lock_t driversLock = 0;
 
 void RegisterDriver(FsDriver* driver) {
+    ScopedSpinLock lockDrivers(driversLock);
+
     for (auto& drv : drivers) {
         assert(drv != driver);
         assert(strcmp(drv->ID(), driver->ID()));
@@ -87,6 +90,8 @@ void RegisterDriver(FsDriver* driver) {
 }
 
 void UnregisterDriver(FsDriver* driver) {
+    ScopedSpinLock lockDrivers(driversLock);
+
     for (auto it = drivers.begin(); it != drivers.end(); it++) {
         if ((*it) == driver) {
             drivers.remove(it);
@@ -96,13 +96,13 @@ int FsNode::Ioctl(uint64_t cmd, uint64_t arg){
     return -ENOSYS;
 }
 
-void FsNode::Watch(FilesystemWatcher& watcher, int events){
+void FsNode::Watch(KernelObjectWatcher& watcher, int events){
     Log::Warning("FsNode::Watch base called");
     
     watcher.Signal();
 }
 
-void FsNode::Unwatch(FilesystemWatcher& watcher){
+void FsNode::Unwatch(KernelObjectWatcher& watcher){
     Log::Warning("FsNode::Unwatch base called");
 }
 
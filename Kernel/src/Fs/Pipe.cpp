@@ -63,12 +63,17 @@ ssize_t UNIXPipe::Write(size_t off, size_t size, uint8_t* buffer){
     return ret;
 }
 
-void UNIXPipe::Watch(FilesystemWatcher& watcher, int events){
+void UNIXPipe::Watch(KernelObjectWatcher& watcher, int events){
     ScopedSpinLock acq(watchingLock);
+    if(end == ReadEnd && (events & POLLIN) && (stream->Pos() || widowed)){
+        watcher.Signal(); // Data was written before we started watching
+        return;
+    }
+
     watching.add_back(&watcher);
 }
 
-void UNIXPipe::Unwatch(FilesystemWatcher& watcher){
+void UNIXPipe::Unwatch(KernelObjectWatcher& watcher){
     ScopedSpinLock acq(watchingLock);
     watching.remove(&watcher);
 }
@@ -2,6 +2,9 @@
 
 #include <Errno.h>
 #include <Debug.h>
+#include <Math.h>
+#include <MM/ZeroedPagePool.h>
+#include <PhysicalAllocator.h>
 
 namespace fs::Temp{
     TempVolume::TempVolume(const char* name){
@@ -9,6 +12,8 @@ namespace fs::Temp{
         mountPoint->parent = fs::GetRoot();
 
         mountPointDirent = DirectoryEntry(mountPoint, name);
+
+        memoryLimit = ((Memory::maxPhysicalBlocks - Memory::usedPhysicalBlocks) / TEMP_MEMORY_LIMIT_DIVISOR) << TEMP_PAGE_SHIFT;
     }
 
     void TempVolume::SetVolumeID(volume_id_t id){
@@ -17,51 +22,24 @@ namespace fs::Temp{
         mountPoint->volumeID = volumeID;
     }
 
-    void TempVolume::ReallocateNode(TempNode* node, size_t oldSize){
-        unsigned newBufferSize = (node->size + (TEMP_BUFFER_CHUNK_SIZE - 1)) & (~(TEMP_BUFFER_CHUNK_SIZE - 1)); // Round up to multiple of the chunk size
-
-        if(newBufferSize <= 0){
-            if(node->buffer){
-                delete node->buffer;
-
-                node->buffer = nullptr;
+    uint64_t TempVolume::AllocatePage(){
+        {
+            ScopedSpinLock lock(memoryLock);
+            if(memoryUsage + TEMP_PAGE_SIZE > memoryLimit){
+                return 0;
             }
 
-            memoryUsage -= node->bufferSize;
-            node->bufferSize = 0;
-        } else if(newBufferSize > node->bufferSize){
-            if(!node->buffer){
-                node->buffer = new uint8_t[newBufferSize];
-
-                memoryUsage += newBufferSize;
-            } else {
-                uint8_t* newBuffer = new uint8_t[newBufferSize];
-                memcpy(newBuffer, node->buffer, oldSize);
-
-                delete node->buffer;
-                node->buffer = newBuffer;
-
-                memoryUsage += newBufferSize - node->bufferSize;
-            }
-
-            node->bufferSize = newBufferSize;
-        } else if(newBufferSize < node->bufferSize){
-            if(!node->buffer){
-                node->buffer = new uint8_t[newBufferSize];
-
-                memoryUsage += newBufferSize;
-            } else {
-                uint8_t* newBuffer = new uint8_t[newBufferSize];
-                memcpy(newBuffer, node->buffer, node->size);
+            memoryUsage += TEMP_PAGE_SIZE;
+        }
 
-                delete node->buffer;
-                node->buffer = newBuffer;
+        return Memory::AllocateZeroedPhysicalMemoryBlock();
+    }
 
-                memoryUsage -= (node->bufferSize - newBufferSize);
-            }
+    void TempVolume::FreePage(uint64_t phys){
+        Memory::FreePhysicalMemoryBlock(phys);
 
-            node->bufferSize = newBufferSize;
-        }
+        ScopedSpinLock lock(memoryLock);
+        memoryUsage -= TEMP_PAGE_SIZE;
     }
 
     TempNode::TempNode(TempVolume* v, int createFlags){
@@ -75,13 +53,7 @@ namespace fs::Temp{
 
         flags = createFlags;
 
-        if((flags & FS_NODE_TYPE) == FS_NODE_FILE){
-            bufferLock = ReadWriteLock();
-            buffer = nullptr;
-            bufferSize = 0;
-        } else if((flags & FS_NODE_TYPE) == FS_NODE_DIRECTORY){
-            children = List<DirectoryEntry>();
-        } else {
+        if((flags & FS_NODE_TYPE) != FS_NODE_FILE && (flags & FS_NODE_TYPE) != FS_NODE_DIRECTORY){
             assert(!"TempNode not regular file or directory!");
         }
     }
@@ -91,8 +63,57 @@ namespace fs::Temp{
             for(auto& ent : children){
                 Unlink(&ent, true); // Unlink all files
             }
-        } else if(buffer){
-            delete buffer;
+        } else if(pages){
+            FreePages(0);
+            delete[] pages;
+        }
+    }
+
+    uint8_t* TempNode::GetPage(size_t index, bool allocate){
+        if(index >= pageArraySize){
+            if(!allocate){
+                return nullptr; // Hole past the end of the page array
+            }
+
+            // Grow geometrically so appending is amortized O(1) per page
+            size_t newArraySize = pageArraySize ? pageArraySize : 16;
+            while(newArraySize <= index){
+                newArraySize *= 2;
+            }
+
+            uint32_t* newPages = new uint32_t[newArraySize];
+            if(pages){
+                memcpy(newPages, pages, pageArraySize * sizeof(uint32_t));
+                delete[] pages;
+            }
+            memset(newPages + pageArraySize, 0, (newArraySize - pageArraySize) * sizeof(uint32_t));
+
+            pages = newPages;
+            pageArraySize = newArraySize;
+        }
+
+        if(!pages[index]){
+            if(!allocate){
+                return nullptr;
+            }
+
+            uint64_t phys = vol->AllocatePage();
+            if(!phys){
+                return nullptr; // Out of space
+            }
+
+            pages[index] = phys >> TEMP_PAGE_SHIFT;
+        }
+
+        return reinterpret_cast<uint8_t*>(Memory::GetDirectMapping(static_cast<uint64_t>(pages[index]) << TEMP_PAGE_SHIFT));
+    }
+
+    void TempNode::FreePages(size_t index){
+        for(size_t i = index; i < pageArraySize; i++){
+            if(pages[i]){
+                vol->FreePage(static_cast<uint64_t>(pages[i]) << TEMP_PAGE_SHIFT);
+                pages[i] = 0;
+            }
         }
     }
 
@@ -113,7 +134,9 @@ namespace fs::Temp{
             return -EISDIR;
         }
 
+        bufferLock.AcquireRead();
         if(off > size){
+            bufferLock.ReleaseRead();
             return 0;
         }
 
@@ -121,8 +144,20 @@ namespace fs::Temp{
             readSize = size - off;
         }
 
-        bufferLock.AcquireRead();
-        memcpy(readBuffer, buffer + off, readSize);
+        size_t read = 0;
+        while(read < readSize){
+            size_t pageOffset = (off + read) & (TEMP_PAGE_SIZE - 1);
+            size_t count = MIN(TEMP_PAGE_SIZE - pageOffset, readSize - read);
+
+            uint8_t* page = GetPage((off + read) >> TEMP_PAGE_SHIFT, false);
+            if(page){
+                memcpy(readBuffer + read, page + pageOffset, count);
+            } else {
+                memset(readBuffer + read, 0, count); // Hole
+            }
+
+            read += count;
+        }
         bufferLock.ReleaseRead();
 
         return readSize;
@@ -138,21 +173,33 @@ namespace fs::Temp{
         }
 
         bufferLock.AcquireWrite();
-        if(!buffer || off + writeSize > size){
-            size_t old = size;
-            size = off + writeSize;
 
-            if(size >= bufferSize){
-                vol->ReallocateNode(this, old);
+        size_t written = 0;
+        while(written < writeSize){
+            size_t pageOffset = (off + written) & (TEMP_PAGE_SIZE - 1);
+            size_t count = MIN(TEMP_PAGE_SIZE - pageOffset, writeSize - written);
+
+            uint8_t* page = GetPage((off + written) >> TEMP_PAGE_SHIFT, true);
+            if(!page){
+                break; // Reached the memory limit
             }
+
+            memcpy(page + pageOffset, writeBuffer + written, count);
+            written += count;
         }
 
-        Log::Debug(debugLevelTmpFS, DebugLevelVerbose, "Writing (offset: %u, size: %u, nsize: %u, bsize: %u)", off, writeSize, size, bufferSize);
+        if(off + written > size){
+            size = off + written;
+        }
 
-        memcpy(buffer + off, writeBuffer, writeSize);
+        Log::Debug(debugLevelTmpFS, DebugLevelVerbose, "Writing (offset: %u, size: %u, nsize: %u, pages: %u)", off, writeSize, size, pageArraySize);
         bufferLock.ReleaseWrite();
 
-        return writeSize;
+        if(!written){
+            return -ENOSPC;
+        }
+
+        return written;
     }
 
     int TempNode::Truncate(off_t length){
@@ -166,9 +213,20 @@ namespace fs::Temp{
 
         bufferLock.AcquireWrite();
 
-        size_t old = size;
-        size = length;
-        vol->ReallocateNode(this, old);
+        if(static_cast<size_t>(length) < size && pages){
+            size_t firstUnused = (length + TEMP_PAGE_SIZE - 1) >> TEMP_PAGE_SHIFT;
+            FreePages(firstUnused);
+
+            // Zero the tail of the last page so the data does not reappear if the file gets extended
+            if(length & (TEMP_PAGE_SIZE - 1)){
+                if(uint8_t* page = GetPage(length >> TEMP_PAGE_SHIFT, false)){
+                    size_t pageOffset = length & (TEMP_PAGE_SIZE - 1);
+                    memset(page + pageOffset, 0, TEMP_PAGE_SIZE - pageOffset);
+                }
+            }
+        }
+
+        size = length; // Extending the file just leaves a hole
 
         bufferLock.ReleaseWrite();
 
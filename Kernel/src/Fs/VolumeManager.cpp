@@ -104,6 +104,8 @@ int Unmount(const char* name) {
 }
 
 void RegisterVolume(FsVolume* volume) {
+    ScopedSpinLock lockVolumes(volumeManagerLock);
+
     volume->SetVolumeID(nextVolumeID++);
     if(volume->mountPoint){
         volume->mountPoint->parent = fs::GetRoot();
@@ -112,6 +114,8 @@ void RegisterVolume(FsVolume* volume) {
 }
 
 int UnregisterVolume(FsVolume* volume) {
+    ScopedSpinLock lockVolumes(volumeManagerLock);
+
     for (auto it = volumes->begin(); it != volumes->end(); it++) {
         if (*it == volume) {
             volumes->remove(it);
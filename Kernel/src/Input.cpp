@@ -0,0 +1,147 @@
+#include <Input.h>
+
+#include <CPU.h>
+#include <CString.h>
+#include <Device.h>
+#include <Errno.h>
+#include <Fs/Filesystem.h>
+#include <List.h>
+#include <Lock.h>
+#include <Timer.h>
+
+// Events copied out of the queue at a time, the user buffer may fault so it is not touched with the lock held
+#define INPUT_READ_CHUNK 16
+
+namespace Input {
+class InputDevice final : public Device {
+public:
+    InputDevice(const char* name) : Device(name, DeviceTypeLegacyHID) {
+        flags = FS_NODE_CHARDEVICE;
+
+        SetDeviceName("Input Event Queue");
+    }
+
+    ssize_t Read(size_t offset, size_t size, uint8_t* buffer) override {
+        size_t count = size / sizeof(lemon_input_event_t);
+
+        size_t read = 0;
+        while (read < count) {
+            lemon_input_event_t events[INPUT_READ_CHUNK];
+
+            unsigned chunk = 0;
+            {
+                ScopedSpinLock<true> lockQueue(m_lock);
+                while (chunk < INPUT_READ_CHUNK && read + chunk < count && m_count > 0) {
+                    events[chunk++] = m_queue[m_head];
+
+                    m_head = (m_head + 1) & (INPUT_QUEUE_SIZE - 1);
+                    m_count--;
+                }
+            }
+
+            if (!chunk) {
+                break;
+            }
+
+            memcpy(buffer + read * sizeof(lemon_input_event_t), events, chunk * sizeof(lemon_input_event_t));
+            read += chunk;
+        }
+
+        return read * sizeof(lemon_input_event_t);
+    }
+
+    int Ioctl(uint64_t cmd, uint64_t arg) override {
+        switch (cmd) {
+        case IoCtlInputGetTimestampFrequency:
+            return Timer::TSCFrequency() / 1000;
+        case IoCtlInputGetDroppedEvents:
+            return m_dropped;
+        default:
+            return -EINVAL;
+        }
+    }
+
+    bool CanRead() override { return __atomic_load_n(&m_count, __ATOMIC_RELAXED) > 0; }
+
+    void Watch(KernelObjectWatcher& watcher, int events) override {
+        ScopedSpinLock<true> lockQueue(m_lock);
+        if (!(events & POLLIN) || m_count > 0) {
+            watcher.Signal();
+            return;
+        }
+
+        m_watching.add_back(&watcher);
+    }
+
+    void Unwatch(KernelObjectWatcher& watcher) override {
+        ScopedSpinLock<true> lockQueue(m_lock);
+        m_watching.remove(&watcher);
+    }
+
+    // Called from interrupt handlers
+    void Post(const lemon_input_event_t& ev) {
+        ScopedSpinLock<true> lockQueue(m_lock);
+
+        if (ev.type == InputEventMouse && m_count > 0) {
+            lemon_input_event_t& last = m_queue[(m_head + m_count - 1) & (INPUT_QUEUE_SIZE - 1)];
+
+            // Only motion is coalesced, button changes and scrolling each get their own event
+            int x = last.xMovement + ev.xMovement;
+            int y = last.yMovement + ev.yMovement;
+            if (last.type == InputEventMouse && last.buttons == ev.buttons && !last.verticalScroll &&
+                !ev.verticalScroll && x >= INT16_MIN && x <= INT16_MAX && y >= INT16_MIN && y <= INT16_MAX) {
+                last.xMovement = x;
+                last.yMovement = y;
+                last.packets++;
+                return; // Readers have already been woken for the last event
+            }
+        }
+
+        if (m_count >= INPUT_QUEUE_SIZE) {
+            m_dropped++;
+            return;
+        }
+
+        m_queue[(m_head + m_count) & (INPUT_QUEUE_SIZE - 1)] = ev;
+        m_count++;
+
+        while (m_watching.get_length()) {
+            m_watching.remove_at(0)->Signal();
+        }
+    }
+
+private:
+    lemon_input_event_t m_queue[INPUT_QUEUE_SIZE];
+    unsigned m_head = 0;
+    unsigned m_count = 0;
+    unsigned m_dropped = 0;
+
+    // Taken with interrupts disabled as events are posted from interrupt handlers
+    lock_t m_lock = 0;
+    List<KernelObjectWatcher*> m_watching;
+};
+
+InputDevice inputDev("input");
+
+void PostKey(uint8_t keyCode) {
+    lemon_input_event_t ev = {};
+    ev.timestamp = ReadTSC();
+    ev.type = InputEventKey;
+    ev.keyCode = keyCode;
+
+    inputDev.Post(ev);
+}
+
+void PostMouse(uint8_t buttons, int xMovement, int yMovement, int8_t verticalScroll) {
+    lemon_input_event_t ev = {};
+    ev.timestamp = ReadTSC();
+    ev.type = InputEventMouse;
+    ev.buttons = buttons;
+    ev.verticalScroll = verticalScroll;
+    ev.xMovement = xMovement;
+    ev.yMovement = yMovement;
+    ev.packets = 1;
+
+    inputDev.Post(ev);
+}
+} // namespace Input
@@ -1,4 +1,5 @@
 #include <Audio/Audio.h>
+#include <BootTrace.h>
 #include <CPU.h>
 #include <Fs/TAR.h>
 #include <Fs/Tmp.h>
@@ -7,6 +8,9 @@
 #include <Lemon.h>
 #include <Logging.h>
 #include <MM/KMalloc.h>
+#include <MM/KernelStack.h>
+#include <MM/Shrinker.h>
+#include <MM/ZeroedPagePool.h>
 #include <Math.h>
 #include <Modules.h>
 #include <Net/Net.h>
@@ -36,45 +40,128 @@ void IdleProcess() {
     Thread* th = Thread::Current();
     for (;;) {
         th->timeSlice = 0;
-        asm volatile("pause");
+
+        // Use idle time to top up the pre-zeroed page pool
+        if (!Memory::RefillZeroedPagePool(1)) {
+            asm volatile("pause");
+        }
     }
 }
 
 void syscall_init();
 
+// Boot work which does not depend on anything else still initializing,
+// such as probing a controller or loading a module
+struct BootTask {
+    const char* name;
+    int (*func)(void* arg);
+    void* arg;
+    int status = 0;
+};
+
+static void BootTaskThread(BootTask* task) {
+    {
+        BootTrace::ScopedPhase phase(task->name);
+        task->status = task->func(task->arg);
+    }
+
+    acquireLock(&Thread::Current()->kernelLock); // Process::Die expects the lock to be held
+    Process::Current()->Die();
+}
+
+// Run each task on its own kernel thread and wait for them all to finish
+static void RunBootTasks(Vector<BootTask>& tasks) {
+    Vector<FancyRefPtr<Process>> workers;
+    for (unsigned i = 0; i < tasks.size(); i++) {
+        FancyRefPtr<Process> proc = Process::CreateKernelProcess((void*)BootTaskThread, tasks[i].name, nullptr);
+        proc->GetMainThread()->registers.rdi = reinterpret_cast<uintptr_t>(&tasks[i]);
+        proc->Start();
+
+        workers.add_back(proc);
+    }
+
+    for (auto& proc : workers) {
+        KernelObjectWatcher watcher;
+        proc->Watch(watcher, 0);
+
+        while (watcher.Wait())
+            ; // Keep waiting if we were interrupted
+    }
+}
+
+// Returns 1 if the module should be retried once the other modules have loaded
+static int LoadBootModule(void* path) {
+    ModuleLoadStatus status = ModuleManager::LoadModule(reinterpret_cast<const char*>(path));
+
+    // The module may depend on symbols from another module which has not loaded yet
+    return status.status == ModuleLoadStatus::ModuleFailure && status.code == ErrorUnresolvedSymbol;
+}
+
 void KernelProcess() {
-    NVMe::Initialize();
-    USB::XHCIController::Initialize();
-    ATA::Init();
-    AHCI::Init();
+    Log::StartLogThread();
+
+    {
+        BootTrace::ScopedPhase phase("Memory pools");
+        Memory::InitializeZeroedPagePool();
+        Memory::InitializeKernelStackPool();
+        Memory::InitializeReclaim();
+    }
+
+    {
+        BootTrace::ScopedPhase phase("Services");
+        ServiceFS::Initialize();
 
-    ServiceFS::Initialize();
+        Network::InitializeConnections();
+        Audio::InitializeSystem();
+    }
 
-    Network::InitializeConnections();
-    Audio::InitializeSystem();
+    // Controllers are probed and modules loaded concurrently,
+    // most of the time is spent waiting on hardware
+    Vector<BootTask> tasks;
+    tasks.add_back({"NVMe", [](void*) -> int { NVMe::Initialize(); return 0; }, nullptr});
+    tasks.add_back({"XHCI", [](void*) -> int { return USB::XHCIController::Initialize(); }, nullptr});
+    tasks.add_back({"ATA", [](void*) -> int { return ATA::Init(); }, nullptr});
+    tasks.add_back({"AHCI", [](void*) -> int { return AHCI::Init(); }, nullptr});
 
+    unsigned firstModuleTask = tasks.size();
+    char* modulesBuffer = nullptr;
     if (FsNode* node = fs::ResolvePath("/initrd/modules.cfg")) {
-        char* buffer = new char[node->size + 1];
+        modulesBuffer = new char[node->size + 1];
 
-        ssize_t read = fs::Read(node, 0, node->size, buffer);
+        ssize_t read = fs::Read(node, 0, node->size, modulesBuffer);
         if (read > 0) {
-            buffer[read] = 0; // Null-terminate the buffer
+            modulesBuffer[read] = 0; // Null-terminate the buffer
 
             char* save;
-            char* path = strtok_r(buffer, "\n", &save);
+            char* path = strtok_r(modulesBuffer, "\n", &save);
             while (path) {
                 if (strlen(path) > 0) {
-                    ModuleManager::LoadModule(path); // modules.cfg should contain a list of paths to modules
+                    tasks.add_back({path, LoadBootModule, path}); // modules.cfg should contain a list of paths to modules
                 }
 
                 path = strtok_r(nullptr, "\n", &save);
             }
         }
+    }
+
+    {
+        BootTrace::ScopedPhase phase("Drivers");
+        RunBootTasks(tasks);
 
-        delete[] buffer;
+        for (unsigned i = firstModuleTask; i < tasks.size(); i++) {
+            if (tasks[i].status) {
+                Log::Info("Retrying module '%s'", tasks[i].name);
+                ModuleManager::LoadModule(tasks[i].name);
+            }
+        }
     }
 
-    fs::VolumeManager::MountSystemVolume();
+    delete[] modulesBuffer;
+
+    {
+        BootTrace::ScopedPhase phase("System volume");
+        fs::VolumeManager::MountSystemVolume();
+    }
 
     // TODO: Move this to userspace
     fs::VolumeManager::RegisterVolume(new fs::LinkVolume("/system/etc", "etc"));
@@ -99,6 +186,7 @@ void KernelProcess() {
 
     PTMultiplexor::Initialize();
 
+    int initPhase = BootTrace::Begin("Init");
     Log::Info("Loading Init Process...");
     FsNode* initFsNode = nullptr;
 
@@ -118,9 +206,30 @@ void KernelProcess() {
 
     auto initProc = Process::CreateELFProcess(initElf, Vector<String>("init"), Vector<String>("PATH=/initrd"),
                                               "/system/lemon/init.lef", nullptr);
+    BootTrace::End(initPhase);
     initProc->Start();
 
+    BootTrace::Dump();
+
+    // Exited threads are held for a pass after they are taken off CPU,
+    // the scheduler marks them before it has switched off of their kernel stack
+    List<FancyRefPtr<Thread>> exitedThreads;
     for (;;) {
+        exitedThreads.clear();
+        {
+            ScopedSpinLock<true> lockDestroyedThreads(Scheduler::destroyedThreadsLock);
+            for (auto it = Scheduler::destroyedThreads->begin(); it != Scheduler::destroyedThreads->end(); it++) {
+                if ((*it)->cpu == -1) {
+                    exitedThreads.add_back(*it);
+                    Scheduler::destroyedThreads->remove(it);
+                }
+
+                if (it == Scheduler::destroyedThreads->end()) {
+                    break;
+                }
+            }
+        }
+
         acquireLock(&Scheduler::destroyedProcessesLock);
         for (auto it = Scheduler::destroyedProcesses->begin(); it != Scheduler::destroyedProcesses->end(); it++) {
             if (!(acquireTestLock(&(*it)->m_processLock))) {
@@ -184,6 +293,7 @@ extern "C" [[noreturn]] void kmain() {
 
     assert(fs::GetRoot());
 
+    int ramdiskPhase = BootTrace::Begin("Ramdisk");
     Log::Info("Initializing Ramdisk...");
 
     fs::tar::TarVolume* tar = new fs::tar::TarVolume(HAL::bootModules[0].base, HAL::bootModules[0].size, "initrd");
@@ -192,6 +302,7 @@ extern "C" [[noreturn]] void kmain() {
     Log::Write("OK");
 
     fs::VolumeManager::RegisterVolume(new fs::Temp::TempVolume("tmp")); // Create tmpfs instance
+    BootTrace::End(ramdiskPhase);
 
     FsNode* initrd = fs::FindDir(fs::GetRoot(), "initrd");
     FsNode* splashFile = nullptr;
@@ -210,6 +321,7 @@ extern "C" [[noreturn]] void kmain() {
             Log::Warning("Could not load splash image");
 
         if ((symbolFile = fs::FindDir(initrd, "kernel.map"))) {
+            BootTrace::ScopedPhase phase("Symbols");
             LoadSymbolsFromFile(symbolFile);
         } else {
             KernelPanic((const char*[]){"Failed to locate kernel.map!"}, 1);
@@ -223,7 +335,10 @@ extern "C" [[noreturn]] void kmain() {
 
     Log::Info("Initializing HID...");
 
-    PS2::Initialize();
+    {
+        BootTrace::ScopedPhase phase("PS2");
+        PS2::Initialize();
+    }
 
     Log::Info("OK");
 
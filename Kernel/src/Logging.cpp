@@ -1,51 +1,474 @@
 #include <Logging.h>
 
+#include <CPU.h>
 #include <Device.h>
 #include <Fs/Filesystem.h>
 #include <MM/KMalloc.h>
-#include <TTY/PTY.h>
+#include <Math.h>
+#include <Objects/Process.h>
+#include <SMP.h>
 #include <Serial.h>
 #include <String.h>
+#include <TTY/PTY.h>
+#include <Thread.h>
+#include <Timer.h>
 #include <Video/VideoConsole.h>
 #include <stdarg.h>
 
 namespace Log {
 VideoConsole* console = nullptr;
 
+struct LogRecord {
+    uint32_t length; // Length of the record including this header
+    LogLevel level;
+    uint8_t reserved;
+    uint16_t cpu;
+    uint64_t sequence; // Used to order records from different CPUs
+    uint64_t timestamp; // Microseconds since boot
+    char text[];
+};
+
+// Single producer (the owning CPU), single consumer (the log thread) ring of log records.
+// Offsets are absolute and only ever increase, a record never wraps around the end of the ring.
+struct LogRing {
+    uint64_t head = 0; // Written by the consumer
+    uint64_t tail = 0; // Written by the producer
+    uint64_t dropped = 0; // Records dropped because the ring was full
+    uint64_t droppedReported = 0; // Written by the consumer
+
+    // State of the record being written on the owning CPU
+    LogRecord* current = nullptr; // nullptr if the record is being dropped
+    unsigned depth = 0; // Amount of nested records
+    bool irq = false; // Interrupt state before the record was started
+
+    uint8_t data[LOG_RING_SIZE];
+};
+
+static_assert(!(LOG_RING_SIZE & (LOG_RING_SIZE - 1)));
+static_assert(!(LOG_HISTORY_SIZE & (LOG_HISTORY_SIZE - 1)));
+static_assert(LOG_RECORD_MAX * 2 <= LOG_RING_SIZE);
+
+LogRing* rings[256]; // Indexed by CPU ID
+uint64_t nextSequence = 0;
+
+// Set once the log thread is running, until then (and during a panic) output is synchronous
+bool asyncOutput = false;
 bool logBufferEnabled = false;
-char* logBuffer = nullptr;
-size_t logBufferPos = 0;
-size_t logBufferSize = 0;
-size_t logBufferMaxSize = 0x100000; // 1MB
 
-lock_t logLock = 0;
+lock_t logLock = 0; // Prevents synchronous messages from different CPUs being interleaved
+lock_t drainLock = 0; // Only one consumer may drain the rings at a time
+
+// Formatted log text read through /dev/kernellog
+char history[LOG_HISTORY_SIZE];
+uint64_t historyEnd = 0; // Offset of the end of the history
+uint64_t historyReserved = 0; // Data before historyReserved - LOG_HISTORY_SIZE may be getting overwritten
+lock_t historyLock = 0;
+
+List<KernelObjectWatcher*> watching;
+lock_t watchingLock = 0;
+
+Thread* logThread = nullptr;
 
 void WriteN(const char* str, size_t n);
 
-class LogDevice : public Device {
-public:
-    LogDevice(char* name) : Device(name, DeviceTypeKernelLog) { flags = FS_NODE_FILE; }
+// Append to the history, only used by the log thread and synchronous writers
+static void AppendHistory(const char* str, size_t n) {
+    if (n > LOG_HISTORY_SIZE) {
+        str += n - LOG_HISTORY_SIZE;
+        n = LOG_HISTORY_SIZE;
+    }
 
-    ssize_t Read(size_t offset, size_t size, uint8_t* buffer) {
-        if (!logBuffer)
-            return 0;
-        if (offset > logBufferPos)
+    __atomic_store_n(&historyReserved, historyEnd + n, __ATOMIC_RELEASE);
+
+    size_t pos = historyEnd & (LOG_HISTORY_SIZE - 1);
+    size_t count = MIN(n, LOG_HISTORY_SIZE - pos);
+
+    memcpy(history + pos, str, count);
+    memcpy(history, str + count, n - count);
+
+    __atomic_store_n(&historyEnd, historyEnd + n, __ATOMIC_RELEASE);
+}
+
+// Reads from the history without taking any locks.
+// If the reader has fallen behind, it skips to the oldest data still available.
+static ssize_t ReadHistory(uint64_t& cursor, uint8_t* buffer, size_t size) {
+    for (;;) {
+        uint64_t end = __atomic_load_n(&historyEnd, __ATOMIC_ACQUIRE);
+        if (end > LOG_HISTORY_SIZE && cursor < end - LOG_HISTORY_SIZE) {
+            cursor = end - LOG_HISTORY_SIZE;
+        }
+
+        if (cursor >= end) {
             return 0;
+        }
+
+        size_t n = MIN(size, end - cursor);
+        size_t pos = cursor & (LOG_HISTORY_SIZE - 1);
+        size_t count = MIN(n, LOG_HISTORY_SIZE - pos);
+
+        memcpy(buffer, history + pos, count);
+        memcpy(buffer + count, history, n - count);
+
+        // Make sure the writer did not overwrite what we just read
+        uint64_t reserved = __atomic_load_n(&historyReserved, __ATOMIC_ACQUIRE);
+        if (reserved > LOG_HISTORY_SIZE && cursor < reserved - LOG_HISTORY_SIZE) {
+            continue;
+        }
+
+        cursor += n;
+        return n;
+    }
+}
+
+static size_t FormatPrefix(char* buffer, LogLevel level, uint64_t timestamp, bool showTimestamp) {
+    const char* tag;
+    switch (level) {
+    case LogLevelInfo:
+        tag = "[INFO]    ";
+        break;
+    case LogLevelWarning:
+        tag = "[WARN]    ";
+        break;
+    case LogLevelError:
+        tag = "[ERROR]   ";
+        break;
+    case LogLevelDebug:
+        tag = "[DEBUG]   ";
+        break;
+    default:
+        return 0; // Continuations have no prefix
+    }
+
+    size_t len = 0;
+    buffer[len++] = '\r';
+    buffer[len++] = '\n';
+
+    if (showTimestamp) {
+        // [sssss.uuuuuu]
+        char num[24];
+        uint64_t seconds = timestamp / 1000000;
+        uint64_t us = timestamp % 1000000;
+
+        buffer[len++] = '[';
+        itoa(seconds, num, 10);
+        for (size_t i = strlen(num); i < 5; i++) {
+            buffer[len++] = ' ';
+        }
+        strcpy(buffer + len, num);
+        len += strlen(num);
+
+        buffer[len++] = '.';
+        itoa(us, num, 10);
+        for (size_t i = strlen(num); i < 6; i++) {
+            buffer[len++] = '0';
+        }
+        strcpy(buffer + len, num);
+        len += strlen(num);
+
+        buffer[len++] = ']';
+        buffer[len++] = ' ';
+    }
+
+    strcpy(buffer + len, tag);
+    return len + strlen(tag);
+}
+
+static void ConsoleWrite(const char* str, size_t n, LogLevel level) {
+    if (!console) {
+        return;
+    }
+
+    if (level == LogLevelWarning) {
+        console->PrintN(str, n, 255, 255, 0);
+    } else if (level == LogLevelError) {
+        console->PrintN(str, n, 255, 0, 0);
+    } else {
+        console->PrintN(str, n, 255, 255, 255);
+    }
+}
+
+// Output a record to the serial port, video console and history
+static void OutputRecord(LogLevel level, uint64_t timestamp, const char* text, size_t length) {
+    char prefix[64];
+    size_t prefixLength = FormatPrefix(prefix, level, timestamp, true);
+
+    Serial::Write(prefix, prefixLength);
+    Serial::Write(text, length);
+
+    if (console) {
+        char consolePrefix[16];
+        size_t consolePrefixLength = FormatPrefix(consolePrefix, level, timestamp, false);
+
+        ConsoleWrite(consolePrefix, consolePrefixLength, level);
+        console->PrintN(text, length, 255, 255, 255);
+    }
+
+    if (!logBufferEnabled) {
+        return;
+    }
+
+    // Whilst draining synchronously (e.g. in a panic) do not wait on the lock,
+    // another CPU may have halted whilst holding it
+    if (asyncOutput) {
+        acquireLock(&historyLock);
+    } else if (acquireTestLock(&historyLock)) {
+        return;
+    }
+
+    AppendHistory(prefix, prefixLength);
+    AppendHistory(text, length);
+    releaseLock(&historyLock);
+}
+
+// Gets the ring for the current CPU and starts a record with interrupts disabled.
+// Returns nullptr if output should be synchronous.
+static LogRing* BeginRecord(LogLevel level) {
+    if (!__atomic_load_n(&asyncOutput, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+
+    bool irq = CheckInterrupts();
+    asm volatile("cli");
+
+    LogRing* ring = rings[GetCPULocal()->id];
+    if (!ring) {
+        if (irq) {
+            asm volatile("sti");
+        }
+        return nullptr;
+    }
+
+    if (ring->depth++) {
+        return ring; // Nested message (e.g. an exception whilst logging), append to the current record
+    }
+
+    ring->irq = irq;
+    ring->current = nullptr;
+
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->tail;
+
+    size_t free = LOG_RING_SIZE - (tail - head);
+    size_t contiguous = LOG_RING_SIZE - (tail & (LOG_RING_SIZE - 1));
+
+    if (contiguous < LOG_RECORD_MAX) {
+        if (free < contiguous + LOG_RECORD_MAX) {
+            ring->dropped++;
+            return ring;
+        }
+
+        // Not enough space at the end of the ring, pad it out and start at the beginning
+        LogRecord* padding = reinterpret_cast<LogRecord*>(&ring->data[tail & (LOG_RING_SIZE - 1)]);
+        padding->length = contiguous;
+        padding->level = LogLevelPadding;
+
+        tail += contiguous;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    } else if (free < LOG_RECORD_MAX) {
+        ring->dropped++;
+        return ring;
+    }
+
+    LogRecord* record = reinterpret_cast<LogRecord*>(&ring->data[tail & (LOG_RING_SIZE - 1)]);
+    record->length = sizeof(LogRecord);
+    record->level = level;
+    record->cpu = GetCPULocal()->id;
+    record->sequence = __atomic_fetch_add(&nextSequence, 1, __ATOMIC_RELAXED);
+    record->timestamp = Timer::UsecondsSinceBoot();
+
+    ring->current = record;
+    return ring;
+}
+
+static void AppendRecord(LogRing* ring, const char* str, size_t n) {
+    LogRecord* record = ring->current;
+    if (!record) {
+        return; // Dropped
+    }
+
+    size_t space = LOG_RECORD_MAX - record->length;
+    if (n > space) {
+        n = space; // Truncate
+    }
+
+    memcpy(reinterpret_cast<uint8_t*>(record) + record->length, str, n);
+    record->length += n;
+}
+
+static void EndRecord(LogRing* ring) {
+    if (--ring->depth) {
+        return;
+    }
+
+    if (ring->current) {
+        // Keep records 8 byte aligned
+        size_t length = (ring->current->length + 7) & ~static_cast<size_t>(7);
+        __atomic_store_n(&ring->tail, ring->tail + length, __ATOMIC_RELEASE);
+
+        ring->current = nullptr;
+    }
+
+    if (ring->irq) {
+        asm volatile("sti");
+    }
+}
+
+// Output the oldest records from all of the rings in order.
+// Returns the amount of records output.
+static unsigned Drain() {
+    if (acquireTestLock(&drainLock)) {
+        return 0; // Someone else is draining
+    }
+
+    unsigned count = 0;
+    for (;;) {
+        LogRing* oldestRing = nullptr;
+        LogRecord* oldest = nullptr;
+
+        for (LogRing* ring : rings) {
+            if (!ring) {
+                continue;
+            }
+
+            uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            while (ring->head < tail) {
+                LogRecord* record = reinterpret_cast<LogRecord*>(&ring->data[ring->head & (LOG_RING_SIZE - 1)]);
+                if (record->level != LogLevelPadding) {
+                    if (!oldest || record->sequence < oldest->sequence) {
+                        oldest = record;
+                        oldestRing = ring;
+                    }
+                    break;
+                }
+
+                __atomic_store_n(&ring->head, ring->head + record->length, __ATOMIC_RELEASE);
+            }
+        }
 
-        if (size + offset > logBufferPos)
-            size = logBufferPos - offset;
-        memcpy(buffer, logBuffer + offset, size);
+        if (!oldest) {
+            break;
+        }
+
+        if (oldestRing->dropped != oldestRing->droppedReported) {
+            char message[64] = "Log ring full, dropped ";
+            itoa(oldestRing->dropped - oldestRing->droppedReported, message + strlen(message), 10);
+            strcat(message, " message(s)");
+
+            OutputRecord(LogLevelWarning, oldest->timestamp, message, strlen(message));
+            oldestRing->droppedReported = oldestRing->dropped;
+        }
+
+        OutputRecord(oldest->level, oldest->timestamp, oldest->text, oldest->length - sizeof(LogRecord));
+
+        size_t length = (oldest->length + 7) & ~static_cast<size_t>(7);
+        __atomic_store_n(&oldestRing->head, oldestRing->head + length, __ATOMIC_RELEASE);
+
+        count++;
+    }
+
+    releaseLock(&drainLock);
+
+    if (count) {
+        if (console) {
+            console->Update();
+        }
+
+        ScopedSpinLock acq(watchingLock);
+        for (auto& w : watching) {
+            w->Signal();
+        }
+        watching.clear();
+    }
+
+    return count;
+}
+
+[[noreturn]] void LogThread() {
+    __atomic_store_n(&asyncOutput, true, __ATOMIC_RELEASE);
+
+    for (;;) {
+        if (!Drain()) {
+            Thread::Current()->Sleep(LOG_DRAIN_INTERVAL);
+        }
+    }
+}
+
+// Each open handle to /dev/kernellog gets its own reader so it can keep track of
+// where it is in the log and if there is anything new to read
+class LogReader final : public FsNode {
+public:
+    LogReader() {
+        flags = FS_NODE_FILE;
+
+        uint64_t end = __atomic_load_n(&historyEnd, __ATOMIC_ACQUIRE);
+        cursor = end > LOG_HISTORY_SIZE ? end - LOG_HISTORY_SIZE : 0; // Start at the oldest message
+    }
+
+    ssize_t Read(size_t, size_t size, uint8_t* buffer) override { return ReadHistory(cursor, buffer, size); }
+
+    ssize_t Write(size_t, size_t size, uint8_t* buffer) override {
+        WriteN((char*)buffer, size);
 
         return size;
     }
 
-    ssize_t Write(size_t offset, size_t size, uint8_t* buffer) {
+    int Ioctl(uint64_t cmd, uint64_t arg) override {
+        if (cmd == TIOCGWINSZ)
+            return 0; // Pretend to be a terminal
+        else
+            return -1;
+    }
+
+    bool CanRead() override { return cursor < __atomic_load_n(&historyEnd, __ATOMIC_ACQUIRE); }
+
+    void Watch(KernelObjectWatcher& watcher, int events) override {
+        ScopedSpinLock acq(watchingLock);
+        if (CanRead()) {
+            watcher.Signal();
+            return;
+        }
+
+        watching.add_back(&watcher);
+    }
+
+    void Unwatch(KernelObjectWatcher& watcher) override {
+        ScopedSpinLock acq(watchingLock);
+        watching.remove(&watcher);
+    }
+
+    void Close() override {
+        handleCount--;
+
+        if (handleCount <= 0) {
+            delete this;
+        }
+    }
+
+private:
+    uint64_t cursor; // Offset in the history
+};
+
+class LogDevice : public Device {
+public:
+    LogDevice(char* name) : Device(name, DeviceTypeKernelLog) { flags = FS_NODE_FILE; }
+
+    ErrorOr<UNIXOpenFile*> Open(size_t flags) override {
+        LogReader* reader = new LogReader();
+        return reader->Open(flags);
+    }
+
+    ssize_t Read(size_t offset, size_t size, uint8_t* buffer) override {
+        uint64_t cursor = offset;
+        return ReadHistory(cursor, buffer, size);
+    }
+
+    ssize_t Write(size_t offset, size_t size, uint8_t* buffer) override {
         WriteN((char*)buffer, size);
 
         return size;
     }
 
-    int Ioctl(uint64_t cmd, uint64_t arg) {
+    int Ioctl(uint64_t cmd, uint64_t arg) override {
         if (cmd == TIOCGWINSZ)
             return 0; // Pretend to be a terminal
         else
@@ -60,54 +483,91 @@ void LateInitialize() { logDevice = new LogDevice("kernellog"); }
 void SetVideoConsole(VideoConsole* con) { console = con; }
 
 void EnableBuffer() {
-    if (!logBuffer) {
-        logBufferSize = 4096;
-        logBuffer = (char*)kmalloc(logBufferSize);
-        logBufferPos = 0;
+    for (unsigned i = 0; i < sizeof(rings) / sizeof(*rings); i++) {
+        if (SMP::cpus[i] && !rings[i]) {
+            rings[i] = new LogRing();
+        }
     }
 
     logBufferEnabled = true;
 }
 
-void DisableBuffer() { logBufferEnabled = false; }
+void DisableBuffer() {
+    __atomic_store_n(&asyncOutput, false, __ATOMIC_RELEASE);
+
+    Drain(); // Flush anything still in the rings
+}
+
+void StartLogThread() {
+    FancyRefPtr<Process> proc = Process::CreateKernelProcess((void*)LogThread, "KernelLog", nullptr);
+    logThread = proc->GetMainThread().get();
+
+    proc->Start();
+}
 
 void WriteN(const char* str, size_t n) {
+    if (LogRing* ring = BeginRecord(LogLevelPrint)) {
+        AppendRecord(ring, str, n);
+        EndRecord(ring);
+        return;
+    }
+
     Serial::Write(str, n);
+    ConsoleWrite(str, n, LogLevelPrint);
 
-    if (console) {
-        console->PrintN(str, n, 255, 255, 255);
+    if (logBufferEnabled && !acquireTestLock(&historyLock)) {
+        AppendHistory(str, n);
+        releaseLock(&historyLock);
     }
+}
 
-    if (logBufferEnabled) {
-        if (n >= logBufferMaxSize) {
-            n -= (n - logBufferMaxSize);
+// Begins a message at level, output of the message is either written
+// to a log ring or synchronously if the log thread is not running
+class MessageScope final {
+public:
+    MessageScope(LogLevel level) {
+        m_ring = BeginRecord(level);
+        if (m_ring) {
+            return;
         }
 
-        if (n + logBufferPos >= logBufferSize) {
-            if (n > logBufferMaxSize) {
-                n = logBufferMaxSize;
-            }
+        m_locked = CheckInterrupts();
+        if (m_locked) {
+            acquireLock(&logLock);
+        }
 
-            if (n + logBufferPos > logBufferMaxSize || !CheckInterrupts()) {
-                size_t discard = (n + logBufferPos) - logBufferSize; // Amount of bytes to discard
+        char prefix[64];
+        size_t prefixLength = FormatPrefix(prefix, level, Timer::UsecondsSinceBoot(), true);
+        Serial::Write(prefix, prefixLength);
 
-                logBufferPos -= discard;
-                memcpy(logBuffer, logBuffer + discard, logBufferPos);
-            } else {
-                logBufferSize += 4096;
-                char* oldBuf = logBuffer;
-                logBuffer = (char*)kmalloc(logBufferSize);
-                memcpy(logBuffer, oldBuf, logBufferPos);
-                kfree(oldBuf);
-            }
+        if (logBufferEnabled && !acquireTestLock(&historyLock)) {
+            AppendHistory(prefix, prefixLength);
+            releaseLock(&historyLock);
         }
 
-        memcpy(logBuffer + logBufferPos, str, n);
-        logBufferPos += n;
+        prefixLength = FormatPrefix(prefix, level, 0, false);
+        ConsoleWrite(prefix, prefixLength, level);
+    }
 
-        logDevice->size = logBufferPos;
+    ~MessageScope() {
+        if (m_ring) {
+            EndRecord(m_ring);
+            return;
+        }
+
+        if (console) {
+            console->Update();
+        }
+
+        if (m_locked) {
+            releaseLock(&logLock);
+        }
     }
-}
+
+private:
+    LogRing* m_ring = nullptr;
+    bool m_locked = false;
+};
 
 void Write(const char* str, uint8_t r, uint8_t g, uint8_t b) { WriteN(str, strlen(str)); }
 
@@ -214,9 +674,11 @@ void WriteF(const char* __restrict format, va_list args) {
             format += len;
         }
     }
+}
 
-    if (console)
-        console->Update();
+void WriteF(LogLevel level, const char* __restrict format, va_list args) {
+    MessageScope message(level);
+    WriteF(format, args);
 }
 
 void Print(const char* __restrict fmt, ...) {
@@ -227,86 +689,39 @@ void Print(const char* __restrict fmt, ...) {
 }
 
 void Warning(const char* __restrict fmt, ...) {
-    if (CheckInterrupts())
-        acquireLock(&logLock);
-    Write("\r\n[WARN]    ", 255, 255, 0);
     va_list args;
     va_start(args, fmt);
-    WriteF(fmt, args);
+    WriteF(LogLevelWarning, fmt, args);
     va_end(args);
-    if (CheckInterrupts())
-        releaseLock(&logLock);
 }
 
 void Error(const char* __restrict fmt, ...) {
-    if (CheckInterrupts())
-        acquireLock(&logLock);
-    Write("\r\n[ERROR]   ", 255, 0, 0);
     va_list args;
     va_start(args, fmt);
-    WriteF(fmt, args);
+    WriteF(LogLevelError, fmt, args);
     va_end(args);
-    if (CheckInterrupts())
-        releaseLock(&logLock);
 }
 
 void Info(const char* __restrict fmt, ...) {
-    if (CheckInterrupts())
-        acquireLock(&logLock);
-    Write("\r\n[INFO]    ");
     va_list args;
     va_start(args, fmt);
-    WriteF(fmt, args);
+    WriteF(LogLevelInfo, fmt, args);
     va_end(args);
-    if (CheckInterrupts())
-        releaseLock(&logLock);
-}
-
-void Warning(const char* str) {
-    Write("\r\n[WARN]    ", 255, 255, 0);
-    Write(str);
 }
 
 void Warning(unsigned long long num) {
-    Write("\r\n[WARN]    ", 255, 255, 0);
-    // Write(str);
-}
-
-void Error(const char* str) {
-    Write("\r\n[ERROR]   ", 255, 0, 0);
-    Write(str);
+    MessageScope message(LogLevelWarning);
+    Write(num);
 }
 
 void Error(unsigned long long num, bool hex) {
-    Write("\r\n[ERROR]   ", 255, 0, 0);
-    char buf[32];
-
-    if (hex) {
-        buf[0] = '0';
-        buf[1] = 'x';
-    }
-    itoa(num, (char*)(buf + (hex ? 2 : 0)), hex ? 16 : 10);
-    Write(buf);
-}
-
-void Info(const char* str) {
-    Write("\r\n[INFO]    ");
-    Write(str);
+    MessageScope message(LogLevelError);
+    Write(num, hex);
 }
 
 void Info(unsigned long long num, bool hex) {
-    Write("\r\n");
-    Write("[");
-    Write("INFO");
-    Write("]    ");
-
-    char buf[32];
-    if (hex) {
-        buf[0] = '0';
-        buf[1] = 'x';
-    }
-    itoa(num, (char*)(buf + (hex ? 2 : 0)), hex ? 16 : 10);
-    Write(buf);
+    MessageScope message(LogLevelInfo);
+    Write(num, hex);
 }
 
 } // namespace Log
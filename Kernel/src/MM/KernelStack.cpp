@@ -0,0 +1,127 @@
+#include <MM/KernelStack.h>
+
+#include <Assert.h>
+#include <CPU.h>
+#include <Lock.h>
+#include <MM/Shrinker.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+#include <SMP.h>
+
+#define KERNEL_STACK_PAGES (KERNEL_STACK_SIZE / PAGE_SIZE_4K)
+
+namespace Memory {
+struct KernelStackCache {
+    void* stacks[KERNEL_STACK_CPU_CACHE_SIZE];
+    unsigned count = 0;
+};
+
+// Indexed by CPU ID like SMP::cpus, each is only touched by its own CPU with interrupts disabled
+KernelStackCache cpuStackCaches[256];
+
+void* kernelStackPool[KERNEL_STACK_POOL_SIZE];
+unsigned kernelStackPoolCount = 0;
+lock_t kernelStackPoolLock = 0;
+
+unsigned kernelStacksInUse = 0;
+
+static void DestroyKernelStack(void* base) {
+    uintptr_t virt = reinterpret_cast<uintptr_t>(base);
+    for (unsigned i = 0; i < KERNEL_STACK_PAGES; i++) {
+        FreePhysicalMemoryBlock(VirtualToPhysicalAddress(virt + i * PAGE_SIZE_4K));
+    }
+
+    KernelFree4KPages(reinterpret_cast<void*>(virt - KERNEL_STACK_GUARD_PAGES * PAGE_SIZE_4K),
+                      KERNEL_STACK_GUARD_PAGES + KERNEL_STACK_PAGES);
+}
+
+// Stacks sitting in the per-CPU caches are left alone, there are only a few of them
+class KernelStackShrinker final : public Shrinker {
+public:
+    KernelStackShrinker() : Shrinker("kernel-stacks") {}
+
+    size_t MemoryUsage() override {
+        size_t stacks = kernelStackPoolCount + kernelStacksInUse;
+        for (unsigned i = 0; i < SMP::processorCount; i++) {
+            stacks += cpuStackCaches[i].count;
+        }
+
+        return stacks * KERNEL_STACK_SIZE;
+    }
+
+    size_t ReclaimableMemory() override { return kernelStackPoolCount * KERNEL_STACK_SIZE; }
+
+    size_t Shrink(size_t pages) override {
+        InterruptDisabler disableInterrupts;
+        if (acquireTestLock(&kernelStackPoolLock)) {
+            return 0;
+        }
+
+        size_t freed = 0;
+        while (kernelStackPoolCount > 0 && freed < pages) {
+            DestroyKernelStack(kernelStackPool[--kernelStackPoolCount]);
+            freed += KERNEL_STACK_PAGES;
+        }
+
+        releaseLock(&kernelStackPoolLock);
+        return freed;
+    }
+} kernelStackShrinker;
+
+void InitializeKernelStackPool() { RegisterShrinker(&kernelStackShrinker); }
+
+void* AllocateKernelStack() {
+    __atomic_add_fetch(&kernelStacksInUse, 1, __ATOMIC_RELAXED);
+
+    {
+        InterruptDisabler disableInterrupts;
+        KernelStackCache& cache = cpuStackCaches[GetCPULocal()->id];
+        if (cache.count > 0) {
+            return cache.stacks[--cache.count];
+        }
+    }
+
+    {
+        ScopedSpinLock<true> lock(kernelStackPoolLock);
+        if (kernelStackPoolCount > 0) {
+            return kernelStackPool[--kernelStackPoolCount];
+        }
+    }
+
+    uintptr_t virt = reinterpret_cast<uintptr_t>(KernelAllocate4KPages(KERNEL_STACK_GUARD_PAGES + KERNEL_STACK_PAGES));
+
+    // Keep the guard pages reserved but not present
+    KernelMapVirtualMemory4K(0, virt, KERNEL_STACK_GUARD_PAGES, PAGE_KERNEL_GUARD);
+    virt += KERNEL_STACK_GUARD_PAGES * PAGE_SIZE_4K;
+
+    for (unsigned i = 0; i < KERNEL_STACK_PAGES; i++) {
+        KernelMapVirtualMemory4K(AllocatePhysicalMemoryBlock(), virt + i * PAGE_SIZE_4K, 1);
+    }
+
+    return reinterpret_cast<void*>(virt);
+}
+
+void FreeKernelStack(void* base) {
+    assert(base);
+    __atomic_sub_fetch(&kernelStacksInUse, 1, __ATOMIC_RELAXED);
+
+    {
+        InterruptDisabler disableInterrupts;
+        KernelStackCache& cache = cpuStackCaches[GetCPULocal()->id];
+        if (cache.count < KERNEL_STACK_CPU_CACHE_SIZE) {
+            cache.stacks[cache.count++] = base;
+            return;
+        }
+    }
+
+    {
+        ScopedSpinLock<true> lock(kernelStackPoolLock);
+        if (kernelStackPoolCount < KERNEL_STACK_POOL_SIZE) {
+            kernelStackPool[kernelStackPoolCount++] = base;
+            return;
+        }
+    }
+
+    DestroyKernelStack(base);
+}
+} // namespace Memory
@@ -0,0 +1,154 @@
+#include <MM/Shrinker.h>
+
+#include <CString.h>
+#include <List.h>
+#include <Lock.h>
+#include <Logging.h>
+#include <PhysicalAllocator.h>
+#include <Scheduler.h>
+#include <Timer.h>
+
+namespace Memory {
+List<Shrinker*> shrinkers;
+// Held for the whole of a reclaim pass so shrinkers cannot be unregistered mid pass
+lock_t shrinkersLock = 0;
+
+uint64_t reclaimedPages = 0;
+uint64_t directReclaimedPages = 0;
+
+FancyRefPtr<Process> reclaimProcess;
+// Signalled to wake the reclaim thread early
+Semaphore reclaimWakeup(0);
+// Incremented each time the reclaim thread finishes a pass
+uint64_t reclaimPasses = 0;
+
+Shrinker::Shrinker(const char* name, bool direct) : m_name(name), m_direct(direct) {}
+
+Shrinker::~Shrinker() {}
+
+static inline uint64_t LowWatermark() {
+    uint64_t watermark = usablePhysicalBlocks / RECLAIM_LOW_WATERMARK_DIVISOR;
+    return watermark > RECLAIM_MIN_LOW_WATERMARK ? watermark : RECLAIM_MIN_LOW_WATERMARK;
+}
+
+static inline uint64_t HighWatermark() {
+    uint64_t watermark = usablePhysicalBlocks / RECLAIM_HIGH_WATERMARK_DIVISOR;
+    return watermark > RECLAIM_MIN_HIGH_WATERMARK ? watermark : RECLAIM_MIN_HIGH_WATERMARK;
+}
+
+bool IsUnderMemoryPressure() { return FreePhysicalBlocks() < LowWatermark(); }
+
+void RegisterShrinker(Shrinker* shrinker) {
+    ScopedSpinLock lock(shrinkersLock);
+
+    shrinkers.add_back(shrinker);
+}
+
+void UnregisterShrinker(Shrinker* shrinker) {
+    ScopedSpinLock lock(shrinkersLock);
+
+    shrinkers.remove(shrinker);
+}
+
+size_t ReclaimMemory(size_t pages, bool direct) {
+    if (direct) {
+        // The allocator may be called with anything held, including by a shrinker
+        // in the middle of a reclaim pass, so never wait for the lock here
+        if (acquireTestLock(&shrinkersLock)) {
+            return 0;
+        }
+    } else {
+        acquireLock(&shrinkersLock);
+    }
+
+    size_t freed = 0;
+    for (Shrinker* shrinker : shrinkers) {
+        if (freed >= pages) {
+            break;
+        }
+
+        if (direct && !shrinker->IsDirect()) {
+            continue;
+        }
+
+        freed += shrinker->Shrink(pages - freed);
+    }
+
+    releaseLock(&shrinkersLock);
+
+    if (direct) {
+        __atomic_add_fetch(&directReclaimedPages, freed, __ATOMIC_RELAXED);
+    } else {
+        __atomic_add_fetch(&reclaimedPages, freed, __ATOMIC_RELAXED);
+    }
+
+    return freed;
+}
+
+unsigned GetShrinkerInfo(lemon_cache_info_t* info, unsigned max) {
+    ScopedSpinLock lock(shrinkersLock);
+
+    unsigned count = 0;
+    for (Shrinker* shrinker : shrinkers) {
+        if (count >= max) {
+            break;
+        }
+
+        strncpy(info[count].name, shrinker->Name(), sizeof(info[count].name) - 1);
+        info[count].name[sizeof(info[count].name) - 1] = 0;
+        info[count].usage = shrinker->MemoryUsage() / 1024;
+        info[count].reclaimable = shrinker->ReclaimableMemory() / 1024;
+
+        count++;
+    }
+
+    return count;
+}
+
+void ReclaimThread() {
+    for (;;) {
+        if (IsUnderMemoryPressure()) {
+            // Reclaim in batches so we give up the CPU often
+            while (FreePhysicalBlocks() < HighWatermark()) {
+                if (!ReclaimMemory(RECLAIM_BATCH_PAGES)) {
+                    break; // Nothing left to reclaim
+                }
+
+                Scheduler::Yield();
+            }
+        }
+
+        __atomic_add_fetch(&reclaimPasses, 1, __ATOMIC_RELEASE);
+
+        long timeout = 50000; // 50ms
+        (void)reclaimWakeup.WaitTimeout(timeout);
+    }
+}
+
+bool WaitForReclaim() {
+    // The reclaim thread may need locks held by whoever is allocating,
+    // so never wait with interrupts disabled (e.g. with the kernel heap locked)
+    if (!reclaimProcess.get() || !CheckInterrupts() || Process::Current() == reclaimProcess.get()) {
+        return false;
+    }
+
+    uint64_t pass = __atomic_load_n(&reclaimPasses, __ATOMIC_ACQUIRE);
+    reclaimWakeup.Signal();
+
+    uint64_t deadline = Timer::UsecondsSinceBoot() + RECLAIM_WAIT_TIMEOUT;
+    while (__atomic_load_n(&reclaimPasses, __ATOMIC_ACQUIRE) == pass) {
+        if (Timer::UsecondsSinceBoot() > deadline) {
+            return false;
+        }
+
+        Scheduler::Yield();
+    }
+
+    return true;
+}
+
+void InitializeReclaim() {
+    reclaimProcess = Process::CreateKernelProcess((void*)ReclaimThread, "Reclaim", nullptr);
+    reclaimProcess->Start();
+}
+} // namespace Memory
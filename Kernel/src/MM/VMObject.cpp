@@ -1,5 +1,6 @@
 #include <MM/VMObject.h>
 
+#include <MM/ZeroedPagePool.h>
 #include <Paging.h>
 #include <PhysicalAllocator.h>
 #include <Scheduler.h>
@@ -31,29 +32,29 @@ PhysicalVMObject::PhysicalVMObject(uintptr_t size, bool anonymous, bool shared)
     if(anonymous){
         memset(physicalBlocks, 0, sizeof(uint32_t) * blockCount);
     } else {
-        void* mapping = Memory::KernelAllocate4KPages(1);
         for(unsigned i = 0; i < blockCount; i++){
-            uintptr_t phys = Memory::AllocatePhysicalMemoryBlock();
+            uintptr_t phys = Memory::AllocateZeroedPhysicalMemoryBlock();
             physicalBlocks[i] = phys >> PAGE_SHIFT_4K; // Allocate all of our blocks
-
-            Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
-            memset(mapping, 0, PAGE_SIZE_4K);
         }
-        Memory::KernelFree4KPages(mapping, 1);
     }
 }
 
 int PhysicalVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap){
+    return MapBlock(base, offset, pMap, PAGE_USER | PAGE_WRITABLE | PAGE_PRESENT);
+}
+
+int PhysicalVMObject::MapBlock(uintptr_t base, uintptr_t offset, PageMap* pMap, uint64_t pageFlags){
     unsigned blockIndex = offset >> PAGE_SHIFT_4K;
     assert(blockIndex < (size >> PAGE_SHIFT_4K));
 
     uint32_t& block = physicalBlocks[blockIndex];
     if(block){ // Another reference to the VMObject probably mapped this block
-        Memory::MapVirtualMemory4K(static_cast<uintptr_t>(block) << PAGE_SHIFT_4K, base + offset, 1, pMap);
+        Memory::MapVirtualMemory4K(static_cast<uintptr_t>(block) << PAGE_SHIFT_4K, base + offset, 1, pageFlags, pMap);
     } else { // We need to allocate block
         assert(anonymous);
 
-        uintptr_t phys = Memory::AllocatePhysicalMemoryBlock();
+        // Zero the block before it gets mapped, usually it will come from the pre-zeroed pool
+        uintptr_t phys = Memory::AllocateZeroedPhysicalMemoryBlock();
         assert(phys < PHYS_BLOCK_MAX);
         if(!phys){
             return 1; // Failed to allocate
@@ -61,40 +62,24 @@ int PhysicalVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap){
 
         block = phys >> PAGE_SHIFT_4K;
 
-        Memory::MapVirtualMemory4K(phys, base + offset, 1, PAGE_USER | PAGE_WRITABLE | PAGE_PRESENT, pMap);
-        
-        if(GetCR3() == pMap->pml4Phys){
-            memset(reinterpret_cast<void*>((base + offset) & ~static_cast<uintptr_t>(PAGE_SIZE_4K - 1)), 0, PAGE_SIZE_4K); // Zero the block
-        } else {
-            void* mapping = Memory::KernelAllocate4KPages(1);
-            Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
-
-            memset(mapping, 0, PAGE_SIZE_4K);
-
-            Memory::KernelFree4KPages(mapping, 1);
-        }
+        Memory::MapVirtualMemory4K(phys, base + offset, 1, pageFlags, pMap);
     }
 
     return 0; // Success
 }
 
 void PhysicalVMObject::ForceAllocate(){
-    void* mapping = Memory::KernelAllocate4KPages(1);
     for(unsigned i = 0; i < (size >> PAGE_SHIFT_4K); i++){
         if(physicalBlocks[i]){
             continue; // Already allocated
         }
         assert(anonymous);
 
-        uintptr_t phys = Memory::AllocatePhysicalMemoryBlock();
+        uintptr_t phys = Memory::AllocateZeroedPhysicalMemoryBlock();
         assert(phys < PHYS_BLOCK_MAX);
         
         physicalBlocks[i] = phys >> PAGE_SHIFT_4K;
-
-        Memory::KernelMapVirtualMemory4K(phys, (uintptr_t)mapping, 1);
-        memset(mapping, 0, PAGE_SIZE_4K);
     }
-    Memory::KernelFree4KPages(mapping, 1);
 }
 
 void PhysicalVMObject::MapAllocatedBlocks(uintptr_t base, PageMap* pMap){
@@ -118,25 +103,20 @@ VMObject* PhysicalVMObject::Clone(){
     assert(!shared);
     PhysicalVMObject* newVMO = new PhysicalVMObject(size, anonymous, shared);
 
-    // Temporary mappings so we can copy the data over
-    uint8_t* virtBuffer = reinterpret_cast<uint8_t*>(Memory::KernelAllocate4KPages(2));
-    uint8_t* virtDestBuffer = virtBuffer + PAGE_SIZE_4K;
-
     for(unsigned i = 0; i < (size >> PAGE_SHIFT_4K); i++){
         uintptr_t block = physicalBlocks[i];
         if(block){
-            uintptr_t newBlock = Memory::AllocatePhysicalMemoryBlock();
-            newVMO->physicalBlocks[i] = newBlock >> PAGE_SHIFT_4K;
-
-            Memory::KernelMapVirtualMemory4K(block << PAGE_SHIFT_4K, (uintptr_t)virtBuffer, 1); // Map temporary mappings to our blocks
-            Memory::KernelMapVirtualMemory4K(newBlock, (uintptr_t)virtDestBuffer, 1);
+            uintptr_t newBlock = static_cast<uintptr_t>(newVMO->physicalBlocks[i]) << PAGE_SHIFT_4K;
+            if(!newBlock){ // Anonymous VMObjects do not allocate blocks up front
+                newBlock = Memory::AllocatePhysicalMemoryBlock();
+                newVMO->physicalBlocks[i] = newBlock >> PAGE_SHIFT_4K;
+            }
 
-            memcpy(virtDestBuffer, virtBuffer, PAGE_SIZE_4K); // Copy each block
+            // Copy each block through the direct map
+            memcpy(Memory::GetDirectMapping(newBlock), Memory::GetDirectMapping(block << PAGE_SHIFT_4K), PAGE_SIZE_4K);
         }
     }
 
-    Memory::KernelFree4KPages(virtBuffer, 2);
-
     newVMO->copyOnWrite = false;
     newVMO->refCount = 1;
 
@@ -0,0 +1,143 @@
+#include <MM/ZeroedPagePool.h>
+
+#include <CString.h>
+#include <Lock.h>
+#include <MM/Shrinker.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+#include <Scheduler.h>
+
+namespace Memory {
+uint64_t zeroedPages[ZEROED_PAGE_POOL_SIZE];
+unsigned zeroedPageCount = 0;
+lock_t zeroedPagePoolLock = 0;
+
+uint64_t zeroedPagePoolHits = 0;
+uint64_t zeroedPagePoolMisses = 0;
+
+FancyRefPtr<Process> zeroingProcess;
+
+// Pool pages are just free pages which have been zeroed, so they are the first to go
+class ZeroedPagePoolShrinker final : public Shrinker {
+public:
+    ZeroedPagePoolShrinker() : Shrinker("zeroed-pages", true) {}
+
+    size_t MemoryUsage() override { return zeroedPageCount * PAGE_SIZE_4K; }
+    size_t ReclaimableMemory() override { return zeroedPageCount * PAGE_SIZE_4K; }
+
+    size_t Shrink(size_t pages) override {
+        InterruptDisabler disableInterrupts;
+        if (acquireTestLock(&zeroedPagePoolLock)) {
+            return 0;
+        }
+
+        size_t freed = 0;
+        while (zeroedPageCount > 0 && freed < pages) {
+            FreePhysicalMemoryBlock(zeroedPages[--zeroedPageCount]);
+            freed++;
+        }
+
+        releaseLock(&zeroedPagePoolLock);
+        return freed;
+    }
+} zeroedPagePoolShrinker;
+
+void ZeroPhysicalPageNonTemporal(uint64_t phys) {
+    uint64_t* page = reinterpret_cast<uint64_t*>(GetDirectMapping(phys));
+
+    // movnti only uses general purpose registers so is fine with -mno-sse
+    for (unsigned i = 0; i < PAGE_SIZE_4K / sizeof(uint64_t); i += 4) {
+        asm volatile("movnti %1, (%0); movnti %1, 8(%0); movnti %1, 16(%0); movnti %1, 24(%0)" ::"r"(page + i),
+                     "r"(0ULL)
+                     : "memory");
+    }
+
+    // Make sure the stores are globally visible before the page gets handed out
+    asm volatile("sfence" ::: "memory");
+}
+
+uint64_t AllocateZeroedPhysicalMemoryBlock() {
+    {
+        ScopedSpinLock<true> lock(zeroedPagePoolLock);
+        if (zeroedPageCount > 0) {
+            zeroedPagePoolHits++;
+            return zeroedPages[--zeroedPageCount];
+        }
+
+        zeroedPagePoolMisses++;
+    }
+
+    uint64_t phys = AllocatePhysicalMemoryBlock();
+    // The page is about to be used so zero it through the cache
+    memset(GetDirectMapping(phys), 0, PAGE_SIZE_4K);
+
+    return phys;
+}
+
+unsigned RefillZeroedPagePool(unsigned maxPages) {
+    unsigned added = 0;
+    while (added < maxPages) {
+        // Racy check, but it just saves us from zeroing a page we will not be able to add
+        if (zeroedPageCount >= ZEROED_PAGE_POOL_SIZE) {
+            break;
+        }
+
+        // Leave memory for actual allocations when it is running low
+        if (FreePhysicalBlocks() < ZEROED_PAGE_POOL_SIZE * 4 || IsUnderMemoryPressure()) {
+            break;
+        }
+
+        uint64_t phys = AllocatePhysicalMemoryBlock();
+        ZeroPhysicalPageNonTemporal(phys);
+
+        ScopedSpinLock<true> lock(zeroedPagePoolLock);
+        if (zeroedPageCount >= ZEROED_PAGE_POOL_SIZE) {
+            FreePhysicalMemoryBlock(phys); // Another CPU filled the pool
+            break;
+        }
+
+        zeroedPages[zeroedPageCount++] = phys;
+        added++;
+    }
+
+    return added;
+}
+
+unsigned DrainZeroedPagePool() {
+    ScopedSpinLock<true> lock(zeroedPagePoolLock);
+
+    unsigned freed = zeroedPageCount;
+    while (zeroedPageCount > 0) {
+        FreePhysicalMemoryBlock(zeroedPages[--zeroedPageCount]);
+    }
+
+    return freed;
+}
+
+void ZeroedPagePoolThread() {
+    Thread* thread = Thread::Current();
+    for (;;) {
+        if (zeroedPageCount < ZEROED_PAGE_POOL_LOW_WATERMARK) {
+            // Zero in small batches so we give up the CPU often
+            while (RefillZeroedPagePool(16) == 16) {
+                Scheduler::Yield();
+            }
+        }
+
+        thread->Sleep(50000); // 50ms
+    }
+}
+
+void InitializeZeroedPagePool() {
+    RegisterShrinker(&zeroedPagePoolShrinker);
+
+    zeroingProcess = Process::CreateKernelProcess((void*)ZeroedPagePoolThread, "PageZeroer", nullptr);
+
+    // Run for as short a time as possible before being preempted
+    Thread* thread = zeroingProcess->GetMainThread().get();
+    thread->timeSliceDefault = 1;
+    thread->timeSlice = 1;
+
+    zeroingProcess->Start();
+}
+} // namespace Memory
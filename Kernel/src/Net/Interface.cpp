@@ -1,5 +1,6 @@
 #include <Net/Net.h>
 #include <Net/Adapter.h>
+#include <Net/Loopback.h>
 
 #include <Scheduler.h>
 #include <Logging.h>
@@ -79,7 +80,7 @@ namespace Network{
 		Log::Info("[Network] [ICMP] Received packet, Type: %d, Code: %d", header->type, header->code);
 	}
 
-    void OnReceiveIPv4(void* data, size_t length){
+    void OnReceiveIPv4(NetworkPacket* packet, void* data, size_t length){
 		if(length < sizeof(IPv4Header)){
 			Log::Warning("[Network] [IPv4] Discarding packet (too short)");
 			return;
@@ -92,12 +93,14 @@ namespace Network{
 			return;
 		}
 
-		BigEndian<uint16_t> checksum = header->headerChecksum;
+		if(!packet->adapter->IsLoopback()){ // Loopback packets are never corrupted
+			BigEndian<uint16_t> checksum = header->headerChecksum;
 
-		header->headerChecksum = 0;
-		if(checksum.value != CaclulateChecksum(data, sizeof(IPv4Header)).value){ // Verify checksum
-			Log::Warning("[Network] [IPv4] Discarding packet (invalid checksum)");
-			return;
+			header->headerChecksum = 0;
+			if(checksum.value != CaclulateChecksum(data, sizeof(IPv4Header)).value){ // Verify checksum
+				Log::Warning("[Network] [IPv4] Discarding packet (invalid checksum)");
+				return;
+			}
 		}
 
 		switch(header->protocol){
@@ -105,7 +108,7 @@ namespace Network{
 				OnReceiveICMP(header->data, length - sizeof(IPv4Header));
 				break;
 			case IPv4ProtocolUDP:
-				UDP::OnReceiveUDP(*header, header->data, ((uint16_t)header->length) - sizeof(IPv4Header));
+				UDP::OnReceiveUDP(packet, *header, header->data, ((uint16_t)header->length) - sizeof(IPv4Header));
 				break;
 			case IPv4ProtocolTCP:
 				TCP::OnReceiveTCP(*header, header->data, ((uint16_t)header->length) - sizeof(IPv4Header));
@@ -116,50 +119,58 @@ namespace Network{
 		}
 	}
 
+	void OnReceive(NetworkPacket* p){
+		if(p->length < sizeof(EthernetFrame)){
+			Log::Warning("[Network] Discarding packet (too short)");
+			return;
+		}
+
+		NetworkAdapter* adapter = p->adapter;
+
+		EthernetFrame* etherFrame = reinterpret_cast<EthernetFrame*>(p->data);
+		if(etherFrame->dest != adapter->mac && etherFrame->dest != MACAddress{0xff, 0xff, 0xff, 0xff, 0xff, 0xff}){
+			Log::Warning("[Network] Discarding packet (invalid MAC address %x:%x:%x:%x:%x:%x)", etherFrame->dest[0], etherFrame->dest[1], etherFrame->dest[2], etherFrame->dest[3], etherFrame->dest[4], etherFrame->dest[5]);
+			return;
+		}
+
+		switch ((uint16_t)etherFrame->etherType)
+		{
+		case EtherTypeIPv4:
+			OnReceiveIPv4(p, etherFrame->data, p->length - sizeof(EthernetFrame));
+			break;
+		case EtherTypeARP:
+			OnReceiveARP(etherFrame->data, p->length - sizeof(EthernetFrame));
+			break;
+		default:
+			Log::Warning("[Network] Discarding packet (invalid EtherType %x)", etherFrame->etherType);
+			break;
+		}
+	}
+
 	[[noreturn]] void InterfaceThread(){
 		Log::Info("[Network] Initializing network interface layer...");
 
 		for(;;){
-			NetworkPacket* p;
 			if(packetQueueSemaphore.Wait()){
 				continue; // We got interrupted
 			}
-			
-			for(NetworkAdapter* adapter : adapters){
-				if((p = adapter->Dequeue())){
-					if(p->length < sizeof(EthernetFrame)){
-						Log::Warning("[Network] Discarding packet (too short)");
-
-						adapter->CachePacket(p);
-						break;
-					}
-
-					size_t len = p->length;
-					uint8_t buffer[ETHERNET_MAX_PACKET_SIZE];
-					memcpy(buffer, p->data, p->length);
-
-					adapter->CachePacket(p); // Get the packet back to the NIC driver's cache as soon as possible
 
-					EthernetFrame* etherFrame = reinterpret_cast<EthernetFrame*>(buffer);
-					if(etherFrame->dest != adapter->mac && etherFrame->dest != MACAddress{0xff, 0xff, 0xff, 0xff, 0xff, 0xff}){
-						Log::Warning("[Network] Discarding packet (invalid MAC address %x:%x:%x:%x:%x:%x)", etherFrame->dest[0], etherFrame->dest[1], etherFrame->dest[2], etherFrame->dest[3], etherFrame->dest[4], etherFrame->dest[5]);
+			// Keep polling until no adapter has packets left,
+			// adapters which use up their budget get polled again after the others
+			bool pending;
+			do {
+				pending = false;
+				for(NetworkAdapter* adapter : adapters){
+					if(!__atomic_exchange_n(&adapter->pollScheduled, false, __ATOMIC_ACQ_REL)){
 						continue;
 					}
-					
-					switch ((uint16_t)etherFrame->etherType)
-					{
-					case EtherTypeIPv4:
-						OnReceiveIPv4(etherFrame->data, len - sizeof(EthernetFrame));
-						break;
-					case EtherTypeARP:
-						OnReceiveARP(etherFrame->data, len - sizeof(EthernetFrame));
-						break;
-					default:
-						Log::Warning("[Network] Discarding packet (invalid EtherType %x)", etherFrame->etherType);
-						break;
+
+					if(adapter->Poll(NETWORK_POLL_BUDGET) >= NETWORK_POLL_BUDGET){
+						adapter->pollScheduled = true;
+						pending = true;
 					}
 				}
-			}
+			} while(pending);
 		}
 	}
 
@@ -172,19 +183,37 @@ namespace Network{
 		if(adapter){
 			adapter->SendPacket(data, length);
 		} else for(auto& adapter : adapters){
+			if(adapter->IsLoopback()){
+				continue;
+			}
+
 			adapter->SendPacket(data, length);
 			break;
 		}
 	}
 
-    int SendIPv4(void* data, size_t length, IPv4Address& source, IPv4Address& destination, uint8_t protocol, NetworkAdapter* adapter){
-		if(length > 1518 - sizeof(EthernetFrame) - sizeof(IPv4Header)){
-			return -EMSGSIZE;
+    int SendIPv4(void* data, size_t length, IPv4Address& source, IPv4Address& destination, uint8_t protocol, NetworkAdapter* adapter, const NetworkTransmitOffload* offload){
+		assert(adapter);
+
+		if(adapter->IsLoopback()){
+			return static_cast<LoopbackAdapter*>(adapter)->SendIPv4(data, length, source, destination, protocol);
 		}
 
-		assert(adapter);
+		size_t maxLength = ETHERNET_MTU - sizeof(IPv4Header);
+		if(offload && (offload->flags & NetworkTransmitOffload::Segment)){
+			assert(adapter->offloads & NetworkAdapter::OffloadTCPSegmentation);
+			maxLength = IPV4_MAX_PACKET_SIZE - sizeof(IPv4Header);
+		}
 
-		uint8_t buffer[1600]; // The maxmium Ethernet frame size is 1518 so this will do
+		if(length > maxLength){
+			return -EMSGSIZE;
+		}
+
+		uint8_t stackBuffer[1600]; // The maxmium Ethernet frame size is 1518 so this will do
+		uint8_t* buffer = stackBuffer;
+		if(sizeof(EthernetFrame) + sizeof(IPv4Header) + length > sizeof(stackBuffer)){
+			buffer = new uint8_t[sizeof(EthernetFrame) + sizeof(IPv4Header) + length]; // Segment to be split by the adapter
+		}
 
 		EthernetFrame* ethFrame = (EthernetFrame*)buffer;
 		ethFrame->etherType = EtherTypeIPv4;
@@ -193,6 +222,9 @@ namespace Network{
 		if(destination.value == INADDR_BROADCAST){
 			ethFrame->dest = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff}; // Broadcast MAC Address
 		} else if(int status = Route(source, destination, ethFrame->dest, adapter); status < 0){
+			if(buffer != stackBuffer){
+				delete[] buffer;
+			}
 			return status;
 		}
 
@@ -213,7 +245,20 @@ namespace Network{
 
 		memcpy(ipHeader->data, data, length);
 
-		Send(ethFrame, sizeof(EthernetFrame) + sizeof(IPv4Header) + length, adapter);
+		if(offload && offload->flags){
+			// Offsets were relative to the IPv4 payload
+			NetworkTransmitOffload frameOffload = *offload;
+			frameOffload.checksumStart += sizeof(EthernetFrame) + sizeof(IPv4Header);
+			frameOffload.headerLength += sizeof(EthernetFrame) + sizeof(IPv4Header);
+
+			adapter->SendOffloadedPacket(ethFrame, sizeof(EthernetFrame) + sizeof(IPv4Header) + length, frameOffload);
+		} else {
+			Send(ethFrame, sizeof(EthernetFrame) + sizeof(IPv4Header) + length, adapter);
+		}
+
+		if(buffer != stackBuffer){
+			delete[] buffer;
+		}
 
 		return 0;
 	}
@@ -0,0 +1,166 @@
+#include <Net/Loopback.h>
+
+#include <Net/Net.h>
+
+#include <Errno.h>
+#include <Logging.h>
+
+namespace Network{
+    extern Vector<NetworkAdapter*> adapters;
+
+    LoopbackAdapter* loopbackAdapter = nullptr;
+
+    LoopbackAdapter::LoopbackAdapter() : NetworkAdapter(NetworkAdapterLoopback) {
+        mac = MACAddress{0, 0, 0, 0, 0, 0};
+
+        adapterIP = IPv4Address(127, 0, 0, 1);
+        subnetMask = IPv4Address(255, 0, 0, 0);
+
+        SetInstanceName("lo");
+        SetDeviceName("Loopback Adapter");
+
+        linkState = LinkUp;
+        dState = DriverState::OK;
+    }
+
+    void LoopbackAdapter::SendPacket(void* data, size_t len){
+        // Anything sent through here has already been framed for Ethernet,
+        // strip the frame and keep IPv4, there is nobody to answer ARP
+        if(len < sizeof(EthernetFrame) + sizeof(IPv4Header)){
+            return;
+        }
+
+        EthernetFrame* frame = reinterpret_cast<EthernetFrame*>(data);
+        if((uint16_t)frame->etherType != EtherTypeIPv4){
+            return;
+        }
+
+        len -= sizeof(EthernetFrame);
+        if(len > LOOPBACK_MTU){
+            return;
+        }
+
+        NetworkPacket* packet = AllocatePacket();
+        if(!packet){
+            return;
+        }
+
+        memcpy(packet->data, frame->data, len);
+        packet->length = len;
+        packet->adapter = this;
+
+        Deliver(packet);
+    }
+
+    int LoopbackAdapter::Poll(int budget){
+        int received = 0;
+        while(received < budget){
+            NetworkPacket* packet;
+            {
+                ScopedSpinLock lockQueue(queueLock);
+                if(!queue.get_length()){
+                    break;
+                }
+
+                packet = queue.remove_at(0);
+            }
+
+            OnReceiveIPv4(packet, packet->data, packet->length);
+            packet->Release();
+
+            received++;
+        }
+
+        return received;
+    }
+
+    NetworkPacket* LoopbackAdapter::AllocateIPv4Packet(size_t length, const IPv4Address& source, const IPv4Address& destination, uint8_t protocol){
+        assert(length + sizeof(IPv4Header) <= LOOPBACK_MTU);
+
+        NetworkPacket* packet = AllocatePacket();
+        if(!packet){
+            return nullptr;
+        }
+
+        IPv4Header* ipHeader = reinterpret_cast<IPv4Header*>(packet->data);
+        memset(ipHeader, 0, sizeof(IPv4Header));
+
+        ipHeader->ihl = 5; // 5 dwords (20 bytes)
+        ipHeader->version = 4; // Internet Protocol version 4
+        ipHeader->length = length + sizeof(IPv4Header);
+        ipHeader->ttl = 64;
+        ipHeader->protocol = protocol;
+        ipHeader->headerChecksum = 0; // Not checked on loopback
+        ipHeader->destIP = destination;
+
+        if(source.value == INADDR_ANY){
+            ipHeader->sourceIP = adapterIP;
+        } else {
+            ipHeader->sourceIP = source;
+        }
+
+        packet->length = length + sizeof(IPv4Header);
+        packet->adapter = this;
+        return packet;
+    }
+
+    void LoopbackAdapter::Deliver(NetworkPacket* packet){
+        IPv4Header* ipHeader = reinterpret_cast<IPv4Header*>(packet->data);
+
+        // Sending a UDP datagram never waits on anything the receiving end holds,
+        // so skip the trip through the network thread
+        if(ipHeader->protocol == IPv4ProtocolUDP){
+            OnReceiveIPv4(packet, packet->data, packet->length);
+            packet->Release();
+            return;
+        }
+
+        // TCP may reply to a segment straight from its receive path,
+        // which would end up back in the sender
+        {
+            ScopedSpinLock lockQueue(queueLock);
+            queue.add_back(packet);
+        }
+
+        ScheduleReceive();
+    }
+
+    int LoopbackAdapter::SendIPv4(void* data, size_t length, const IPv4Address& source, const IPv4Address& destination, uint8_t protocol){
+        if(length > LOOPBACK_MTU - sizeof(IPv4Header)){
+            return -EMSGSIZE;
+        }
+
+        NetworkPacket* packet = AllocateIPv4Packet(length, source, destination, protocol);
+        if(!packet){
+            return -ENOBUFS;
+        }
+
+        memcpy(packet->data + sizeof(IPv4Header), data, length);
+        Deliver(packet);
+
+        return 0;
+    }
+
+    bool IsLocalAddress(const IPv4Address& address){
+        if(address.data[0] == 127){
+            return true; // 127.0.0.0/8
+        }
+
+        if(address.value == INADDR_ANY){
+            return false;
+        }
+
+        for(NetworkAdapter* a : adapters){
+            if(a->adapterIP.value == address.value){
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void InitializeLoopback(){
+        loopbackAdapter = new LoopbackAdapter();
+        NetFS::GetInstance()->RegisterAdapter(loopbackAdapter);
+    }
+}
@@ -1,6 +1,7 @@
 #include <Net/Net.h>
 
 #include <Net/Adapter.h>
+#include <Net/Loopback.h>
 #include <Net/Socket.h>
 
 #include <Endian.h>
@@ -17,6 +18,8 @@ namespace Network {
     HashMap<uint32_t, MACAddress> addressCache;
 
     void InitializeConnections(){
+        InitializePacketPool();
+        InitializeLoopback();
         InitializeNetworkThread();
     }
 
@@ -74,6 +77,15 @@ namespace Network {
 
         Log::Debug(debugLevelNetwork, DebugLevelVerbose, "[Network] Route: Attempting to find route from %s to %s", to_string(local).c_str(), to_string(dest).c_str());
 
+        if((!adapter || adapter->IsLoopback()) && IsLocalAddress(dest)){
+            // Traffic to ourselves never touches a NIC
+            adapter = loopbackAdapter;
+            mac = loopbackAdapter->mac;
+            return 0;
+        } else if(adapter && adapter->IsLoopback()){
+            return -ENETUNREACH;
+        }
+
         if(adapter){
             if(local.value != INADDR_ANY && local.value != adapter->adapterIP.value){ // If the socket address is not 0 then make sure it aligns with the adapter
                 return -ENETUNREACH;
@@ -88,6 +100,10 @@ namespace Network {
             }
         } else {
             for(NetworkAdapter* a : adapters){
+                if(a->IsLoopback()){
+                    continue;
+                }
+
                 if(local.value != INADDR_ANY && a->adapterIP.value != local.value){
                     continue; // Local address does not correspond to the adapter IP address
                 }
@@ -17,48 +17,25 @@ namespace Network {
         assert(!"NetworkAdapter: Base class SendPacket has been called");
     }
 
-    int NetworkAdapter::GetLink() const {
-        return linkState;
-    }
+    void NetworkAdapter::SendOffloadedPacket(void* data, size_t len, const NetworkTransmitOffload& offload){
+        assert(!offload.flags); // Adapter advertised an offload without implementing it
 
-    int NetworkAdapter::QueueSize() const {
-        return queue.get_length();
+        SendPacket(data, len);
     }
 
-    NetworkPacket* NetworkAdapter::Dequeue() { 
-        ScopedSpinLock lock{queueLock};
-        if(queue.get_length()) {
-            packetSemaphore.SetValue(queue.get_length() - 1);
-            return queue.remove_at(0); 
-        } else {
-            return nullptr;
-        }
+    int NetworkAdapter::GetLink() const {
+        return linkState;
     }
 
-    NetworkPacket* NetworkAdapter::DequeueBlocking() {
-        if(packetSemaphore.Wait()){
-            return nullptr; // We were interrupted
-        }
-        
-        ScopedSpinLock lock{queueLock};
-        if(queue.get_length()){
-            return queue.remove_at(0); 
-        } else {
-            return nullptr;
-        }
+    int NetworkAdapter::Poll(int budget){
+        return 0;
     }
-    
-    void NetworkAdapter::CachePacket(NetworkPacket* pkt){
-        if(cache.get_length() < maxCache){
-            acquireLock(&cacheLock);
 
-            cache.add_back(pkt);
-
-            releaseLock(&cacheLock);
-        } else {
-            delete pkt;
+    void NetworkAdapter::ScheduleReceive(){
+        if(!__atomic_exchange_n(&pollScheduled, true, __ATOMIC_ACQ_REL)){
+            packetQueueSemaphore.Signal();
         }
-    };
+    }
 
     int NetworkAdapter::Ioctl(uint64_t cmd, uint64_t arg){
         Process* currentProcess = Scheduler::GetCurrentProcess();
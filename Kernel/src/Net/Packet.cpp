@@ -0,0 +1,108 @@
+#include <Net/Net.h>
+
+#include <Assert.h>
+#include <List.h>
+#include <Lock.h>
+#include <MM/Shrinker.h>
+#include <Paging.h>
+#include <PhysicalAllocator.h>
+
+namespace Network {
+FastList<NetworkPacket*> packetPool;
+// Packets may be released from interrupt handlers
+lock_t packetPoolLock = 0;
+
+// Packet buffers in use, including those in the pool
+unsigned allocatedPackets = 0;
+
+static void FreePacket(NetworkPacket* packet) {
+    Memory::FreePhysicalMemoryBlock(packet->physicalAddress);
+    delete packet;
+
+    __atomic_sub_fetch(&allocatedPackets, 1, __ATOMIC_RELAXED);
+}
+
+class PacketPoolShrinker final : public Memory::Shrinker {
+public:
+    PacketPoolShrinker() : Shrinker("net-packets") {}
+
+    size_t MemoryUsage() override { return allocatedPackets * NETWORK_PACKET_BUFFER_SIZE; }
+    size_t ReclaimableMemory() override { return packetPool.get_length() * NETWORK_PACKET_BUFFER_SIZE; }
+
+    size_t Shrink(size_t pages) override {
+        size_t freed = 0;
+        while (freed < pages) {
+            NetworkPacket* packet;
+            {
+                InterruptDisabler disableInterrupts;
+                if (acquireTestLock(&packetPoolLock)) {
+                    break;
+                }
+
+                packet = packetPool.get_length() ? packetPool.remove_at(0) : nullptr;
+                releaseLock(&packetPoolLock);
+            }
+
+            if (!packet) {
+                break;
+            }
+
+            FreePacket(packet);
+            freed++;
+        }
+
+        return freed;
+    }
+} packetPoolShrinker;
+
+void InitializePacketPool() { Memory::RegisterShrinker(&packetPoolShrinker); }
+
+NetworkPacket* AllocatePacket() {
+    NetworkPacket* packet = nullptr;
+    {
+        ScopedSpinLock<true> lockPool(packetPoolLock);
+        if (packetPool.get_length()) {
+            packet = packetPool.remove_at(0);
+        }
+    }
+
+    if (!packet) {
+        if (Memory::IsUnderMemoryPressure()) {
+            return nullptr; // Drop packets rather than run out of memory
+        }
+
+        packet = new NetworkPacket;
+        packet->physicalAddress = Memory::AllocatePhysicalMemoryBlock();
+        packet->data = reinterpret_cast<uint8_t*>(Memory::GetDirectMapping(packet->physicalAddress));
+
+        __atomic_add_fetch(&allocatedPackets, 1, __ATOMIC_RELAXED);
+    }
+
+    packet->length = 0;
+    packet->adapter = nullptr;
+    packet->refCount = 1;
+    return packet;
+}
+
+} // namespace Network
+
+void NetworkPacket::Release() {
+    using namespace Network;
+
+    int refs = __atomic_sub_fetch(&refCount, 1, __ATOMIC_ACQ_REL);
+    assert(refs >= 0);
+
+    if (refs) {
+        return;
+    }
+
+    {
+        ScopedSpinLock<true> lockPool(packetPoolLock);
+        if (packetPool.get_length() < NETWORK_PACKET_POOL_SIZE) {
+            packetPool.add_back(this);
+            return;
+        }
+    }
+
+    FreePacket(this);
+}
@@ -135,9 +135,9 @@ ErrorOr<UNIXOpenFile*> Socket::Open(size_t flags) {
 
 void Socket::Close() {}
 
-void Socket::Watch(FilesystemWatcher& watcher, int events) { assert(!"Socket::Watch called from socket base"); }
+void Socket::Watch(KernelObjectWatcher& watcher, int events) { assert(!"Socket::Watch called from socket base"); }
 
-void Socket::Unwatch(FilesystemWatcher& watcher) { assert(!"Socket::Unwatch called from socket base"); }
+void Socket::Unwatch(KernelObjectWatcher& watcher) { assert(!"Socket::Unwatch called from socket base"); }
 
 LocalSocket::LocalSocket(int type, int protocol) : Socket(type, protocol) {
     domain = UnixDomain;
@@ -457,7 +457,7 @@ void LocalSocket::Close() {
     }
 }
 
-void LocalSocket::Watch(FilesystemWatcher& watcher, int events) {
+void LocalSocket::Watch(KernelObjectWatcher& watcher, int events) {
     if (!(events & (POLLIN | POLLPRI))) {
         return;
     }
@@ -471,7 +471,7 @@ void LocalSocket::Watch(FilesystemWatcher& watcher, int events) {
     releaseLock(&m_watcherLock);
 }
 
-void LocalSocket::Unwatch(FilesystemWatcher& watcher) {
+void LocalSocket::Unwatch(KernelObjectWatcher& watcher) {
     acquireLock(&m_watcherLock);
     m_watching.remove(&watcher);
     releaseLock(&m_watcherLock);
@@ -1,6 +1,7 @@
 #include <Net/Net.h>
 #include <Net/Socket.h>
 #include <Net/Adapter.h>
+#include <Net/Loopback.h>
 
 #include <Timer.h>
 #include <Math.h>
@@ -105,7 +106,8 @@ namespace Network {
             return 0;
         }
 
-        BigEndian<uint16_t> CalculateTCPChecksum(const IPv4Address& src, const IPv4Address& dest, void* data, uint16_t size){
+        // Sum of the pseudo-header the TCP checksum covers
+        static uint32_t PseudoHeaderSum(const IPv4Address& src, const IPv4Address& dest, uint16_t size){
             struct PseudoIPv4Header{
                 uint32_t source;
                 uint32_t destination;
@@ -129,8 +131,14 @@ namespace Network {
                 count -= 2;
             }
 
-            ptr = (uint16_t*)data;
-            count = size;
+            return checksum;
+        }
+
+        BigEndian<uint16_t> CalculateTCPChecksum(const IPv4Address& src, const IPv4Address& dest, void* data, uint16_t size){
+            uint32_t checksum = PseudoHeaderSum(src, dest, size);
+
+            uint16_t* ptr = (uint16_t*)data;
+            uint16_t count = size;
             while(count >= 2){
                 checksum += *ptr++;
                 count -= 2;
@@ -147,11 +155,37 @@ namespace Network {
             return ret;
         }
 
+        // Loopback segments never leave memory so they are not checksummed
+        inline BigEndian<uint16_t> OutgoingTCPChecksum(NetworkAdapter* adapter, const IPv4Address& src, const IPv4Address& dest, void* data, uint16_t size){
+            if(adapter && adapter->IsLoopback()){
+                return 0;
+            }
+
+            return CalculateTCPChecksum(src, dest, data, size);
+        }
+
+        // Largest payload which can go out in one call to SendTCP
+        static size_t MaxSegmentPayload(NetworkAdapter* adapter){
+            if(adapter && adapter->IsLoopback()){
+                return LOOPBACK_MTU - sizeof(IPv4Header) - sizeof(TCPHeader);
+            } else if(adapter && (adapter->offloads & NetworkAdapter::OffloadTCPChecksum) &&
+                (adapter->offloads & NetworkAdapter::OffloadTCPSegmentation)){
+                // SendTCP only asks the adapter to segment alongside checksum offload
+                return IPV4_MAX_PACKET_SIZE - sizeof(IPv4Header) - sizeof(TCPHeader);
+            }
+
+            return ETHERNET_MTU - sizeof(IPv4Header) - sizeof(TCPHeader);
+        }
+
         int SendTCP(void* data, size_t length, IPv4Address& source, IPv4Address& destination, TCPHeader& header, NetworkAdapter* adapter = nullptr){
-            uint8_t buffer[1600];
+            if(length > MaxSegmentPayload(adapter)){
+                length = MaxSegmentPayload(adapter);
+            }
 
-            if(length + sizeof(TCPHeader) > 1600){
-                length = 1600 - sizeof(TCPHeader);
+            uint8_t stackBuffer[1600];
+            uint8_t* buffer = stackBuffer;
+            if(length + sizeof(TCPHeader) > sizeof(stackBuffer)){
+                buffer = new uint8_t[length + sizeof(TCPHeader)];
             }
 
             TCPHeader* tcpHeader = reinterpret_cast<TCPHeader*>(buffer);
@@ -160,10 +194,34 @@ namespace Network {
 
             *tcpHeader = header;
 
-            tcpHeader->checksum = 0;
-            tcpHeader->checksum = CalculateTCPChecksum(source, destination, buffer, length + sizeof(TCPHeader));
+            NetworkTransmitOffload offload;
+            if(adapter && !adapter->IsLoopback() && (adapter->offloads & NetworkAdapter::OffloadTCPChecksum)){
+                // Leave the rest of the checksum to the adapter
+                uint32_t sum = PseudoHeaderSum(source, destination, length + sizeof(TCPHeader));
+                sum = (sum & 0xFFFF) + (sum >> 16);
+                sum = (sum & 0xFFFF) + (sum >> 16);
+                tcpHeader->checksum.value = sum;
 
-            if(int e = SendIPv4(buffer, length + sizeof(TCPHeader), source, destination, IPv4ProtocolTCP, adapter); e){
+                offload.flags = NetworkTransmitOffload::NeedsChecksum;
+                offload.checksumStart = 0;
+                offload.checksumOffset = offsetof(TCPHeader, checksum);
+
+                if(length > ETHERNET_MTU - sizeof(IPv4Header) - sizeof(TCPHeader)){
+                    offload.flags |= NetworkTransmitOffload::Segment;
+                    offload.headerLength = sizeof(TCPHeader);
+                    offload.segmentSize = ETHERNET_MTU - sizeof(IPv4Header) - sizeof(TCPHeader);
+                }
+            } else {
+                tcpHeader->checksum = 0;
+                tcpHeader->checksum = OutgoingTCPChecksum(adapter, source, destination, buffer, length + sizeof(TCPHeader));
+            }
+
+            int e = SendIPv4(buffer, length + sizeof(TCPHeader), source, destination, IPv4ProtocolTCP, adapter, &offload);
+            if(buffer != stackBuffer){
+                delete[] buffer;
+            }
+
+            if(e){
                 return e;
             }
 
@@ -437,7 +495,7 @@ namespace Network {
 
             tcpHeader.windowSize = 65535;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = OutgoingTCPChecksum(adapter, adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
 
             if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
@@ -462,7 +520,7 @@ namespace Network {
 
             tcpHeader.windowSize = 65535;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = OutgoingTCPChecksum(adapter, adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
 
             if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
@@ -488,7 +546,7 @@ namespace Network {
 
             tcpHeader.windowSize = 65535;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = OutgoingTCPChecksum(adapter, adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
 
             if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
@@ -512,7 +570,7 @@ namespace Network {
 
             tcpHeader.windowSize = 65535;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = OutgoingTCPChecksum(adapter, adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
 
             if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
@@ -538,7 +596,7 @@ namespace Network {
 
             tcpHeader.windowSize = 65535;
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = OutgoingTCPChecksum(adapter, adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
 
             if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
@@ -560,7 +618,7 @@ namespace Network {
             tcpHeader.dataOffset = sizeof(TCPHeader) / 4; // Size of the TCP Header in DWORDs
             tcpHeader.rst = 1; // RST, Abort the connections
 
-            tcpHeader.checksum = CalculateTCPChecksum(adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
+            tcpHeader.checksum = OutgoingTCPChecksum(adapter, adapter->adapterIP, peerAddress, &tcpHeader, sizeof(TCPHeader));
 
             if(int e = SendIPv4(&tcpHeader, sizeof(TCPHeader), address, peerAddress, IPv4ProtocolTCP, adapter); e){
                 return e;
@@ -747,6 +805,9 @@ namespace Network {
                 return -EISCONN; // dest is invalid
             }
 
+            if(len > MaxSegmentPayload(adapter)){
+                len = MaxSegmentPayload(adapter); // Sent in one segment so the sequence number stays in step
+            }
             uint16_t shortLength = static_cast<uint16_t>(len);
 
             TCPHeader header;
@@ -1,5 +1,6 @@
 #include <Net/Socket.h>
 #include <Net/Net.h>
+#include <Net/Loopback.h>
 
 #include <Hash.h>
 #include <Errno.h>
@@ -75,6 +76,32 @@ namespace Network::UDP{
     }
 
     int SendUDP(void* data, size_t length, IPv4Address& source, IPv4Address& destination, BigEndian<uint16_t> sourcePort, BigEndian<uint16_t> destinationPort, NetworkAdapter* adapter){
+		if(adapter && adapter->IsLoopback()){
+			if(!IsLocalAddress(destination)){
+				return -ENETUNREACH;
+			} else if(length > LOOPBACK_MTU - sizeof(IPv4Header) - sizeof(UDPHeader)){
+				return -EMSGSIZE;
+			}
+
+			// Build the datagram straight in a packet buffer,
+			// the receiving socket then queues the same buffer
+			NetworkPacket* packet = loopbackAdapter->AllocateIPv4Packet(sizeof(UDPHeader) + length, source, destination, IPv4ProtocolUDP);
+			if(!packet){
+				return -ENOBUFS;
+			}
+
+			UDPHeader* header = (UDPHeader*)(packet->data + sizeof(IPv4Header));
+			header->destPort = destinationPort;
+			header->srcPort = sourcePort;
+			header->length = sizeof(UDPHeader) + length;
+			header->checksum = 0;
+
+			memcpy(header->data, data, length);
+
+			loopbackAdapter->Deliver(packet);
+			return 0;
+		}
+
 		if(length > 1518){
 			return -EMSGSIZE;
 		}
@@ -94,14 +121,14 @@ namespace Network::UDP{
 		return SendIPv4(header, header->length, source, destination, IPv4ProtocolUDP, adapter);
 	}
 
-    void OnReceiveUDP(IPv4Header& ipHeader, void* data, size_t length){
+    void OnReceiveUDP(NetworkPacket* packet, IPv4Header& ipHeader, void* data, size_t length){
 		if(length < sizeof(UDPHeader)){
 			Log::Warning("[Network] [UDP] Discarding packet (too short)");
 			return;
 		}
 
 		UDPHeader* header = (UDPHeader*)data;
-        if(header->length > length){
+        if(header->length > length || header->length < sizeof(UDPHeader)){
 			Log::Warning("[Network] [UDP] Discarding packet (too long)");
             return;
         }
@@ -110,9 +137,11 @@ namespace Network::UDP{
 		    Log::Info("[Network] [UDP] Receiving Packet (Source port: %d, Destination port: %d)", (uint16_t)header->srcPort, (uint16_t)header->destPort);
         });
 
+        ScopedSpinLock lockSockets(socketsLock);
+
         UDPSocket* sock = nullptr;
         if(sockets.get((uint16_t)header->destPort, sock) && sock){
-            sock->OnReceive(ipHeader.sourceIP, header->srcPort, header->data, header->length);
+            sock->OnReceive(packet, ipHeader.sourceIP, header->srcPort, header->data, header->length - sizeof(UDPHeader));
         }
     }
 
@@ -124,6 +153,14 @@ namespace Network::UDP{
         if(bound){
             ReleasePort();
         }
+
+        ScopedSpinLock lockPackets(packetsLock);
+        while(m_ringCount){
+            m_receiveRing[m_ringHead].packet->Release();
+
+            m_ringHead = (m_ringHead + 1) & (UDP_RECEIVE_RING_SIZE - 1);
+            m_ringCount--;
+        }
     }
 
     unsigned short UDPSocket::AllocatePort(){
@@ -138,16 +175,26 @@ namespace Network::UDP{
         return Network::UDP::ReleasePort(port);
     }
 
-    int64_t UDPSocket::OnReceive(IPv4Address& sourceIP, BigEndian<uint16_t> sourcePort, void* buffer, size_t len){
-        UDPPacket pkt;
-        pkt.sourceIP = sourceIP;
-        pkt.sourcePort = sourcePort;
-        pkt.length = len;
+    int64_t UDPSocket::OnReceive(NetworkPacket* packet, IPv4Address& sourceIP, BigEndian<uint16_t> sourcePort, void* buffer, size_t len){
+        {
+            ScopedSpinLock lockPackets(packetsLock);
+            if(m_ringCount >= UDP_RECEIVE_RING_SIZE){
+                m_droppedPackets++; // Nobody is reading, drop the datagram
+                return -ENOBUFS;
+            }
+
+            UDPPacket& pkt = m_receiveRing[(m_ringHead + m_ringCount) & (UDP_RECEIVE_RING_SIZE - 1)];
+            pkt.sourceIP = sourceIP;
+            pkt.sourcePort = sourcePort;
+            pkt.length = len;
 
-        pkt.data = new uint8_t[len];
-        memcpy(pkt.data, buffer, len);
+            // Keep the packet buffer around instead of copying the payload
+            pkt.data = reinterpret_cast<uint8_t*>(buffer);
+            pkt.packet = packet;
+            packet->Acquire();
 
-        packets.add_back(pkt);
+            m_ringCount++;
+        }
 
         acquireLock(&blockedLock);
         while(blocked.get_length()){
@@ -155,9 +202,34 @@ namespace Network::UDP{
         }
         releaseLock(&blockedLock);
 
+        acquireLock(&m_watcherLock);
+        while(m_watching.get_length()){
+            m_watching.remove_at(0)->Signal();
+        }
+        releaseLock(&m_watcherLock);
+
         return 0;
     }
 
+    void UDPSocket::Watch(KernelObjectWatcher& watcher, int events){
+        if(!(events & (POLLIN | POLLPRI))){
+            return;
+        }
+
+        ScopedSpinLock lockWatchers(m_watcherLock);
+        if(CanRead()){
+            watcher.Signal();
+            return;
+        }
+
+        m_watching.add_back(&watcher);
+    }
+
+    void UDPSocket::Unwatch(KernelObjectWatcher& watcher){
+        ScopedSpinLock lockWatchers(m_watcherLock);
+        m_watching.remove(&watcher);
+    }
+
     Socket* UDPSocket::Accept(sockaddr* addr, socklen_t* addrlen, int mode){
         return nullptr;
     }
@@ -190,16 +262,20 @@ namespace Network::UDP{
 
     int64_t UDPSocket::ReceiveFrom(void* buffer, size_t len, int flags, sockaddr* src, socklen_t* addrlen, const void* ancillary, size_t ancillaryLen){
         acquireLock(&packetsLock);
-        if(packets.get_length() <= 0){
+        while(!m_ringCount){
             releaseLock(&packetsLock);
             if(flags & MSG_DONTWAIT){
                 return -EAGAIN; // Don't wait
             } else if(FilesystemBlocker bl(this); Thread::Current()->Block(&bl)){
                 return -EINTR; // We were interrupted
             }
+
+            acquireLock(&packetsLock); // Another thread may have taken the datagram
         }
 
-        UDPPacket pkt = packets.remove_at(0);
+        UDPPacket pkt = m_receiveRing[m_ringHead];
+        m_ringHead = (m_ringHead + 1) & (UDP_RECEIVE_RING_SIZE - 1);
+        m_ringCount--;
         releaseLock(&packetsLock);
 
         if(src && addrlen){
@@ -208,7 +284,7 @@ namespace Network::UDP{
             addr.sin_port = pkt.sourcePort;
             addr.sin_addr.s_addr = pkt.sourceIP.value;
 
-            memcpy(src, &addr, *addrlen); // Make sure to stay within bounds of addrlen
+            memcpy(src, &addr, MIN(*addrlen, sizeof(sockaddr_in))); // Make sure to stay within bounds of addrlen
 
             *addrlen = sizeof(sockaddr_in); // addrlen is updated to contain the actual size of the source address
         }
@@ -216,7 +292,7 @@ namespace Network::UDP{
         size_t finalLength = MIN(len, pkt.length);
         memcpy(buffer, pkt.data, finalLength);
 
-        delete[] pkt.data; // Free buffer
+        pkt.packet->Release();
 
         return finalLength;
     }
@@ -423,7 +423,7 @@ void Process::Die() {
     assert(!runningThreads.get_length());
 
     // Prevent run queue balancing
-    acquireLock(&Scheduler::processesLock);
+    acquireLock(&Scheduler::runQueueBalanceLock);
     acquireLockIntDisable(&m_processLock);
 
     CPU* cpu = GetCPULocal();
@@ -442,6 +442,7 @@ void Process::Die() {
     for (unsigned j = 0; j < cpu->runQueue->get_length(); j++) {
         if (Thread* thread = cpu->runQueue->get_at(j); thread != cpu->currentThread && thread->parent == this) {
             cpu->runQueue->remove_at(j);
+            thread->cpu = -1;
             j = 0;
         }
     }
@@ -469,6 +470,7 @@ void Process::Die() {
 
             if (thread->parent == this) {
                 other->runQueue->remove(thread);
+                thread->cpu = -1;
                 j = 0;
             }
         }
@@ -486,7 +488,7 @@ void Process::Die() {
     }
 
     asm("sti");
-    releaseLock(&Scheduler::processesLock);
+    releaseLock(&Scheduler::runQueueBalanceLock);
 
     Log::Debug(debugLevelScheduler, DebugLevelNormal, "[%d] Closing handles...", m_pid);
     m_handles.clear();
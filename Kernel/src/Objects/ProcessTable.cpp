@@ -0,0 +1,191 @@
+#include <Objects/ProcessTable.h>
+
+#include <Assert.h>
+#include <CPU.h>
+#include <Objects/Process.h>
+
+using Entry = FancyRefPtr<Process>;
+
+ALWAYS_INLINE static unsigned SlotIndex(uint32_t pid, int level) {
+    return (pid >> (level * PROCESS_TABLE_RADIX_BITS)) & (PROCESS_TABLE_FANOUT - 1);
+}
+
+ProcessTable::ReadGuard::ReadGuard(ProcessTable& table) : m_table(table) {
+    m_irq = CheckInterrupts();
+    asm volatile("cli");
+
+    // If a writer bumped the epoch before we registered,
+    // it may not have seen us so register against the new epoch
+    for (;;) {
+        m_epoch = m_table.m_epoch.load();
+        m_table.m_readers[m_epoch & 1].fetch_add(1);
+
+        if (m_table.m_epoch.load() == m_epoch) {
+            break;
+        }
+
+        m_table.m_readers[m_epoch & 1].fetch_sub(1);
+    }
+}
+
+ProcessTable::ReadGuard::~ReadGuard() {
+    m_table.m_readers[m_epoch & 1].fetch_sub(1, std::memory_order_release);
+
+    if (m_irq) {
+        asm volatile("sti");
+    }
+}
+
+void ProcessTable::Synchronize() {
+    assert(m_lock);
+
+    // Writers are serialized so by the time the epoch is bumped again,
+    // readers of this epoch have left
+    unsigned epoch = m_epoch.fetch_add(1);
+    while (m_readers[epoch & 1].load(std::memory_order_acquire)) {
+        asm volatile("pause");
+    }
+}
+
+void ProcessTable::Insert(FancyRefPtr<Process> proc) {
+    uint32_t pid = proc->PID();
+
+    ScopedSpinLock<true> lockTable(m_lock);
+
+    Node* node = &m_root;
+    for (int level = PROCESS_TABLE_LEVELS - 1; level > 0; level--) {
+        std::atomic<void*>& slot = node->slots[SlotIndex(pid, level)];
+
+        Node* child = reinterpret_cast<Node*>(slot.load(std::memory_order_relaxed));
+        if (!child) {
+            child = new Node();
+            slot.store(child, std::memory_order_release);
+            node->live++;
+        }
+
+        node = child;
+    }
+
+    std::atomic<void*>& slot = node->slots[SlotIndex(pid, 0)];
+    assert(!slot.load(std::memory_order_relaxed));
+
+    slot.store(new Entry(std::move(proc)), std::memory_order_release);
+    node->live++;
+    m_count++;
+}
+
+FancyRefPtr<Process> ProcessTable::Remove(pid_t pid) {
+    ScopedSpinLock<true> lockTable(m_lock);
+
+    Node* path[PROCESS_TABLE_LEVELS];
+    path[PROCESS_TABLE_LEVELS - 1] = &m_root;
+    for (int level = PROCESS_TABLE_LEVELS - 1; level > 0; level--) {
+        path[level - 1] =
+            reinterpret_cast<Node*>(path[level]->slots[SlotIndex(pid, level)].load(std::memory_order_relaxed));
+        if (!path[level - 1]) {
+            return nullptr;
+        }
+    }
+
+    Entry* entry = reinterpret_cast<Entry*>(path[0]->slots[SlotIndex(pid, 0)].exchange(nullptr));
+    if (!entry) {
+        return nullptr;
+    }
+
+    path[0]->live--;
+    m_count--;
+
+    // Once every PID a node covers has been handed out and its slots are empty,
+    // it can never be used again so unlink it
+    Node* retired[PROCESS_TABLE_LEVELS - 1];
+    int retiredCount = 0;
+    for (int level = 0; level < PROCESS_TABLE_LEVELS - 1; level++) {
+        uint64_t last = (static_cast<uint64_t>(pid) | ((1ULL << ((level + 1) * PROCESS_TABLE_RADIX_BITS)) - 1));
+        if (path[level]->live || static_cast<uint64_t>(m_nextPID.load()) <= last) {
+            break;
+        }
+
+        path[level + 1]->slots[SlotIndex(pid, level + 1)].store(nullptr);
+        path[level + 1]->live--;
+        retired[retiredCount++] = path[level];
+    }
+
+    Synchronize();
+
+    FancyRefPtr<Process> proc = std::move(*entry);
+    delete entry;
+
+    for (int i = 0; i < retiredCount; i++) {
+        delete retired[i];
+    }
+
+    return proc;
+}
+
+FancyRefPtr<Process> ProcessTable::Find(pid_t pid) {
+    if (pid <= 0) {
+        return nullptr;
+    }
+
+    ReadGuard guard(*this);
+
+    Node* node = &m_root;
+    for (int level = PROCESS_TABLE_LEVELS - 1; level > 0; level--) {
+        node = reinterpret_cast<Node*>(node->slots[SlotIndex(pid, level)].load(std::memory_order_acquire));
+        if (!node) {
+            return nullptr;
+        }
+    }
+
+    Entry* entry = reinterpret_cast<Entry*>(node->slots[SlotIndex(pid, 0)].load(std::memory_order_acquire));
+    if (!entry) {
+        return nullptr;
+    }
+
+    // Take a reference whilst the entry is guaranteed to be alive
+    return *entry;
+}
+
+void* ProcessTable::NextFrom(Node* node, int level, uint32_t base, uint32_t start, pid_t& pid) {
+    // Only the first child searched has to start part way through
+    for (unsigned i = SlotIndex(start, level); i < PROCESS_TABLE_FANOUT; i++, start = 0) {
+        void* child = node->slots[i].load(std::memory_order_acquire);
+        if (!child) {
+            continue;
+        }
+
+        uint32_t childBase = base | (i << (level * PROCESS_TABLE_RADIX_BITS));
+        if (level == 0) {
+            pid = childBase;
+            return child;
+        }
+
+        if (void* entry = NextFrom(reinterpret_cast<Node*>(child), level - 1, childBase, start, pid)) {
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+FancyRefPtr<Process> ProcessTable::Next(pid_t& pid) {
+    if (pid < 0) {
+        pid = 0;
+    }
+
+    // PIDs only go up to m_nextPID - 1
+    if (pid >= m_nextPID.load(std::memory_order_relaxed) - 1) {
+        return nullptr;
+    }
+
+    ReadGuard guard(*this);
+
+    pid_t found;
+    Entry* entry = reinterpret_cast<Entry*>(NextFrom(&m_root, PROCESS_TABLE_LEVELS - 1, 0, pid + 1, found));
+    if (!entry) {
+        return nullptr;
+    }
+
+    pid = found;
+    return *entry;
+}
@@ -9,6 +9,7 @@ void KernelPanic(const char** reasons, int reasonCount) {
     asm volatile("cli");
 
     APIC::Local::SendIPI(0, ICR_DSH_OTHER, ICR_MESSAGE_TYPE_FIXED, IPI_HALT);
+    Log::DisableBuffer();
 
     video_mode_t v = Video::GetVideoMode();
     Video::DrawRect(0, 0, v.width, v.height, 0, 0, 0);
@@ -1,29 +1,140 @@
 #include <Memory.h>
 
+#include <Errno.h>
 #include <Lock.h>
 #include <Logging.h>
+#include <MM/ZeroedPagePool.h>
+#include <PhysicalAllocator.h>
 #include <RefPtr.h>
 #include <Scheduler.h>
 #include <SharedMemory.h>
 
-SharedVMObject::SharedVMObject(size_t size, int64_t key, pid_t owner, pid_t recipient, bool isPrivate)
-    : PhysicalVMObject(size, false, true), key(key), owner(owner), recipient(recipient), isPrivate(isPrivate) {}
+SharedVMObject::SharedVMObject(size_t size, int64_t key, pid_t owner, pid_t recipient, bool isPrivate,
+                               bool hugePages, bool readOnly)
+    : PhysicalVMObject(size, true, true), key(key), owner(owner), recipient(recipient), isPrivate(isPrivate),
+      hugePages(hugePages), readOnly(readOnly) {}
+
+bool SharedVMObject::CanWrite(PageMap* pMap) const {
+    if (!readOnly) {
+        return true;
+    }
+
+    // Fork maps the regions of the child whilst the owner is running, so check the page map too
+    Process* proc = Process::Current();
+    return proc && proc->PID() == owner && proc->GetPageMap() == pMap;
+}
+
+int SharedVMObject::Hit(uintptr_t base, uintptr_t offset, PageMap* pMap) {
+    ScopedSpinLock acquired(blocksLock);
+
+    uint64_t pageFlags = PageFlags(pMap);
+    if (hugePages) {
+        return HitHugePage(base, offset, pMap, pageFlags);
+    }
+
+    return MapBlock(base, offset, pMap, pageFlags);
+}
+
+void SharedVMObject::MapAllocatedBlocks(uintptr_t base, PageMap* pMap) {
+    uint64_t pageFlags = PageFlags(pMap);
+
+    uintptr_t virt = base;
+    for (unsigned i = 0; i < (size >> PAGE_SHIFT_4K); i++, virt += PAGE_SIZE_4K) {
+        if (physicalBlocks[i]) {
+            Memory::MapVirtualMemory4K(static_cast<uintptr_t>(physicalBlocks[i]) << PAGE_SHIFT_4K, virt, 1, pageFlags,
+                                       pMap);
+        } else {
+            Memory::MapVirtualMemory4K(0, virt, 1, PAGE_USER, pMap); // Not present, allocated on first touch
+        }
+    }
+}
+
+int SharedVMObject::HitHugePage(uintptr_t base, uintptr_t offset, PageMap* pMap, uint64_t pageFlags) {
+    const unsigned blocksPerChunk = PAGE_SIZE_2M >> PAGE_SHIFT_4K;
+
+    uintptr_t chunkOffset = offset & ~static_cast<uintptr_t>(PAGE_SIZE_2M - 1);
+    if (chunkOffset + PAGE_SIZE_2M > size) {
+        return MapBlock(base, offset, pMap, pageFlags); // Partial chunk at the end of the object
+    }
+
+    uint32_t* blocks = &physicalBlocks[chunkOffset >> PAGE_SHIFT_4K];
+
+    bool chunkEmpty = true;
+    for (unsigned i = 0; i < blocksPerChunk; i++) {
+        if (blocks[i]) {
+            chunkEmpty = false;
+            break;
+        }
+    }
+
+    if (chunkEmpty) {
+        uintptr_t phys = Memory::AllocateLargePhysicalMemoryBlock();
+        if (!phys) {
+            return MapBlock(base, offset, pMap, pageFlags); // No contiguous memory left, fall back to 4K pages
+        }
+        assert(phys < PHYS_BLOCK_MAX);
+
+        memset(Memory::GetDirectMapping(phys), 0, PAGE_SIZE_2M);
+        for (unsigned i = 0; i < blocksPerChunk; i++) {
+            blocks[i] = (phys >> PAGE_SHIFT_4K) + i;
+        }
+    } else if (!blocks[(offset - chunkOffset) >> PAGE_SHIFT_4K]) {
+        return MapBlock(base, offset, pMap, pageFlags); // Chunk was partially populated with 4K pages
+    }
+
+    // Map the whole chunk so the rest of it does not fault
+    uintptr_t virt = base + chunkOffset;
+    for (unsigned i = 0; i < blocksPerChunk; i++, virt += PAGE_SIZE_4K) {
+        if (blocks[i]) {
+            Memory::MapVirtualMemory4K(static_cast<uintptr_t>(blocks[i]) << PAGE_SHIFT_4K, virt, 1,
+                                       pageFlags, pMap);
+        }
+    }
+
+    return 0;
+}
+
+void SharedVMObject::Resize(size_t newSize) {
+    assert(!(newSize & (PAGE_SIZE_4K - 1)));
+    assert(refCount == 0);
+
+    ScopedSpinLock acquired(blocksLock);
+
+    size_t oldCount = PAGE_COUNT_4K(size);
+    size_t newCount = PAGE_COUNT_4K(newSize);
+
+    if (newCount > oldCount) {
+        uint32_t* newBlocks = new uint32_t[newCount];
+        memcpy(newBlocks, physicalBlocks, oldCount * sizeof(uint32_t));
+        memset(newBlocks + oldCount, 0, (newCount - oldCount) * sizeof(uint32_t)); // Allocated on first touch
+
+        delete[] physicalBlocks;
+        physicalBlocks = newBlocks;
+    } else {
+        for (size_t i = newCount; i < oldCount; i++) {
+            if (physicalBlocks[i]) {
+                Memory::FreePhysicalMemoryBlock(static_cast<uintptr_t>(physicalBlocks[i]) << PAGE_SHIFT_4K);
+                physicalBlocks[i] = 0;
+            }
+        }
+    }
+
+    size = newSize;
+}
 
 namespace Memory {
 lock_t sMemLock = 0;
 
-Vector<FancyRefPtr<SharedVMObject>> table;
+Vector<FancyRefPtr<SharedVMObject>> table; // Indexed by key - 1
+Vector<int64_t> freeKeys; // Keys of destroyed objects, available for reuse
 
 int64_t NextKey() {
-    int64_t key = 1;
-    while ((key - 1) < table.size() && table[key - 1].get())
-        key++;
-
-    if (key - 1 >= table.size()) {
-        table.resize(key);
+    if (freeKeys.size()) {
+        return freeKeys.pop_back();
     }
 
-    return key;
+    table.add_back(nullptr);
+    return table.size(); // Keys start at 1
 }
 
 FancyRefPtr<SharedVMObject> GetSharedMemory(int64_t key) {
@@ -54,7 +165,11 @@ int64_t CreateSharedMemory(uint64_t size, uint64_t flags, pid_t owner, pid_t rec
 
     uint64_t vmoSize = (size + PAGE_SIZE_4K - 1) & ~static_cast<size_t>(PAGE_SIZE_4K - 1);
 
-    SharedVMObject* sMem = new SharedVMObject(vmoSize, key, owner, recipient, flags & SMEM_FLAGS_PRIVATE);
+    // Hugepages are only worth it if at least one full chunk fits
+    bool hugePages = (flags & SMEM_FLAGS_HUGEPAGES) && vmoSize >= PAGE_SIZE_2M;
+
+    SharedVMObject* sMem = new SharedVMObject(vmoSize, key, owner, recipient, flags & SMEM_FLAGS_PRIVATE, hugePages,
+                                              flags & SMEM_FLAGS_READONLY);
     table[key - 1] = sMem;
 
     return key;
@@ -98,5 +213,73 @@ void DestroySharedMemory(int64_t key) {
     }
 
     table[key - 1] = nullptr; // Keys start at 1
+    freeKeys.add_back(key);
+}
+
+long ResizeSharedMemory(int64_t key, uint64_t size, Process* proc, uintptr_t* mapping) {
+    if (!size || size > SMEM_MAX_SIZE) {
+        return -EINVAL;
+    }
+
+    // sMemLock only covers the table and the size of the object,
+    // page table work is done without it so other shared memory operations are not held up
+    FancyRefPtr<SharedVMObject> sMem;
+    {
+        ScopedSpinLock acquired(sMemLock);
+
+        sMem = GetSharedMemory(key);
+        if (!sMem.get()) {
+            return -EINVAL;
+        }
+
+        if (sMem->Owner() != proc->PID()) {
+            return -EPERM;
+        }
+    }
+
+    if (*mapping) {
+        MappedRegion* region = proc->addressSpace->AddressToRegionWriteLock(*mapping);
+        if (!region) {
+            return -EINVAL;
+        } else if (region->vmObject != sMem) {
+            region->lock.ReleaseWrite();
+            return -EINVAL;
+        }
+
+        // Other processes may still be using the memory at the old size
+        if (sMem->ReferenceCount() > 1) {
+            region->lock.ReleaseWrite();
+            return -EBUSY;
+        }
+
+        long r = proc->addressSpace->UnmapRegion(region);
+        assert(!r);
+    }
+
+    long ret = 0;
+    {
+        ScopedSpinLock acquired(sMemLock);
+
+        // The key may have been destroyed or the object mapped elsewhere whilst unlocked,
+        // MapSharedMemory holds sMemLock so nobody can map it whilst it is resized
+        if (GetSharedMemory(key).get() != sMem.get()) {
+            ret = -EINVAL;
+        } else if (sMem->ReferenceCount() > 0) {
+            ret = -EBUSY;
+        } else {
+            uint64_t vmoSize = (size + PAGE_SIZE_4K - 1) & ~static_cast<size_t>(PAGE_SIZE_4K - 1);
+            sMem->Resize(vmoSize);
+        }
+    }
+
+    // Remap even if the resize failed so the caller does not lose its mapping
+    if (*mapping) {
+        MappedRegion* region = proc->addressSpace->MapVMO(static_pointer_cast<VMObject>(sMem), 0, false);
+        assert(region && region->Base());
+
+        *mapping = region->Base();
+    }
+
+    return ret;
 }
 } // namespace Memory
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include <Storage/BlockQueue.h>
+
+#include <Assert.h>
+#include <CString.h>
+#include <Device.h>
+#include <Errno.h>
+#include <Logging.h>
+#include <Objects/Process.h>
+#include <Scheduler.h>
+#include <Timer.h>
+
+BlockRequest::BlockRequest(Operation op, uint64_t lba) : op(op), lba(lba) {}
+
+BlockRequest::BlockRequest(Operation op, uint64_t lba, void* buffer, size_t length) : op(op), lba(lba) {
+    AddSegment(buffer, length);
+}
+
+bool BlockRequest::AddSegment(void* data, size_t segmentLength) {
+    if (segmentCount >= BLOCK_REQUEST_MAX_SEGMENTS) {
+        return false;
+    }
+
+    segments[segmentCount++] = {data, segmentLength};
+    length += segmentLength;
+    return true;
+}
+
+int BlockRequest::Wait() {
+    assert(!callback);
+
+    while (!__atomic_load_n(&completed, __ATOMIC_ACQUIRE)) {
+        // Block returns straight away when there are pending signals,
+        // or when the request has been completed but not yet marked as such
+        if (Thread::Current()->Block(&blocker) || !__atomic_load_n(&completed, __ATOMIC_ACQUIRE)) {
+            Scheduler::Yield();
+        }
+    }
+
+    return status;
+}
+
+BlockQueue::BlockQueue(DiskDevice* disk) : m_disk(disk) {
+    memset(&m_stats, 0, sizeof(DiskStatistics));
+
+    char name[32];
+    strcpy(name, "BlockQueue ");
+    strncpy(name + strlen(name), disk->InstanceName().c_str(), sizeof(name) - strlen(name) - 1);
+    name[sizeof(name) - 1] = 0;
+
+    m_threadCount = disk->hardwareQueues;
+    m_runningThreads = m_threadCount;
+    for (unsigned i = 0; i < m_threadCount; i++) {
+        FancyRefPtr<Process> proc = Process::CreateKernelProcess((void*)DispatchThread, name, nullptr);
+        proc->GetMainThread()->registers.rdi = reinterpret_cast<uintptr_t>(this);
+        proc->Start();
+    }
+}
+
+BlockQueue::~BlockQueue() {
+    __atomic_store_n(&m_stopping, true, __ATOMIC_RELEASE);
+    for (unsigned i = 0; i < m_threadCount; i++) {
+        m_pending.Signal();
+    }
+
+    while (__atomic_load_n(&m_runningThreads, __ATOMIC_ACQUIRE)) {
+        Scheduler::Yield();
+    }
+}
+
+int BlockQueue::Submit(BlockRequest* request) {
+    if (!request->segmentCount || !request->length) {
+        return -EINVAL;
+    }
+
+    // Only the last segment may end part way through a block
+    for (unsigned i = 0; i + 1 < request->segmentCount; i++) {
+        if (request->segments[i].length % m_disk->blocksize) {
+            return -EINVAL;
+        }
+    }
+
+    request->status = 0;
+    request->completed = false;
+    request->submitTime = Timer::UsecondsSinceBoot();
+    request->deadline = request->submitTime +
+                        (request->op == BlockRequest::Read ? BLOCK_QUEUE_READ_EXPIRE : BLOCK_QUEUE_WRITE_EXPIRE);
+
+    {
+        ScopedSpinLock lockQueue(m_lock);
+        m_queued[request->op].add_back(request);
+
+        if (++m_stats.queueDepth > m_stats.maxQueueDepth) {
+            m_stats.maxQueueDepth = m_stats.queueDepth;
+        }
+    }
+
+    m_pending.Signal();
+    return 0;
+}
+
+void BlockQueue::GetStatistics(DiskStatistics& stats) {
+    ScopedSpinLock lockQueue(m_lock);
+    stats = m_stats;
+}
+
+void BlockQueue::DispatchThread(BlockQueue* queue) {
+    BlockRequest* batch[BLOCK_QUEUE_MAX_MERGE_REQUESTS];
+    uint8_t* bounceBuffer = reinterpret_cast<uint8_t*>(kmalloc(BLOCK_QUEUE_MAX_MERGE_SIZE)); // Merged requests are gathered here
+
+    for (;;) {
+        if (queue->m_pending.Wait()) {
+            continue; // We got interrupted
+        }
+
+        for (;;) {
+            unsigned count;
+            {
+                ScopedSpinLock lockQueue(queue->m_lock);
+                batch[0] = queue->NextRequest();
+                if (!batch[0]) {
+                    break;
+                }
+
+                count = queue->MergeAdjacent(batch, 1);
+                queue->m_stats.merges += count - 1;
+            }
+
+            queue->Dispatch(batch, count, bounceBuffer);
+        }
+
+        if (__atomic_load_n(&queue->m_stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    kfree(bounceBuffer);
+
+    // The queue may be freed as soon as the last thread is done with it
+    __atomic_sub_fetch(&queue->m_runningThreads, 1, __ATOMIC_RELEASE);
+
+    acquireLock(&Thread::Current()->kernelLock); // Process::Die expects the lock to be held
+    Process::Current()->Die();
+}
+
+BlockRequest* BlockQueue::NextRequest() {
+    FastList<BlockRequest*>& reads = m_queued[BlockRequest::Read];
+    FastList<BlockRequest*>& writes = m_queued[BlockRequest::Write];
+    if (!reads.get_length() && !writes.get_length()) {
+        return nullptr;
+    }
+
+    uint64_t now = Timer::UsecondsSinceBoot();
+
+    // Prefer reads as someone is usually waiting on them,
+    // but do not let them hold back writes forever
+    FastList<BlockRequest*>* list = &reads;
+    if (!reads.get_length() || (writes.get_length() && (writes.get_front()->deadline <= now ||
+                                                        m_readsSinceWrite >= BLOCK_QUEUE_WRITES_STARVED))) {
+        list = &writes;
+        m_readsSinceWrite = 0;
+    } else if (writes.get_length()) {
+        m_readsSinceWrite++;
+    }
+
+    // Requests are in order of submission so the front expires first
+    BlockRequest* oldest = list->get_front();
+    if (oldest->deadline <= now) {
+        list->remove(oldest);
+        return oldest;
+    }
+
+    // Carry on upwards from where the last command ended,
+    // then go back to the lowest LBA once there is nothing left above
+    BlockRequest* next = nullptr;
+    BlockRequest* lowest = oldest;
+    for (BlockRequest* r = oldest; r; r = list->next(r)) {
+        if (r->lba >= m_headLBA && (!next || r->lba < next->lba)) {
+            next = r;
+        }
+
+        if (r->lba < lowest->lba) {
+            lowest = r;
+        }
+    }
+
+    if (!next) {
+        next = lowest;
+    }
+
+    list->remove(next);
+    return next;
+}
+
+unsigned BlockQueue::MergeAdjacent(BlockRequest** batch, unsigned count) {
+    FastList<BlockRequest*>& list = m_queued[batch[0]->op];
+    size_t blocksize = m_disk->blocksize;
+
+    if (batch[0]->length % blocksize) {
+        return count; // Ends part way through a block, nothing can follow it
+    }
+
+    uint64_t start = batch[0]->lba;
+    uint64_t end = start + batch[0]->length / blocksize;
+    size_t length = batch[0]->length;
+
+    bool merged = true;
+    while (merged && count < BLOCK_QUEUE_MAX_MERGE_REQUESTS) {
+        merged = false;
+
+        for (BlockRequest* r = list.get_front(); r; r = list.next(r)) {
+            if ((r->length % blocksize) || length + r->length > BLOCK_QUEUE_MAX_MERGE_SIZE) {
+                continue;
+            }
+
+            if (r->lba == end) {
+                batch[count++] = r; // Back merge
+                end += r->length / blocksize;
+            } else if (r->lba + r->length / blocksize == start) {
+                for (unsigned i = count; i > 0; i--) { // Front merge
+                    batch[i] = batch[i - 1];
+                }
+                batch[0] = r;
+                count++;
+                start = r->lba;
+            } else {
+                continue;
+            }
+
+            length += r->length;
+            list.remove(r);
+
+            merged = true;
+            break;
+        }
+    }
+
+    return count;
+}
+
+int BlockQueue::Transfer(BlockRequest::Operation op, uint64_t lba, size_t length, void* buffer) {
+    __atomic_add_fetch(&m_stats.commands, 1, __ATOMIC_RELAXED);
+
+    int e;
+    if (op == BlockRequest::Read) {
+        e = m_disk->ReadDiskBlock(lba, length, buffer);
+    } else {
+        e = m_disk->WriteDiskBlock(lba, length, buffer);
+    }
+
+    if (e) {
+        Log::Debug(debugLevelPartitions, DebugLevelNormal, "[BlockQueue] %s: Error %d at LBA %x (%u bytes)",
+                   m_disk->InstanceName().c_str(), e, lba, length);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+void BlockQueue::Dispatch(BlockRequest** batch, unsigned count, uint8_t* bounceBuffer) {
+    BlockRequest* first = batch[0];
+    size_t blocksize = m_disk->blocksize;
+
+    // Lone requests which do not need gathering go straight to the driver,
+    // as do requests too large for the bounce buffer
+    if (count == 1 && (first->segmentCount == 1 || first->length > BLOCK_QUEUE_MAX_MERGE_SIZE)) {
+        uint64_t lba = first->lba;
+        int status = 0;
+        for (unsigned i = 0; i < first->segmentCount && !status; i++) {
+            const BlockSegment& segment = first->segments[i];
+
+            status = Transfer(first->op, lba, segment.length, segment.data);
+            lba += segment.length / blocksize;
+        }
+
+        m_headLBA = lba;
+        Complete(first, status);
+        return;
+    }
+
+    size_t length = 0;
+    if (first->op == BlockRequest::Write) {
+        for (unsigned i = 0; i < count; i++) {
+            for (unsigned s = 0; s < batch[i]->segmentCount; s++) {
+                memcpy(bounceBuffer + length, batch[i]->segments[s].data, batch[i]->segments[s].length);
+                length += batch[i]->segments[s].length;
+            }
+        }
+    } else {
+        for (unsigned i = 0; i < count; i++) {
+            length += batch[i]->length;
+        }
+    }
+
+    int status = Transfer(first->op, first->lba, length, bounceBuffer);
+    m_headLBA = first->lba + (length + blocksize - 1) / blocksize;
+
+    size_t offset = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (first->op == BlockRequest::Read && !status) {
+            for (unsigned s = 0; s < batch[i]->segmentCount; s++) {
+                memcpy(batch[i]->segments[s].data, bounceBuffer + offset, batch[i]->segments[s].length);
+                offset += batch[i]->segments[s].length;
+            }
+        }
+
+        Complete(batch[i], status);
+    }
+}
+
+void BlockQueue::Complete(BlockRequest* request, int status) {
+    uint64_t elapsed = Timer::UsecondsSinceBoot() - request->submitTime;
+
+    {
+        ScopedSpinLock lockQueue(m_lock);
+        if (status) {
+            m_stats.errors++;
+        } else if (request->op == BlockRequest::Read) {
+            m_stats.reads++;
+            m_stats.bytesRead += request->length;
+            m_stats.readTime += elapsed;
+        } else {
+            m_stats.writes++;
+            m_stats.bytesWritten += request->length;
+            m_stats.writeTime += elapsed;
+        }
+
+        m_stats.queueDepth--;
+    }
+
+    request->status = status;
+    if (request->callback) {
+        request->callback(request, request->context);
+        return;
+    }
+
+    // The waiter may return as soon as completed is set,
+    // so do not touch the request after that
+    request->blocker.Unblock();
+    __atomic_store_n(&request->completed, true, __ATOMIC_RELEASE);
+}
@@ -1,10 +1,16 @@
 #include <Device.h>
 
+#include <ABI/Storage.h>
 #include <Errno.h>
 #include <Fs/Fat32.h>
 #include <Fs/VolumeManager.h>
 #include <Logging.h>
+#include <Math.h>
+#include <Scheduler.h>
+#include <Storage/BlockQueue.h>
+#include <UserPointer.h>
 
+// Disks are probed by parallel boot tasks, so numbers are handed out in whatever order they are found
 static int nextDeviceNumber = 0;
 
 DiskDevice::DiskDevice() : Device(DeviceTypeStorageDevice) {
@@ -12,7 +18,7 @@ DiskDevice::DiskDevice() : Device(DeviceTypeStorageDevice) {
 
     char buf[16];
     strcpy(buf, "hd");
-    itoa(nextDeviceNumber++, buf + 2, 10);
+    itoa(__atomic_fetch_add(&nextDeviceNumber, 1, __ATOMIC_RELAXED), buf + 2, 10);
 
     SetInstanceName(buf);
 }
@@ -25,12 +31,83 @@ int DiskDevice::ReadDiskBlock(uint64_t lba, uint32_t count, void* buffer) { retu
 
 int DiskDevice::WriteDiskBlock(uint64_t lba, uint32_t count, void* buffer) { return -1; }
 
+BlockQueue* DiskDevice::Queue() {
+    BlockQueue* queue = __atomic_load_n(&m_queue, __ATOMIC_ACQUIRE);
+    if (queue) {
+        return queue;
+    }
+
+    // Creating the queue allocates and starts its dispatch threads so do it without a lock,
+    // if another thread got there first use its queue
+    BlockQueue* created = new BlockQueue(this);
+    if (!__atomic_compare_exchange_n(&m_queue, &queue, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        delete created;
+        return queue;
+    }
+
+    return created;
+}
+
+int DiskDevice::SubmitRequest(BlockRequest* request) { return Queue()->Submit(request); }
+
+int DiskDevice::QueuedRead(uint64_t lba, uint32_t count, void* buffer) { return QueuedTransfer(false, lba, count, buffer); }
+
+int DiskDevice::QueuedWrite(uint64_t lba, uint32_t count, void* buffer) { return QueuedTransfer(true, lba, count, buffer); }
+
+int DiskDevice::QueuedTransfer(bool write, uint64_t lba, uint32_t count, void* buffer) {
+    // Requests are carried out by the dispatch thread, which cannot see
+    // the address space of the caller, so copy user buffers in pieces
+    if (reinterpret_cast<uintptr_t>(buffer) < KERNEL_VIRTUAL_BASE) {
+        uint8_t* userBuffer = reinterpret_cast<uint8_t*>(buffer);
+        uint8_t* kernelBuffer = reinterpret_cast<uint8_t*>(kmalloc(MIN(count, BLOCK_QUEUE_MAX_MERGE_SIZE)));
+
+        int e = 0;
+        while (count && !e) {
+            uint32_t chunk = MIN(count, BLOCK_QUEUE_MAX_MERGE_SIZE);
+            if (write && UserMemcpy(kernelBuffer, userBuffer, chunk)) {
+                e = -EFAULT;
+            } else if (!(e = QueuedTransfer(write, lba, chunk, kernelBuffer)) && !write &&
+                       UserMemcpy(userBuffer, kernelBuffer, chunk)) {
+                e = -EFAULT;
+            }
+
+            lba += chunk / blocksize;
+            userBuffer += chunk;
+            count -= chunk;
+        }
+
+        kfree(kernelBuffer);
+        return e;
+    }
+
+    BlockRequest request(write ? BlockRequest::Write : BlockRequest::Read, lba, buffer, count);
+    if (int e = SubmitRequest(&request)) {
+        return e;
+    }
+
+    return request.Wait();
+}
+
 ssize_t DiskDevice::Read(size_t off, size_t size, uint8_t* buffer) {
     if (off & (blocksize - 1)) {
         return -EINVAL; // Block aligned reads only
     }
 
-    int e = ReadDiskBlock(off / blocksize, size, buffer);
+    int e = QueuedRead(off / blocksize, size, buffer);
+
+    if (e) {
+        return -EIO;
+    }
+
+    return size;
+}
+
+ssize_t DiskDevice::Write(size_t off, size_t size, uint8_t* buffer) {
+    if ((off | size) & (blocksize - 1)) {
+        return -EINVAL; // Whole blocks only
+    }
+
+    int e = QueuedWrite(off / blocksize, size, buffer);
 
     if (e) {
         return -EIO;
@@ -39,6 +116,25 @@ ssize_t DiskDevice::Read(size_t off, size_t size, uint8_t* buffer) {
     return size;
 }
 
-ssize_t DiskDevice::Write(size_t off, size_t size, uint8_t* buffer) { return -ENOSYS; }
+int DiskDevice::Ioctl(uint64_t cmd, uint64_t arg) {
+    switch (cmd) {
+    case IoCtlDiskGetStatistics: {
+        UserPointer<DiskStatistics> statsPointer = arg;
+        if (!Scheduler::CheckUsermodePointer(statsPointer.Pointer())) {
+            return -EFAULT;
+        }
+
+        DiskStatistics stats;
+        Queue()->GetStatistics(stats);
+        if (statsPointer.StoreValue(stats)) {
+            return -EFAULT;
+        }
+        return 0;
+    }
+    default:
+        return -EINVAL;
+    }
+}
 
-DiskDevice::~DiskDevice() {}
\ No newline at end of file
+// Waits for the dispatch threads to finish outstanding requests and exit
+DiskDevice::~DiskDevice() { delete m_queue; }
\ No newline at end of file
@@ -122,7 +122,7 @@ int PTYDevice::Ioctl(uint64_t cmd, uint64_t arg) {
     return 0;
 }
 
-void PTYDevice::Watch(FilesystemWatcher& watcher, int events) {
+void PTYDevice::Watch(KernelObjectWatcher& watcher, int events) {
     if (device == PTYMasterDevice) {
         pty->WatchMaster(watcher, events);
     } else if (device == PTYSlaveDevice) {
@@ -132,7 +132,7 @@ void PTYDevice::Watch(FilesystemWatcher& watcher, int events) {
     }
 }
 
-void PTYDevice::Unwatch(FilesystemWatcher& watcher) {
+void PTYDevice::Unwatch(KernelObjectWatcher& watcher) {
     if (device == PTYMasterDevice) {
         pty->UnwatchMaster(watcher);
     } else if (device == PTYSlaveDevice) {
@@ -301,7 +301,7 @@ ssize_t PTY::SlaveWrite(char* buffer, size_t count) {
     return written;
 }
 
-void PTY::WatchMaster(FilesystemWatcher& watcher, int events) {
+void PTY::WatchMaster(KernelObjectWatcher& watcher, int events) {
     if (!(events & (POLLIN))) { // We don't really block on writes and nothing else applies except POLLIN
         watcher.Signal();
         return;
@@ -313,7 +313,7 @@ void PTY::WatchMaster(FilesystemWatcher& watcher, int events) {
     m_watchingMaster.add_back(&watcher);
 }
 
-void PTY::WatchSlave(FilesystemWatcher& watcher, int events) {
+void PTY::WatchSlave(KernelObjectWatcher& watcher, int events) {
     if (!(events & (POLLIN))) { // We don't really block on writes and nothing else applies except POLLIN
         watcher.Signal();
         return;
@@ -325,6 +325,6 @@ void PTY::WatchSlave(FilesystemWatcher& watcher, int events) {
     m_watchingSlave.add_back(&watcher);
 }
 
-void PTY::UnwatchMaster(FilesystemWatcher& watcher) { m_watchingMaster.remove(&watcher); }
+void PTY::UnwatchMaster(KernelObjectWatcher& watcher) { m_watchingMaster.remove(&watcher); }
 
-void PTY::UnwatchSlave(FilesystemWatcher& watcher) { m_watchingSlave.remove(&watcher); }
\ No newline at end of file
+void PTY::UnwatchSlave(KernelObjectWatcher& watcher) { m_watchingSlave.remove(&watcher); }
\ No newline at end of file
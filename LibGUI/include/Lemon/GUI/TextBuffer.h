@@ -0,0 +1,136 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Lemon::GUI {
+/////////////////////////////
+/// \brief Piece table text document
+///
+/// The loaded text is never modified, inserted text is appended to a separate buffer
+/// and the document is a list of pieces of either buffer. Line breaks in the loaded text
+/// are indexed lazily, so loading is constant time and lines are only found as they are needed.
+/////////////////////////////
+class TextBuffer final {
+public:
+    TextBuffer();
+
+    /////////////////////////////
+    /// \brief Replace the document, taking ownership of the text
+    /////////////////////////////
+    void Load(std::unique_ptr<char[]> text, size_t size);
+
+    /////////////////////////////
+    /// \brief Replace the document with a copy of the text
+    /////////////////////////////
+    void Load(const char* text, size_t size);
+
+    inline size_t Size() const { return m_size; }
+
+    /////////////////////////////
+    /// \brief Get line count
+    ///
+    /// Lines in the loaded text are only counted once indexed,
+    /// so this can grow until IsIndexed() returns true.
+    /////////////////////////////
+    size_t LineCount();
+
+    /////////////////////////////
+    /// \brief Index more of the loaded text
+    ///
+    /// \param maxBytes Maximum amount of bytes to scan for line breaks
+    ///
+    /// \return true if the whole document has been indexed
+    /////////////////////////////
+    bool IndexLines(size_t maxBytes);
+    inline bool IsIndexed() const { return m_originalIndexed >= m_originalSize; }
+
+    /////////////////////////////
+    /// \brief Get the offset of the start of a line
+    ///
+    /// Indexes as much of the loaded text as is needed to find the line.
+    ///
+    /// \return Offset of the line, or the size of the document if the line does not exist
+    /////////////////////////////
+    size_t LineStart(size_t line);
+
+    /////////////////////////////
+    /// \brief Get the length of a line excluding the line break
+    /////////////////////////////
+    size_t LineLength(size_t line);
+
+    /////////////////////////////
+    /// \brief Get the contents of a line excluding the line break
+    ///
+    /// \param maxLength Maximum amount of characters to copy
+    /////////////////////////////
+    void GetLine(size_t line, std::string& out, size_t maxLength = SIZE_MAX);
+
+    /////////////////////////////
+    /// \brief Copy text out of the document
+    /////////////////////////////
+    std::string GetText(size_t offset = 0, size_t length = SIZE_MAX) const;
+
+    /////////////////////////////
+    /// \brief Call func for each contiguous span of text in order
+    ///
+    /// Avoids copying the document, e.g. when writing it to a file.
+    /////////////////////////////
+    template <typename F> void ForEachSpan(F func) const {
+        for (const Piece& piece : m_pieces) {
+            func(PieceData(piece), piece.length);
+        }
+    }
+
+    void Insert(size_t offset, const char* text, size_t length);
+    void Erase(size_t offset, size_t length);
+
+private:
+    enum Source : uint8_t {
+        SourceOriginal,
+        SourceAdd,
+    };
+
+    struct Piece {
+        Source source;
+        size_t start;
+        size_t length;
+    };
+
+    inline const char* PieceData(const Piece& piece) const {
+        return (piece.source == SourceOriginal ? m_original.get() : m_add.data()) + piece.start;
+    }
+
+    inline const std::vector<size_t>& LineBreaks(Source source) const {
+        return source == SourceOriginal ? m_originalLineBreaks : m_addLineBreaks;
+    }
+
+    // Amount of the source buffer which has been indexed
+    inline size_t Indexed(Source source) const { return source == SourceOriginal ? m_originalIndexed : m_add.size(); }
+
+    // Returns false and the size of the document if the line does not exist
+    bool FindLineStart(size_t line, size_t& offset);
+    // Split the piece containing offset so it falls on a piece boundary, returns the index of the piece after it
+    size_t SplitAt(size_t offset);
+
+    std::unique_ptr<char[]> m_original;
+    size_t m_originalSize = 0;
+    size_t m_originalIndexed = 0;
+    // Offsets of the line breaks in each buffer
+    std::vector<size_t> m_originalLineBreaks;
+
+    std::string m_add;
+    std::vector<size_t> m_addLineBreaks;
+
+    std::vector<Piece> m_pieces;
+    size_t m_size = 0;
+
+    // Line count cache, invalidated by edits and indexing
+    size_t m_lineCount = 0;
+    bool m_lineCountDirty = true;
+};
+} // namespace Lemon::GUI
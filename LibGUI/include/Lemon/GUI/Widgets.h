@@ -2,6 +2,7 @@
 
 #include <Lemon/GUI/ContextMenu.h>
 #include <Lemon/GUI/Event.h>
+#include <Lemon/GUI/TextBuffer.h>
 #include <Lemon/GUI/Theme.h>
 #include <Lemon/Graphics/Graphics.h>
 #include <Lemon/Graphics/Surface.h>
@@ -51,6 +52,11 @@ public:
                            WidgetAlignment newAlignVert = WAlignTop);
 
     virtual void Paint(surface_t* surface);
+    // Repaint the widget where it intersects region, by default the whole widget is repainted
+    virtual void PaintRegion(surface_t* surface, const Rect& region) { Paint(surface); }
+
+    // Mark the widget as needing to be repainted
+    void Invalidate();
 
     virtual void OnMouseEnter(vector2i_t mousePos);
     virtual void OnMouseExit(vector2i_t mousePos);
@@ -110,6 +116,7 @@ public:
     virtual void RemoveWidget(Widget* w);
 
     virtual void Paint(surface_t* surface);
+    virtual void PaintRegion(surface_t* surface, const Rect& region);
 
     virtual void OnMouseEnter(vector2i_t mousePos);
     virtual void OnMouseExit(vector2i_t mousePos);
@@ -279,10 +286,8 @@ public:
     bool editable = true;
     bool multiline = false;
     bool active = false;
-    std::vector<std::string> contents;
-    int lineCount;
+    TextBuffer document;
     int lineSpacing = 3;
-    size_t bufferSize;
     vector2i_t cursorPos = {0, 0};
     Graphics::Font* font = Graphics::DefaultFont();
 
@@ -290,6 +295,9 @@ public:
 
     void Paint(surface_t* surface);
     void LoadText(const char* text);
+    // Takes ownership of the text so large files are not copied
+    void LoadText(std::unique_ptr<char[]> text, size_t size);
+    inline std::string GetText() const { return document.GetText(); }
 
     void OnMouseDown(vector2i_t mousePos);
     void OnMouseUp(vector2i_t mousePos);
@@ -11,6 +11,7 @@
 #include <utility>
 #include <functional>
 #include <map>
+#include <vector>
 
 #define WINDOW_FLAGS_NODECORATION 0x1   // Do not draw window borders
 #define WINDOW_FLAGS_RESIZABLE 0x2      // Allow window resizing
@@ -21,6 +22,10 @@
 
 #define WINDOW_MENUBAR_HEIGHT 20
 
+// Maximum amount of damage rects passed to the WM per frame, any more and the whole window is redrawn
+#define WINDOW_DAMAGE_MAX 16
+#define WINDOW_DAMAGE_ALL (WINDOW_DAMAGE_MAX + 1)
+
 namespace Lemon::GUI {
 typedef void (*WindowPaintHandler)(surface_t*);
 
@@ -43,8 +48,12 @@ struct WindowBuffer {
     uint64_t currentBuffer;
     uint64_t buffer1Offset;
     uint64_t buffer2Offset;
-    uint32_t drawing; // Is being drawn?
+    uint32_t drawing; // Buffer being read by the WM (index + 1), 0 if none
     uint32_t dirty;   // Does it need to be drawn?
+
+    uint32_t damageLock;            // Held while damage is being written or read
+    uint32_t damageCount;           // Amount of rects in damage, WINDOW_DAMAGE_ALL if the whole window changed
+    Rect damage[WINDOW_DAMAGE_MAX]; // Regions (relative to the window) changed since the WM last drew the window
 };
 
 enum WindowType {
@@ -130,10 +139,32 @@ public:
     /////////////////////////////
     virtual void Paint();
 
+    /////////////////////////////
+    /// \brief Enable damage tracking
+    ///
+    /// By default Paint() redraws the whole window. With damage tracking only the regions passed to Invalidate()
+    /// are redrawn, the rest is kept from the last frame, and Paint() does nothing if nothing has been invalidated.
+    /// All widgets in the window must invalidate themselves when they change.
+    /////////////////////////////
+    inline void EnableDamageTracking() { m_damageTracking = true; }
+
+    /////////////////////////////
+    /// \brief Mark a region of the window as needing to be repainted
+    ///
+    /// \param rect Region of the window to repaint
+    /////////////////////////////
+    void Invalidate(const Rect& rect);
+
+    /////////////////////////////
+    /// \brief Mark the whole window as needing to be repainted
+    /////////////////////////////
+    inline void InvalidateAll() { m_invalidateAll = true; }
+
     /////////////////////////////
     /// \brief Swap the window buffers
     ///
-    /// Swap the window buffers, equivalent to Paint() on a Basic Window without OnPaint()
+    /// Swap the window buffers, equivalent to Paint() on a Basic Window without OnPaint().
+    /// Unless damage tracking is enabled the whole window is redrawn by the WM.
     /////////////////////////////
     void SwapBuffers();
 
@@ -333,6 +364,15 @@ private:
     uint8_t* m_buffer2;
     uint64_t m_windowBufferKey;
 
+    bool m_damageTracking = false;
+    // Regions to repaint on the next Paint()
+    bool m_invalidateAll = true;
+    std::vector<Rect> m_damage;
+    // Regions changed in the front buffer,
+    // these get copied to the back buffer before a partial repaint
+    bool m_lastDamageAll = true;
+    std::vector<Rect> m_lastDamage;
+
     uint32_t m_flags;
 
     int m_windowType = WindowType::Basic;
@@ -26,11 +26,11 @@ void FileDialogOnFileOpened(FileView*, std::string path) {
 }
 
 void FileDialogOnFileSelected(void*, std::string path) {
-    dialogFileBox->contents.front() = std::move(path);
+    dialogFileBox->LoadText(path.c_str());
 }
 
 void FileDialogOnPathChanged(void*, std::string) {
-    dialogFileBox->contents.front().clear();
+    dialogFileBox->LoadText("");
 }
 
 void FileDialogOnCancelPress(Lemon::GUI::Window* window) {
@@ -38,17 +38,18 @@ void FileDialogOnCancelPress(Lemon::GUI::Window* window) {
 }
 
 void FileDialogOnFileBoxSubmit(Lemon::GUI::TextBox* box) {
-    if (box->contents.size() > NAME_MAX) {
+    std::string name = box->GetText();
+    if (name.empty() || name.length() > NAME_MAX) {
         DisplayMessageBox("Open...", "Filename is invalid!", MsgButtonsOK);
         return;
     }
 
     // Check for a leading slash
     std::string path;
-    if(box->contents.front().front() != '/') {
+    if(name.front() != '/') {
         path = dialogFileView->currentPath;
     }
-    path += box->contents.front();
+    path += name;
 
     struct stat sResult;
 
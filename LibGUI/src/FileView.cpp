@@ -5,7 +5,9 @@
 #include <Lemon/GUI/Messagebox.h>
 #include <Lemon/GUI/Theme.h>
 #include <Lemon/GUI/Window.h>
+#include <Lemon/System/Filesystem.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <dirent.h>
 #include <fcntl.h>
@@ -158,46 +160,27 @@ void FileView::Refresh() {
 
     fileList->ClearItems();
 
-    std::string absPath;
-    struct dirent** entries;
-    int entryCount =
-        scandir(currentPath.c_str(), &entries, static_cast<int (*)(const dirent*)>([](const dirent* d) -> int {
-                    (void)d;
-                    return 1;
-                }),
-                static_cast<int (*)(const dirent**, const dirent**)>([](const dirent** a, const dirent** b) {
-                    if ((*a)->d_type == DT_DIR && (*b)->d_type != DT_DIR) {
-                        return -1;
-                    } else if ((*b)->d_type == DT_DIR && (*a)->d_type != DT_DIR) {
-                        return 1;
-                    }
-                    return strcmp((*a)->d_name, (*b)->d_name);
-                }));
-
-    if (entryCount < 0) {
+    // Attributes come with the entries, no need to lstat every entry
+    std::vector<DirectoryEntryPlus> entries;
+    if (Lemon::ListDirectory(currentPath.c_str(), entries)) {
         perror("GUI: FileView: open:");
         return;
     }
 
-    for (int i = 0; i < entryCount; i++) {
-        struct dirent& dirent = *entries[i];
+    std::sort(entries.begin(), entries.end(), [](const DirectoryEntryPlus& a, const DirectoryEntryPlus& b) {
+        if (S_ISDIR(a.mode) != S_ISDIR(b.mode)) {
+            return S_ISDIR(a.mode); // Directories first
+        }
+        return strcmp(a.name, b.name) < 0;
+    });
 
+    for (const DirectoryEntryPlus& entry : entries) {
         GridItem item;
-        item.name = dirent.d_name;
-
-        absPath = currentPath + "/" + dirent.d_name;
-
-        struct stat statResult;
-        int ret = lstat(absPath.c_str(), &statResult);
-        if (ret) {
-            perror("GUI: FileView: File: Stat");
-            // assert(!ret);
-            continue;
-        }
+        item.name = entry.name;
 
-        if (S_ISDIR(statResult.st_mode)) {
+        if (S_ISDIR(entry.mode)) {
             item.icon = folderIcon;
-        } else if (char* ext = strchr(dirent.d_name, '.'); ext) {
+        } else if (const char* ext = strchr(entry.name, '.'); ext) {
             if (!strcmp(ext, ".txt") || !strcmp(ext, ".cfg") || !strcmp(ext, ".py") || !strcmp(ext, ".asm")) {
                 item.icon = textFileIcon;
             } else if (!strcmp(ext, ".json")) {
@@ -211,11 +194,6 @@ void FileView::Refresh() {
 
         fileList->AddItem(item);
     }
-
-    while (--entryCount >= 0) {
-        free(entries[entryCount]);
-    }
-    free(entries);
 }
 
 void FileView::OnSubmit(std::string& path) {
@@ -256,6 +234,7 @@ void FileView::OnListSubmit(GridItem& item, GridView* list) {
 void FileView::OnTextBoxSubmit(TextBox* textBox) {
     FileView* fv = (FileView*)textBox->GetParent();
 
-    fv->OnSubmit(textBox->contents[0]);
+    std::string path = textBox->GetText();
+    fv->OnSubmit(path);
 }
 } // namespace Lemon::GUI
\ No newline at end of file
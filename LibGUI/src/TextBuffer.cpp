@@ -0,0 +1,260 @@
+#include <Lemon/GUI/TextBuffer.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+// Bytes indexed at a time when looking for a line which has not been indexed yet
+#define TEXT_BUFFER_INDEX_CHUNK (256 * 1024)
+
+namespace Lemon::GUI {
+static inline size_t CountLineBreaks(const std::vector<size_t>& breaks, size_t start, size_t end) {
+    return std::lower_bound(breaks.begin(), breaks.end(), end) - std::lower_bound(breaks.begin(), breaks.end(), start);
+}
+
+TextBuffer::TextBuffer() {}
+
+void TextBuffer::Load(std::unique_ptr<char[]> text, size_t size) {
+    m_original = std::move(text);
+    m_originalSize = size;
+    m_originalIndexed = 0;
+    m_originalLineBreaks.clear();
+
+    m_add.clear();
+    m_addLineBreaks.clear();
+
+    m_pieces.clear();
+    if (size) {
+        m_pieces.push_back({SourceOriginal, 0, size});
+    }
+
+    m_size = size;
+    m_lineCountDirty = true;
+}
+
+void TextBuffer::Load(const char* text, size_t size) {
+    std::unique_ptr<char[]> copy(new char[size]);
+    memcpy(copy.get(), text, size);
+
+    Load(std::move(copy), size);
+}
+
+size_t TextBuffer::LineCount() {
+    if (!m_lineCountDirty) {
+        return m_lineCount;
+    }
+
+    size_t lines = 1;
+    for (const Piece& piece : m_pieces) {
+        size_t end = piece.start + piece.length;
+        size_t indexed = Indexed(piece.source);
+        if (piece.start < indexed) {
+            lines += CountLineBreaks(LineBreaks(piece.source), piece.start, std::min(end, indexed));
+        }
+
+        if (end > indexed) {
+            break; // We do not know about any lines past here yet
+        }
+    }
+
+    m_lineCount = lines;
+    m_lineCountDirty = false;
+    return lines;
+}
+
+bool TextBuffer::IndexLines(size_t maxBytes) {
+    size_t end = std::min(m_originalSize, m_originalIndexed + maxBytes);
+
+    const char* text = m_original.get();
+    size_t pos = m_originalIndexed;
+    while (pos < end) {
+        const char* lineBreak = reinterpret_cast<const char*>(memchr(text + pos, '\n', end - pos));
+        if (!lineBreak) {
+            break;
+        }
+
+        pos = lineBreak - text;
+        m_originalLineBreaks.push_back(pos++);
+    }
+
+    m_originalIndexed = end;
+    m_lineCountDirty = true;
+    return IsIndexed();
+}
+
+bool TextBuffer::FindLineStart(size_t line, size_t& offset) {
+    offset = 0;
+    if (line == 0) {
+        return true;
+    }
+
+    size_t remaining = line; // Line breaks left to pass
+    for (const Piece& piece : m_pieces) {
+        size_t end = piece.start + piece.length;
+
+        for (;;) {
+            const std::vector<size_t>& breaks = LineBreaks(piece.source);
+            size_t indexedEnd = std::min(end, Indexed(piece.source));
+
+            auto first = std::lower_bound(breaks.begin(), breaks.end(), piece.start);
+            size_t count = std::lower_bound(first, breaks.end(), indexedEnd) - first;
+            if (count >= remaining) {
+                offset += first[remaining - 1] - piece.start + 1;
+                return true;
+            }
+
+            if (indexedEnd >= end) {
+                remaining -= count;
+                break;
+            }
+
+            // Only the loaded text can be partially indexed
+            IndexLines(TEXT_BUFFER_INDEX_CHUNK);
+        }
+
+        offset += piece.length;
+    }
+
+    offset = m_size;
+    return false;
+}
+
+size_t TextBuffer::LineStart(size_t line) {
+    size_t offset;
+    FindLineStart(line, offset);
+
+    return offset;
+}
+
+size_t TextBuffer::LineLength(size_t line) {
+    size_t start;
+    if (!FindLineStart(line, start)) {
+        return 0;
+    }
+
+    size_t next;
+    if (!FindLineStart(line + 1, next)) {
+        return m_size - start; // Last line
+    }
+
+    return next - start - 1;
+}
+
+void TextBuffer::GetLine(size_t line, std::string& out, size_t maxLength) {
+    size_t start;
+    if (!FindLineStart(line, start)) {
+        out.clear();
+        return;
+    }
+
+    size_t length = m_size - start;
+    if (size_t next; FindLineStart(line + 1, next)) {
+        length = next - start - 1;
+    }
+
+    out = GetText(start, std::min(length, maxLength));
+}
+
+std::string TextBuffer::GetText(size_t offset, size_t length) const {
+    std::string text;
+    if (offset >= m_size) {
+        return text;
+    }
+
+    length = std::min(length, m_size - offset);
+    text.reserve(length);
+
+    size_t pos = 0;
+    for (const Piece& piece : m_pieces) {
+        if (!length) {
+            break;
+        }
+
+        if (offset < pos + piece.length) {
+            size_t pieceOffset = offset - pos;
+            size_t count = std::min(length, piece.length - pieceOffset);
+
+            text.append(PieceData(piece) + pieceOffset, count);
+            offset += count;
+            length -= count;
+        }
+
+        pos += piece.length;
+    }
+
+    return text;
+}
+
+void TextBuffer::Insert(size_t offset, const char* text, size_t length) {
+    if (!length) {
+        return;
+    }
+
+    offset = std::min(offset, m_size);
+
+    size_t addStart = m_add.size();
+    m_add.append(text, length);
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\n') {
+            m_addLineBreaks.push_back(addStart + i);
+        }
+    }
+
+    size_t index = SplitAt(offset);
+
+    // When typing, each character follows the last so extend its piece
+    if (index > 0) {
+        Piece& previous = m_pieces[index - 1];
+        if (previous.source == SourceAdd && previous.start + previous.length == addStart) {
+            previous.length += length;
+
+            m_size += length;
+            m_lineCountDirty = true;
+            return;
+        }
+    }
+
+    m_pieces.insert(m_pieces.begin() + index, {SourceAdd, addStart, length});
+
+    m_size += length;
+    m_lineCountDirty = true;
+}
+
+void TextBuffer::Erase(size_t offset, size_t length) {
+    if (offset >= m_size || !length) {
+        return;
+    }
+
+    length = std::min(length, m_size - offset);
+
+    size_t first = SplitAt(offset);
+    size_t last = SplitAt(offset + length);
+    m_pieces.erase(m_pieces.begin() + first, m_pieces.begin() + last);
+
+    m_size -= length;
+    m_lineCountDirty = true;
+}
+
+size_t TextBuffer::SplitAt(size_t offset) {
+    size_t pos = 0;
+    for (size_t i = 0; i < m_pieces.size(); i++) {
+        Piece& piece = m_pieces[i];
+        if (offset == pos) {
+            return i;
+        }
+
+        if (offset < pos + piece.length) {
+            size_t split = offset - pos;
+            Piece tail = {piece.source, piece.start + split, piece.length - split};
+
+            piece.length = split;
+            m_pieces.insert(m_pieces.begin() + i + 1, tail);
+            return i + 1;
+        }
+
+        pos += piece.length;
+    }
+
+    return m_pieces.size();
+}
+} // namespace Lemon::GUI
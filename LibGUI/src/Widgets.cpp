@@ -36,6 +36,12 @@ void Widget::SetLayout(LayoutSize newSizeX, LayoutSize newSizeY, WidgetAlignment
 
 void Widget::Paint(__attribute__((unused)) surface_t* surface) {}
 
+void Widget::Invalidate() {
+    if (window) {
+        window->Invalidate(fixedBounds);
+    }
+}
+
 void Widget::OnMouseEnter(vector2i_t mousePos) { OnMouseMove(mousePos); }
 
 void Widget::OnMouseExit(__attribute__((unused)) vector2i_t mousePos) {}
@@ -134,9 +140,12 @@ void Container::AddWidget(Widget* w) {
     }
 
     UpdateFixedBounds();
+    Invalidate();
 }
 
 void Container::RemoveWidget(Widget* w) {
+    Invalidate();
+
     w->SetParent(nullptr);
     w->SetWindow(nullptr);
 
@@ -158,10 +167,27 @@ void Container::Paint(surface_t* surface) {
     }
 }
 
+void Container::PaintRegion(surface_t* surface, const Rect& region) {
+    if (!fixedBounds.Intersects(region)) {
+        return;
+    }
+
+    if (background.a == 255) {
+        Graphics::DrawRect(fixedBounds.GetIntersect(region), background, surface);
+    }
+
+    for (Widget* w : children) {
+        if (w->GetFixedBounds().Intersects(region)) {
+            w->PaintRegion(surface, region);
+        }
+    }
+}
+
 void Container::OnMouseEnter(vector2i_t mousePos) {
     for (Widget* w : children) {
         if (Graphics::PointInRect(w->GetFixedBounds(), mousePos)) {
             w->OnMouseEnter(mousePos);
+            w->Invalidate();
 
             lastMousedOver = w;
             break;
@@ -172,6 +198,7 @@ void Container::OnMouseEnter(vector2i_t mousePos) {
 void Container::OnMouseExit(vector2i_t mousePos) {
     if (lastMousedOver) {
         lastMousedOver->OnMouseExit(mousePos);
+        lastMousedOver->Invalidate();
     }
 
     lastMousedOver = nullptr;
@@ -183,9 +210,11 @@ void Container::OnMouseDown(vector2i_t mousePos) {
             if (active != w) {
                 if (active) {
                     active->OnInactive();
+                    active->Invalidate();
                 }
 
                 w->OnActive();
+                w->Invalidate();
             }
             active = w;
             w->OnMouseDown(mousePos);
@@ -224,13 +253,16 @@ void Container::OnMouseMove(vector2i_t mousePos) {
             } else {
                 if (lastMousedOver) {
                     lastMousedOver->OnMouseExit(mousePos);
+                    lastMousedOver->Invalidate();
                 }
 
                 w->OnMouseEnter(mousePos);
+                w->Invalidate();
 
                 lastMousedOver = w;
             }
         } else if (w == lastMousedOver) {
+            lastMousedOver->Invalidate();
             lastMousedOver = nullptr;
         }
     }
@@ -365,13 +397,17 @@ void Button::Paint(surface_t* surface) {
     DrawButtonLabel(surface);
 }
 
-void Button::OnMouseDown(__attribute__((unused)) vector2i_t mousePos) { pressed = true; }
+void Button::OnMouseDown(__attribute__((unused)) vector2i_t mousePos) {
+    pressed = true;
+    Invalidate();
+}
 
 void Button::OnMouseUp(vector2i_t mousePos) {
+    pressed = false;
+    Invalidate();
+
     if (Graphics::PointInRect(fixedBounds, mousePos) && e.onPress.handler)
         e.onPress();
-
-    pressed = false;
 }
 
 //////////////////////////
@@ -491,7 +527,6 @@ void ScrollBarHorizontal::OnMouseMoveRelative(vector2i_t relativePosition) {
 TextBox::TextBox(rect_t bounds, bool multiline) : Widget(bounds) {
     this->multiline = multiline;
     font = Graphics::GetFont("default");
-    contents.push_back(std::string());
 
     {
         ContextMenuEntry ctx;
@@ -545,20 +580,26 @@ void TextBox::Paint(surface_t* surface) {
     if (multiline) {
         cursorY = cursorPos.y * font->lineHeight - sBar.scrollPos;
 
-        for (size_t i = sBar.scrollPos / (font->lineHeight);
-             i < contents.size() && i < static_cast<size_t>(sBar.scrollPos + fixedBounds.height) / font->lineHeight + 1;
-             i++) {
+        // Only lines in the viewport are read from the document
+        size_t firstLine = sBar.scrollPos / font->lineHeight;
+        size_t lastLine = static_cast<size_t>(sBar.scrollPos + fixedBounds.height) / font->lineHeight + 1;
+        document.LineStart(lastLine); // Make sure the viewport has been indexed
+
+        std::string line;
+        for (size_t i = firstLine; i < document.LineCount() && i < lastLine; i++) {
             ypos = i * font->lineHeight + 2;
 
-            for (size_t j = 0; j < contents[i].length(); j++) {
-                if (contents[i][j] == '\t') {
+            // No character is narrower than a pixel
+            document.GetLine(i, line, fixedBounds.size.x);
+            for (size_t j = 0; j < line.length(); j++) {
+                if (line[j] == '\t') {
                     xpos += font->tabWidth * font->width;
-                } else if (isspace(contents[i][j])) {
+                } else if (isspace(line[j])) {
                     xpos += font->width;
-                } else if (!isgraph(contents[i][j])) {
+                } else if (!isgraph(line[j])) {
                     continue;
                 } else {
-                    xpos += Graphics::DrawChar(contents[i][j], fixedBounds.pos.x + xpos,
+                    xpos += Graphics::DrawChar(line[j], fixedBounds.pos.x + xpos,
                                                fixedBounds.pos.y + ypos - sBar.scrollPos, textColour.r, textColour.g,
                                                textColour.b, surface, fixedBounds, font);
                 }
@@ -578,15 +619,15 @@ void TextBox::Paint(surface_t* surface) {
 
         // Check if all lines can be displayed on screen
         // if not, draw the scrollbar
-        if (static_cast<int>(contents.size()) * (font->lineHeight + 2) >= fixedBounds.size.y) {
+        if (static_cast<int>(document.LineCount()) * (font->lineHeight + 2) >= fixedBounds.size.y) {
             sBar.Paint(surface, {fixedBounds.pos.x + fixedBounds.size.x - 16, fixedBounds.pos.y});
         }
     } else {
         ypos = fixedBounds.height / 2 - font->height / 2;
         cursorY = ypos;
 
-        std::string& line = contents.front();
-        for (size_t j = 0; j < contents[0].length(); j++) {
+        std::string line = document.GetText();
+        for (size_t j = 0; j < line.length(); j++) {
             char ch;
 
             if (masked) {
@@ -625,47 +666,35 @@ void TextBox::Paint(surface_t* surface) {
 }
 
 void TextBox::LoadText(const char* text) {
-    const char* text2 = text;
-    int lineCount = 1;
-
-    contents.clear();
-
-    if (multiline) {
-        while (*text2) {
-            if (*text2 == '\n')
-                lineCount++;
-            text2++;
-        }
-
-        text2 = text;
-        for (int i = 0; i < lineCount; i++) {
-            const char* end = strchr(text2, '\n');
-            if (end) {
-                size_t len = (uintptr_t)(end - text2);
-                if (len > strlen(text2))
-                    break;
+    size_t size = strlen(text);
+    std::unique_ptr<char[]> copy(new char[size]);
+    memcpy(copy.get(), text, size);
 
-                contents.push_back(std::string(text2, len));
+    LoadText(std::move(copy), size);
+}
 
-                text2 = end + 1;
-            } else {
-                contents.push_back(std::string(text2));
-            }
-        }
+void TextBox::LoadText(std::unique_ptr<char[]> text, size_t size) {
+    document.Load(std::move(text), size);
 
-        this->lineCount = contents.size();
+    if (multiline) {
+        cursorPos = {0, 0};
+        sBar.scrollPos = 0;
         ResetScrollBar();
     } else {
-        contents.push_back(std::string(text2));
+        cursorPos.x = std::min<int>(cursorPos.x, size);
     }
+
+    Invalidate();
 }
 
 void TextBox::OnMouseDown(vector2i_t mousePos) {
-    assert(contents.size() <= INT_MAX);
+    assert(document.LineCount() <= INT_MAX);
 
     mousePos.x -= fixedBounds.pos.x;
     mousePos.y -= fixedBounds.pos.y;
 
+    Invalidate();
+
     if (multiline && mousePos.x > fixedBounds.size.x - 16) {
         sBar.OnMouseDownRelative({mousePos.x + fixedBounds.size.x - 16, mousePos.y});
         return;
@@ -676,13 +705,16 @@ void TextBox::OnMouseDown(vector2i_t mousePos) {
 
     if (multiline) {
         cursorPos.y = (sBar.scrollPos + mousePos.y) / (font->lineHeight);
-        if (cursorPos.y >= static_cast<int>(contents.size()))
-            cursorPos.y = contents.size() - 1;
+        if (cursorPos.y >= static_cast<int>(document.LineCount()))
+            cursorPos.y = document.LineCount() - 1;
     }
 
+    std::string line;
+    document.GetLine(cursorPos.y, line);
+
     int dist = 0;
-    for (cursorPos.x = 0; cursorPos.x < static_cast<int>(contents[cursorPos.y].length()); cursorPos.x++) {
-        dist += Graphics::GetCharWidth(contents[cursorPos.y][cursorPos.x], font);
+    for (cursorPos.x = 0; cursorPos.x < static_cast<int>(line.length()); cursorPos.x++) {
+        dist += Graphics::GetCharWidth(line[cursorPos.x], font);
         if (dist >= mousePos.x) {
             break;
         }
@@ -700,49 +732,62 @@ void TextBox::OnCommand(unsigned short cmd) { (void)cmd; }
 void TextBox::OnMouseMove(__attribute__((unused)) vector2i_t mousePos) {
     if (multiline && sBar.pressed) {
         sBar.OnMouseMoveRelative({0, mousePos.y - fixedBounds.pos.y});
+        Invalidate();
     }
 }
 
 void TextBox::OnMouseUp(__attribute__((unused)) vector2i_t mousePos) { sBar.pressed = false; }
 
-void TextBox::ResetScrollBar() { sBar.ResetScrollBar(fixedBounds.size.y, contents.size() * (font->lineHeight)); }
+void TextBox::ResetScrollBar() {
+    // Keep our place as the document grows while it is being indexed
+    int scrollPos = sBar.scrollPos;
+    sBar.ResetScrollBar(fixedBounds.size.y, document.LineCount() * (font->lineHeight));
+
+    if (scrollPos) {
+        sBar.ScrollTo(scrollPos);
+    }
+}
 
 void TextBox::OnKeyPress(int key) {
     if (!editable)
         return;
 
-    assert(contents.size() < INT_MAX);
+    Invalidate();
+
+    // Make sure the line after the cursor has been indexed so it is included in LineCount()
+    document.LineStart(cursorPos.y + 1);
+    assert(document.LineCount() < INT_MAX);
 
+    int lineCount = static_cast<int>(document.LineCount());
     if (isprint(key)) {
-        contents[cursorPos.y].insert(cursorPos.x++, 1, key);
+        char ch = key;
+        document.Insert(document.LineStart(cursorPos.y) + cursorPos.x++, &ch, 1);
     } else if (key == '\b' || key == KEY_DELETE) {
         if (key == KEY_DELETE) { // Delete is essentially backspace but on the character in front so just increment the
                                  // cursor pos.
             cursorPos.x++;
-            if (cursorPos.x > static_cast<int>(contents[cursorPos.y].length())) {
-                if (cursorPos.y < static_cast<int>(contents.size()) - 1) {
-                    cursorPos.x = static_cast<int>(contents[++cursorPos.y].length());
+            if (cursorPos.x > static_cast<int>(document.LineLength(cursorPos.y))) {
+                if (cursorPos.y < lineCount - 1) {
+                    cursorPos.x = 0; // Join the next line onto this one
+                    cursorPos.y++;
                 } else
                     return;
             }
         }
 
         if (cursorPos.x) {
-            contents[cursorPos.y].erase(--cursorPos.x, 1);
+            document.Erase(document.LineStart(cursorPos.y) + --cursorPos.x, 1);
         } else if (cursorPos.y) { // Delete line if not at start of file
             cursorPos.x = static_cast<int>(
-                contents[cursorPos.y - 1].length());            // Move cursor horizontally to end of previous line
-            contents[cursorPos.y - 1] += contents[cursorPos.y]; // Append contents of current line to previous
-            contents.erase(contents.begin() + cursorPos.y--);   // Remove line and move to previous line
+                document.LineLength(cursorPos.y - 1));              // Move cursor horizontally to end of previous line
+            document.Erase(document.LineStart(cursorPos.y--) - 1, 1); // Remove the line break before the line
 
             ResetScrollBar();
         }
     } else if (key == '\n') {
         if (multiline) {
-            std::string s = contents[cursorPos.y].substr(cursorPos.x); // Grab the contents of the line after the cursor
-            contents[cursorPos.y].erase(cursorPos.x);                  // Erase all that was after the cursor
-            contents.insert(contents.begin() + (++cursorPos.y),
-                            s); // Insert new line after cursor and move to that line
+            document.Insert(document.LineStart(cursorPos.y) + cursorPos.x, "\n", 1);
+            cursorPos.y++; // Move to the new line
             cursorPos.x = 0;
 
             ResetScrollBar();
@@ -753,40 +798,40 @@ void TextBox::OnKeyPress(int key) {
         cursorPos.x--;
         if (cursorPos.x < 0) {
             if (cursorPos.y) {
-                cursorPos.x = static_cast<int>(contents[--cursorPos.y].length());
+                cursorPos.x = static_cast<int>(document.LineLength(--cursorPos.y));
             } else
                 cursorPos.x = 0;
         }
     } else if (key == KEY_ARROW_RIGHT) { // Move cursor right
         cursorPos.x++;
-        if (cursorPos.x > static_cast<int>(contents[cursorPos.y].length())) {
-            if (cursorPos.y < static_cast<int>(contents.size())) {
+        if (cursorPos.x > static_cast<int>(document.LineLength(cursorPos.y))) {
+            if (cursorPos.y < lineCount - 1) {
                 cursorPos.x = 0;
                 cursorPos.y++;
             } else
-                cursorPos.x = contents[cursorPos.y].length();
+                cursorPos.x = document.LineLength(cursorPos.y);
         }
     } else if (key == KEY_ARROW_UP) { // Move cursor up
         if (cursorPos.y) {
             cursorPos.y--;
-            if (cursorPos.x > static_cast<int>(contents[cursorPos.y].length())) {
-                cursorPos.x = static_cast<int>(contents[cursorPos.y].length());
+            if (cursorPos.x > static_cast<int>(document.LineLength(cursorPos.y))) {
+                cursorPos.x = static_cast<int>(document.LineLength(cursorPos.y));
             }
         } else
             cursorPos.x = 0;
     } else if (key == KEY_ARROW_DOWN) { // Move cursor down
-        if (cursorPos.y < static_cast<int>(contents.size())) {
+        if (cursorPos.y < lineCount - 1) {
             cursorPos.y++;
-            if (cursorPos.x > static_cast<int>(contents[cursorPos.y].length())) {
-                cursorPos.x = static_cast<int>(contents[cursorPos.y].length());
+            if (cursorPos.x > static_cast<int>(document.LineLength(cursorPos.y))) {
+                cursorPos.x = static_cast<int>(document.LineLength(cursorPos.y));
             }
         } else
-            cursorPos.x = contents[cursorPos.y].length();
+            cursorPos.x = document.LineLength(cursorPos.y);
     }
 
-    if (cursorPos.y >= static_cast<int>(contents.size())) {
-        cursorPos.y = contents.size() - 1;
-        cursorPos.x = contents[cursorPos.y].length() - 1;
+    if (cursorPos.y >= static_cast<int>(document.LineCount())) {
+        cursorPos.y = document.LineCount() - 1;
+        cursorPos.x = document.LineLength(cursorPos.y);
     }
 
     if (cursorPos.y * font->lineHeight < sBar.scrollPos) {
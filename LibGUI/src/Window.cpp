@@ -4,13 +4,50 @@
 #include <Lemon/GUI/Window.h>
 
 #include <Lemon/GUI/WindowServer.h>
+#include <Lemon/System/Util.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sstream>
 
 namespace Lemon::GUI {
+// Pass damage to the WM, damage is nullptr if the whole window has changed
+// Returns true if the WM needs to be notified
+static bool SubmitDamage(WindowBuffer* buffer, const Rect* damage, size_t count) {
+    while (__atomic_exchange_n(&buffer->damageLock, 1, __ATOMIC_ACQUIRE)) {
+        Lemon::Yield(); // The WM only holds the lock to copy the rects out
+    }
+
+    // If the WM has not yet drawn the last frame, add to its damage
+    uint32_t damageCount = __atomic_load_n(&buffer->dirty, __ATOMIC_ACQUIRE) ? buffer->damageCount : 0;
+    if (!damage || damageCount + count > WINDOW_DAMAGE_MAX) {
+        damageCount = WINDOW_DAMAGE_ALL;
+    } else if (damageCount != WINDOW_DAMAGE_ALL) {
+        for (size_t i = 0; i < count; i++) {
+            buffer->damage[damageCount++] = damage[i];
+        }
+    }
+    buffer->damageCount = damageCount;
+
+    // Only wake the WM if it has already drawn the last frame
+    bool notify = !__atomic_exchange_n(&buffer->dirty, 1, __ATOMIC_ACQ_REL);
+
+    __atomic_store_n(&buffer->damageLock, 0, __ATOMIC_RELEASE);
+    return notify;
+}
+
+// Wait for the WM to finish reading from the back buffer
+static void WaitForBackBuffer(WindowBuffer* buffer) {
+    // The WM sets drawing before checking currentBuffer again,
+    // so once currentBuffer has been swapped it will not start reading the back buffer
+    uint32_t back = !__atomic_load_n(&buffer->currentBuffer, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&buffer->drawing, __ATOMIC_SEQ_CST) == back + 1) {
+        Lemon::Yield();
+    }
+}
+
 Window::Window(const char* title, vector2i_t size, uint32_t flags, int type, vector2i_t pos)
     : rootContainer({{0, 0}, size}), m_flags(flags), m_windowType(type) {
     WindowServer* server = WindowServer::Instance();
@@ -84,7 +121,7 @@ void Window::Resize(vector2i_t size) {
 
     m_windowBufferInfo = (WindowBuffer*)Lemon::MapSharedMemory(m_windowBufferKey);
 
-    m_windowBufferInfo->currentBuffer = 0;
+    m_windowBufferInfo->currentBuffer = 1;
     m_buffer1 = ((uint8_t*)m_windowBufferInfo) + m_windowBufferInfo->buffer1Offset;
     m_buffer2 = ((uint8_t*)m_windowBufferInfo) + m_windowBufferInfo->buffer2Offset;
 
@@ -92,6 +129,10 @@ void Window::Resize(vector2i_t size) {
     surface.width = size.x;
     surface.height = size.y;
 
+    // Neither buffer has any content
+    InvalidateAll();
+    m_lastDamageAll = true;
+
     Paint();
 }
 
@@ -102,22 +143,95 @@ void Window::UpdateFlags(uint32_t flags) {
     WindowServer::Instance()->UpdateFlags(m_windowID, flags);
 }
 
-void Window::SwapBuffers() {
-    while (m_windowBufferInfo->drawing)
-        ; // WM is currently drawing the other buffer
+void Window::Invalidate(const Rect& rect) {
+    if (m_invalidateAll) {
+        return;
+    }
+
+    Rect windowRect = {0, 0, surface.width, surface.height};
+    if (!windowRect.Intersects(rect)) {
+        return;
+    }
+
+    Rect clipped = rect.GetIntersect(windowRect);
+    for (Rect& r : m_damage) {
+        if (r.Contains(clipped)) {
+            return;
+        } else if (clipped.Contains(r)) {
+            r = clipped;
+            return;
+        }
+    }
+
+    if (m_damage.size() >= WINDOW_DAMAGE_MAX) {
+        InvalidateAll();
+        return;
+    }
 
+    m_damage.push_back(clipped);
+}
+
+void Window::SwapBuffers() {
     if (surface.buffer == m_buffer1) {
-        m_windowBufferInfo->currentBuffer = 0;
+        __atomic_store_n(&m_windowBufferInfo->currentBuffer, 0, __ATOMIC_SEQ_CST);
         surface.buffer = m_buffer2;
     } else {
-        m_windowBufferInfo->currentBuffer = 1;
+        __atomic_store_n(&m_windowBufferInfo->currentBuffer, 1, __ATOMIC_SEQ_CST);
         surface.buffer = m_buffer1;
     }
 
-    m_windowBufferInfo->dirty = 1;
+    bool partial = m_damageTracking && !m_invalidateAll;
+    if (SubmitDamage(m_windowBufferInfo, partial ? m_damage.data() : nullptr, m_damage.size())) {
+        WindowServer::Instance()->InvalidateWindow(m_windowID);
+    }
+
+    // The new back buffer is missing what was just drawn
+    m_lastDamageAll = !partial;
+    m_lastDamage.swap(m_damage);
+    m_damage.clear();
+    m_invalidateAll = false;
+
+    WaitForBackBuffer(m_windowBufferInfo);
 }
 
 void Window::Paint() {
+    if (m_damageTracking && !m_invalidateAll && m_damage.empty()) {
+        return; // Nothing has changed
+    }
+
+    if (m_damageTracking && !m_invalidateAll) {
+        surface_t front = surface;
+        front.buffer = (surface.buffer == m_buffer1) ? m_buffer2 : m_buffer1;
+
+        // Bring the back buffer up to date with the last frame
+        if (m_lastDamageAll) {
+            memcpy(surface.buffer, front.buffer, surface.BufferSize());
+        } else {
+            for (const Rect& r : m_lastDamage) {
+                surface.Blit(&front, r.pos, r);
+            }
+        }
+
+        if (OnPaint)
+            OnPaint(&surface);
+
+        if (m_windowType == WindowType::GUI) {
+            for (const Rect& r : m_damage) {
+                if (menuBar && menuBar->GetFixedBounds().Intersects(r)) {
+                    menuBar->Paint(&surface);
+                }
+
+                rootContainer.PaintRegion(&surface, r);
+            }
+        }
+
+        if (OnPaintEnd)
+            OnPaintEnd(&surface);
+
+        SwapBuffers();
+        return;
+    }
+
     if (OnPaint)
         OnPaint(&surface);
 
@@ -228,12 +342,20 @@ void Window::GUIHandleEvent(LemonEvent& ev) {
         rootContainer.OnRightMouseUp(ev.mousePos);
         break;
     case EventMouseExit:
+        if (menuBar && menuBar->GetFixedBounds().Contains(lastMousePos)) {
+            menuBar->Invalidate();
+        }
+
         lastMousePos = {INT_MIN, INT_MIN}; // Prevent anything from staying selected
         rootContainer.OnMouseExit(ev.mousePos);
 
         break;
     case EventMouseEnter:
     case EventMouseMoved:
+        if (menuBar && menuBar->GetFixedBounds().Contains(lastMousePos)) {
+            menuBar->Invalidate(); // Clear the hover highlight if the mouse has left the menu bar
+        }
+
         lastMousePos = ev.mousePos;
 
         if (menuBar && ev.mousePos.y >= 0 && ev.mousePos.y < menuBar->GetFixedBounds().height) {
@@ -329,7 +451,7 @@ Window::TooltipWindow::TooltipWindow(const char* text, vector2i_t pos, const RGB
 
     windowBufferInfo = (WindowBuffer*)Lemon::MapSharedMemory(windowBufferKey);
 
-    windowBufferInfo->currentBuffer = 0;
+    windowBufferInfo->currentBuffer = 1;
     buffer1 = ((uint8_t*)windowBufferInfo) + windowBufferInfo->buffer1Offset;
     buffer2 = ((uint8_t*)windowBufferInfo) + windowBufferInfo->buffer2Offset;
 
@@ -378,14 +500,18 @@ void Window::TooltipWindow::Paint() {
     textObject.BlitTo(&surface);
 
     if (surface.buffer == buffer1) {
-        windowBufferInfo->currentBuffer = 0;
+        __atomic_store_n(&windowBufferInfo->currentBuffer, 0, __ATOMIC_SEQ_CST);
         surface.buffer = buffer2;
     } else {
-        windowBufferInfo->currentBuffer = 1;
+        __atomic_store_n(&windowBufferInfo->currentBuffer, 1, __ATOMIC_SEQ_CST);
         surface.buffer = buffer1;
     }
 
-    windowBufferInfo->dirty = 1;
+    if (SubmitDamage(windowBufferInfo, nullptr, 0)) {
+        InvalidateWindow(windowID);
+    }
+
+    WaitForBackBuffer(windowBufferInfo);
 }
 
 void WindowMenuBar::Paint(surface_t* surface) {
@@ -426,5 +552,9 @@ void WindowMenuBar::OnMouseDown(vector2i_t mousePos) {
 
 void WindowMenuBar::OnMouseUp(__attribute__((unused)) vector2i_t mousePos) {}
 
-void WindowMenuBar::OnMouseMove(__attribute__((unused)) vector2i_t mousePos) {}
+void WindowMenuBar::OnMouseMove(__attribute__((unused)) vector2i_t mousePos) {
+    fixedBounds = {0, 0, window->GetSize().x, WINDOW_MENUBAR_HEIGHT};
+
+    Invalidate(); // Redraw the hovered item
+}
 } // namespace Lemon::GUI
\ No newline at end of file
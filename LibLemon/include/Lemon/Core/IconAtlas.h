@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Layout of the shared memory the icon cache service (lemon.iconcache) decodes every system icon into
+
+#define ICON_ATLAS_MAGIC 0x414E4349 // 'ICNA'
+#define ICON_ATLAS_NAME_MAX 64
+
+namespace Lemon {
+struct IconAtlasHeader {
+    uint32_t magic;
+    uint32_t entryCount; // Entries follow the header, sorted by name
+};
+
+struct IconAtlasEntry {
+    char name[ICON_ATLAS_NAME_MAX];
+    // Offset of the 32-bit BGRA pixels from the start of the atlas for each IconManager::IconSize,
+    // 0 if the icon could not be loaded at that size
+    uint64_t pixels[3];
+};
+} // namespace Lemon
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Lemon/Core/Icon.h>
+#include <Lemon/Core/IconAtlas.h>
 #include <Lemon/Graphics/Surface.h>
 
 #include <map>
@@ -9,6 +10,9 @@
 
 namespace Lemon {
 // Thread safe class for retrieve and caching icons
+//
+// Icons are looked up in the atlas shared by the icon cache service,
+// when it is not running they are decoded by the process.
 class IconManager final {
   public:
     enum IconSize {
@@ -31,14 +35,39 @@ class IconManager final {
     /////////////////////////////
     const Surface* GetIcon(const std::string& name, IconSize preferredSize = IconSize32x32);
 
+    /////////////////////////////
+    /// \brief Decode icon from the icon resources
+    ///
+    /// Tries the resources for the requested size first, then the other sizes scaled to fit.
+    ///
+    /// \param name Name of icon
+    /// \param size Size to decode at
+    /// \param surface Surface to decode into, a buffer is allocated if it has none
+    ///
+    /// \return 0 on success
+    /////////////////////////////
+    static int DecodeIcon(const std::string& name, IconSize size, Surface* surface);
+
+    static constexpr int IconDimensions(IconSize size) { return 16 << size; }
+
   private:
     IconManager();
 
+    // Map the atlas of the icon cache service, returns false if it is not available
+    bool MapAtlas();
+    const IconAtlasEntry* FindAtlasEntry(const std::string& name) const;
+
     static IconManager* m_instance;
     static std::mutex m_mutex;
 
+    std::mutex m_iconsLock;
+
     Icon m_missingIcon; // Filler icon for when no sucessful icon could be found
 
     std::map<std::string, Icon> m_icons; // Icon cache
+
+    const uint8_t* m_atlas = nullptr; // Shared with the icon cache service, read only
+    const IconAtlasEntry* m_atlasEntries = nullptr;
+    uint32_t m_atlasEntryCount = 0;
 };
 } // namespace Lemon
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include <Lemon/System/ABI/Input.h>
+
 namespace Lemon {
 enum MouseButton {
     Left = 0x1,
@@ -20,4 +22,11 @@ struct MousePacket {
 
 int PollMouse(MousePacket& pkt);
 ssize_t PollKeyboard(uint8_t* buffer, size_t count);
+
+// File descriptor of the input event queue (/dev/input), can be used with poll or epoll
+int InputEventsFd();
+// Returns the amount of events read, does not block
+ssize_t PollInputEvents(lemon_input_event_t* events, size_t count);
+// Frequency of event timestamps in Hz, 0 if it is not yet known
+uint64_t InputTimestampFrequency();
 } // namespace Lemon
@@ -5,10 +5,17 @@
 
 #define SMEM_FLAGS_PRIVATE 1
 #define SMEM_FLAGS_SHARED 0
+#define SMEM_FLAGS_HUGEPAGES 2 // Back with 2MB physically contiguous chunks where possible
+#define SMEM_FLAGS_READONLY 4  // Only the creator may write, everyone else gets a read only mapping
 
 namespace Lemon {
 int64_t CreateSharedMemory(uint64_t size, uint64_t flags);
 void* MapSharedMemory(int64_t key);
 long UnmapSharedMemory(void* address, int64_t key);
 long DestroySharedMemory(int64_t key);
+
+// Resize shared memory in place, keeping its key and contents.
+// It must not be mapped by any other process.
+// If *address points to an existing mapping it is replaced with the new mapping.
+long ResizeSharedMemory(int64_t key, uint64_t size, void** address);
 } // namespace Lemon
@@ -244,6 +244,14 @@ int GetCharWidth(int c);
 
 uint32_t Interpolate(double q11, double q21, double q12, double q22, double x, double y);
 
+/////////////////////////////
+/// \brief Scale a surface with bilinear filtering
+///
+/// Scales src by (xScale, yScale) into the (w, h) area of dest at (x, y),
+/// stopping early at the edge of the source. Uses fixed point SSE2 arithmetic.
+/////////////////////////////
+void ScaleBilinear(const surface_t* src, surface_t* dest, int x, int y, int w, int h, double xScale, double yScale);
+
 // LoadImage (const char*, int, int, int, int, surface_t*, bool) - Load image, scale to dimensions (w, h) and copy to
 // surface at offset (x, y)
 int LoadImage(const char* path, int x, int y, int w, int h, surface_t* surface, bool preserveAspectRatio);
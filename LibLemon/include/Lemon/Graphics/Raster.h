@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raster kernels work on spans of 32-bit 0xAARRGGBB pixels.
+// SIMD variants are chosen once through CPUID, the variants give identical results.
+namespace Lemon::Graphics::Raster {
+enum ISA {
+    ISAScalar,
+    ISASSE2,
+    ISASSE41,
+    ISAAVX2,
+    ISACount,
+};
+
+struct Kernels {
+    // Set count pixels to colour
+    void (*fill)(uint32_t* dest, uint32_t colour, size_t count);
+    // Linear gradient from c1 to c2 over length pixels, only the first count pixels are written
+    void (*gradient)(uint32_t* dest, uint32_t c1, uint32_t c2, size_t length, size_t count);
+    // Blend src over dest
+    void (*alphaBlend)(uint32_t* dest, const uint32_t* src, size_t count);
+    // Blend colour over dest
+    void (*alphaFill)(uint32_t* dest, uint32_t colour, size_t count);
+    // Blend colour over dest with the alpha of each pixel taken from mask (e.g. glyph coverage)
+    void (*maskBlend)(uint32_t* dest, uint32_t colour, const uint8_t* mask, size_t count);
+    // Composite premultiplied src over dest
+    void (*compositePremultiplied)(uint32_t* dest, const uint32_t* src, size_t count);
+    // Copy src to dest, skipping pixels equal to key
+    void (*blitColourKey)(uint32_t* dest, const uint32_t* src, uint32_t key, size_t count);
+};
+
+// Best ISA supported by the CPU (and enabled by the OS)
+ISA BestISA();
+// Kernels for the best ISA
+const Kernels& Current();
+// Kernels for a specific ISA, nullptr if it is not supported
+const Kernels* GetKernels(ISA isa);
+const char* ISAName(ISA isa);
+
+inline void Fill(uint32_t* dest, uint32_t colour, size_t count) { Current().fill(dest, colour, count); }
+inline void Gradient(uint32_t* dest, uint32_t c1, uint32_t c2, size_t length, size_t count) {
+    Current().gradient(dest, c1, c2, length, count);
+}
+inline void AlphaBlend(uint32_t* dest, const uint32_t* src, size_t count) { Current().alphaBlend(dest, src, count); }
+inline void AlphaFill(uint32_t* dest, uint32_t colour, size_t count) { Current().alphaFill(dest, colour, count); }
+inline void MaskBlend(uint32_t* dest, uint32_t colour, const uint8_t* mask, size_t count) {
+    Current().maskBlend(dest, colour, mask, count);
+}
+inline void CompositePremultiplied(uint32_t* dest, const uint32_t* src, size_t count) {
+    Current().compositePremultiplied(dest, src, count);
+}
+inline void BlitColourKey(uint32_t* dest, const uint32_t* src, uint32_t key, size_t count) {
+    Current().blitColourKey(dest, src, key, count);
+}
+} // namespace Lemon::Graphics::Raster
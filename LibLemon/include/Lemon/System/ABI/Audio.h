@@ -1,5 +1,6 @@
 #pragma once
 
+// 20, 24 and 32-bit samples are each stored in a dword
 enum SoundEncoding {
     PCMS16LE = 0, // PCM signed 16-bit little endian
     PCMS20LE = 1,
@@ -10,6 +11,10 @@ enum SoundEncoding {
 enum AudioMixerIoCtl {
     IoCtlMixerSetMasterVolume = 0x1000,
     IoCtlMixerGetMasterVolume = 0x1001,
+    // Amount of frames in each hardware period,
+    // smaller periods lower latency at the cost of more interrupts
+    IoCtlMixerSetPeriodSize = 0x1002,
+    IoCtlMixerGetPeriodSize = 0x1003,
 };
 
 enum AudioOutputIoCtl {
@@ -20,11 +25,21 @@ enum AudioOutputIoCtl {
     IoCtlOutputSetNumberOfChannels = 0x1004,
     IoCtlOutputGetNumberOfChannels = 0x1005,
     IoCtlOutputSetAsync = 0x1006,
+    // Each open of /dev/snd/pcm is a separate stream with its own format,
+    // the mixer converts streams to the format of the hardware
+    IoCtlOutputSetSampleRate = 0x1007,
+    IoCtlOutputSetEncoding = 0x1008,
+    // Frames written but not yet played, including frames queued in hardware
+    IoCtlOutputGetBufferedFrames = 0x1009,
+    // Amount of times the stream ran out of samples whilst playing
+    IoCtlOutputGetUnderruns = 0x100A,
 };
 
-#define LEMON_ABI_AUDIO_ENCODING_COUNT 2
+#define LEMON_ABI_AUDIO_ENCODING_COUNT 4
 
 static const char* const lemonABIAudioEncodingNames[] = {
     "PCM signed 16-bit little endian",
     "PCM signed 20-bit little endian",
+    "PCM signed 24-bit little endian",
+    "PCM signed 32-bit little endian",
 };
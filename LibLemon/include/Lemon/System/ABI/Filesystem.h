@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// Most entries returned by one SYS_READDIR_PLUS call
+#define READDIR_PLUS_MAX_ENTRIES 256
+
+// Directory entry together with the attributes lstat would return for it
+struct DirectoryEntryPlus {
+    uint64_t inode;
+    uint64_t size;
+    uint32_t mode; // File type and permissions, as in st_mode
+    uint32_t type; // DT_* type
+    uint32_t uid;
+    uint32_t nlink;
+    int64_t atime; // Seconds since the epoch, 0 when the filesystem does not report them
+    int64_t mtime;
+    int64_t ctime;
+    char name[256]; // Null terminated
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+enum InputEventType {
+    InputEventKey = 1,
+    InputEventMouse = 2,
+};
+
+enum InputIoCtl {
+    // Frequency of event timestamps in kHz, 0 if it has not been measured yet
+    IoCtlInputGetTimestampFrequency = 0x1000,
+    // Amount of events dropped because the queue was full
+    IoCtlInputGetDroppedEvents = 0x1001,
+};
+
+// Events read from /dev/input
+typedef struct InputEvent {
+    uint64_t timestamp; // TSC value when the event (or the first packet coalesced into it) was received
+    uint16_t type;      // InputEventType
+
+    uint16_t keyCode; // Key code, the high bit (0x80) is set on release as with /dev/keyboard0
+
+    uint8_t buttons; // Mouse button state
+    int8_t verticalScroll;
+    // Relative mouse motion, consecutive packets with the same button state
+    // are coalesced until the event has been read
+    int16_t xMovement;
+    int16_t yMovement;
+    uint16_t packets; // Amount of mouse packets coalesced into this event
+} lemon_input_event_t;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+enum DiskIoCtl {
+    // Fills in a DiskStatistics, partitions report the statistics of their disk
+    IoCtlDiskGetStatistics = 0x3000,
+};
+
+// Counters since boot, IOPS and throughput are worked out from the difference between two samples
+struct DiskStatistics {
+    uint64_t reads; // Requests completed
+    uint64_t writes;
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint64_t readTime; // Total microseconds between submission and completion
+    uint64_t writeTime;
+    uint64_t merges;   // Requests merged into a command with another request
+    uint64_t commands; // Commands given to the driver
+    uint64_t errors;
+    uint32_t queueDepth; // Requests submitted but not yet completed
+    uint32_t maxQueueDepth;
+};
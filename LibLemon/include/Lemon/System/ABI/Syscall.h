@@ -109,3 +109,7 @@
 #define SYS_EPOLL_CREATE 108
 #define SYS_EPOLL_CTL 109
 #define SYS_EPOLL_WAIT 110
+#define SYS_RESIZE_SHARED_MEMORY 112
+#define SYS_SENDMMSG 113
+#define SYS_RECVMMSG 114
+#define SYS_READDIR_PLUS 115
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef __lemon__
+#error "Lemon OS Only"
+#endif
+
+#include <Lemon/System/ABI/Filesystem.h>
+
+#include <vector>
+
+namespace Lemon {
+/////////////////////////////
+/// \brief Read directory entries along with their attributes
+///
+/// Continues from the current offset of the directory, like readdir.
+/// Unlike calling lstat on each entry, paths do not have to be resolved again.
+///
+/// \param fd File descriptor of an open directory
+/// \param entries Array to fill
+/// \param count Size of the array, the kernel returns at most READDIR_PLUS_MAX_ENTRIES at once
+///
+/// \return Amount of entries read, 0 at the end of the directory, -1 on failure (errno is set)
+/////////////////////////////
+int ReadDirectoryPlus(int fd, DirectoryEntryPlus* entries, unsigned count);
+
+/////////////////////////////
+/// \brief Get all entries of a directory along with their attributes
+///
+/// \param path Path of the directory
+/// \param entries Entries are appended to the vector, including "." and ".."
+///
+/// \return 0 on success, -1 on failure (errno is set)
+/////////////////////////////
+int ListDirectory(const char* path, std::vector<DirectoryEntryPlus>& entries);
+} // namespace Lemon
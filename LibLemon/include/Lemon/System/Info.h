@@ -6,17 +6,29 @@
 
 #include <stdint.h>
 
+#define LEMON_SYSINFO_MAX_CACHES 16
+
+typedef struct {
+    char name[32];
+    uint64_t usage;       // Memory used by the cache in KB
+    uint64_t reclaimable; // Memory the cache could give back in KB
+} lemon_cache_info_t;
+
 typedef struct {
     uint64_t totalMem;
     uint64_t usedMem;
     uint16_t cpuCount;
+
+    // Kernel caches which give memory back under memory pressure
+    uint16_t cacheCount;
+    lemon_cache_info_t caches[LEMON_SYSINFO_MAX_CACHES];
 } lemon_sysinfo_t;
 
 namespace Lemon {
 /////////////////////////////
 /// \brief Get information about the system
 ///
-/// Fill a lemon_sysinfo struct with information about memory and processor(s).
+/// Fill a lemon_sysinfo struct with information about memory, kernel caches and processor(s).
 ///
 /// \return lemon_sysinfo_t
 /////////////////////////////
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef __lemon__
+#error "Lemon OS Only"
+#endif
+
+#include <sys/socket.h>
+
+// Same layout as the kernel's struct mmsghdr
+typedef struct {
+    struct msghdr msg_hdr;
+    unsigned int msg_len; // Set to the amount of bytes sent or received
+} lemon_mmsghdr_t;
+
+namespace Lemon {
+/////////////////////////////
+/// \brief Send several messages through a socket in one syscall
+///
+/// Equivalent to calling sendmsg for each message.
+///
+/// \param sockfd Socket file descriptor
+/// \param msgvec Messages to send, msg_len is filled in for each message sent
+/// \param vlen Amount of messages
+/// \param flags sendmsg flags
+///
+/// \return Amount of messages sent, -1 on failure (errno is set)
+/////////////////////////////
+int SendMultipleMessages(int sockfd, lemon_mmsghdr_t* msgvec, unsigned vlen, int flags);
+
+/////////////////////////////
+/// \brief Receive several messages from a socket in one syscall
+///
+/// Only waits for the first message, returns as soon as no more messages are queued.
+///
+/// \param sockfd Socket file descriptor
+/// \param msgvec Messages to fill, msg_len is filled in for each message received
+/// \param vlen Maximum amount of messages
+/// \param flags recvmsg flags
+///
+/// \return Amount of messages received, -1 on failure (errno is set)
+/////////////////////////////
+int ReceiveMultipleMessages(int sockfd, lemon_mmsghdr_t* msgvec, unsigned vlen, int flags);
+} // namespace Lemon
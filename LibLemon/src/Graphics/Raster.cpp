@@ -0,0 +1,702 @@
+#include <Lemon/Graphics/Raster.h>
+
+#include <Lemon/Graphics/Graphics.h>
+
+#include <algorithm>
+#include <cpuid.h>
+#include <immintrin.h>
+#include <string.h>
+
+// The library is built for x86-64-v2 so SSE4.1 is always available to the compiler,
+// AVX2 kernels are built separately and only used if the CPU and OS support them.
+#define SSE41_KERNEL __attribute__((target("sse4.1")))
+#define AVX2_KERNEL __attribute__((target("avx2")))
+
+namespace Lemon::Graphics::Raster {
+//////////////////////////
+// Scalar
+//////////////////////////
+
+// Divide by 255 with rounding, exact for t <= 255 * 255
+static inline uint32_t Div255(uint32_t t) {
+    t += 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// Blend src over dest, the SIMD kernels give the same result
+static inline uint32_t Blend(uint32_t dest, uint32_t src) {
+    uint32_t alpha = src >> 24;
+    if (alpha == 0) {
+        return dest;
+    } else if (alpha == 0xff) {
+        return src;
+    } else if ((dest >> 24) != 0xff) {
+        return AlphaBlendInt(dest, src);
+    }
+
+    // Opaque destination, the result is opaque
+    uint32_t result = 0xff000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t s = (src >> shift) & 0xff;
+        uint32_t d = (dest >> shift) & 0xff;
+        result |= Div255(s * alpha + d * (0xff - alpha)) << shift;
+    }
+
+    return result;
+}
+
+static inline uint32_t Composite(uint32_t dest, uint32_t src) {
+    uint32_t inverseAlpha = 0xff - (src >> 24);
+
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t s = (src >> shift) & 0xff;
+        uint32_t d = (dest >> shift) & 0xff;
+        result |= std::min<uint32_t>(s + Div255(d * inverseAlpha), 0xff) << shift;
+    }
+
+    return result;
+}
+
+// Gradient channels are 16.16 fixed point
+static inline void GradientSteps(uint32_t c1, uint32_t c2, size_t length, int32_t* start, int32_t* step) {
+    for (int i = 0; i < 4; i++) {
+        int32_t from = (c1 >> (i * 8)) & 0xff;
+        int32_t to = (c2 >> (i * 8)) & 0xff;
+
+        start[i] = from << 16;
+        step[i] = static_cast<int32_t>(((to - from) * 65536LL) / static_cast<int64_t>(length));
+    }
+}
+
+static inline uint32_t GradientPixel(const int32_t* start, const int32_t* step, size_t index) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        result |= static_cast<uint32_t>((start[i] + step[i] * static_cast<int32_t>(index)) >> 16) << (i * 8);
+    }
+
+    return result;
+}
+
+static void FillScalar(uint32_t* dest, uint32_t colour, size_t count) {
+    while (count--) {
+        *(dest++) = colour;
+    }
+}
+
+static void GradientScalar(uint32_t* dest, uint32_t c1, uint32_t c2, size_t length, size_t count) {
+    if (!length) {
+        return;
+    }
+
+    int32_t start[4], step[4];
+    GradientSteps(c1, c2, length, start, step);
+
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = GradientPixel(start, step, i);
+    }
+}
+
+static void AlphaBlendScalar(uint32_t* dest, const uint32_t* src, size_t count) {
+    for (; count; count--, dest++, src++) {
+        *dest = Blend(*dest, *src);
+    }
+}
+
+static void AlphaFillScalar(uint32_t* dest, uint32_t colour, size_t count) {
+    for (; count; count--, dest++) {
+        *dest = Blend(*dest, colour);
+    }
+}
+
+static void MaskBlendScalar(uint32_t* dest, uint32_t colour, const uint8_t* mask, size_t count) {
+    colour &= 0xffffff;
+    for (; count; count--, dest++, mask++) {
+        *dest = Blend(*dest, colour | (static_cast<uint32_t>(*mask) << 24));
+    }
+}
+
+static void CompositePremultipliedScalar(uint32_t* dest, const uint32_t* src, size_t count) {
+    for (; count; count--, dest++, src++) {
+        *dest = Composite(*dest, *src);
+    }
+}
+
+static void BlitColourKeyScalar(uint32_t* dest, const uint32_t* src, uint32_t key, size_t count) {
+    for (; count; count--, dest++, src++) {
+        if (*src != key) {
+            *dest = *src;
+        }
+    }
+}
+
+//////////////////////////
+// SSE2
+//////////////////////////
+
+// (s * a + d * (255 - a)) / 255 on 16-bit channels
+static inline __m128i BlendChannelsSSE2(__m128i s, __m128i d, __m128i a) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(0xff), a)));
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// d * (255 - a) / 255 on 16-bit channels
+static inline __m128i ScaleChannelsSSE2(__m128i d, __m128i a) {
+    __m128i t = _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(0xff), a));
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// Blend 4 pixels over dest
+static inline void BlendBlockSSE2(uint32_t* dest, __m128i s) {
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i srcAlpha = _mm_and_si128(s, alphaMask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, zero)) == 0xffff) {
+        return; // Fully transparent
+    } else if (_mm_movemask_epi8(_mm_cmpeq_epi32(srcAlpha, alphaMask)) == 0xffff) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), s); // Fully opaque
+        return;
+    }
+
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(d, alphaMask), alphaMask)) != 0xffff) {
+        uint32_t pixels[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), s);
+        AlphaBlendScalar(dest, pixels, 4);
+        return;
+    }
+
+    // Alpha of each pixel in each 16-bit channel
+    __m128i a = _mm_srli_epi32(s, 24);
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+    __m128i lo = BlendChannelsSSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(a, a));
+    __m128i hi = BlendChannelsSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(a, a));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_or_si128(_mm_packus_epi16(lo, hi), alphaMask));
+}
+
+static void FillSSE2(uint32_t* dest, uint32_t colour, size_t count) {
+    while (count && (reinterpret_cast<uintptr_t>(dest) & 0xf)) {
+        *(dest++) = colour;
+        count--;
+    }
+
+    __m128i c = _mm_set1_epi32(colour);
+    for (; count >= 16; count -= 16, dest += 16) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(dest), c);
+        _mm_store_si128(reinterpret_cast<__m128i*>(dest + 4), c);
+        _mm_store_si128(reinterpret_cast<__m128i*>(dest + 8), c);
+        _mm_store_si128(reinterpret_cast<__m128i*>(dest + 12), c);
+    }
+
+    for (; count >= 4; count -= 4, dest += 4) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(dest), c);
+    }
+
+    FillScalar(dest, colour, count);
+}
+
+static void GradientSSE2(uint32_t* dest, uint32_t c1, uint32_t c2, size_t length, size_t count) {
+    if (!length) {
+        return;
+    }
+
+    int32_t start[4], step[4];
+    GradientSteps(c1, c2, length, start, step);
+
+    // One vector per channel, one lane per pixel
+    __m128i channels[4];
+    __m128i increments[4];
+    for (int i = 0; i < 4; i++) {
+        channels[i] = _mm_setr_epi32(start[i], start[i] + step[i], start[i] + step[i] * 2, start[i] + step[i] * 3);
+        increments[i] = _mm_set1_epi32(step[i] * 4);
+    }
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_srli_epi32(channels[0], 16);
+        pixels = _mm_or_si128(pixels, _mm_slli_epi32(_mm_srli_epi32(channels[1], 16), 8));
+        pixels = _mm_or_si128(pixels, _mm_slli_epi32(_mm_srli_epi32(channels[2], 16), 16));
+        pixels = _mm_or_si128(pixels, _mm_slli_epi32(_mm_srli_epi32(channels[3], 16), 24));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), pixels);
+
+        for (int c = 0; c < 4; c++) {
+            channels[c] = _mm_add_epi32(channels[c], increments[c]);
+        }
+    }
+
+    for (; i < count; i++) {
+        dest[i] = GradientPixel(start, step, i);
+    }
+}
+
+static void AlphaBlendSSE2(uint32_t* dest, const uint32_t* src, size_t count) {
+    for (; count >= 4; count -= 4, dest += 4, src += 4) {
+        BlendBlockSSE2(dest, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    }
+
+    AlphaBlendScalar(dest, src, count);
+}
+
+static void AlphaFillSSE2(uint32_t* dest, uint32_t colour, size_t count) {
+    if (!(colour >> 24)) {
+        return;
+    } else if ((colour >> 24) == 0xff) {
+        FillSSE2(dest, colour, count);
+        return;
+    }
+
+    __m128i c = _mm_set1_epi32(colour);
+    for (; count >= 4; count -= 4, dest += 4) {
+        BlendBlockSSE2(dest, c);
+    }
+
+    AlphaFillScalar(dest, colour, count);
+}
+
+static void MaskBlendSSE2(uint32_t* dest, uint32_t colour, const uint8_t* mask, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i rgb = _mm_set1_epi32(colour & 0xffffff);
+
+    for (; count >= 4; count -= 4, dest += 4, mask += 4) {
+        uint32_t m;
+        memcpy(&m, mask, sizeof(m));
+        if (!m) {
+            continue;
+        }
+
+        __m128i alpha = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(m), zero), zero);
+        BlendBlockSSE2(dest, _mm_or_si128(rgb, _mm_slli_epi32(alpha, 24)));
+    }
+
+    MaskBlendScalar(dest, colour, mask, count);
+}
+
+static void CompositePremultipliedSSE2(uint32_t* dest, const uint32_t* src, size_t count) {
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; count >= 4; count -= 4, dest += 4, src += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), alphaMask)) == 0xffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), s);
+            continue;
+        }
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+
+        __m128i a = _mm_srli_epi32(s, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+
+        __m128i lo = ScaleChannelsSSE2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(a, a));
+        __m128i hi = ScaleChannelsSSE2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(a, a));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+
+    CompositePremultipliedScalar(dest, src, count);
+}
+
+static void BlitColourKeySSE2(uint32_t* dest, const uint32_t* src, uint32_t key, size_t count) {
+    __m128i k = _mm_set1_epi32(key);
+
+    for (; count >= 4; count -= 4, dest += 4, src += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+        __m128i keyed = _mm_cmpeq_epi32(s, k);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                         _mm_or_si128(_mm_and_si128(keyed, d), _mm_andnot_si128(keyed, s)));
+    }
+
+    BlitColourKeyScalar(dest, src, key, count);
+}
+
+//////////////////////////
+// SSE4.1
+//////////////////////////
+
+// Spread the alpha of pixels 0 and 1 (lo) or 2 and 3 (hi) into 16-bit channels
+#define ALPHA_SHUFFLE_LO 3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1
+#define ALPHA_SHUFFLE_HI 11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1
+
+SSE41_KERNEL static inline void BlendBlockSSE41(uint32_t* dest, __m128i s) {
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+
+    if (_mm_testz_si128(s, alphaMask)) {
+        return; // Fully transparent
+    } else if (_mm_testc_si128(s, alphaMask)) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), s); // Fully opaque
+        return;
+    }
+
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+    if (!_mm_testc_si128(d, alphaMask)) {
+        uint32_t pixels[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), s);
+        AlphaBlendScalar(dest, pixels, 4);
+        return;
+    }
+
+    __m128i aLo = _mm_shuffle_epi8(s, _mm_setr_epi8(ALPHA_SHUFFLE_LO));
+    __m128i aHi = _mm_shuffle_epi8(s, _mm_setr_epi8(ALPHA_SHUFFLE_HI));
+
+    __m128i lo = BlendChannelsSSE2(_mm_cvtepu8_epi16(s), _mm_cvtepu8_epi16(d), aLo);
+    __m128i hi = BlendChannelsSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), aHi);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_or_si128(_mm_packus_epi16(lo, hi), alphaMask));
+}
+
+SSE41_KERNEL static void AlphaBlendSSE41(uint32_t* dest, const uint32_t* src, size_t count) {
+    for (; count >= 4; count -= 4, dest += 4, src += 4) {
+        BlendBlockSSE41(dest, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    }
+
+    AlphaBlendScalar(dest, src, count);
+}
+
+SSE41_KERNEL static void AlphaFillSSE41(uint32_t* dest, uint32_t colour, size_t count) {
+    if (!(colour >> 24)) {
+        return;
+    } else if ((colour >> 24) == 0xff) {
+        FillSSE2(dest, colour, count);
+        return;
+    }
+
+    __m128i c = _mm_set1_epi32(colour);
+    for (; count >= 4; count -= 4, dest += 4) {
+        BlendBlockSSE41(dest, c);
+    }
+
+    AlphaFillScalar(dest, colour, count);
+}
+
+SSE41_KERNEL static void MaskBlendSSE41(uint32_t* dest, uint32_t colour, const uint8_t* mask, size_t count) {
+    __m128i rgb = _mm_set1_epi32(colour & 0xffffff);
+
+    for (; count >= 4; count -= 4, dest += 4, mask += 4) {
+        uint32_t m;
+        memcpy(&m, mask, sizeof(m));
+        if (!m) {
+            continue;
+        }
+
+        __m128i alpha = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(m));
+        BlendBlockSSE41(dest, _mm_or_si128(rgb, _mm_slli_epi32(alpha, 24)));
+    }
+
+    MaskBlendScalar(dest, colour, mask, count);
+}
+
+SSE41_KERNEL static void CompositePremultipliedSSE41(uint32_t* dest, const uint32_t* src, size_t count) {
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; count >= 4; count -= 4, dest += 4, src += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        if (_mm_testc_si128(s, alphaMask)) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), s);
+            continue;
+        }
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+
+        __m128i lo = ScaleChannelsSSE2(_mm_cvtepu8_epi16(d), _mm_shuffle_epi8(s, _mm_setr_epi8(ALPHA_SHUFFLE_LO)));
+        __m128i hi =
+            ScaleChannelsSSE2(_mm_unpackhi_epi8(d, zero), _mm_shuffle_epi8(s, _mm_setr_epi8(ALPHA_SHUFFLE_HI)));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+
+    CompositePremultipliedScalar(dest, src, count);
+}
+
+SSE41_KERNEL static void BlitColourKeySSE41(uint32_t* dest, const uint32_t* src, uint32_t key, size_t count) {
+    __m128i k = _mm_set1_epi32(key);
+
+    for (; count >= 4; count -= 4, dest += 4, src += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i keyed = _mm_cmpeq_epi32(s, k);
+        if (_mm_testz_si128(keyed, keyed)) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), s);
+            continue;
+        }
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_blendv_epi8(s, d, keyed));
+    }
+
+    BlitColourKeyScalar(dest, src, key, count);
+}
+
+//////////////////////////
+// AVX2
+//////////////////////////
+
+AVX2_KERNEL static inline __m256i BlendChannelsAVX2(__m256i s, __m256i d, __m256i a) {
+    __m256i t =
+        _mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(0xff), a)));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+AVX2_KERNEL static inline __m256i ScaleChannelsAVX2(__m256i d, __m256i a) {
+    __m256i t = _mm256_mullo_epi16(d, _mm256_sub_epi16(_mm256_set1_epi16(0xff), a));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// Shuffles work within each 128-bit lane so the same pattern is used for both
+#define ALPHA_SHUFFLE_LO_AVX2 _mm256_setr_epi8(ALPHA_SHUFFLE_LO, ALPHA_SHUFFLE_LO)
+#define ALPHA_SHUFFLE_HI_AVX2 _mm256_setr_epi8(ALPHA_SHUFFLE_HI, ALPHA_SHUFFLE_HI)
+
+// Blend 8 pixels over dest
+AVX2_KERNEL static inline void BlendBlockAVX2(uint32_t* dest, __m256i s) {
+    const __m256i alphaMask = _mm256_set1_epi32(0xff000000);
+    const __m256i zero = _mm256_setzero_si256();
+
+    if (_mm256_testz_si256(s, alphaMask)) {
+        return; // Fully transparent
+    } else if (_mm256_testc_si256(s, alphaMask)) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), s); // Fully opaque
+        return;
+    }
+
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest));
+    if (!_mm256_testc_si256(d, alphaMask)) {
+        uint32_t pixels[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels), s);
+        AlphaBlendScalar(dest, pixels, 8);
+        return;
+    }
+
+    // Unpacking and packing also work within each lane, so the pixel order is kept
+    __m256i lo = BlendChannelsAVX2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero),
+                                   _mm256_shuffle_epi8(s, ALPHA_SHUFFLE_LO_AVX2));
+    __m256i hi = BlendChannelsAVX2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero),
+                                   _mm256_shuffle_epi8(s, ALPHA_SHUFFLE_HI_AVX2));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_or_si256(_mm256_packus_epi16(lo, hi), alphaMask));
+}
+
+AVX2_KERNEL static void FillAVX2(uint32_t* dest, uint32_t colour, size_t count) {
+    while (count && (reinterpret_cast<uintptr_t>(dest) & 0x1f)) {
+        *(dest++) = colour;
+        count--;
+    }
+
+    __m256i c = _mm256_set1_epi32(colour);
+    for (; count >= 32; count -= 32, dest += 32) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dest), c);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dest + 8), c);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dest + 16), c);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dest + 24), c);
+    }
+
+    for (; count >= 8; count -= 8, dest += 8) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dest), c);
+    }
+
+    FillScalar(dest, colour, count);
+}
+
+AVX2_KERNEL static void GradientAVX2(uint32_t* dest, uint32_t c1, uint32_t c2, size_t length, size_t count) {
+    if (!length) {
+        return;
+    }
+
+    int32_t start[4], step[4];
+    GradientSteps(c1, c2, length, start, step);
+
+    const __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256i channels[4];
+    __m256i increments[4];
+    for (int i = 0; i < 4; i++) {
+        channels[i] = _mm256_add_epi32(_mm256_set1_epi32(start[i]), _mm256_mullo_epi32(_mm256_set1_epi32(step[i]), index));
+        increments[i] = _mm256_set1_epi32(step[i] * 8);
+    }
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_srli_epi32(channels[0], 16);
+        pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(_mm256_srli_epi32(channels[1], 16), 8));
+        pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(_mm256_srli_epi32(channels[2], 16), 16));
+        pixels = _mm256_or_si256(pixels, _mm256_slli_epi32(_mm256_srli_epi32(channels[3], 16), 24));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), pixels);
+
+        for (int c = 0; c < 4; c++) {
+            channels[c] = _mm256_add_epi32(channels[c], increments[c]);
+        }
+    }
+
+    for (; i < count; i++) {
+        dest[i] = GradientPixel(start, step, i);
+    }
+}
+
+AVX2_KERNEL static void AlphaBlendAVX2(uint32_t* dest, const uint32_t* src, size_t count) {
+    for (; count >= 8; count -= 8, dest += 8, src += 8) {
+        BlendBlockAVX2(dest, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+    }
+
+    AlphaBlendScalar(dest, src, count);
+}
+
+AVX2_KERNEL static void AlphaFillAVX2(uint32_t* dest, uint32_t colour, size_t count) {
+    if (!(colour >> 24)) {
+        return;
+    } else if ((colour >> 24) == 0xff) {
+        FillAVX2(dest, colour, count);
+        return;
+    }
+
+    __m256i c = _mm256_set1_epi32(colour);
+    for (; count >= 8; count -= 8, dest += 8) {
+        BlendBlockAVX2(dest, c);
+    }
+
+    AlphaFillScalar(dest, colour, count);
+}
+
+AVX2_KERNEL static void MaskBlendAVX2(uint32_t* dest, uint32_t colour, const uint8_t* mask, size_t count) {
+    __m256i rgb = _mm256_set1_epi32(colour & 0xffffff);
+
+    for (; count >= 8; count -= 8, dest += 8, mask += 8) {
+        uint64_t m;
+        memcpy(&m, mask, sizeof(m));
+        if (!m) {
+            continue;
+        }
+
+        __m256i alpha = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(m));
+        BlendBlockAVX2(dest, _mm256_or_si256(rgb, _mm256_slli_epi32(alpha, 24)));
+    }
+
+    MaskBlendScalar(dest, colour, mask, count);
+}
+
+AVX2_KERNEL static void CompositePremultipliedAVX2(uint32_t* dest, const uint32_t* src, size_t count) {
+    const __m256i alphaMask = _mm256_set1_epi32(0xff000000);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (; count >= 8; count -= 8, dest += 8, src += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        if (_mm256_testc_si256(s, alphaMask)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), s);
+            continue;
+        }
+
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest));
+
+        __m256i lo = ScaleChannelsAVX2(_mm256_unpacklo_epi8(d, zero), _mm256_shuffle_epi8(s, ALPHA_SHUFFLE_LO_AVX2));
+        __m256i hi = ScaleChannelsAVX2(_mm256_unpackhi_epi8(d, zero), _mm256_shuffle_epi8(s, ALPHA_SHUFFLE_HI_AVX2));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+    }
+
+    CompositePremultipliedScalar(dest, src, count);
+}
+
+AVX2_KERNEL static void BlitColourKeyAVX2(uint32_t* dest, const uint32_t* src, uint32_t key, size_t count) {
+    __m256i k = _mm256_set1_epi32(key);
+
+    for (; count >= 8; count -= 8, dest += 8, src += 8) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        __m256i keyed = _mm256_cmpeq_epi32(s, k);
+        if (_mm256_testz_si256(keyed, keyed)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), s);
+            continue;
+        }
+
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_blendv_epi8(s, d, keyed));
+    }
+
+    BlitColourKeyScalar(dest, src, key, count);
+}
+
+//////////////////////////
+// Dispatch
+//////////////////////////
+
+static const Kernels kernels[ISACount] = {
+    {FillScalar, GradientScalar, AlphaBlendScalar, AlphaFillScalar, MaskBlendScalar, CompositePremultipliedScalar,
+     BlitColourKeyScalar},
+    {FillSSE2, GradientSSE2, AlphaBlendSSE2, AlphaFillSSE2, MaskBlendSSE2, CompositePremultipliedSSE2,
+     BlitColourKeySSE2},
+    // SSE4.1 adds nothing for filling or gradients
+    {FillSSE2, GradientSSE2, AlphaBlendSSE41, AlphaFillSSE41, MaskBlendSSE41, CompositePremultipliedSSE41,
+     BlitColourKeySSE41},
+    {FillAVX2, GradientAVX2, AlphaBlendAVX2, AlphaFillAVX2, MaskBlendAVX2, CompositePremultipliedAVX2,
+     BlitColourKeyAVX2},
+};
+
+static ISA DetectISA() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return ISAScalar;
+    }
+
+    ISA isa = ISAScalar;
+    if (edx & bit_SSE2) {
+        isa = ISASSE2;
+    }
+
+    if ((ecx & bit_SSSE3) && (ecx & bit_SSE4_1)) {
+        isa = ISASSE41;
+    }
+
+    // The OS must save the AVX registers, check that it has enabled them in XCR0
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+        uint32_t xcr0Low, xcr0High;
+        asm volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+
+        if ((xcr0Low & 0x6) == 0x6 && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2)) {
+            isa = ISAAVX2;
+        }
+    }
+
+    return isa;
+}
+
+ISA BestISA() {
+    static const ISA isa = DetectISA();
+    return isa;
+}
+
+const Kernels& Current() {
+    static const Kernels& current = kernels[BestISA()];
+    return current;
+}
+
+const Kernels* GetKernels(ISA isa) {
+    if (isa < 0 || isa > BestISA()) {
+        return nullptr;
+    }
+
+    return &kernels[isa];
+}
+
+const char* ISAName(ISA isa) {
+    switch (isa) {
+    case ISAScalar:
+        return "Scalar";
+    case ISASSE2:
+        return "SSE2";
+    case ISASSE41:
+        return "SSE4.1";
+    case ISAAVX2:
+        return "AVX2";
+    default:
+        return "Unknown";
+    }
+}
+} // namespace Lemon::Graphics::Raster
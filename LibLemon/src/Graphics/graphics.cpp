@@ -5,6 +5,9 @@
 #include <string.h>
 
 #include <assert.h>
+#include <smmintrin.h>
+
+#include <algorithm>
 
 #include "FastMem.h"
 
@@ -109,6 +112,93 @@ uint32_t Interpolate(double q11, double q21, double q12, double q22, double x, d
     return (uint32_t)val;
 }
 
+void ScaleBilinear(const surface_t* src, surface_t* dest, int x, int y, int w, int h, double xScale, double yScale) {
+    if (src->width <= 0 || src->height <= 0 || xScale <= 0 || yScale <= 0) {
+        return;
+    }
+
+    // Clip to the destination
+    if (x < 0) {
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        h += y;
+        y = 0;
+    }
+    w = std::min(w, dest->width - x);
+    h = std::min(h, dest->height - y);
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    // Source positions are 16.16 fixed point, weights are 8 bit (0-256)
+    const int64_t xStep = static_cast<int64_t>(65536 / xScale);
+    const int64_t yStep = static_cast<int64_t>(65536 / yScale);
+
+    // The columns are the same for every row, so work out the sample positions and weights once
+    struct Column {
+        int x0;
+        int x1;
+        __m128i weights; // Left pixel weight in the low four words, right pixel weight in the high four
+    };
+    Column* columns = new Column[w];
+
+    int columnCount = 0;
+    for (; columnCount < w; columnCount++) {
+        int64_t pos = columnCount * xStep;
+        int x0 = pos >> 16;
+        if (x0 >= src->width) {
+            break; // Past the end of the source (only when the aspect ratio is preserved)
+        }
+
+        int fx = (pos >> 8) & 0xFF;
+        columns[columnCount] = {
+            .x0 = x0,
+            .x1 = std::min(x0 + 1, src->width - 1),
+            .weights = _mm_set_epi16(fx, fx, fx, fx, 256 - fx, 256 - fx, 256 - fx, 256 - fx),
+        };
+    }
+
+    const uint32_t* srcBuffer = reinterpret_cast<const uint32_t*>(src->buffer);
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < h; i++) {
+        int64_t pos = i * yStep;
+        int y0 = pos >> 16;
+        if (y0 >= src->height) {
+            break;
+        }
+
+        const uint32_t* row0 = srcBuffer + y0 * src->width;
+        const uint32_t* row1 = srcBuffer + std::min(y0 + 1, src->height - 1) * src->width;
+
+        int fy = (pos >> 8) & 0xFF;
+        const __m128i topWeight = _mm_set1_epi16(256 - fy);
+        const __m128i bottomWeight = _mm_set1_epi16(fy);
+
+        uint32_t* out = reinterpret_cast<uint32_t*>(dest->buffer) + (y + i) * dest->width + x;
+        for (int j = 0; j < columnCount; j++) {
+            const Column& c = columns[j];
+
+            // Both pixels of each row as 16 bit channels, left pixel in the low half
+            __m128i top = _mm_unpacklo_epi8(
+                _mm_unpacklo_epi32(_mm_cvtsi32_si128(row0[c.x0]), _mm_cvtsi32_si128(row0[c.x1])), zero);
+            __m128i bottom = _mm_unpacklo_epi8(
+                _mm_unpacklo_epi32(_mm_cvtsi32_si128(row1[c.x0]), _mm_cvtsi32_si128(row1[c.x1])), zero);
+
+            // 255 * 256 still fits in 16 bits
+            __m128i v = _mm_srli_epi16(
+                _mm_add_epi16(_mm_mullo_epi16(top, topWeight), _mm_mullo_epi16(bottom, bottomWeight)), 8);
+            v = _mm_mullo_epi16(v, c.weights);
+            v = _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_si128(v, 8)), 8);
+
+            out[j] = _mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+        }
+    }
+
+    delete[] columns;
+}
+
 void DrawGradient(int x, int y, int width, int height, rgba_colour_t c1, rgba_colour_t c2, surface_t* surface) {
     if (x < 0) {
         width += x;
@@ -120,10 +210,19 @@ void DrawGradient(int x, int y, int width, int height, rgba_colour_t c1, rgba_co
         y = 0;
     }
 
-    for (int j = 0; j < width && (x + j) < surface->width; j++) {
-        DrawRect(x + j, y, 1, height, (uint8_t)(j * (((double)c2.r - (double)c1.r) / width) + c1.r),
-                 (uint8_t)(j * (((double)c2.g - (double)c1.g) / width) + c1.g),
-                 (uint8_t)(j * (((double)c2.b - (double)c1.b) / width) + c1.b), surface);
+    int visibleWidth = std::min(width, surface->width - x);
+    int visibleHeight = std::min(height, surface->height - y);
+    if (visibleWidth <= 0 || visibleHeight <= 0) {
+        return;
+    }
+
+    uint32_t* row = reinterpret_cast<uint32_t*>(surface->buffer) + y * surface->width + x;
+
+    // Every row is the same so only the first is interpolated
+    Raster::Gradient(row, RGBAColour::ToARGB({c1.r, c1.g, c1.b, 0xff}), RGBAColour::ToARGB({c2.r, c2.g, c2.b, 0xff}),
+                     width, visibleWidth);
+    for (int i = 1; i < visibleHeight; i++) {
+        memcpy_optimized(row + i * surface->width, row, visibleWidth);
     }
 }
 
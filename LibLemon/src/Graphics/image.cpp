@@ -95,13 +95,13 @@ int LoadImage(const char* path, int x, int y, int w, int h, surface_t* surface,
 
     surface_t surf;
     int r = LoadImage(imageFile, &surf);
+    fclose(imageFile);
 
     if (r)
         return r;
 
     double xScale = ((double)w) / surf.width;
     double yScale = (((double)h) / surf.height);
-    double xOffset = 0;
 
     if (preserveAspectRatio) {
         if (yScale > xScale)
@@ -110,48 +110,13 @@ int LoadImage(const char* path, int x, int y, int w, int h, surface_t* surface,
             yScale = xScale;
     }
 
-    uint8_t* srcBuffer = surf.buffer;
-
     if (!surface->buffer) { // Allocate new surface if needed
         *surface = {.width = w + x, .height = h + y, .depth = 32, .buffer = new uint8_t[(w + x) * (h + y) * 4]};
     }
 
-    uint32_t* destBuffer = (uint32_t*)surface->buffer;
-
-    for (int i = 0; i < h && i + y < surface->height; i++) {
-        double _yval = ((double)i) / yScale;
-        if (ceil(_yval) >= surf.height)
-            break;
-        for (int j = 0; j < w && j + x < surface->width; j++) {
-            double _xval = xOffset + ((double)+j) / xScale;
-            if (ceil(_xval) >= surf.width)
-                break;
-            uint32_t offset = (y + i) * surface->width + x + j;
-
-            long b = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)floor(_xval)) * 4],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4], _xval, _yval);
-            long g = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4 + 1],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 1],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 1],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4 + 1], _xval, _yval);
-            long r = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4 + 2],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 2],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 2],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4 + 2], _xval, _yval);
-            long a = Interpolate(srcBuffer[((int)floor(_yval) * surf.width + (int)floor(_xval)) * 4 + 3],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 3],
-                                 srcBuffer[((int)floor(_yval) * surf.width + (int)ceil(_xval)) * 4 + 3],
-                                 srcBuffer[((int)ceil(_yval) * surf.width + (int)ceil(_xval)) * 4 + 3], _xval, _yval);
-
-            destBuffer[offset] = (a << 24) | (r << 16) | (g << 8) | b;
-        }
-    }
-
-    free(srcBuffer);
-    fclose(imageFile);
+    ScaleBilinear(&surf, surface, x, y, w, h, xScale, yScale);
 
+    free(surf.buffer);
     return 0;
 }
 
@@ -1,5 +1,6 @@
 #include <Lemon/Graphics/Font.h>
 #include <Lemon/Graphics/Graphics.h>
+#include <Lemon/Graphics/Raster.h>
 #include <Lemon/Graphics/Text.h>
 
 #include <Lemon/Core/Unicode.h>
@@ -7,6 +8,7 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <algorithm>
 #include <ctype.h>
 
 extern uint8_t font_default[];
@@ -76,15 +78,13 @@ int DrawChar(int character, int x, int y, uint8_t r, uint8_t g, uint8_t b, surfa
             continue;
 
         uint32_t yOffset = (i + y + (font->height - face->glyph->bitmap_top)) * (surface->width);
-        for (unsigned int j = 0; j < face->glyph->bitmap.width && static_cast<long>(j) + x < surface->width;
-             j++) {
-            if (x + static_cast<long>(j) < 0)
-                continue;
-            if (face->glyph->bitmap.buffer[i * face->glyph->bitmap.width + j] == 255)
-                buffer[yOffset + (j + x)] = colour_i;
-            else if (face->glyph->bitmap.buffer[i * face->glyph->bitmap.width + j] > 0) {
-                buffer[yOffset + (j + x)] = AlphaBlendInt(buffer[yOffset + (j + x)], RGBAColour::ToARGB({r, g, b, face->glyph->bitmap.buffer[i * face->glyph->bitmap.width + j]}));
-            }
+
+        // Glyph coverage is used as the alpha
+        int start = std::max(0, -x);
+        int end = std::min<long>(face->glyph->bitmap.width, surface->width - x);
+        if (end > start) {
+            Raster::MaskBlend(buffer + yOffset + x + start, colour_i,
+                              face->glyph->bitmap.buffer + i * face->glyph->bitmap.width + start, end - start);
         }
     }
     return face->glyph->advance.x >> 6;
@@ -190,13 +190,10 @@ int DrawString(const char* str, int x, int y, uint8_t r, uint8_t g, uint8_t b, s
                 j = limits.x - xOffset;
             }
 
-            for (; j < face->glyph->bitmap.width && (xOffset + static_cast<long>(j)) < surface->width; j++) {
-                unsigned off = yOffset + (j + xOffset);
-                if (face->glyph->bitmap.buffer[i * face->glyph->bitmap.width + j] == 255)
-                    buffer[off] = colour_i;
-                else if (face->glyph->bitmap.buffer[i * face->glyph->bitmap.width + j]) {
-                    buffer[off] = AlphaBlendInt(buffer[off], RGBAColour::ToARGB({r, g, b, face->glyph->bitmap.buffer[i * face->glyph->bitmap.width + j]}));
-                }
+            long end = std::min<long>(face->glyph->bitmap.width, surface->width - xOffset);
+            if (end > static_cast<long>(j)) {
+                Raster::MaskBlend(buffer + yOffset + xOffset + j, colour_i,
+                                  face->glyph->bitmap.buffer + i * face->glyph->bitmap.width + j, end - j);
             }
         }
 
@@ -71,40 +71,7 @@ void Texture::UpdateSurface() {
                 yScale = xScale;
         }
 
-        uint8_t* srcBuffer = source.buffer;
-        for (int i = 0; i < surface.height; i++) {
-            double _yval = ((double)i) / yScale;
-            if (ceil(_yval) >= source.height)
-                break;
-            for (int j = 0; j < surface.width; j++) {
-                double _xval = ((double)j) / xScale;
-                if (ceil(_xval) >= source.width)
-                    break;
-                uint32_t offset = i * surface.width + j;
-
-                long b = Interpolate(srcBuffer[((int)floor(_yval) * source.width + (int)floor(_xval)) * 4],
-                                     srcBuffer[((int)floor(_yval) * source.width + (int)ceil(_xval)) * 4],
-                                     srcBuffer[((int)ceil(_yval) * source.width + (int)floor(_xval)) * 4],
-                                     srcBuffer[((int)ceil(_yval) * source.width + (int)ceil(_xval)) * 4], _xval, _yval);
-                long g =
-                    Interpolate(srcBuffer[((int)floor(_yval) * source.width + (int)floor(_xval)) * 4 + 1],
-                                srcBuffer[((int)floor(_yval) * source.width + (int)ceil(_xval)) * 4 + 1],
-                                srcBuffer[((int)ceil(_yval) * source.width + (int)floor(_xval)) * 4 + 1],
-                                srcBuffer[((int)ceil(_yval) * source.width + (int)ceil(_xval)) * 4 + 1], _xval, _yval);
-                long r =
-                    Interpolate(srcBuffer[((int)floor(_yval) * source.width + (int)floor(_xval)) * 4 + 2],
-                                srcBuffer[((int)floor(_yval) * source.width + (int)ceil(_xval)) * 4 + 2],
-                                srcBuffer[((int)ceil(_yval) * source.width + (int)floor(_xval)) * 4 + 2],
-                                srcBuffer[((int)ceil(_yval) * source.width + (int)ceil(_xval)) * 4 + 2], _xval, _yval);
-                long a =
-                    Interpolate(srcBuffer[((int)floor(_yval) * source.width + (int)floor(_xval)) * 4 + 3],
-                                srcBuffer[((int)floor(_yval) * source.width + (int)ceil(_xval)) * 4 + 3],
-                                srcBuffer[((int)ceil(_yval) * source.width + (int)floor(_xval)) * 4 + 3],
-                                srcBuffer[((int)ceil(_yval) * source.width + (int)ceil(_xval)) * 4 + 3], _xval, _yval);
-
-                reinterpret_cast<uint32_t*>(surface.buffer)[offset] = (a << 24) | (r << 16) | (g << 8) | b;
-            }
-        }
+        ScaleBilinear(&source, &surface, 0, 0, surface.width, surface.height, xScale, yScale);
     }
 }
 } // namespace Lemon::Graphics
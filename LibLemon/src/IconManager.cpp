@@ -1,6 +1,12 @@
 #include <Lemon/Core/IconManager.h>
 
+#include <Lemon/Core/Logger.h>
+#include <Lemon/Core/SharedMemory.h>
 #include <Lemon/Graphics/Graphics.h>
+#include <Lemon/Services/lemon.iconcache.h>
+
+#include <assert.h>
+#include <string.h>
 
 namespace Lemon {
 IconManager* IconManager::m_instance = nullptr;
@@ -30,6 +36,8 @@ IconManager::IconManager() {
                 .buffer = new uint8_t[64 * 64 * 4],
             },
     };
+
+    MapAtlas();
 }
 
 IconManager* IconManager::Instance() {
@@ -43,81 +51,114 @@ IconManager* IconManager::Instance() {
 }
 
 const Surface* IconManager::GetIcon(const std::string& name, IconSize preferredSize) {
-    Icon& icon = m_icons[name];
-
-    if (preferredSize == IconSize16x16) {
-        if (icon.icon16.buffer) {
-            return &icon.icon16;
-        }
+    assert(preferredSize >= IconSize16x16 && preferredSize <= IconSize64x64);
 
-        // Try all sizes if unsuccessful, scale if necessary
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/16/") + name + ".png").c_str(), 0,
-                                        0, 16, 16, &icon.icon16, false)) {
-            return &icon.icon16;
-        }
+    std::scoped_lock lock(m_iconsLock);
 
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/32/") + name + ".png").c_str(), 0,
-                                        0, 16, 16, &icon.icon16, false)) {
-            return &icon.icon16;
-        }
+    Icon& icon = m_icons[name];
+    Surface* surface = (preferredSize == IconSize16x16)   ? &icon.icon16
+                       : (preferredSize == IconSize32x32) ? &icon.icon32
+                                                          : &icon.icon64;
+    if (surface->buffer) {
+        return surface;
+    }
 
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/64/") + name + ".png").c_str(), 0,
-                                        0, 16, 16, &icon.icon16, false)) {
-            return &icon.icon16;
-        }
+    const IconAtlasEntry* entry = FindAtlasEntry(name);
+    if (entry && entry->pixels[preferredSize]) {
+        int dimensions = IconDimensions(preferredSize);
+        *surface = {
+            .width = dimensions,
+            .height = dimensions,
+            .depth = 32,
+            .buffer = const_cast<uint8_t*>(m_atlas + entry->pixels[preferredSize]),
+        };
+        return surface;
+    }
 
-        return &m_missingIcon.icon16; // Unsuccessful
+    if (!entry && !DecodeIcon(name, preferredSize, surface)) {
+        return surface;
     }
 
-    if (preferredSize == IconSize32x32) {
-        if (icon.icon32.buffer) {
-            return &icon.icon32;
-        }
+    // Either the icon cache could not load it either or we failed to decode it
+    return (preferredSize == IconSize16x16)   ? &m_missingIcon.icon16
+           : (preferredSize == IconSize32x32) ? &m_missingIcon.icon32
+                                              : &m_missingIcon.icon64;
+}
 
-        // Try all sizes if unsuccessful, scale if necessary
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/32/") + name + ".png").c_str(), 0,
-                                        0, 32, 32, &icon.icon32, false)) {
-            return &icon.icon32;
-        }
+int IconManager::DecodeIcon(const std::string& name, IconSize size, Surface* surface) {
+    // Try the requested size first, then the others (scaled) in order of preference
+    static const int sizeOrder[][3] = {
+        {16, 32, 64},
+        {32, 64, 16},
+        {64, 32, 16},
+    };
 
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/64/") + name + ".png").c_str(), 0,
-                                        0, 32, 32, &icon.icon32, false)) {
-            return &icon.icon32;
+    int dimensions = IconDimensions(size);
+    for (int resourceSize : sizeOrder[size]) {
+        std::string path = "/system/lemon/resources/icons/" + std::to_string(resourceSize) + "/" + name + ".png";
+        if (!Graphics::LoadImage(path.c_str(), 0, 0, dimensions, dimensions, surface, false)) {
+            return 0;
         }
+    }
 
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/16/") + name + ".png").c_str(), 0,
-                                        0, 32, 32, &icon.icon32, false)) {
-            return &icon.icon32;
-        }
+    return 1;
+}
 
-        return &m_missingIcon.icon32; // Unsuccessful
+bool IconManager::MapAtlas() {
+    handle_t handle = InterfaceConnect("lemon.iconcache/Instance");
+    if (handle <= 0) {
+        return false; // Icon cache is not running, decode icons ourselves
     }
 
-    if (preferredSize == IconSize64x64) {
-        if (icon.icon64.buffer) {
-            return &icon.icon64;
-        }
+    IconCache::GetAtlasResponse atlas;
+    try {
+        IconCacheEndpoint endpoint(Handle{handle});
+        atlas = endpoint.GetAtlas();
+    } catch (...) {
+        Logger::Warning("Failed to get icon atlas");
+        return false;
+    }
 
-        // Try all sizes if unsuccessful, scale if necessary
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/64/") + name + ".png").c_str(), 0,
-                                        0, 64, 64, &icon.icon64, false)) {
-            return &icon.icon64;
-        }
+    if (atlas.key <= 0 || atlas.size < sizeof(IconAtlasHeader)) {
+        return false;
+    }
 
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/32/") + name + ".png").c_str(), 0,
-                                        0, 64, 64, &icon.icon64, false)) {
-            return &icon.icon64;
-        }
+    const uint8_t* mapping = reinterpret_cast<const uint8_t*>(MapSharedMemory(atlas.key));
+    if (!mapping) {
+        return false;
+    }
 
-        if (!Lemon::Graphics::LoadImage((std::string("/system/lemon/resources/icons/16/") + name + ".png").c_str(), 0,
-                                        0, 64, 64, &icon.icon64, false)) {
-            return &icon.icon64;
-        }
+    const IconAtlasHeader* header = reinterpret_cast<const IconAtlasHeader*>(mapping);
+    if (header->magic != ICON_ATLAS_MAGIC ||
+        sizeof(IconAtlasHeader) + header->entryCount * sizeof(IconAtlasEntry) > atlas.size) {
+        Logger::Warning("Invalid icon atlas");
+        UnmapSharedMemory(const_cast<uint8_t*>(mapping), atlas.key);
+        return false;
+    }
 
-        return &m_missingIcon.icon64; // Unsuccessful
+    m_atlas = mapping;
+    m_atlasEntries = reinterpret_cast<const IconAtlasEntry*>(mapping + sizeof(IconAtlasHeader));
+    m_atlasEntryCount = header->entryCount;
+    return true;
+}
+
+const IconAtlasEntry* IconManager::FindAtlasEntry(const std::string& name) const {
+    // Entries are sorted by name
+    uint32_t low = 0;
+    uint32_t high = m_atlasEntryCount;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+
+        int cmp = strncmp(name.c_str(), m_atlasEntries[mid].name, ICON_ATLAS_NAME_MAX);
+        if (!cmp) {
+            return &m_atlasEntries[mid];
+        } else if (cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
     }
 
-    assert(!"Invalid icon preferred size!");
     return nullptr;
 }
 } // namespace Lemon
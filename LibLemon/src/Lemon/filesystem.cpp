@@ -0,0 +1,43 @@
+#include <Lemon/System/Filesystem.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <lemon/syscall.h>
+#include <unistd.h>
+
+namespace Lemon {
+int ReadDirectoryPlus(int fd, DirectoryEntryPlus* entries, unsigned count) {
+    long ret = syscall(SYS_READDIR_PLUS, fd, entries, count);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+int ListDirectory(const char* path, std::vector<DirectoryEntryPlus>& entries) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int ret;
+    do {
+        size_t used = entries.size();
+        entries.resize(used + READDIR_PLUS_MAX_ENTRIES);
+
+        ret = ReadDirectoryPlus(fd, entries.data() + used, READDIR_PLUS_MAX_ENTRIES);
+        entries.resize(used + (ret > 0 ? ret : 0));
+    } while (ret > 0);
+
+    int error = errno;
+    close(fd);
+
+    if (ret < 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+} // namespace Lemon
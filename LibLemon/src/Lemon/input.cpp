@@ -3,10 +3,12 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/ioctl.h>
 
 namespace Lemon{
     static int mouseFd = 0;
     static int keyboardFd = 0;
+    static int inputFd = 0;
 
     int PollMouse(MousePacket& pkt){
         if(!mouseFd) mouseFd = open("/dev/mouse0", O_RDONLY);
@@ -21,4 +23,28 @@ namespace Lemon{
 
         return read(keyboardFd, buffer, count);
     }
+
+    int InputEventsFd(){
+        if(!inputFd) inputFd = open("/dev/input", O_RDONLY);
+
+        return inputFd;
+    }
+
+    ssize_t PollInputEvents(lemon_input_event_t* events, size_t count){
+        ssize_t ret = read(InputEventsFd(), events, count * sizeof(lemon_input_event_t));
+        if(ret < 0){
+            return ret;
+        }
+
+        return ret / sizeof(lemon_input_event_t);
+    }
+
+    uint64_t InputTimestampFrequency(){
+        int khz = ioctl(InputEventsFd(), IoCtlInputGetTimestampFrequency);
+        if(khz < 0){
+            return 0;
+        }
+
+        return khz * 1000ULL;
+    }
 }
@@ -22,4 +22,8 @@ void* MapSharedMemory(int64_t key) {
 long UnmapSharedMemory(void* address, int64_t key) { return syscall(SYS_UNMAP_SHARED_MEMORY, address, key); }
 
 long DestroySharedMemory(int64_t key) { return syscall(SYS_DESTROY_SHARED_MEMORY, key); }
+
+long ResizeSharedMemory(int64_t key, uint64_t size, void** address) {
+    return syscall(SYS_RESIZE_SHARED_MEMORY, address, key, size);
+}
 } // namespace Lemon
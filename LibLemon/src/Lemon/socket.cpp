@@ -0,0 +1,26 @@
+#include <Lemon/System/Socket.h>
+
+#include <errno.h>
+#include <lemon/syscall.h>
+
+namespace Lemon {
+int SendMultipleMessages(int sockfd, lemon_mmsghdr_t* msgvec, unsigned vlen, int flags) {
+    long ret = syscall(SYS_SENDMMSG, sockfd, msgvec, vlen, flags);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+int ReceiveMultipleMessages(int sockfd, lemon_mmsghdr_t* msgvec, unsigned vlen, int flags) {
+    long ret = syscall(SYS_RECVMMSG, sockfd, msgvec, vlen, flags);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+} // namespace Lemon
@@ -23,3 +23,4 @@ cd "$1/Services"
 "$LIC" lemon.networkgovernor.li "$INCLUDEDIR/lemon.networkgovernor.h"
 "$LIC" lemon.lemonwm.li "$INCLUDEDIR/lemon.lemonwm.h"
 "$LIC" lemon.shell.li "$INCLUDEDIR/lemon.shell.h"
+"$LIC" lemon.iconcache.li "$INCLUDEDIR/lemon.iconcache.h"
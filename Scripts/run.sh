@@ -20,6 +20,24 @@ qemunetdump(){
 	qemu-system-x86_64 --enable-kvm -cpu host $LEMOND/Disks/Lemon.img -no-reboot -no-shutdown -m 512M -device qemu-xhci -M q35 -smp 2 -serial stdio -netdev user,id=net0 -device e1000,netdev=net0,mac=DE:AD:69:BE:EF:42 -object filter-dump,id=net0,netdev=net0,file=/tmp/lemon.pcap
 }
 
+qemunetbench(){
+	qemu-system-x86_64 --enable-kvm -cpu host $LEMOND/Disks/Lemon.img -no-reboot -no-shutdown -m 1024M -M q35 -smp 2 -serial stdio -netdev user,id=net0,hostfwd=udp::5555-:5555 -device e1000,netdev=net0,mac=DE:AD:69:BE:EF:42
+}
+
+qemuvirtio(){
+	qemu-system-x86_64 --enable-kvm -cpu host $LEMOND/Disks/Lemon.img -no-reboot -no-shutdown -m 1024M -M q35 -smp 2 -serial stdio -netdev user,id=net0,hostfwd=udp::5555-:5555 -device virtio-net-pci,netdev=net0,mac=DE:AD:69:BE:EF:42
+}
+
+# Multiple queues and checksum/segmentation offload need a tap backend, set up lemontap0 beforehand
+qemuvirtiotap(){
+	qemu-system-x86_64 --enable-kvm -cpu host $LEMOND/Disks/Lemon.img -no-reboot -no-shutdown -m 1024M -M q35 -smp 2 -serial stdio -netdev tap,id=net0,ifname=lemontap0,script=no,downscript=no,vhost=on,queues=2 -device virtio-net-pci,netdev=net0,mac=DE:AD:69:BE:EF:42,mq=on,vectors=6
+}
+
+# Boot disk on virtio-blk with a queue per CPU, try diskbench /dev/hd0p1
+qemuvirtioblk(){
+	qemu-system-x86_64 --enable-kvm -cpu host -drive file=$LEMOND/Disks/Lemon.img,if=none,id=disk0 -device virtio-blk-pci,drive=disk0,num-queues=2 -no-reboot -no-shutdown -m 1024M -M q35 -smp 2 -serial stdio -netdev user,id=net0 -device e1000,netdev=net0,mac=DE:AD:69:BE:EF:42
+}
+
 vbox(){
 	VBoxManage startvm "LemonOS"
 }
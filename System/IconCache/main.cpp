@@ -0,0 +1,150 @@
+#include <Lemon/Core/IconAtlas.h>
+#include <Lemon/Core/IconManager.h>
+#include <Lemon/Core/Logger.h>
+#include <Lemon/Core/SharedMemory.h>
+#include <Lemon/IPC/Interface.h>
+#include <Lemon/Services/lemon.iconcache.h>
+#include <Lemon/System/IPC.h>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#define ICON_RESOURCE_PATH "/system/lemon/resources/icons/"
+
+// Decodes every system icon once at every size into a single shared memory atlas.
+// Clients map the atlas read only (see Lemon::IconManager) instead of each decoding the PNGs themselves.
+class IconCacheInstance final : IconCache {
+public:
+    IconCacheInstance(const Lemon::Handle& svc, const char* name) : m_interface(svc, name, 512) {}
+
+    int BuildAtlas() {
+        std::set<std::string> names; // Kept sorted for the atlas
+        for (const char* size : {"16", "32", "64"}) {
+            DIR* dir = opendir((std::string(ICON_RESOURCE_PATH) + size).c_str());
+            if (!dir) {
+                continue;
+            }
+
+            while (dirent* entry = readdir(dir)) {
+                size_t len = strlen(entry->d_name);
+                if (len <= 4 || strcmp(entry->d_name + len - 4, ".png")) {
+                    continue;
+                }
+
+                if (len - 4 >= ICON_ATLAS_NAME_MAX) {
+                    Lemon::Logger::Warning("Icon name '{}' too long", entry->d_name);
+                    continue;
+                }
+
+                names.insert(std::string(entry->d_name, len - 4));
+            }
+            closedir(dir);
+        }
+
+        struct DecodedIcon {
+            std::string name;
+            Surface sizes[3];
+        };
+        std::vector<DecodedIcon> icons;
+
+        size_t size = sizeof(Lemon::IconAtlasHeader) + names.size() * sizeof(Lemon::IconAtlasEntry);
+        for (const std::string& name : names) {
+            DecodedIcon& icon = icons.emplace_back();
+            icon.name = name;
+
+            for (int i = Lemon::IconManager::IconSize16x16; i <= Lemon::IconManager::IconSize64x64; i++) {
+                auto iconSize = static_cast<Lemon::IconManager::IconSize>(i);
+                if (!Lemon::IconManager::DecodeIcon(name, iconSize, &icon.sizes[i])) {
+                    size += icon.sizes[i].BufferSize();
+                }
+            }
+        }
+
+        m_atlasKey = Lemon::CreateSharedMemory(size, SMEM_FLAGS_SHARED | SMEM_FLAGS_READONLY);
+        if (m_atlasKey <= 0) {
+            return 1;
+        }
+
+        uint8_t* atlas = reinterpret_cast<uint8_t*>(Lemon::MapSharedMemory(m_atlasKey));
+        if (!atlas) {
+            return 1;
+        }
+        m_atlasSize = size;
+
+        Lemon::IconAtlasHeader* header = reinterpret_cast<Lemon::IconAtlasHeader*>(atlas);
+        Lemon::IconAtlasEntry* entries =
+            reinterpret_cast<Lemon::IconAtlasEntry*>(atlas + sizeof(Lemon::IconAtlasHeader));
+
+        size_t offset = sizeof(Lemon::IconAtlasHeader) + icons.size() * sizeof(Lemon::IconAtlasEntry);
+        for (size_t i = 0; i < icons.size(); i++) {
+            DecodedIcon& icon = icons[i];
+            Lemon::IconAtlasEntry& entry = entries[i];
+
+            strncpy(entry.name, icon.name.c_str(), ICON_ATLAS_NAME_MAX);
+            for (int j = 0; j < 3; j++) {
+                Surface& surface = icon.sizes[j];
+                if (!surface.buffer) {
+                    entry.pixels[j] = 0; // Could not be loaded
+                    continue;
+                }
+
+                entry.pixels[j] = offset;
+                memcpy(atlas + offset, surface.buffer, surface.BufferSize());
+                offset += surface.BufferSize();
+
+                delete[] surface.buffer;
+            }
+        }
+
+        header->entryCount = icons.size();
+        header->magic = ICON_ATLAS_MAGIC;
+
+        Lemon::Logger::Debug("Cached {} icons ({} KB)", icons.size(), size / 1024);
+        return 0;
+    }
+
+    void Run() {
+        Lemon::Handle client;
+        Lemon::Message m;
+        for (;;) {
+            while (m_interface.Poll(client, m)) {
+                HandleMessage(client, m);
+            }
+
+            m_interface.Wait();
+        }
+    }
+
+protected:
+    void OnPeerDisconnect(const Lemon::Handle&) override {}
+
+    void OnGetAtlas(const Lemon::Handle& client) override {
+        IconCache::GetAtlasResponse response{m_atlasKey, m_atlasSize};
+        Lemon::EndpointQueue(client.get(), IconCache::ResponseGetAtlas, sizeof(IconCache::GetAtlasResponse),
+                             reinterpret_cast<uintptr_t>(&response));
+    }
+
+private:
+    Lemon::Interface m_interface;
+
+    int64_t m_atlasKey = 0;
+    uint64_t m_atlasSize = 0;
+};
+
+int main() {
+    Lemon::Handle svc = Lemon::Handle(Lemon::CreateService("lemon.iconcache"));
+    IconCacheInstance cache(svc, "Instance");
+
+    if (cache.BuildAtlas()) {
+        Lemon::Logger::Error("Failed to create icon atlas");
+        return 1;
+    }
+
+    cache.Run();
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include <Lemon/Core/Logger.h>
 #include <Lemon/Graphics/Graphics.h>
 
+#include <cstdio>
+
 //#define COMPOSITOR_DEBUG
 
 using namespace Lemon;
@@ -32,22 +34,26 @@ Compositor::Compositor(const Surface& displaySurface) : m_displaySurface(display
 }
 
 void Compositor::Render() {
-    if (m_displayFramerate) {
-        timespec cTime;
-        clock_gettime(CLOCK_BOOTTIME, &cTime);
+    timespec renderStart;
+    clock_gettime(CLOCK_BOOTTIME, &renderStart);
 
-        unsigned long renderTime =
-            (cTime.tv_nsec - m_lastRender.tv_nsec) + (cTime.tv_sec - m_lastRender.tv_sec) * 1000000000L;
-        m_fCount++;
+    if (m_displayFramerate) {
+        long elapsed = TimeDifference(renderStart, m_lastRender);
 
-        if (renderTime > 1000000000 && m_fCount) {
+        if (elapsed > 1000000000 && m_fCount) {
+            m_fRate = 1000000000 / (elapsed / m_fCount);
+            snprintf(m_frameStats, sizeof(m_frameStats), "%d fps | idle %ld%% | render %.2f ms | present %.2f ms",
+                     m_fRate, m_idleTime * 100 / elapsed, m_renderTime / 1000000.0 / m_fCount,
+                     m_presentTime / 1000000.0 / m_fCount);
 
-            if (renderTime)
-                m_fRate = 1000000000 / (renderTime / m_fCount);
             m_fCount = 0;
-            renderTime = 0;
-            m_lastRender = cTime;
+            m_idleTime = 0;
+            m_renderTime = 0;
+            m_presentTime = 0;
+            m_lastRender = renderStart;
         }
+
+        m_fCount++;
     }
 
     Vector2i mousePos = WM::Instance().Input().mouse.pos;
@@ -74,6 +80,11 @@ void Compositor::Render() {
                                   &m_displaySurface);
 #endif
 
+        // Everything gets redrawn so clear the dirty flags
+        for (WMWindow* win : WM::Instance().m_windows) {
+            win->IsDirtyAndClear();
+        }
+
         if (m_wallpaper.buffer) {
             m_renderSurface.Blit(&m_wallpaper);
             for (BackgroundClipRect& rect : m_backgroundRects) {
@@ -85,34 +96,39 @@ void Compositor::Render() {
         }
     } else {
         for (WMWindow* win : WM::Instance().m_windows) {
-            if (win->IsDirtyAndClear()) {
+            if (win->ConsumeDamage(m_windowDamage)) {
+                // Only the damaged parts of the window need to be redrawn
+
                 // If the window is transparent, we will need to invalidate
                 // any rects underneath the window
 
                 // If the window is occluded, we will need to invalidate any rects
                 // above the clip
 
-                // Otherwise, just set the window rect as invalid
+                // Otherwise, just add the damage to the clip
                 // and move on
 
-                if(win->IsTransparent()) for(auto& r : m_windowClipRects) {
-                    if(r.win == win) {
-                        Invalidate(r.rect);
-                    }
-                } else for(auto& r : m_windowClipRects) {
-                    if(r.win == win) {
-                        if(r.occluded) {
-                            Invalidate(r.rect);
+                for (const Rect& damage : m_windowDamage) {
+                    for (auto& r : m_windowClipRects) {
+                        if (r.win != win || r.type != WindowClipRect::TypeWindow || !r.rect.Intersects(damage)) {
+                            continue;
+                        }
+
+                        Rect rect = damage.GetIntersect(r.rect);
+                        if (win->IsTransparent() || r.occluded) {
+                            Invalidate(rect);
                         } else {
-                            r.invalid = true;
+                            r.damage = RectUnion(r.damage, rect);
                         }
                     }
                 }
-                
             }
         }
     }
 
+    // Region of the screen which needs to be copied to the display surface
+    Rect present = {};
+
     if (m_wallpaper.buffer) {
         for (BackgroundClipRect& rect : m_backgroundRects) {
             if (!rect.invalid) {
@@ -120,6 +136,7 @@ void Compositor::Render() {
             }
 
             m_renderSurface.Blit(&m_wallpaper, rect.rect.pos, rect.rect);
+            present = RectUnion(present, rect.rect);
 
 #ifdef COMPOSITOR_DEBUG
             Lemon::Graphics::DrawRectOutline(rect.rect, {255, 0, 0, 255}, &m_renderSurface);
@@ -138,6 +155,7 @@ void Compositor::Render() {
             } else {
                 win->DrawClip(it->rect, &m_renderSurface);
             }
+            present = RectUnion(present, it->rect);
 
 #ifdef COMPOSITOR_DEBUG
             Lemon::Graphics::DrawRect(it->rect, {255, 0, 0, 255}, &m_displaySurface);
@@ -148,6 +166,17 @@ void Compositor::Render() {
 #endif
 
             it->invalid = false;
+            it->damage = {};
+            it++;
+        } else if (it->damage.width > 0 && it->damage.height > 0) { // Only draw the part of the window that changed
+            win->DrawClip(it->damage, &m_renderSurface);
+            present = RectUnion(present, it->damage);
+
+#ifdef COMPOSITOR_DEBUG
+            Lemon::Graphics::DrawRectOutline(it->damage, {0, 255, 0, 255}, &m_renderSurface);
+#endif
+
+            it->damage = {};
             it++;
         } else {
             it++;
@@ -157,6 +186,7 @@ void Compositor::Render() {
     if (WM::Instance().m_showContextMenu) {
         Lemon::Graphics::DrawRoundedRect(WM::Instance().m_contextMenu.bounds, WMWindow::theme.titlebarColour, 5, 5, 5,
                                          5, &m_renderSurface);
+        present = RectUnion(present, WM::Instance().m_contextMenu.bounds);
         for (const auto& ent : WM::Instance().m_contextMenu.entries) {
             const Vector2i& pos = ent.bounds.pos;
             Lemon::Graphics::DrawString(ent.text.c_str(), pos.x, pos.y, GUI::Theme::Current().ColourText(),
@@ -165,23 +195,66 @@ void Compositor::Render() {
     }
 
     m_renderSurface.AlphaBlit(m_cursorCurrent, mousePos);
+    present = RectUnion(present, {mousePos, m_cursorCurrent->width, m_cursorCurrent->height});
 
     if (m_displayFramerate) {
-        Lemon::Graphics::DrawRect(0, 0, 80, 18, 0, 0, 0, &m_renderSurface);
-        Lemon::Graphics::DrawString(std::to_string(m_fRate).c_str(), 0, 0, 255, 255, 255, &m_renderSurface);
+        Rect statsRect = {0, 0, Graphics::GetTextLength(m_frameStats) + 4, 18};
+        Lemon::Graphics::DrawRect(statsRect, {0, 0, 0, 255}, &m_renderSurface);
+        Lemon::Graphics::DrawString(m_frameStats, 2, 0, 255, 255, 255, &m_renderSurface);
+        present = RectUnion(present, statsRect);
     }
 
-    // Copy the render surface to the display surface
+    timespec presentStart;
+    clock_gettime(CLOCK_BOOTTIME, &presentStart);
+
+    // Copy the bounds of everything drawn to the display surface
     // Generally actually faster than copying each individual clip region
-    m_displaySurface.Blit(&m_renderSurface);
+    Rect screen = {0, 0, m_displaySurface.width, m_displaySurface.height};
+    if (m_invalidateAll) {
+        m_displaySurface.Blit(&m_renderSurface);
+    } else if (present.Intersects(screen)) {
+        present = present.GetIntersect(screen);
+        m_displaySurface.Blit(&m_renderSurface, present.pos, present);
+    }
     m_invalidateAll = false;
+    m_damaged = false;
 
     m_renderMutex.unlock();
+
+    if (m_displayFramerate) {
+        timespec presentEnd;
+        clock_gettime(CLOCK_BOOTTIME, &presentEnd);
+
+        m_renderTime += TimeDifference(presentStart, renderStart);
+        m_presentTime += TimeDifference(presentEnd, presentStart);
+    }
+}
+
+bool Compositor::HasDamage() const {
+    if (m_invalidateAll || m_damaged) {
+        return true;
+    }
+
+    if (WM::Instance().Input().mouse.pos != m_lastMousePos) {
+        return true;
+    }
+
+    for (const WMWindow* win : WM::Instance().m_windows) {
+        if (!win->IsMinimized() && win->IsDirty()) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-void Compositor::InvalidateAll() { m_invalidateAll = true; }
+void Compositor::InvalidateAll() {
+    m_invalidateAll = true;
+    m_damaged = true;
+}
 
 void Compositor::Invalidate(const Rect& rect) {
+    m_damaged = true;
     if (m_invalidateAll) {
         return;
     }
@@ -249,6 +322,8 @@ void Compositor::SetWallpaper(const std::string& path) {
         InvalidateAll();
         m_wallpaperStatus++;
         m_renderMutex.unlock();
+
+        WM::Instance().Wake(); // The WM may be waiting for events
     });
 
     m_wallpaperThread = std::move(wallpaperThread);
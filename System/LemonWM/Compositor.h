@@ -7,6 +7,28 @@
 #include <ctime>
 #include <list>
 #include <thread>
+#include <vector>
+
+// Time between two timestamps in nanoseconds
+inline long TimeDifference(const timespec& newTime, const timespec& oldTime) {
+    return (newTime.tv_sec - oldTime.tv_sec) * 1000000000L + (newTime.tv_nsec - oldTime.tv_nsec);
+}
+
+// Smallest rect containing both rects, empty rects are ignored
+inline Rect RectUnion(const Rect& a, const Rect& b) {
+    if (a.width <= 0 || a.height <= 0) {
+        return b;
+    } else if (b.width <= 0 || b.height <= 0) {
+        return a;
+    }
+
+    Rect r = a;
+    r.left(std::min(a.left(), b.left()));
+    r.top(std::min(a.top(), b.top()));
+    r.right(std::max(a.right(), b.right()));
+    r.bottom(std::max(a.bottom(), b.bottom()));
+    return r;
+}
 
 template <typename T, class... D> std::list<T> SplitModify(Rect& victim, const Rect& cut, D... extraData) {
     std::list<T> clips;
@@ -83,6 +105,8 @@ struct WindowClipRect {
     } type = TypeWindow;
     bool invalid = true;
     bool occluded = false;
+    // Damaged part of the clip to draw if it is not invalid
+    Rect damage = {};
 
     std::list<WindowClipRect> SplitModify(const Rect& cut) { return ::SplitModify<WindowClipRect>(rect, cut, win, type, true, occluded); }
     std::list<WindowClipRect> Split(const Rect& cut) { return ::Split<WindowClipRect>(rect, cut, win, type, true, occluded); }
@@ -101,6 +125,8 @@ public:
     Compositor(const Surface& displaySurface);
 
     void Render();
+    // Whether anything on screen has changed since the last render
+    bool HasDamage() const;
 
     inline Vector2i GetScreenBounds() const { return {m_renderSurface.width, m_renderSurface.height}; }
 
@@ -110,11 +136,20 @@ public:
 
     void SetWallpaper(const std::string& path);
     void SetShouldDisplayFramerate(bool value) { m_displayFramerate = value; }
+    // Time (in ns) the WM spent waiting for events, shown on the framerate overlay
+    inline void AddIdleTime(long time) { m_idleTime += time; }
 
-    inline void SetNormalCursor() { m_cursorCurrent = &m_cursorNormal; }
-    inline void SetResizeCursor() { m_cursorCurrent = &m_cursorResize; }
+    inline void SetNormalCursor() { SetCursor(&m_cursorNormal); }
+    inline void SetResizeCursor() { SetCursor(&m_cursorResize); }
 
 private:
+    inline void SetCursor(Surface* cursor) {
+        if (cursor != m_cursorCurrent) {
+            Invalidate({m_lastMousePos, m_cursorCurrent->width, m_cursorCurrent->height});
+            m_cursorCurrent = cursor;
+        }
+    }
+
     void RecalculateWindowClipping();
     void RecalculateBackgroundClipping();
     void RecalculateRenderClipping();
@@ -124,6 +159,7 @@ private:
     void InvalidateDecorationRect(WindowClipRect& dRect);
 
     bool m_invalidateAll = true;
+    bool m_damaged = false; // Set by Invalidate, cleared after rendering
     bool m_displayFramerate = false;
 
     Vector2i m_lastMousePos = {0, 0};
@@ -131,11 +167,15 @@ private:
     Surface m_cursorResize; // Window resize mouse cursor
     Surface* m_cursorCurrent = &m_cursorNormal; // Current mouse cursor
 
-    // Used for framerate counter
+    // Used for framerate counter and frame statistics,
+    // times are in ns and reset every second
     timespec m_lastRender;
-    long m_avgFrametime = 0;
     long m_fCount = 0;
+    long m_idleTime = 0;
+    long m_renderTime = 0;
+    long m_presentTime = 0;
     int m_fRate = 0;
+    char m_frameStats[80] = "";
 
     Surface m_renderSurface;  // Backbuffer to render to
     Surface m_displaySurface; // Display mapped surface
@@ -151,4 +191,7 @@ private:
     // Clip rects used when determining which parts of the screen
     // to copy to the framebuffer
     std::list<BackgroundClipRect> m_renderClipRects;
+
+    // Used when consuming window damage
+    std::vector<Rect> m_windowDamage;
 };
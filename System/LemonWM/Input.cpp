@@ -12,11 +12,13 @@ extern int usKeymapShift[];
 
 InputManager::InputManager(const Vector2i& mouseBounds) : m_mouseBounds(mouseBounds) {}
 
+int InputManager::Fd() const { return Lemon::InputEventsFd(); }
+
 void InputManager::Poll() {
-    auto handlePacketPress = [=](Lemon::MousePacket& pkt) -> void {
-        if ((!!(pkt.buttons & Lemon::MouseButton::Left)) !=
+    auto handlePacketPress = [this](uint8_t buttons) -> void {
+        if ((!!(buttons & Lemon::MouseButton::Left)) !=
             mouse.left) { // Use a double negative to make the statement 0 or 1
-            mouse.left = !!(pkt.buttons & Lemon::MouseButton::Left);
+            mouse.left = !!(buttons & Lemon::MouseButton::Left);
 
             if (mouse.left) {
                 WM::Instance().OnMouseDown(false);
@@ -25,9 +27,9 @@ void InputManager::Poll() {
             }
         }
 
-        if ((!!(pkt.buttons & Lemon::MouseButton::Right)) !=
+        if ((!!(buttons & Lemon::MouseButton::Right)) !=
             mouse.right) { // Use a double negative to make the statement 0 or 1
-            mouse.right = !!(pkt.buttons & Lemon::MouseButton::Right);
+            mouse.right = !!(buttons & Lemon::MouseButton::Right);
 
             if (mouse.right) {
                 WM::Instance().OnMouseDown(true);
@@ -37,29 +39,9 @@ void InputManager::Poll() {
         }
     };
 
-    if (Lemon::MousePacket mousePacket; Lemon::PollMouse(mousePacket)) {
-        mouse.pos.x = std::max(0, std::min(mouse.pos.x + mousePacket.xMovement, m_mouseBounds.x));
-        mouse.pos.y = std::max(0, std::min(mouse.pos.y + mousePacket.yMovement, m_mouseBounds.y));
-
-        handlePacketPress(mousePacket);
-
-        while (Lemon::PollMouse(mousePacket)) {
-            mouse.pos.x = std::max(0, std::min(mouse.pos.x + mousePacket.xMovement, m_mouseBounds.x));
-            mouse.pos.y = std::max(0, std::min(mouse.pos.y + mousePacket.yMovement, m_mouseBounds.y));
-
-            handlePacketPress(mousePacket); // If necessary send a mouse press event for each packet, however only send
-                                            // move event after processing all packets
-        }
-
-        WM::Instance().OnMouseMove();
-    }
-
-    uint8_t buf[32];
-    ssize_t count = Lemon::PollKeyboard(buf, 32);
-
-    for (ssize_t i = 0; i < count; i++) {
-        uint8_t code = buf[i] & 0x7F;
-        bool isPressed = !((buf[i] >> 7) & 1);
+    auto handleKey = [this](uint8_t keyCode) -> void {
+        uint8_t code = keyCode & 0x7F;
+        bool isPressed = !((keyCode >> 7) & 1);
         int key = 0;
 
         if (keyboard.shift) {
@@ -85,6 +67,33 @@ void InputManager::Poll() {
         }
 
         WM::Instance().OnKeyUpdate(key, isPressed);
+    };
+
+    bool mouseMoved = false;
+
+    lemon_input_event_t events[INPUT_EVENT_BUFFER_SIZE];
+    ssize_t count;
+    do {
+        count = Lemon::PollInputEvents(events, INPUT_EVENT_BUFFER_SIZE);
+
+        for (ssize_t i = 0; i < count; i++) {
+            const lemon_input_event_t& ev = events[i];
+            if (ev.type == InputEventMouse) {
+                mouse.pos.x = std::max(0, std::min(mouse.pos.x + ev.xMovement, m_mouseBounds.x));
+                mouse.pos.y = std::max(0, std::min(mouse.pos.y + ev.yMovement, m_mouseBounds.y));
+
+                // If necessary send a mouse press event for each packet,
+                // however only send move event after processing all packets
+                handlePacketPress(ev.buttons);
+                mouseMoved = true;
+            } else if (ev.type == InputEventKey) {
+                handleKey(ev.keyCode);
+            }
+        }
+    } while (count == INPUT_EVENT_BUFFER_SIZE);
+
+    if (mouseMoved) {
+        WM::Instance().OnMouseMove();
     }
 }
 
@@ -2,6 +2,9 @@
 
 #include <Lemon/Graphics/Vector.h>
 
+// Amount of input events read at a time
+#define INPUT_EVENT_BUFFER_SIZE 64
+
 struct MouseState {
     Vector2i pos;
     bool left, middle, right;
@@ -20,6 +23,9 @@ public:
 
     void Poll();
 
+    // Readable when there are input events, so the WM can wait on it
+    int Fd() const;
+
 private:
     Vector2i m_mouseBounds; // Maximum mouse cursor position
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <Lemon/Core/Logger.h>
 #include <Lemon/Core/Shell.h>
 #include <Lemon/GUI/WindowServer.h>
+#include <Lemon/System/KernelObject.h>
 
 #include <cassert>
 #include <unistd.h>
@@ -22,12 +23,16 @@ WM::WM(const Surface& displaySurface)
     }
 
     GUI::Theme::Current().Update(m_systemTheme);
+
+    if (pipe(m_wakeFds)) {
+        Logger::Error("Failed to create wake pipe!");
+        m_wakeFds[0] = m_wakeFds[1] = -1;
+    }
 }
 
 void WM::Run() {
+    std::vector<handle_t> waitHandles;
     for (;;) {
-        clock_gettime(CLOCK_BOOTTIME, &m_lastUpdate);
-
         Lemon::Handle client;
         Lemon::Message message;
         while (m_messageInterface.Poll(client, message)) {
@@ -37,20 +42,53 @@ void WM::Run() {
         }
 
         m_input.Poll();
-        m_compositor.Render();
 
-        if (m_targetFramerate <= 0) {
-            continue; // Do not limit framerate
+        if (m_wakePending.exchange(false)) {
+            char c;
+            read(m_wakeFds[0], &c, 1);
+        }
+
+        long timeout = -1; // Wait until there is an event
+        if (m_compositor.HasDamage()) {
+            timespec now;
+            clock_gettime(CLOCK_BOOTTIME, &now);
+
+            // Render straight away unless that would exceed the target framerate,
+            // in which case keep handling events until the next frame is due
+            long sinceLastFrame = TimeDifference(now, m_lastFrame);
+            if (m_targetFramerate <= 0 || sinceLastFrame >= m_targetFrameInterval) {
+                m_lastFrame = now;
+                m_compositor.Render();
+                continue;
+            }
+
+            timeout = std::max((m_targetFrameInterval - sinceLastFrame) / 1000, 1L);
         }
 
-        timespec timeSinceBoot;
-        clock_gettime(CLOCK_BOOTTIME, &timeSinceBoot);
+        // Wait on IPC, input and wakeups all at once
+        waitHandles.clear();
+        m_messageInterface.GetAllHandles(waitHandles);
+        if (m_input.Fd() >= 0) {
+            waitHandles.push_back(m_input.Fd());
+        }
 
-        long timeDiff = (timeSinceBoot.tv_sec - m_lastUpdate.tv_sec) * 1000000000UL +
-                        (timeSinceBoot.tv_nsec - m_lastUpdate.tv_nsec);
-        if (timeDiff && timeDiff < m_targetFrameIntervalThreshold) {
-            usleep((m_targetFrameInterval - timeDiff) / 1000); // Sleep the remaining time
+        if (m_wakeFds[0] >= 0) {
+            waitHandles.push_back(m_wakeFds[0]);
         }
+
+        timespec waitStart, waitEnd;
+        clock_gettime(CLOCK_BOOTTIME, &waitStart);
+        Lemon::WaitForKernelObject(waitHandles.data(), waitHandles.size(), timeout);
+        clock_gettime(CLOCK_BOOTTIME, &waitEnd);
+
+        m_compositor.AddIdleTime(TimeDifference(waitEnd, waitStart));
+    }
+}
+
+void WM::Wake() {
+    if (m_wakeFds[1] >= 0 && !m_wakePending.exchange(true)) {
+        char c = 0;
+        write(m_wakeFds[1], &c, 1);
     }
 }
 
@@ -59,7 +97,7 @@ void WM::OnMouseDown(bool isRightButton) {
     if (m_showContextMenu && m_contextMenu.bounds.Contains(m_input.mouse.pos)) {
         return;
     }
-    m_showContextMenu = false;
+    HideContextMenu();
 
     for (auto it = m_windows.rbegin(); it != m_windows.rend(); ++it) {
         WMWindow* win = *it;
@@ -125,14 +163,14 @@ void WM::OnMouseUp(bool isRightButton) {
                 // Send the window command
                 m_contextMenu.window->SendEvent(
                     LemonEvent{.event = EventWindowCommand, .windowCmd = static_cast<uint16_t>(ent.id)});
-                m_showContextMenu = false;
+                HideContextMenu();
                 break; // Found the right menu entry
             }
         }
         return;
     }
 
-    m_showContextMenu = false;
+    HideContextMenu();
 
     if (!m_activeWindow) {
         return; // Only send mouse up events to the active window
@@ -307,6 +345,13 @@ void WM::DestroyWindow(WMWindow* win) {
     delete win;
 }
 
+void WM::HideContextMenu() {
+    if (m_showContextMenu) {
+        m_compositor.Invalidate(m_contextMenu.bounds); // Redraw whatever was under the menu
+        m_showContextMenu = false;
+    }
+}
+
 void WM::BroadcastWindowState(WMWindow* win) {
     if (win->NoShellEvents()) {
         return; // Dont send events for these windows
@@ -435,6 +480,8 @@ void WM::OnDisplayContextMenu(const Lemon::Handle&, int64_t windowID, int32_t x,
         return;
     }
 
+    HideContextMenu();
+
     m_contextMenu.bounds = {win->GetPosition() + (vector2i_t){x, y}, {CONTEXT_MENU_ITEM_WIDTH + 10, 12}};
     if (win->ShouldDrawDecoration()) {
         m_contextMenu.bounds.y += WMWindow::theme.titlebarHeight + WMWindow::theme.borderWidth;
@@ -465,6 +512,7 @@ void WM::OnDisplayContextMenu(const Lemon::Handle&, int64_t windowID, int32_t x,
 
     m_contextMenu.window = win;
     m_showContextMenu = true;
+    m_compositor.Invalidate(m_contextMenu.bounds);
 }
 
 void WM::OnPong(const Lemon::Handle&, int64_t windowID) {
@@ -512,6 +560,16 @@ void WM::OnGetScreenBounds(const Lemon::Handle& client) {
 
 void WM::OnReloadConfig(const Lemon::Handle&) {}
 
+void WM::OnInvalidateWindow(const Lemon::Handle&, int64_t windowID) {
+    // The message only wakes the main loop,
+    // the compositor picks up the damage from the window buffer's dirty flag
+    WMWindow* win = GetWindowFromID(windowID);
+    if (!win) {
+        Lemon::Logger::Warning("OnInvalidateWindow: Invalid Window ID: {}", windowID);
+        return;
+    }
+}
+
 void WM::OnSubscribeToWindowEvents(const Lemon::Handle& client) {
     auto endp = std::make_unique<LemonWMClientEndpoint>(client);
     for (WMWindow* win : m_windows) {
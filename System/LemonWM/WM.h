@@ -8,6 +8,7 @@
 #include <Lemon/IPC/Interface.h>
 #include <Lemon/Services/lemon.lemonwm.h>
 
+#include <atomic>
 #include <list>
 
 #define CONTEXT_MENU_ITEM_WIDTH 100
@@ -29,6 +30,8 @@ public:
     }
 
     void Run();
+    // Wake the main loop from another thread
+    void Wake();
 
     inline Compositor& Compositor() { return m_compositor; }
     inline InputManager& Input() { return m_input; }
@@ -48,7 +51,6 @@ public:
         m_targetFramerate = fps;
         if (fps > 0) {
             m_targetFrameInterval = 1000000000 / fps;
-            m_targetFrameIntervalThreshold = m_targetFrameInterval / 3 * 2;
         }
     }
 
@@ -65,6 +67,8 @@ private:
 
     void DestroyWindow(WMWindow* win);
 
+    void HideContextMenu();
+
     void BroadcastCreatedWindow(WMWindow* win);
     void BroadcastDestroyedWindow(WMWindow* win);
 
@@ -88,12 +92,16 @@ private:
     void OnGetScreenBounds(const Lemon::Handle& client) override;
     void OnReloadConfig(const Lemon::Handle& client) override;
     void OnSubscribeToWindowEvents(const Lemon::Handle& client) override;
+    void OnInvalidateWindow(const Lemon::Handle& client, int64_t windowID) override;
 
-    timespec m_lastUpdate;
-    long m_targetFramerate = 0;              // Used for framerate limiter
-    long m_targetFrameIntervalThreshold = 0; // The maximum time difference to thread sleep
+    timespec m_lastFrame = {0, 0}; // When the last frame was rendered
+    long m_targetFramerate = 0;    // Used for framerate limiter
     long m_targetFrameInterval = 0;
 
+    // Pipe used by Wake(), at most one byte is ever pending
+    int m_wakeFds[2] = {-1, -1};
+    std::atomic<bool> m_wakePending = false;
+
     std::string m_systemTheme = "/system/lemon/resources/themes/default.json";
 
     Lemon::Interface m_messageInterface;
@@ -57,8 +57,15 @@ void WMWindow::DrawDecorationClip(const Rect& clip, Surface* surface) {
 }
 
 void WMWindow::DrawClip(const Rect& clip, Surface* surface) {
-    m_buffer->drawing = 1;
-    m_windowSurface.buffer = m_buffer->currentBuffer ? (m_buffer2) : (m_buffer1);
+    // Claim the front buffer, if the client swaps buffers before we have set drawing try again.
+    // Once drawing is set the client will wait for us before painting to the buffer.
+    uint64_t current;
+    do {
+        current = __atomic_load_n(&m_buffer->currentBuffer, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&m_buffer->drawing, current + 1, __ATOMIC_SEQ_CST);
+    } while (__atomic_load_n(&m_buffer->currentBuffer, __ATOMIC_SEQ_CST) != current);
+
+    m_windowSurface.buffer = current ? (m_buffer2) : (m_buffer1);
 
     Rect clipCopy = clip;
     clipCopy.pos -= m_contentRect.pos;
@@ -69,7 +76,46 @@ void WMWindow::DrawClip(const Rect& clip, Surface* surface) {
         surface->Blit(&m_windowSurface, clip.pos, clipCopy);
     }
 
-    m_buffer->drawing = 0;
+    __atomic_store_n(&m_buffer->drawing, 0, __ATOMIC_RELEASE);
+}
+
+bool WMWindow::ConsumeDamage(std::vector<Rect>& damage) {
+    damage.clear();
+
+    int spins = 0;
+    while (__atomic_exchange_n(&m_buffer->damageLock, 1, __ATOMIC_ACQUIRE)) {
+        if (++spins >= DAMAGE_LOCK_SPIN_COUNT) {
+            // Assume everything has changed
+            bool dirty = IsDirtyAndClear();
+            if (dirty) {
+                damage.push_back(m_contentRect);
+            }
+            return dirty;
+        }
+    }
+
+    if (!IsDirtyAndClear()) {
+        __atomic_store_n(&m_buffer->damageLock, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    uint32_t count = m_buffer->damageCount;
+    if (!count || count > WINDOW_DAMAGE_MAX) {
+        damage.push_back(m_contentRect);
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            Rect r = m_buffer->damage[i];
+            r.pos += m_contentRect.pos;
+
+            // The client may have passed anything
+            if (r.Intersects(m_contentRect)) {
+                damage.push_back(r.GetIntersect(m_contentRect));
+            }
+        }
+    }
+
+    __atomic_store_n(&m_buffer->damageLock, 0, __ATOMIC_RELEASE);
+    return true;
 }
 
 int WMWindow::GetResizePoint(Vector2i absolutePosition) const {
@@ -109,12 +155,19 @@ void WMWindow::Relocate(int x, int y) {
 }
 
 void WMWindow::Resize(int width, int height) {
-    long e = Lemon::DestroySharedMemory(m_bufferKey);
-    assert(!e);
-
     m_size = {width, height};
 
-    CreateWindowBuffer();
+    // Clients unmap the buffer before asking for a resize,
+    // so it can usually be resized in place instead of recreated.
+    if (Lemon::ResizeSharedMemory(m_bufferKey, WindowBufferSize(), reinterpret_cast<void**>(&m_buffer))) {
+        long e = Lemon::DestroySharedMemory(m_bufferKey);
+        assert(!e);
+
+        CreateWindowBuffer();
+    } else {
+        UpdateWindowBuffer();
+    }
+
     Queue(Lemon::Message(LemonWMServer::ResponseResize, LemonWMServer::ResizeResponse{m_bufferKey}));
     UpdateWindowRects();
 
@@ -186,18 +239,29 @@ void WMWindow::UpdateWindowRects() {
     }
 }
 
-void WMWindow::CreateWindowBuffer() {
+size_t WMWindow::WindowBufferSize() const {
     // Size of each buffer for the window
     // Aligned to 32 bytes
     unsigned bufferSize = (m_size.x * m_size.y * 4 + 0x1F) & (~0x1FULL);
+
+    return ((sizeof(GUI::WindowBuffer) + 0x1F) & (~0x1FULL)) + bufferSize * 2;
+}
+
+void WMWindow::CreateWindowBuffer() {
     if(m_bufferKey){
         Lemon::UnmapSharedMemory(m_buffer, m_bufferKey);
     }
 
-    m_bufferKey = Lemon::CreateSharedMemory(((sizeof(GUI::WindowBuffer) + 0x1F) & (~0x1FULL)) + bufferSize * 2,
-                                            SMEM_FLAGS_SHARED);
+    // Window buffers get completely painted so large ones may as well be backed by hugepages
+    m_bufferKey = Lemon::CreateSharedMemory(WindowBufferSize(), SMEM_FLAGS_SHARED | SMEM_FLAGS_HUGEPAGES);
     m_buffer = reinterpret_cast<GUI::WindowBuffer*>(Lemon::MapSharedMemory(m_bufferKey));
 
+    UpdateWindowBuffer();
+}
+
+void WMWindow::UpdateWindowBuffer() {
+    unsigned bufferSize = (m_size.x * m_size.y * 4 + 0x1F) & (~0x1FULL);
+
     memset(m_buffer, 0, sizeof(GUI::WindowBuffer));
     m_buffer->buffer1Offset = ((sizeof(GUI::WindowBuffer) + 0x1F) & (~0x1FULL));
     m_buffer->buffer2Offset = ((sizeof(GUI::WindowBuffer) + 0x1F) & (~0x1FULL)) + bufferSize;
@@ -4,8 +4,12 @@
 #include <Lemon/Graphics/Types.h>
 
 #include <string>
+#include <vector>
 
 #define RESIZE_HANDLE_SIZE 7
+// Times to try for the damage lock before assuming the whole window is damaged,
+// the client only holds it briefly so this stops a misbehaving client from stalling the WM
+#define DAMAGE_LOCK_SPIN_COUNT 1000
 #define MIN_WINDOW_RESIZE_WIDTH 50
 #define MIN_WINDOW_RESIZE_HEIGHT 50
 
@@ -81,12 +85,15 @@ public:
     // This will get the window content size accounting for the window decorations
     Vector2i NewWindowSizeFromRect(const Rect& rect) const;
 
+    inline bool IsDirty() const { return __atomic_load_n(&m_buffer->dirty, __ATOMIC_ACQUIRE); }
+
     // Get whether the window buffer is dirty and regardless clear it
-    inline bool IsDirtyAndClear() {
-        bool isDirty = m_buffer->dirty;
-        m_buffer->dirty = 0;
-        return isDirty;
-    }
+    // The client only notifies the WM when the dirty flag was clear
+    inline bool IsDirtyAndClear() { return __atomic_exchange_n(&m_buffer->dirty, 0, __ATOMIC_ACQ_REL); }
+
+    // Clear the dirty flag and get the regions (relative to the screen) which have changed
+    // Returns false if the window buffer is not dirty
+    bool ConsumeDamage(std::vector<Rect>& damage);
 
     inline void SendEvent(const Lemon::LemonEvent& event) {
         LemonWMClientEndpoint::SendEvent(m_id, event.event, event.data);
@@ -110,7 +117,10 @@ public:
 
 private:
     void UpdateWindowRects();
+    size_t WindowBufferSize() const;
     void CreateWindowBuffer();
+    // Lays out the window buffer after it has been (re)mapped
+    void UpdateWindowBuffer();
 
     // Shared memory key for buffer
     int64_t m_bufferKey = 0;
@@ -29,16 +29,18 @@ struct User{
 std::map<std::string, User> users;
 
 void OnOKPress(void*){
-	if(users.find(usernameBox->contents.front()) != users.end()){
-		User& user = users.at(usernameBox->contents.front());
+	std::string username = usernameBox->GetText();
+	if(users.find(username) != users.end()){
+		User& user = users.at(username);
 
+		std::string password = passwordBox->GetText();
 		SHA256 passwordHash;
-		passwordHash.Update(passwordBox->contents.front().data(), passwordBox->contents.front().length());
+		passwordHash.Update(password.data(), password.length());
 
 		if(user.hash.compare(passwordHash.GetHash())){
 			char buf[128];
 			printf("Actual hash: %s, inserted hash: %s\n", user.hash.c_str(), passwordHash.GetHash().c_str());
-			snprintf(buf, 128, "Incorrect password for '%s'!", usernameBox->contents.front().c_str());
+			snprintf(buf, 128, "Incorrect password for '%s'!", username.c_str());
 			Lemon::GUI::DisplayMessageBox("Incorrect Password", buf);
 			return;
 		}
@@ -54,7 +56,7 @@ void OnOKPress(void*){
 		exit(0);
 	} else {
 		char buf[128];
-		snprintf(buf, 128, "Unknown user '%s'", usernameBox->contents.front().c_str());
+		snprintf(buf, 128, "Unknown user '%s'", username.c_str());
 		Lemon::GUI::DisplayMessageBox("Invalid Username", buf);
 		return;
 	}
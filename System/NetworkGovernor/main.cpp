@@ -295,6 +295,10 @@ int main() {
             continue; // Ignore . and ..
         }
 
+        if (strcmp(entry->d_name, "lo") == 0) {
+            continue; // The loopback adapter is always configured as 127.0.0.1
+        }
+
         int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
         if (sock < 0) {
             perror("Error creating UDP socket");
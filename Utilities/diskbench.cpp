@@ -0,0 +1,193 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Lemon/System/ABI/Storage.h>
+
+#define MAX_JOBS 16
+
+struct Job {
+    pthread_t thread;
+    int index;
+
+    uint64_t ops = 0;
+    uint64_t totalLatency = 0; // Microseconds
+    uint64_t maxLatency = 0;
+    int error = 0;
+};
+
+int device;
+size_t blockSize = 4096;
+size_t regionSize = 64 * 1024 * 1024; // Bytes of the device covered by the test
+int jobCount = 1;
+bool randomAccess = false;
+bool writeTest = false;
+
+static inline uint64_t Microseconds() {
+    timespec t;
+    clock_gettime(CLOCK_BOOTTIME, &t);
+    return t.tv_sec * 1000000ULL + t.tv_nsec / 1000;
+}
+
+static inline uint64_t XorShift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+void* RunJob(void* arg) {
+    Job* job = reinterpret_cast<Job*>(arg);
+
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(malloc(blockSize));
+    memset(buffer, job->index, blockSize);
+
+    // Sequential jobs each get their own part of the region
+    uint64_t blocks = regionSize / blockSize;
+    uint64_t opsPerJob = blocks / jobCount;
+    uint64_t first = opsPerJob * job->index;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL * (job->index + 1);
+
+    for (uint64_t i = 0; i < opsPerJob; i++) {
+        uint64_t block = randomAccess ? (XorShift(seed) % blocks) : (first + i);
+        off_t offset = block * blockSize;
+
+        uint64_t start = Microseconds();
+        ssize_t ret;
+        if (writeTest) {
+            ret = pwrite(device, buffer, blockSize, offset);
+        } else {
+            ret = pread(device, buffer, blockSize, offset);
+        }
+        uint64_t latency = Microseconds() - start;
+
+        if (ret != (ssize_t)blockSize) {
+            job->error = (ret < 0) ? errno : EIO;
+            break;
+        }
+
+        job->ops++;
+        job->totalLatency += latency;
+        if (latency > job->maxLatency) {
+            job->maxLatency = latency;
+        }
+    }
+
+    free(buffer);
+    return nullptr;
+}
+
+void PrintUsage(const char* name) {
+    printf("Usage: %s [-b block size] [-s size in MB] [-j jobs] [-r] [-w] <device>\n"
+           "    -r  Random offsets instead of sequential\n"
+           "    -w  Write instead of read, destroys the data on the device!\n",
+           name);
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:j:rwh")) >= 0) {
+        switch (opt) {
+        case 'b':
+            blockSize = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            regionSize = strtoul(optarg, NULL, 10) * 1024 * 1024;
+            break;
+        case 'j':
+            jobCount = atoi(optarg);
+            break;
+        case 'r':
+            randomAccess = true;
+            break;
+        case 'w':
+            writeTest = true;
+            break;
+        case 'h':
+        case '?':
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind < 1) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (!blockSize || blockSize % 512) {
+        fprintf(stderr, "Block size must be a multiple of 512\n");
+        return 1;
+    }
+
+    if (jobCount < 1 || jobCount > MAX_JOBS) {
+        fprintf(stderr, "Jobs must be between 1 and %d\n", MAX_JOBS);
+        return 1;
+    }
+
+    if (regionSize / blockSize < (size_t)jobCount) {
+        fprintf(stderr, "Size too small for %d jobs of %lu byte blocks\n", jobCount, blockSize);
+        return 1;
+    }
+
+    device = open(argv[optind], writeTest ? O_RDWR : O_RDONLY);
+    if (device < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    DiskStatistics before;
+    bool haveStats = !ioctl(device, IoCtlDiskGetStatistics, &before);
+
+    Job jobs[MAX_JOBS];
+    uint64_t start = Microseconds();
+    for (int i = 0; i < jobCount; i++) {
+        jobs[i].index = i;
+        pthread_create(&jobs[i].thread, nullptr, RunJob, &jobs[i]);
+    }
+
+    uint64_t ops = 0;
+    uint64_t totalLatency = 0;
+    uint64_t maxLatency = 0;
+    for (int i = 0; i < jobCount; i++) {
+        pthread_join(jobs[i].thread, nullptr);
+
+        if (jobs[i].error) {
+            fprintf(stderr, "Job %d failed after %lu operations: %s\n", i, jobs[i].ops, strerror(jobs[i].error));
+        }
+
+        ops += jobs[i].ops;
+        totalLatency += jobs[i].totalLatency;
+        if (jobs[i].maxLatency > maxLatency) {
+            maxLatency = jobs[i].maxLatency;
+        }
+    }
+    uint64_t elapsed = Microseconds() - start + 1;
+
+    printf("%s %s: %lu byte blocks, %d job(s)\n", randomAccess ? "random" : "sequential", writeTest ? "write" : "read",
+           blockSize, jobCount);
+    printf("    %lu IOPS, %lu KB/s\n", ops * 1000000 / elapsed, ops * blockSize * 1000000 / 1024 / elapsed);
+    printf("    latency: avg %lu us, max %lu us\n", ops ? totalLatency / ops : 0, maxLatency);
+
+    DiskStatistics after;
+    if (haveStats && !ioctl(device, IoCtlDiskGetStatistics, &after)) {
+        uint64_t requests = (after.reads + after.writes) - (before.reads + before.writes);
+        uint64_t queueTime = (after.readTime + after.writeTime) - (before.readTime + before.writeTime);
+
+        printf("    disk: %lu requests, %lu commands, %lu merged, %lu errors\n", requests,
+               after.commands - before.commands, after.merges - before.merges, after.errors - before.errors);
+        printf("    disk: avg latency %lu us, max queue depth %u\n", requests ? queueTime / requests : 0,
+               after.maxQueueDepth);
+    }
+
+    close(device);
+    return 0;
+}
@@ -7,6 +7,9 @@
 #include <errno.h>
 #include <dirent.h>
 #include <string>
+#include <algorithm>
+
+#include <Lemon/System/Filesystem.h>
 
 int help = 0;
 int inode = 0;
@@ -14,16 +17,16 @@ int size = 0;
 int listDirectories = 0;
 int recursive = 0;
 
-void DisplayEntry(const char* path, struct stat& st){
+void DisplayEntry(const char* path, mode_t mode, off_t fileSize){
     std::string entryString = "";
 
-    if(S_ISDIR(st.st_mode)){
+    if(S_ISDIR(mode)){
         entryString += "\e[95m"; // Magneta foregrouud
-    } else if(S_ISLNK(st.st_mode)){
+    } else if(S_ISLNK(mode)){
         entryString += "\e[93m"; // Orange foregrouud
-    } else if(S_ISCHR(st.st_mode)){
+    } else if(S_ISCHR(mode)){
         entryString += "\e[96m"; // Cyan foreground
-    } else if(S_ISBLK(st.st_mode)){
+    } else if(S_ISBLK(mode)){
         entryString += "\e[94m"; // Blue foreground
     }  else {
         entryString += "\e[31m"; // Red foregrouud
@@ -32,7 +35,7 @@ void DisplayEntry(const char* path, struct stat& st){
     entryString += path;
 
     if(size){
-        printf("\e[0m%08lu K  %s\n", st.st_size / 1024, entryString.c_str());
+        printf("\e[0m%08lu K  %s\n", fileSize / 1024, entryString.c_str());
     } else {
         printf("%s\n", entryString.c_str());
     }
@@ -42,44 +45,45 @@ void DisplayPath(const char* path, bool displayPath = false){
     if(listDirectories){
         struct stat sResult;
         stat(path, &sResult);
-        DisplayEntry(path, sResult);
+        DisplayEntry(path, sResult.st_mode, sResult.st_size);
     } else {
         struct stat sResult;
         int ret = stat(path, &sResult);
         if(ret){
-            fprintf(stderr, "ls: %s: %s", path, strerror(errno));
+            fprintf(stderr, "ls: %s: %s\n", path, strerror(errno));
             return;
         }
 
         if(!S_ISDIR(sResult.st_mode)){
-            DisplayEntry(path, sResult);
+            DisplayEntry(path, sResult.st_mode, sResult.st_size);
             return;
         } else {
             if(displayPath)
                 printf("%s:\n", path);
 
-            struct dirent** entries;
-            int entryCount = scandir(path, &entries, static_cast<int(*)(const dirent*)>([](const dirent* d) -> int { return strcmp(d->d_name, "..") && strcmp(d->d_name, "."); }), static_cast<int(*)(const dirent**, const dirent**)>([](const dirent** a, const dirent**b) { return strcmp((*a)->d_name, (*b)->d_name); }));
-
-            int i = 0;
-            while(i < entryCount){
-                struct dirent* dirent = entries[i++];
+            // Get the attributes along with the entries instead of a stat for every entry
+            std::vector<DirectoryEntryPlus> entries;
+            if(Lemon::ListDirectory(path, entries)){
+                fprintf(stderr, "ls: %s: %s\n", path, strerror(errno));
+                return;
+            }
 
-                if(!strlen(dirent->d_name)) continue;
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [](const DirectoryEntryPlus& e) -> bool {
+                return !strlen(e.name) || !strcmp(e.name, "..") || !strcmp(e.name, ".");
+            }), entries.end());
+            std::sort(entries.begin(), entries.end(), [](const DirectoryEntryPlus& a, const DirectoryEntryPlus& b) {
+                return strcmp(a.name, b.name) < 0;
+            });
 
+            for(const DirectoryEntryPlus& entry : entries){
                 if(recursive){
                     std::string dirPath = path;
                     dirPath.append("/");
-                    dirPath.append(dirent->d_name);
+                    dirPath.append(entry.name);
 
                     DisplayPath(dirPath.c_str(), true);
                 } else {
-                    std::string dirPath = path;
-                    dirPath.append("/");
-                    dirPath.append(dirent->d_name);
-                    struct stat sResult;
-                    stat(dirPath.c_str(), &sResult);
-                    DisplayEntry(dirent->d_name, sResult);
+                    DisplayEntry(entry.name, entry.mode, entry.size);
                 }
             }
         }